@@ -130,7 +130,7 @@ typedef intptr_t ssize_t;
  * Current version of the library.
  * 0x01093001 = 1.9.30-1.
  */
-#define MHD_VERSION 0x00094801
+#define MHD_VERSION 0x00094818
 
 /**
  * MHD-internal return code for "YES".
@@ -160,9 +160,11 @@ typedef intptr_t ssize_t;
 #ifdef SIZE_MAX
 #define MHD_CONTENT_READER_END_OF_STREAM SIZE_MAX
 #define MHD_CONTENT_READER_END_WITH_ERROR (SIZE_MAX - 1)
+#define MHD_CONTENT_READER_WAIT (SIZE_MAX - 2)
 #else
 #define MHD_CONTENT_READER_END_OF_STREAM ((size_t) -1LL)
 #define MHD_CONTENT_READER_END_WITH_ERROR (((size_t) -1LL) - 1)
+#define MHD_CONTENT_READER_WAIT (((size_t) -1LL) - 2)
 #endif
 
 #ifndef _MHD_EXTERN
@@ -656,7 +658,24 @@ enum MHD_FLAG
    * kernel >= 3.6.  On other systems, using this option cases #MHD_start_daemon
    * to fail.
    */
-  MHD_USE_TCP_FASTOPEN = 16384
+  MHD_USE_TCP_FASTOPEN = 16384,
+
+  /**
+   * Use Linux `io_uring` instead of `select()`, `poll()` or `epoll()`
+   * for the event loop.  Accepts, reads and writes are submitted to a
+   * per-thread ring and their completions drive the connections,
+   * saving most of the per-request system calls.  Requires a kernel
+   * >= 5.11; using the option on other systems will cause
+   * #MHD_start_daemon to fail.  Not supported with
+   * #MHD_USE_THREAD_PER_CONNECTION or #MHD_USE_SSL.
+   */
+  MHD_USE_IO_URING = 32768,
+
+  /**
+   * Run using an internal thread (or thread pool) driving `io_uring`.
+   * This option is only available on Linux.
+   */
+  MHD_USE_IO_URING_INTERNALLY = MHD_USE_SELECT_INTERNALLY | MHD_USE_IO_URING
 
 };
 
@@ -672,6 +691,43 @@ enum MHD_FLAG
 typedef void (*MHD_LogCallback)(void *cls, const char *fm, va_list ap);
 
 
+/**
+ * @brief How a daemon with a thread pool assigns new connections
+ * to its workers (#MHD_OPTION_WORKER_DISPATCH_POLICY).
+ */
+enum MHD_WorkerDispatchPolicy
+{
+
+  /**
+   * Connections are handled by the worker that accepted them;
+   * connections added with #MHD_add_connection() are assigned
+   * based on the value of the socket.  Only a worker that has
+   * reached its connection limit is skipped.
+   */
+  MHD_DISPATCH_DEFAULT = 0,
+
+  /**
+   * Assign connections to the workers in turn.
+   */
+  MHD_DISPATCH_ROUND_ROBIN = 1,
+
+  /**
+   * Assign each connection to the worker with the smallest
+   * number of active (and not yet started) connections.
+   */
+  MHD_DISPATCH_LEAST_CONNECTIONS = 2,
+
+  /**
+   * Assign each connection to the worker with the smallest
+   * number of response bytes that are still waiting to be sent,
+   * as far as their size is known.  Useful if some connections
+   * stream large responses.
+   */
+  MHD_DISPATCH_LEAST_QUEUED_BYTES = 3
+
+};
+
+
 /**
  * @brief MHD options.
  *
@@ -975,7 +1031,218 @@ enum MHD_OPTION
    * value is used. This option should be followed by an `unsigned int`
    * argument.
    */
-  MHD_OPTION_LISTEN_BACKLOG_SIZE = 28
+  MHD_OPTION_LISTEN_BACKLOG_SIZE = 28,
+
+  /**
+   * If set to true and #MHD_OPTION_THREAD_POOL_SIZE is used, give
+   * each worker thread its own listen socket bound to the same
+   * address (using SO_REUSEPORT), so that the kernel distributes
+   * incoming connections among the workers instead of all workers
+   * waking up for each connection on a shared socket.  The first
+   * worker uses the socket returned by #MHD_DAEMON_INFO_LISTEN_FD
+   * (which is also what #MHD_quiesce_daemon returns); the sockets of
+   * the other workers are owned and closed by MHD.  Implies
+   * #MHD_OPTION_LISTENING_ADDRESS_REUSE, and cannot be combined with
+   * disallowing address reuse.  Ignored without a thread pool.
+   * This option should be followed by an `unsigned int` argument.
+   */
+  MHD_OPTION_LISTEN_SOCKET_PER_WORKER = 29,
+
+  /**
+   * After how many milliseconds of inactivity should a connection
+   * automatically be timed out?  Like #MHD_OPTION_CONNECTION_TIMEOUT,
+   * but with millisecond granularity; the last of the two options
+   * given wins.  This option should be followed by an `unsigned int`
+   * argument (zero for no timeout).
+   */
+  MHD_OPTION_CONNECTION_TIMEOUT_MS = 30,
+
+  /**
+   * How should a daemon with a thread pool assign new connections
+   * to its workers?  With any policy other than
+   * #MHD_DISPATCH_DEFAULT, the worker that accepts a connection
+   * hands it over to the worker selected by the policy, which
+   * starts processing it in its next event loop iteration.
+   * Ignored without a thread pool.  This option should be
+   * followed by an `enum MHD_WorkerDispatchPolicy` argument.
+   */
+  MHD_OPTION_WORKER_DISPATCH_POLICY = 31,
+
+  /**
+   * If set to true, an idle worker of the thread pool takes over
+   * connections that were assigned to a busy worker but that this
+   * worker did not start to process yet (because it is, for
+   * example, stuck in a slow access handler).  Only has an effect
+   * together with a #MHD_OPTION_WORKER_DISPATCH_POLICY other than
+   * #MHD_DISPATCH_DEFAULT.  This option should be followed by an
+   * `unsigned int` argument.
+   */
+  MHD_OPTION_WORKER_WORK_STEALING = 32,
+
+  /**
+   * Run the threads created by MHD only on the given CPUs.  With
+   * #MHD_OPTION_THREAD_POOL_SIZE, worker number i is pinned to CPU
+   * i modulo the number of CPUs given; otherwise the internal
+   * select thread and the threads of
+   * #MHD_USE_THREAD_PER_CONNECTION run on all of the given CPUs.
+   * As the memory of a connection is allocated and first used by
+   * the thread handling the connection, it is then local to the
+   * NUMA node of that thread.  Only supported if
+   * #MHD_FEATURE_CPU_AFFINITY is available.  This option should be
+   * followed by two arguments: an `unsigned int` with the number of
+   * CPUs and a `const unsigned int *` pointing to the array of CPU
+   * numbers (which is copied).
+   */
+  MHD_OPTION_CPU_AFFINITY = 33,
+
+  /**
+   * Number of threads of the offload pool on which access handler
+   * calls are run for requests marked with #MHD_offload_request().
+   * Requires #MHD_USE_SUSPEND_RESUME and cannot be used with
+   * #MHD_USE_THREAD_PER_CONNECTION (where the access handler runs
+   * on the thread of the connection anyway).  Default is 0 (no
+   * offload pool).  This option should be followed by an `unsigned
+   * int` argument.
+   */
+  MHD_OPTION_OFFLOAD_POOL_SIZE = 34,
+
+  /**
+   * Maximum number of closed connections that each thread handling
+   * connections keeps (together with their memory pools) to reuse
+   * them for the next connections it accepts.  Once the cache is
+   * warm, accepting and closing connections then neither allocates
+   * nor maps memory.  Connections added with MHD_add_connection()
+   * may not be taken from the cache.  Default is 0 (connections are
+   * freed when they are closed).  This option should be followed
+   * by an `unsigned int` argument.
+   */
+  MHD_OPTION_CONNECTION_CACHE_SIZE = 35,
+
+  /**
+   * Register a function that decides which request headers (and
+   * footers) to keep.  Headers it rejects are discarded while the
+   * request is parsed, so they take no memory in the connection's
+   * pool and are not visible to #MHD_lookup_connection_value and
+   * friends.  The headers MHD needs to process the request
+   * ("Host", "Connection", "Content-Length", "Transfer-Encoding"
+   * and "Expect") are always kept without asking.
+   *
+   * This option should be followed by TWO pointers.  First a pointer
+   * to a function of type #MHD_HeaderFilterCallback and second a
+   * pointer to a closure to pass to it.  The second pointer maybe
+   * NULL.
+   */
+  MHD_OPTION_HEADER_FILTER = 36,
+
+  /**
+   * Register a function that is called as soon as the request line
+   * of a request was received, before any headers are parsed, and
+   * that may reject the request.  A rejected request is answered
+   * with a response given by the function (or the connection is
+   * closed without one) and then the connection is closed, without
+   * reading the rest of the request.  This is much cheaper than
+   * rejecting the request from the access handler, for example to
+   * shed load from scanners.
+   *
+   * This option should be followed by TWO pointers.  First a pointer
+   * to a function of type #MHD_RequestLineCallback and second a
+   * pointer to a closure to pass to it.  The second pointer maybe
+   * NULL.
+   */
+  MHD_OPTION_REQUEST_LINE_CALLBACK = 37,
+
+  /**
+   * Dispatch requests to the handlers registered with a router
+   * (see #MHD_router_create()).  Requests that match a route are
+   * passed to the handler of the route instead of the default
+   * #MHD_AccessHandlerCallback; the values captured by the path
+   * pattern are available as #MHD_ROUTE_PARAMETER_KIND.  Requests
+   * that match no route still go to the default handler.
+   *
+   * No more routes can be added to the router once it was given
+   * to a daemon, so it can be used by all threads of the daemon
+   * without locking.  It must not be destroyed before the daemon
+   * is stopped.
+   *
+   * This option should be followed by a `struct MHD_Router *`.
+   */
+  MHD_OPTION_ROUTER = 38,
+
+  /**
+   * Register responses that are sent for the given method and URL
+   * without calling the access handler, for example for health
+   * checks, "/robots.txt" or "/favicon.ico".  The URL must equal
+   * the (unescaped) path of the request; the arguments of the
+   * request are ignored.  The body of such a request is not read;
+   * if the request has one, the connection is closed after the
+   * response.  Static responses take precedence over the routes
+   * of #MHD_OPTION_ROUTER.
+   *
+   * This option should be followed by a pointer to an array of
+   * `struct MHD_StaticResponse`, terminated by an entry with a
+   * NULL @e url.  MHD copies the array and keeps a reference to
+   * each response, so the application may destroy its own
+   * references once the daemon is started.  The option can be
+   * given more than once.
+   */
+  MHD_OPTION_STATIC_RESPONSES = 39,
+
+  /**
+   * Send the bodies of responses from memory (such as those of
+   * #MHD_create_response_from_buffer() and
+   * #MHD_create_response_from_iovec()) with `MSG_ZEROCOPY` once at
+   * least this many bytes of the body remain to be sent: the kernel
+   * sends the data directly from the buffer of the response instead
+   * of copying it.  MHD keeps a reference to the response until the
+   * kernel reports that the data was sent, so the buffer is not
+   * released early.  This only pays off for large bodies (about
+   * 10 kB or more) sent to remote clients; the kernel copies the
+   * data for local clients anyway, in which case MHD stops using
+   * `MSG_ZEROCOPY` for the connection.  Only supported on Linux (see
+   * #MHD_FEATURE_ZEROCOPY), not with HTTPS, #MHD_USE_IO_URING or
+   * #MHD_USE_THREAD_PER_CONNECTION.
+   *
+   * This option should be followed by a `size_t`; 0 (the default)
+   * disables `MSG_ZEROCOPY`.
+   */
+  MHD_OPTION_ZEROCOPY_THRESHOLD = 40
+};
+
+
+/**
+ * Entry in an array of #MHD_OPTION_STATIC_RESPONSES.
+ */
+struct MHD_StaticResponse
+{
+
+  /**
+   * Method of the requests to answer (#MHD_HTTP_METHOD_GET,
+   * etc.), NULL for all methods.
+   */
+  const char *method;
+
+  /**
+   * Path of the requests to answer, NULL to terminate the array.
+   */
+  const char *url;
+
+  /**
+   * HTTP status code to send.
+   */
+  unsigned int status_code;
+
+  /**
+   * Response to send.
+   */
+  struct MHD_Response *response;
+
+  /**
+   * #MHD_YES to call the #MHD_OPTION_NOTIFY_COMPLETED callback
+   * (with a NULL request context) once the response was sent,
+   * #MHD_NO to not inform the application at all.
+   */
+  int notify_completed;
+
 };
 
 
@@ -1047,7 +1314,13 @@ enum MHD_ValueKind
   /**
    * HTTP footer (only for HTTP 1.1 chunked encodings).
    */
-  MHD_FOOTER_KIND = 16
+  MHD_FOOTER_KIND = 16,
+
+  /**
+   * Parameters captured by the path pattern of the route that
+   * matched the request (see #MHD_OPTION_ROUTER).
+   */
+  MHD_ROUTE_PARAMETER_KIND = 32
 };
 
 
@@ -1412,6 +1685,55 @@ typedef void
                                  enum MHD_ConnectionNotificationCode toe);
 
 
+/**
+ * Signature of the callback used by MHD to decide whether
+ * to keep a request header.
+ *
+ * @param cls client-defined closure
+ * @param connection connection handle; the request line was
+ *        already parsed, so the arguments of the URL can be
+ *        looked up with #MHD_lookup_connection_value
+ * @param name name of the header, as sent by the client
+ * @return #MHD_YES to keep the header, #MHD_NO to discard it
+ * @see #MHD_OPTION_HEADER_FILTER
+ * @ingroup request
+ */
+typedef int
+(*MHD_HeaderFilterCallback) (void *cls,
+                             struct MHD_Connection *connection,
+                             const char *name);
+
+
+/**
+ * Signature of the callback used by MHD to decide whether to
+ * process a request right after its request line was received.
+ *
+ * @param cls client-defined closure
+ * @param connection connection handle
+ * @param method the HTTP method used (#MHD_HTTP_METHOD_GET,
+ *        #MHD_HTTP_METHOD_PUT, etc.)
+ * @param url the requested url, as it will be passed to the
+ *        #MHD_AccessHandlerCallback
+ * @param[out] status_code HTTP status code to use for @a response
+ * @param[out] response set to the response to send if the request
+ *        is rejected; it is queued as by #MHD_queue_response, so
+ *        the application still has to destroy it (it can be reused
+ *        for many requests).  Leave NULL to close the connection
+ *        without a response.
+ * @return #MHD_YES to process the request normally,
+ *         #MHD_NO to reject it
+ * @see #MHD_OPTION_REQUEST_LINE_CALLBACK
+ * @ingroup request
+ */
+typedef int
+(*MHD_RequestLineCallback) (void *cls,
+                            struct MHD_Connection *connection,
+                            const char *method,
+                            const char *url,
+                            unsigned int *status_code,
+                            struct MHD_Response **response);
+
+
 /**
  * Iterator over key-value pairs.  This iterator
  * can be used to iterate over all of the cookies,
@@ -1442,7 +1764,8 @@ typedef int
  *
  * Note that returning zero will cause libmicrohttpd to try again.
  * Thus, returning zero should only be used in conjunction
- * with MHD_suspend_connection() to avoid busy waiting.
+ * with MHD_suspend_connection() to avoid busy waiting; returning
+ * #MHD_CONTENT_READER_WAIT is usually simpler.
  *
  * @param cls extra argument to the callback
  * @param pos position in the datastream to access;
@@ -1476,7 +1799,13 @@ typedef int
  *    does not know a response size and chunked encoding is not in
  *    use, then clients will not be able to tell the difference between
  *    #MHD_CONTENT_READER_END_WITH_ERROR and #MHD_CONTENT_READER_END_OF_STREAM.
- *    This is not a limitation of MHD but rather of the HTTP protocol.
+ *    This is not a limitation of MHD but rather of the HTTP protocol;
+ *  #MHD_CONTENT_READER_WAIT (-3) if no data is available yet; MHD will
+ *    then not call the content reader again for the connection until
+ *    the application calls #MHD_response_data_ready() for it.  This
+ *    requires #MHD_USE_SUSPEND_RESUME and does not work with
+ *    #MHD_USE_THREAD_PER_CONNECTION; otherwise, it is treated
+ *    like returning 0.
  */
 typedef ssize_t
 (*MHD_ContentReaderCallback) (void *cls,
@@ -1498,6 +1827,20 @@ typedef void
 (*MHD_ContentReaderFreeCallback) (void *cls);
 
 
+/**
+ * Called by libmicrohttpd once the data queued in a response for
+ * push (see #MHD_create_response_for_push()) fell to half of the
+ * high-water mark after #MHD_response_push() refused data.  May be
+ * called from any of MHD's threads, and occasionally when the push
+ * that was refused would now succeed anyway.
+ *
+ * @param cls closure
+ * @ingroup response
+ */
+typedef void
+(*MHD_ResponseDrainedCallback) (void *cls);
+
+
 /**
  * Iterator over key-value pairs where the value
  * maybe made available in increments and/or may
@@ -1959,6 +2302,109 @@ _MHD_EXTERN void
 MHD_resume_connection (struct MHD_Connection *connection);
 
 
+/**
+ * Signal that the content reader of the response queued for
+ * @a connection has new data, after it returned
+ * #MHD_CONTENT_READER_WAIT.  MHD will then call the content reader
+ * again.  Can be called from any thread, also before the content
+ * reader returned #MHD_CONTENT_READER_WAIT (in which case MHD calls
+ * it again right away); as with #MHD_resume_connection(), the
+ * daemon should use #MHD_USE_PIPE_FOR_SHUTDOWN for the connection to
+ * be processed immediately.  Must not be called once the request
+ * of the connection completed (see #MHD_OPTION_NOTIFY_COMPLETED).
+ *
+ * @param connection the connection with the response
+ */
+_MHD_EXTERN void
+MHD_response_data_ready (struct MHD_Connection *connection);
+
+
+/**
+ * Run all further calls of the #MHD_AccessHandlerCallback for the
+ * current request of @a connection on a thread of the offload pool
+ * (see #MHD_OPTION_OFFLOAD_POOL_SIZE), so that the handler may block
+ * (for example on a database) without stalling the other connections
+ * of the event loop.  MHD suspends the connection while such a call
+ * runs and resumes it once the call returns.  The handler must not
+ * suspend or resume the connection itself during an offloaded call.
+ *
+ * Must only be called from the #MHD_AccessHandlerCallback.  Applies
+ * to the current request only.
+ *
+ * @param connection the connection the request belongs to
+ * @return #MHD_YES on success, #MHD_NO if the daemon has no
+ *         offload pool (the calls then continue to be made
+ *         from the event loop)
+ */
+_MHD_EXTERN int
+MHD_offload_request (struct MHD_Connection *connection);
+
+
+/* **************** Request routing ***************** */
+
+/**
+ * Handle for a set of routes mapping the method and path of a
+ * request to an access handler.
+ */
+struct MHD_Router;
+
+
+/**
+ * Create an empty router.
+ *
+ * @return NULL on error (out of memory)
+ * @ingroup request
+ */
+_MHD_EXTERN struct MHD_Router *
+MHD_router_create (void);
+
+
+/**
+ * Add a route to @a router.  The path @a pattern must start with
+ * a "/" and can contain:
+ *
+ * - segments of the form "{name}", which match any non-empty
+ *   segment of the path; the matched value is made available to
+ *   the handler as #MHD_ROUTE_PARAMETER_KIND under "name";
+ * - a trailing "*", which makes the route match all paths that
+ *   start with the part of @a pattern before it.
+ *
+ * Everything else must match the path (after unescaping) exactly.
+ * If several routes match a path, fixed text is preferred over a
+ * "{name}" segment and both are preferred over a trailing "*".
+ *
+ * Routes can only be added before the router is passed to a
+ * daemon with #MHD_OPTION_ROUTER.
+ *
+ * @param router router to add the route to
+ * @param method HTTP method of the route (#MHD_HTTP_METHOD_GET,
+ *        etc.), NULL to match all methods
+ * @param pattern path pattern, see above
+ * @param handler handler for the requests matching the route
+ * @param handler_cls closure for @a handler
+ * @return #MHD_YES on success, #MHD_NO if @a pattern is malformed,
+ *         the route is already defined, the router is in use or
+ *         on error (out of memory)
+ * @ingroup request
+ */
+_MHD_EXTERN int
+MHD_router_add (struct MHD_Router *router,
+                const char *method,
+                const char *pattern,
+                MHD_AccessHandlerCallback handler,
+                void *handler_cls);
+
+
+/**
+ * Destroy a router.  All daemons using it must have been stopped.
+ *
+ * @param router router to destroy
+ * @ingroup request
+ */
+_MHD_EXTERN void
+MHD_router_destroy (struct MHD_Router *router);
+
+
 /* **************** Response manipulation functions ***************** */
 
 
@@ -1977,7 +2423,15 @@ enum MHD_ResponseFlags
    * do not (automatically) sent "Connection" headers and always
    * close the connection after generating the response.
    */
-  MHD_RF_HTTP_VERSION_1_0_ONLY = 1
+  MHD_RF_HTTP_VERSION_1_0_ONLY = 1,
+
+  /**
+   * The content reader callback of the response may be called
+   * concurrently for different connections the response is queued
+   * for.  By default, MHD serializes the calls to the content reader
+   * of a response.
+   */
+  MHD_RF_THREAD_SAFE_READER = 2
 
 };
 
@@ -2105,6 +2559,226 @@ MHD_create_response_from_buffer (size_t size,
 				 enum MHD_ResponseMemoryMode mode);
 
 
+/**
+ * A segment of the data of a response created with
+ * #MHD_create_response_from_iovec.
+ * @ingroup response
+ */
+struct MHD_IoVec
+{
+  /**
+   * Start of the data of the segment; must stay valid and unchanged
+   * until @e free_cb is called (or the response is destroyed).
+   */
+  const void *iov_base;
+
+  /**
+   * Number of bytes in the segment.
+   */
+  size_t iov_len;
+
+  /**
+   * Function to call once the response (and thus the segment) is
+   * no longer used, NULL for none.
+   */
+  MHD_ContentReaderFreeCallback free_cb;
+
+  /**
+   * Closure for @e free_cb.
+   */
+  void *free_cls;
+};
+
+
+/**
+ * Create a response object whose data is the concatenation of the
+ * given segments, without copying them.  The response object can be
+ * extended with header information and then be used any number of
+ * times.  On plain sockets, the segments are sent with as few system
+ * calls as possible (together with the headers); with TLS, they are
+ * combined into full records.
+ *
+ * @param iov segments of the data portion of the response; the array
+ *        itself is copied, the segments are not
+ * @param iovcnt number of entries in @a iov
+ * @return NULL on error (i.e. invalid arguments, out of memory);
+ *         in this case, the @e free_cb of the segments are not called
+ * @ingroup response
+ */
+_MHD_EXTERN struct MHD_Response *
+MHD_create_response_from_iovec (const struct MHD_IoVec *iov,
+                                unsigned int iovcnt);
+
+
+/**
+ * Create a response object whose data is pushed by the application
+ * with #MHD_response_push() while the response is being sent, for
+ * example for a stream of log lines or events.  The buffers are sent
+ * without copying them (on plain sockets) and released once sent.
+ * If the size is not known, the response uses chunked encoding (or
+ * ends by closing the connection) and the stream ends with
+ * #MHD_response_push_end().
+ *
+ * The response can only be queued for one connection.  With
+ * #MHD_USE_SUSPEND_RESUME (and without
+ * #MHD_USE_THREAD_PER_CONNECTION), the connection waits for pushed
+ * data without polling; the daemon should then also use
+ * #MHD_USE_PIPE_FOR_SHUTDOWN.
+ *
+ * @param size size of the data portion of the response,
+ *        #MHD_SIZE_UNKNOWN for unknown
+ * @param high_water number of queued bytes from which on
+ *        #MHD_response_push() refuses further data, 0 for no limit
+ * @param drained_cb function to call once queued data fell below half
+ *        of @a high_water after data was refused, NULL for none
+ * @param drained_cls closure for @a drained_cb
+ * @return NULL on error (i.e. out of memory)
+ * @ingroup response
+ */
+_MHD_EXTERN struct MHD_Response *
+MHD_create_response_for_push (uint64_t size,
+                              size_t high_water,
+                              MHD_ResponseDrainedCallback drained_cb,
+                              void *drained_cls);
+
+
+/**
+ * Append a buffer to the data of a response created with
+ * #MHD_create_response_for_push().  Can be called from any thread,
+ * also by several threads at the same time.
+ *
+ * @param response the response
+ * @param buf data to append; must stay valid and unchanged until
+ *        @a free_cb is called
+ * @param len number of bytes in @a buf, must not be 0
+ * @param free_cb function to call once @a buf was sent (or the
+ *        response is destroyed), NULL for none
+ * @param free_cls closure for @a free_cb
+ * @return #MHD_YES if the buffer was queued, #MHD_NO if it was not
+ *         (@a free_cb is then not called), because the queued data
+ *         reached the high-water mark (retry after the drained
+ *         callback was called), the stream was ended, @a len would
+ *         exceed the size of the response or on invalid arguments
+ * @ingroup response
+ */
+_MHD_EXTERN int
+MHD_response_push (struct MHD_Response *response,
+                   const void *buf,
+                   size_t len,
+                   MHD_ContentReaderFreeCallback free_cb,
+                   void *free_cls);
+
+
+/**
+ * End the data of a response created with
+ * #MHD_create_response_for_push().  Once the queued data is sent,
+ * the response is complete.  If the size of the response was given
+ * and not all of the data was pushed, the connection is closed with
+ * an error instead.  Must not be called concurrently with
+ * #MHD_response_push().
+ *
+ * @param response the response
+ * @return #MHD_NO on invalid arguments or if the stream was already
+ *         ended
+ * @ingroup response
+ */
+_MHD_EXTERN int
+MHD_response_push_end (struct MHD_Response *response);
+
+
+/**
+ * Handle for a broadcast channel, which sends each published event
+ * to all of its subscribers (for example for Server-Sent Events).
+ * @ingroup response
+ */
+struct MHD_Broadcast;
+
+
+/**
+ * What to do with a subscriber of a broadcast channel that does not
+ * keep up with the published events.
+ * @ingroup response
+ */
+enum MHD_BroadcastPolicy
+{
+
+  /**
+   * Do not send the events to the subscriber until its backlog
+   * drained.
+   */
+  MHD_BROADCAST_DROP = 0,
+
+  /**
+   * Close the connection of the subscriber.
+   */
+  MHD_BROADCAST_DISCONNECT = 1
+
+};
+
+
+/**
+ * Create a broadcast channel.  Each event published on the channel
+ * is copied once and sent to all subscribers without copying it
+ * again; each subscriber costs a pointer in the queue of its
+ * response.
+ *
+ * @param max_backlog number of bytes of events queued for a
+ *        subscriber from which on @a policy applies, 0 for no limit
+ * @param policy what to do with a subscriber whose backlog is full
+ * @return NULL on error (i.e. out of memory)
+ * @ingroup response
+ */
+_MHD_EXTERN struct MHD_Broadcast *
+MHD_broadcast_create (size_t max_backlog,
+                      enum MHD_BroadcastPolicy policy);
+
+
+/**
+ * Subscribe to the events of a broadcast channel.  Returns a response
+ * (of unknown size, see #MHD_create_response_for_push()) that
+ * receives the events published from now on; add headers (such as
+ * "Content-Type: text/event-stream"), queue it for the connection and
+ * destroy it as usual.  The subscription ends once the connection is
+ * done with the response and it was destroyed.  Can be called from
+ * any thread.
+ *
+ * @param bc the broadcast channel
+ * @return NULL on error (i.e. out of memory)
+ * @ingroup response
+ */
+_MHD_EXTERN struct MHD_Response *
+MHD_broadcast_subscribe (struct MHD_Broadcast *bc);
+
+
+/**
+ * Publish an event on a broadcast channel: queue it for all
+ * subscribers.  The data is copied once.  Can be called from any
+ * thread.
+ *
+ * @param bc the broadcast channel
+ * @param data the event, as it is to be sent
+ * @param size number of bytes in @a data, must not be 0
+ * @return #MHD_NO on error (i.e. invalid arguments, out of memory)
+ * @ingroup response
+ */
+_MHD_EXTERN int
+MHD_broadcast_publish (struct MHD_Broadcast *bc,
+                       const void *data,
+                       size_t size);
+
+
+/**
+ * Destroy a broadcast channel.  The responses of the subscribers end
+ * once the events queued for them are sent.
+ * Must not be called concurrently with #MHD_broadcast_publish().
+ *
+ * @param bc the broadcast channel
+ * @ingroup response
+ */
+_MHD_EXTERN void
+MHD_broadcast_destroy (struct MHD_Broadcast *bc);
+
+
 /**
  * Create a response object.  The response object can be extended with
  * header information and then be used any number of times.
@@ -2609,7 +3283,14 @@ enum MHD_CONNECTION_OPTION
    * as the number of seconds, given as an `unsigned int`.  Use
    * zero for no timeout.
    */
-  MHD_CONNECTION_OPTION_TIMEOUT
+  MHD_CONNECTION_OPTION_TIMEOUT,
+
+  /**
+   * Set a custom timeout for the given connection.  Specified
+   * as the number of milliseconds, given as an `unsigned int`.
+   * Use zero for no timeout.
+   */
+  MHD_CONNECTION_OPTION_TIMEOUT_MS
 
 };
 
@@ -2798,7 +3479,27 @@ enum MHD_FEATURE
    * offsets larger than 2 GiB. If not supported value of size+offset is
    * limited to 2 GiB.
    */
-  MHD_FEATURE_LARGE_FILE = 15
+  MHD_FEATURE_LARGE_FILE = 15,
+
+  /**
+   * Get whether `io_uring` is supported. If supported then flags
+   * #MHD_USE_IO_URING and #MHD_USE_IO_URING_INTERNALLY can be used
+   * (if the running kernel is recent enough).
+   */
+  MHD_FEATURE_IO_URING = 16,
+
+  /**
+   * Get whether the threads of MHD can be pinned to CPUs with
+   * #MHD_OPTION_CPU_AFFINITY.
+   */
+  MHD_FEATURE_CPU_AFFINITY = 17,
+
+  /**
+   * Get whether the bodies of responses can be sent with
+   * `MSG_ZEROCOPY`, see #MHD_OPTION_ZEROCOPY_THRESHOLD (if the
+   * running kernel is recent enough).
+   */
+  MHD_FEATURE_ZEROCOPY = 18
 };
 
 
@@ -0,0 +1,467 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file broadcast.c
+ * @brief sending published events to many connections
+ * @author Christian Grothoff
+ *
+ * Each subscriber of a broadcast channel is a response created with
+ * #MHD_create_response_for_push().  A published event is copied once
+ * into a reference counted buffer, and each subscriber gets a
+ * reference to it pushed into the queue of its response; the
+ * connections frame and send the buffer themselves.  The queue
+ * entries are allocated together with the event, so publishing
+ * costs one allocation and links one entry per subscriber.  The
+ * channel holds a reference to the response of each subscriber;
+ * once it holds the only one, the connection is done with the
+ * response and the subscriber is removed.
+ */
+
+#include "internal.h"
+#include "response.h"
+
+
+/**
+ * A published event, shared by the responses of the subscribers.
+ * Followed by the queue entries for the subscribers, the responses
+ * to signal and the data of the event (see event_create()).
+ */
+struct BroadcastEvent
+{
+
+#if ! HAVE_ATOMIC_BUILTINS
+  /**
+   * Mutex protecting @e reference_count.
+   */
+  MHD_mutex_ mutex;
+#endif
+
+  /**
+   * Number of responses (and publishers) using the event.
+   */
+  unsigned int reference_count;
+
+  /**
+   * Number of bytes of the event.
+   */
+  size_t size;
+
+};
+
+
+/**
+ * A subscriber of a broadcast channel.
+ */
+struct Subscriber
+{
+
+  /**
+   * Next subscriber in the DLL.
+   */
+  struct Subscriber *next;
+
+  /**
+   * Previous subscriber in the DLL.
+   */
+  struct Subscriber *prev;
+
+  /**
+   * Response of the subscriber; we hold a reference.
+   */
+  struct MHD_Response *response;
+
+};
+
+
+/**
+ * Handle for a broadcast channel.
+ */
+struct MHD_Broadcast
+{
+
+  /**
+   * Head of the DLL of subscribers.
+   */
+  struct Subscriber *subscribers_head;
+
+  /**
+   * Tail of the DLL of subscribers.
+   */
+  struct Subscriber *subscribers_tail;
+
+  /**
+   * Mutex protecting the DLL of subscribers.
+   */
+  MHD_mutex_ mutex;
+
+  /**
+   * Number of subscribers in the DLL.
+   */
+  unsigned int num_subscribers;
+
+  /**
+   * Number of queued bytes from which on @e policy applies, 0 for
+   * no limit.
+   */
+  size_t max_backlog;
+
+  /**
+   * What to do with subscribers whose backlog is full.
+   */
+  enum MHD_BroadcastPolicy policy;
+
+};
+
+
+/**
+ * Get the queue entries allocated with @a ev.
+ *
+ * @param ev the event
+ * @return array of the queue entries
+ */
+static struct MHD_PushBuffer *
+event_nodes (struct BroadcastEvent *ev)
+{
+  return (struct MHD_PushBuffer *) &ev[1];
+}
+
+
+/**
+ * Allocate an event with room for @a num subscribers and copy the
+ * data into it.  One reference is held for each subscriber and one
+ * for the caller.
+ *
+ * @param num number of subscribers
+ * @param data the event
+ * @param size number of bytes in @a data
+ * @return NULL on error (i.e. out of memory)
+ */
+static struct BroadcastEvent *
+event_create (unsigned int num,
+              const void *data,
+              size_t size)
+{
+  struct BroadcastEvent *ev;
+  size_t per_sub;
+  size_t total;
+
+  per_sub = sizeof (struct MHD_PushBuffer) + sizeof (struct MHD_Response *);
+  if ( ((SIZE_MAX - sizeof (struct BroadcastEvent)) / per_sub < num) ||
+       (SIZE_MAX - sizeof (struct BroadcastEvent) - num * per_sub < size) )
+    return NULL;
+  total = sizeof (struct BroadcastEvent) + num * per_sub + size;
+  if (NULL == (ev = malloc (total)))
+    return NULL;
+#if ! HAVE_ATOMIC_BUILTINS
+  if (MHD_YES != MHD_mutex_create_ (&ev->mutex))
+    {
+      free (ev);
+      return NULL;
+    }
+#endif
+  ev->reference_count = num + 1;
+  ev->size = size;
+  memcpy (&((char *) ev)[total - size], data, size);
+  return ev;
+}
+
+
+/**
+ * Free an event nobody else knows about.
+ *
+ * @param ev the event
+ */
+static void
+event_destroy (struct BroadcastEvent *ev)
+{
+#if ! HAVE_ATOMIC_BUILTINS
+  (void) MHD_mutex_destroy_ (&ev->mutex);
+#endif
+  free (ev);
+}
+
+
+/**
+ * Drop @a n references to an event, freeing it with the last one.
+ *
+ * @param ev the event
+ * @param n number of references to drop
+ */
+static void
+event_release_n (struct BroadcastEvent *ev,
+                 unsigned int n)
+{
+  if (0 == n)
+    return;
+#if HAVE_ATOMIC_BUILTINS
+  if (0 != __atomic_sub_fetch (&ev->reference_count, n, __ATOMIC_ACQ_REL))
+    return;
+#else
+  (void) MHD_mutex_lock_ (&ev->mutex);
+  ev->reference_count -= n;
+  if (0 != ev->reference_count)
+    {
+      (void) MHD_mutex_unlock_ (&ev->mutex);
+      return;
+    }
+  (void) MHD_mutex_unlock_ (&ev->mutex);
+#endif
+  event_destroy (ev);
+}
+
+
+/**
+ * Drop a reference to an event, freeing it with the last one.  Also
+ * the free callback of the queue entries of the subscribers, which
+ * are part of the event.
+ *
+ * @param cls the `struct BroadcastEvent`
+ */
+static void
+event_release (void *cls)
+{
+  event_release_n (cls, 1);
+}
+
+
+/**
+ * Create a broadcast channel.  Each event published on the channel
+ * is copied once and sent to all subscribers without copying it
+ * again; each subscriber costs a pointer in the queue of its
+ * response.
+ *
+ * @param max_backlog number of bytes of events queued for a
+ *        subscriber from which on @a policy applies, 0 for no limit
+ * @param policy what to do with a subscriber whose backlog is full
+ * @return NULL on error (i.e. out of memory)
+ * @ingroup response
+ */
+struct MHD_Broadcast *
+MHD_broadcast_create (size_t max_backlog,
+                      enum MHD_BroadcastPolicy policy)
+{
+  struct MHD_Broadcast *bc;
+
+  if (NULL == (bc = malloc (sizeof (struct MHD_Broadcast))))
+    return NULL;
+  memset (bc, 0, sizeof (struct MHD_Broadcast));
+  if (MHD_YES != MHD_mutex_create_ (&bc->mutex))
+    {
+      free (bc);
+      return NULL;
+    }
+  bc->max_backlog = max_backlog;
+  bc->policy = policy;
+  return bc;
+}
+
+
+/**
+ * Subscribe to the events of a broadcast channel.  Returns a response
+ * (of unknown size, see #MHD_create_response_for_push()) that
+ * receives the events published from now on; add headers (such as
+ * "Content-Type: text/event-stream"), queue it for the connection and
+ * destroy it as usual.  The subscription ends once the connection is
+ * done with the response and it was destroyed.  Can be called from
+ * any thread.
+ *
+ * @param bc the broadcast channel
+ * @return NULL on error (i.e. out of memory)
+ * @ingroup response
+ */
+struct MHD_Response *
+MHD_broadcast_subscribe (struct MHD_Broadcast *bc)
+{
+  struct Subscriber *sub;
+  struct MHD_Response *response;
+
+  if (NULL == bc)
+    return NULL;
+  if (NULL == (sub = malloc (sizeof (struct Subscriber))))
+    return NULL;
+  response = MHD_create_response_for_push (MHD_SIZE_UNKNOWN,
+                                           bc->max_backlog,
+                                           NULL,
+                                           NULL);
+  if (NULL == response)
+    {
+      free (sub);
+      return NULL;
+    }
+  MHD_increment_response_rc (response);
+  sub->next = NULL;
+  sub->prev = NULL;
+  sub->response = response;
+  (void) MHD_mutex_lock_ (&bc->mutex);
+  DLL_insert (bc->subscribers_head,
+              bc->subscribers_tail,
+              sub);
+  bc->num_subscribers++;
+  (void) MHD_mutex_unlock_ (&bc->mutex);
+  return response;
+}
+
+
+/**
+ * Publish an event on a broadcast channel: queue it for all
+ * subscribers.  The data is copied once.  Can be called from any
+ * thread.
+ *
+ * @param bc the broadcast channel
+ * @param data the event, as it is to be sent
+ * @param size number of bytes in @a data, must not be 0
+ * @return #MHD_NO on error (i.e. invalid arguments, out of memory)
+ * @ingroup response
+ */
+int
+MHD_broadcast_publish (struct MHD_Broadcast *bc,
+                       const void *data,
+                       size_t size)
+{
+  struct BroadcastEvent *ev;
+  struct MHD_PushBuffer *nodes;
+  struct MHD_PushBuffer *pb;
+  struct MHD_Response **woken;
+  const char *copy;
+  struct Subscriber *pos;
+  struct Subscriber *next;
+  struct Subscriber *gone;
+  unsigned int num;
+  unsigned int used;
+  unsigned int aborted;
+  unsigned int i;
+
+  if ( (NULL == bc) ||
+       (NULL == data) ||
+       (0 == size) )
+    return MHD_NO;
+  /* allocate outside of the lock; retry in the unlikely case that
+     subscribers were added meanwhile */
+  (void) MHD_mutex_lock_ (&bc->mutex);
+  num = bc->num_subscribers;
+  (void) MHD_mutex_unlock_ (&bc->mutex);
+  while (1)
+    {
+      if (NULL == (ev = event_create (num, data, size)))
+        return MHD_NO;
+      (void) MHD_mutex_lock_ (&bc->mutex);
+      if (bc->num_subscribers <= num)
+        break;
+      num = bc->num_subscribers;
+      (void) MHD_mutex_unlock_ (&bc->mutex);
+      event_destroy (ev);
+    }
+  nodes = event_nodes (ev);
+  woken = (struct MHD_Response **) &nodes[num];
+  copy = (const char *) &woken[num];
+  used = 0;
+  aborted = 0;
+  gone = NULL;
+  for (pos = bc->subscribers_head; NULL != pos; pos = next)
+    {
+      next = pos->next;
+      if (MHD_YES == MHD_response_is_shared_ (pos->response))
+        {
+          pb = &nodes[used];
+          pb->data = copy;
+          pb->size = size;
+          pb->free_cb = &event_release;
+          pb->free_cls = ev;
+          pb->embedded = MHD_YES;
+          /* the connections are signalled once we released the lock;
+             the references keep the responses alive until then */
+          if (MHD_YES == MHD_response_push_buffer_ (pos->response,
+                                                    pb))
+            {
+              MHD_increment_response_rc (pos->response);
+              woken[used++] = pos->response;
+              continue;
+            }
+          if (MHD_BROADCAST_DISCONNECT != bc->policy)
+            continue; /* the subscriber misses this event */
+          MHD_response_push_abort_ (pos->response);
+          MHD_increment_response_rc (pos->response);
+          woken[num - (++aborted)] = pos->response;
+        }
+      /* the connection is done with the response, or is to be
+         closed; destroy the response outside of the lock, as that
+         releases the events queued for it */
+      DLL_remove (bc->subscribers_head,
+                  bc->subscribers_tail,
+                  pos);
+      bc->num_subscribers--;
+      pos->next = gone;
+      gone = pos;
+    }
+  (void) MHD_mutex_unlock_ (&bc->mutex);
+  /* the references of the queue entries that were not used */
+  event_release_n (ev, num - used);
+  for (i = 0; i < used; i++)
+    {
+      MHD_response_push_wake_ (woken[i]);
+      MHD_destroy_response (woken[i]);
+    }
+  for (i = num - aborted; i < num; i++)
+    {
+      MHD_response_push_wake_ (woken[i]);
+      MHD_destroy_response (woken[i]);
+    }
+  /* 'woken' is part of the event, so release our reference last */
+  event_release (ev);
+  while (NULL != (pos = gone))
+    {
+      gone = pos->next;
+      MHD_destroy_response (pos->response);
+      free (pos);
+    }
+  return MHD_YES;
+}
+
+
+/**
+ * Destroy a broadcast channel.  The responses of the subscribers end
+ * once the events queued for them are sent.
+ * Must not be called concurrently with #MHD_broadcast_publish().
+ *
+ * @param bc the broadcast channel
+ * @ingroup response
+ */
+void
+MHD_broadcast_destroy (struct MHD_Broadcast *bc)
+{
+  struct Subscriber *pos;
+
+  if (NULL == bc)
+    return;
+  while (NULL != (pos = bc->subscribers_head))
+    {
+      DLL_remove (bc->subscribers_head,
+                  bc->subscribers_tail,
+                  pos);
+      bc->num_subscribers--;
+      (void) MHD_response_push_end (pos->response);
+      MHD_destroy_response (pos->response);
+      free (pos);
+    }
+  (void) MHD_mutex_destroy_ (&bc->mutex);
+  free (bc);
+}
+
+/* end of broadcast.c */
@@ -30,6 +30,8 @@
 #include "memorypool.h"
 #include "response.h"
 #include "mhd_mono_clock.h"
+#include "router.h"
+#include "zerocopy.h"
 
 #if HAVE_NETINET_TCP_H
 /* for TCP_CORK */
@@ -100,6 +102,20 @@
 #define INTERNAL_ERROR ""
 #endif
 
+/**
+ * Bodies of responses up to this size are copied into the write
+ * buffer after the headers, so that the complete response is sent
+ * with a single write.  Only used if the connection cannot gather
+ * the headers and the body with one system call (TLS).
+ */
+#define MHD_INLINE_BODY_SIZE 1024
+
+/**
+ * Maximum number of buffers passed to a single call to the
+ * `sendv_cls` of a connection.
+ */
+#define MHD_SENDV_MAX_SEGMENTS 32
+
 /**
  * Add extra debug messages with reasons for closing connections
  * (non-error reasons).
@@ -338,6 +354,7 @@ MHD_get_connection_values (struct MHD_Connection *connection,
 
   if (NULL == connection)
     return -1;
+  MHD_connection_parse_values_ (connection, kind);
   ret = 0;
   for (pos = connection->headers_received; NULL != pos; pos = pos->next)
     if (0 != (pos->kind & kind))
@@ -385,7 +402,14 @@ MHD_set_connection_value (struct MHD_Connection *connection,
                           const char *key, const char *value)
 {
   struct MHD_HTTP_Header *pos;
-
+  enum MHD_HeaderToken token;
+
+  /* values set by the application go after the parsed ones */
+  MHD_connection_parse_values_ (connection, kind);
+  /* the index must cover all entries, so it is only ever created
+     together with the first one */
+  if (NULL == connection->headers_received)
+    connection->headers_index = MHD_header_index_create_ (connection->pool);
   pos = MHD_pool_allocate (connection->pool,
                            sizeof (struct MHD_HTTP_Header), MHD_YES);
   if (NULL == pos)
@@ -394,6 +418,9 @@ MHD_set_connection_value (struct MHD_Connection *connection,
   pos->value = (char *) value;
   pos->kind = kind;
   pos->next = NULL;
+  token = MHD_header_token_ (key, &pos->hash);
+  if (NULL != connection->headers_index)
+    MHD_header_index_add_ (connection->headers_index, pos, token);
   /* append 'pos' to the linked list of headers */
   if (NULL == connection->headers_received_tail)
     {
@@ -424,9 +451,22 @@ MHD_lookup_connection_value (struct MHD_Connection *connection,
                              enum MHD_ValueKind kind, const char *key)
 {
   struct MHD_HTTP_Header *pos;
+  enum MHD_HeaderToken token;
+  uint32_t hash;
 
   if (NULL == connection)
     return NULL;
+  MHD_connection_parse_values_ (connection, kind);
+  if (NULL != connection->headers_index)
+    {
+      token = MHD_header_token_ (key, &hash);
+      pos = MHD_header_index_find_ (connection->headers_index,
+                                    kind,
+                                    token,
+                                    hash,
+                                    key);
+      return (NULL == pos) ? NULL : pos->value;
+    }
   for (pos = connection->headers_received; NULL != pos; pos = pos->next)
     if ((0 != (pos->kind & kind)) &&
 	( (key == pos->header) ||
@@ -438,6 +478,33 @@ MHD_lookup_connection_value (struct MHD_Connection *connection,
 }
 
 
+/**
+ * Get the value of a well-known request header, without
+ * interning its name.
+ *
+ * @param connection connection to get the header from
+ * @param token token of the header
+ * @return NULL if no such header was received
+ */
+static const char *
+lookup_header (struct MHD_Connection *connection,
+               enum MHD_HeaderToken token)
+{
+  struct MHD_HTTP_Header *pos;
+
+  if (NULL == connection->headers_index)
+    return MHD_lookup_connection_value (connection,
+                                        MHD_HEADER_KIND,
+                                        MHD_header_token_name_ (token));
+  pos = MHD_header_index_find_ (connection->headers_index,
+                                MHD_HEADER_KIND,
+                                token,
+                                0,
+                                NULL);
+  return (NULL == pos) ? NULL : pos->value;
+}
+
+
 /**
  * Do we (still) need to send a 100 continue
  * message for this connection?
@@ -454,15 +521,171 @@ need_100_continue (struct MHD_Connection *connection)
 	   (NULL != connection->version) &&
        (MHD_str_equal_caseless_(connection->version,
 			     MHD_HTTP_VERSION_1_1)) &&
-	   (NULL != (expect = MHD_lookup_connection_value (connection,
-							   MHD_HEADER_KIND,
-							   MHD_HTTP_HEADER_EXPECT))) &&
+	   (NULL != (expect = lookup_header (connection,
+                                             MHD_HEADER_TOKEN_EXPECT))) &&
 	   (MHD_str_equal_caseless_(expect, "100-continue")) &&
 	   (connection->continue_message_write_offset <
 	    strlen (HTTP_100_CONTINUE)) );
 }
 
 
+#ifdef HAVE_POLL
+/**
+ * Add the connection to the poll set of its daemon, growing the
+ * poll set if needed.  The poll set always keeps room for all
+ * connections of the daemon (including suspended ones), so that
+ * resuming a connection never needs to grow it; hence the
+ * connection must already be counted in the daemon's
+ * 'connections'.
+ *
+ * @param connection connection to add
+ * @param process_now #MHD_YES if the connection must be processed
+ *        in the next iteration of the event loop even if there are
+ *        no events for it (i.e. after resuming it)
+ * @return #MHD_YES on success, #MHD_NO if we failed to grow the
+ *         poll set
+ */
+int
+MHD_connection_poll_add_ (struct MHD_Connection *connection,
+                          int process_now)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+  struct pollfd *fds;
+  struct MHD_Connection **conns;
+  unsigned int size;
+
+  if (daemon->poll_size < MHD_POLL_SLOT_FIRST + daemon->connections)
+    {
+      size = 2 * daemon->poll_size;
+      if (size < MHD_POLL_SLOT_FIRST + daemon->connections)
+        size = MHD_POLL_SLOT_FIRST + daemon->connections;
+      fds = realloc (daemon->poll_fds,
+                     size * sizeof (struct pollfd));
+      if (NULL == fds)
+        return MHD_NO;
+      daemon->poll_fds = fds;
+      conns = realloc (daemon->poll_connections,
+                       size * sizeof (struct MHD_Connection *));
+      if (NULL == conns)
+        return MHD_NO;
+      daemon->poll_connections = conns;
+      daemon->poll_size = size;
+    }
+  connection->poll_slot = daemon->poll_used++;
+  connection->poll_info = MHD_EVENT_LOOP_INFO_READ;
+  daemon->poll_fds[connection->poll_slot].fd = connection->socket_fd;
+  daemon->poll_fds[connection->poll_slot].revents = 0;
+  daemon->poll_connections[connection->poll_slot] = connection;
+  MHD_connection_poll_update_ (connection);
+  if ( (MHD_YES == process_now) &&
+       ( (MHD_EVENT_LOOP_INFO_READ == connection->poll_info) ||
+         (MHD_EVENT_LOOP_INFO_WRITE == connection->poll_info) ) )
+    {
+      /* accounted like a blocked connection until it was processed */
+      connection->poll_info = MHD_EVENT_LOOP_INFO_BLOCK;
+      daemon->poll_num_block++;
+    }
+  return MHD_YES;
+}
+
+
+/**
+ * Remove the connection from the poll set of its daemon (if it is
+ * in the poll set).  The last entry of the poll set takes the place
+ * of the connection.
+ *
+ * @param connection connection to remove
+ */
+void
+MHD_connection_poll_remove_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+  unsigned int slot = connection->poll_slot;
+  unsigned int last;
+
+  if (0 == slot)
+    return;
+  if (MHD_EVENT_LOOP_INFO_BLOCK == connection->poll_info)
+    daemon->poll_num_block--;
+  else if (MHD_EVENT_LOOP_INFO_CLEANUP == connection->poll_info)
+    daemon->poll_num_cleanup--;
+  last = --daemon->poll_used;
+  if (slot != last)
+    {
+      daemon->poll_fds[slot] = daemon->poll_fds[last];
+      daemon->poll_connections[slot] = daemon->poll_connections[last];
+      daemon->poll_connections[slot]->poll_slot = slot;
+    }
+  connection->poll_slot = 0;
+}
+
+
+/**
+ * Update the events of the poll set entry of the connection to
+ * match its 'event_loop_info'.
+ *
+ * @param connection connection to update
+ */
+void
+MHD_connection_poll_update_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+  struct pollfd *p;
+
+  if (0 == connection->poll_slot)
+    return;
+  p = &daemon->poll_fds[connection->poll_slot];
+  switch (connection->event_loop_info)
+    {
+    case MHD_EVENT_LOOP_INFO_READ:
+      p->events = POLLIN;
+      break;
+    case MHD_EVENT_LOOP_INFO_WRITE:
+      p->events = POLLOUT;
+      if (connection->read_buffer_size > connection->read_buffer_offset)
+        p->events |= POLLIN;
+      break;
+    case MHD_EVENT_LOOP_INFO_BLOCK:
+      p->events = 0;
+      if (connection->read_buffer_size > connection->read_buffer_offset)
+        p->events |= POLLIN;
+      break;
+    case MHD_EVENT_LOOP_INFO_CLEANUP:
+      p->events = 0;
+      break;
+    }
+  if (connection->poll_info == connection->event_loop_info)
+    return;
+  if (MHD_EVENT_LOOP_INFO_BLOCK == connection->poll_info)
+    daemon->poll_num_block--;
+  else if (MHD_EVENT_LOOP_INFO_CLEANUP == connection->poll_info)
+    daemon->poll_num_cleanup--;
+  if (MHD_EVENT_LOOP_INFO_BLOCK == connection->event_loop_info)
+    daemon->poll_num_block++;
+  else if (MHD_EVENT_LOOP_INFO_CLEANUP == connection->event_loop_info)
+    daemon->poll_num_cleanup++;
+  connection->poll_info = connection->event_loop_info;
+}
+#endif
+
+
+/**
+ * Make sure that pushing data to the response of @a connection no
+ * longer signals the connection, as it is done with the response
+ * (see #MHD_create_response_for_push()).
+ *
+ * @param connection the connection
+ */
+static void
+detach_push_response (struct MHD_Connection *connection)
+{
+  if ( (NULL != connection->response) &&
+       (NULL != connection->response->push) )
+    MHD_response_push_detach_ (connection->response,
+                               connection);
+}
+
+
 /**
  * Close the given connection and give the
  * specified termination code to the user.
@@ -482,6 +705,10 @@ MHD_connection_close_ (struct MHD_Connection *connection,
 	      (MHD_YES == connection->read_closed) ? SHUT_WR : SHUT_RDWR);
   connection->state = MHD_CONNECTION_CLOSED;
   connection->event_loop_info = MHD_EVENT_LOOP_INFO_CLEANUP;
+#ifdef HAVE_POLL
+  MHD_connection_poll_update_ (connection);
+#endif
+  detach_push_response (connection);
   if ( (NULL != daemon->notify_completed) &&
        (MHD_YES == connection->client_aware) )
     daemon->notify_completed (daemon->notify_completed_cls,
@@ -524,16 +751,205 @@ connection_close_error (struct MHD_Connection *connection,
 
 
 /**
- * Prepare the response buffer of this connection for
- * sending.  Assumes that the response mutex is
- * already held.  If the transmission is complete,
- * this function may close the socket (and return
- * #MHD_NO).
+ * Record that the content reader of the response of @a connection
+ * returned #MHD_CONTENT_READER_WAIT, unless the application already
+ * signalled new data.  The idle handler then parks the connection
+ * (see wait_for_data()).  Without #MHD_USE_SUSPEND_RESUME or with
+ * #MHD_USE_THREAD_PER_CONNECTION, the connection cannot be parked
+ * and polls the content reader as if it returned 0.
+ *
+ * @param connection the connection
+ */
+static void
+note_data_wait (struct MHD_Connection *connection)
+{
+#if HAVE_ATOMIC_BUILTINS
+  struct MHD_Daemon *daemon = connection->daemon;
+  int expected;
+
+  if ( (MHD_USE_SUSPEND_RESUME != (daemon->options & MHD_USE_SUSPEND_RESUME)) ||
+       (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) )
+    return;
+  expected = MHD_CONNECTION_DATA_WAIT_NONE;
+  /* fails if MHD_response_data_ready() was called meanwhile */
+  (void) __atomic_compare_exchange_n (&connection->data_wait,
+                                      &expected,
+                                      MHD_CONNECTION_DATA_WAIT_PENDING,
+                                      0,
+                                      __ATOMIC_ACQ_REL,
+                                      __ATOMIC_ACQUIRE);
+#endif
+}
+
+
+/**
+ * Check whether @a connection has to wait for the application to
+ * signal new data before its content reader may be called again.
+ * Suspends the connection if the content reader just returned
+ * #MHD_CONTENT_READER_WAIT; #MHD_response_data_ready() resumes it.
+ * Must only be called from the idle handler.
+ *
+ * @param connection the connection
+ * @return #MHD_YES if the content reader must not be called now
+ */
+static int
+wait_for_data (struct MHD_Connection *connection)
+{
+#if HAVE_ATOMIC_BUILTINS
+  int expected;
+
+  switch (__atomic_load_n (&connection->data_wait, __ATOMIC_ACQUIRE))
+    {
+    case MHD_CONNECTION_DATA_WAIT_PENDING:
+      MHD_suspend_connection (connection);
+      expected = MHD_CONNECTION_DATA_WAIT_PENDING;
+      if (! __atomic_compare_exchange_n (&connection->data_wait,
+                                         &expected,
+                                         MHD_CONNECTION_DATA_WAIT_PARKED,
+                                         0,
+                                         __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE))
+        {
+          /* signalled while we were suspending */
+          MHD_resume_connection (connection);
+        }
+      return MHD_YES;
+    case MHD_CONNECTION_DATA_WAIT_SIGNALED:
+      __atomic_store_n (&connection->data_wait,
+                        MHD_CONNECTION_DATA_WAIT_NONE,
+                        __ATOMIC_RELEASE);
+      return MHD_NO;
+    default:
+      return MHD_NO;
+    }
+#else
+  return MHD_NO;
+#endif
+}
+
+
+/**
+ * Call the content reader of the response of @a connection for the
+ * data at the current write position.  Calls are serialized using
+ * the mutex of the response, unless the response was marked with
+ * #MHD_RF_THREAD_SAFE_READER.
+ *
+ * @param connection the connection
+ * @param buf where the content reader should write the data
+ * @param max maximum number of bytes to write to @a buf
+ * @return result from the content reader, 0 instead of
+ *         #MHD_CONTENT_READER_WAIT
+ */
+static ssize_t
+call_content_reader (struct MHD_Connection *connection,
+                     char *buf,
+                     size_t max)
+{
+  struct MHD_Response *response = connection->response;
+  ssize_t ret;
+
+  if (0 == (response->flags & MHD_RF_THREAD_SAFE_READER))
+    (void) MHD_mutex_lock_ (&response->mutex);
+  ret = response->crc (response->crc_cls,
+                       connection->response_write_position,
+                       buf,
+                       max);
+  if (0 == (response->flags & MHD_RF_THREAD_SAFE_READER))
+    (void) MHD_mutex_unlock_ (&response->mutex);
+  if (((ssize_t) MHD_CONTENT_READER_WAIT) == ret)
+    {
+      if ( (NULL == response->push) ||
+           (MHD_YES == MHD_response_push_wait_ (response, connection)) )
+        note_data_wait (connection);
+      ret = 0;
+    }
+  return ret;
+}
+
+
+#if SENDV_SUPPORT
+/**
+ * Check whether the data pushed to the response of @a connection
+ * ended (see #MHD_create_response_for_push()), or else wait for
+ * more.  Used if the connection sends the pushed buffers directly
+ * and none are queued (or the data was aborted).
+ *
+ * @param connection the connection
+ * @return 0 if more data will be pushed,
+ *         #MHD_CONTENT_READER_END_OF_STREAM at the end of the data,
+ *         #MHD_CONTENT_READER_END_WITH_ERROR if the data ended before
+ *         the size of the response was reached or was aborted
+ */
+static ssize_t
+wait_for_push (struct MHD_Connection *connection)
+{
+  struct MHD_Response *response = connection->response;
+
+  if (MHD_YES == MHD_response_push_aborted_ (response))
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  /* once ended, all of the data is linked */
+  if (MHD_YES == MHD_response_push_ended_ (response))
+    {
+      if (0 != MHD_response_push_peek_ (response, 1, 1))
+        return 0;
+      if (MHD_SIZE_UNKNOWN == response->total_size)
+        return MHD_CONTENT_READER_END_OF_STREAM;
+      return MHD_CONTENT_READER_END_WITH_ERROR;
+    }
+  if (MHD_YES == MHD_response_push_wait_ (response, connection))
+    note_data_wait (connection);
+  return 0;
+}
+#endif
+
+
+/**
+ * Allocate the write buffer of the connection for the body of the
+ * response, if it does not have one yet.  Tries @a size bytes first
+ * and less if the memory pool of the connection does not have that
+ * much.  If not even a small buffer can be had, the connection is
+ * closed.
+ *
+ * @param connection the connection
+ * @param size preferred size of the buffer
+ * @return #MHD_NO if the connection was closed
+ */
+static int
+alloc_body_buffer (struct MHD_Connection *connection,
+                   size_t size)
+{
+  char *buf;
+
+  if (0 != connection->write_buffer_size)
+    return MHD_YES;
+  size = MHD_MIN (size, connection->daemon->pool_size);
+  while (NULL == (buf = MHD_pool_allocate (connection->pool, size, MHD_NO)))
+    {
+      size /= 2;
+      if (size < 128)
+        {
+          /* not enough memory */
+          CONNECTION_CLOSE_ERROR (connection,
+                                  "Closing connection (out of memory)\n");
+          return MHD_NO;
+        }
+    }
+  connection->write_buffer_size = size;
+  connection->write_buffer = buf;
+  return MHD_YES;
+}
+
+
+/**
+ * Prepare the response buffer of this connection for sending.  The
+ * data produced by the content reader is kept in the write buffer of
+ * the connection (its private read-ahead window), so connections
+ * sharing a response do not overwrite each other's data.  If the
+ * transmission is complete, this function may close the socket (and
+ * return #MHD_NO).
  *
  * @param connection the connection
- * @return #MHD_NO if readying the response failed (the
- *  lock on the response will have been released already
- *  in this case).
+ * @return #MHD_NO if readying the response failed
  */
 static int
 try_ready_normal_body (struct MHD_Connection *connection)
@@ -547,10 +963,8 @@ try_ready_normal_body (struct MHD_Connection *connection)
   if ( (0 == response->total_size) ||
        (connection->response_write_position == response->total_size) )
     return MHD_YES; /* 0-byte response is always ready */
-  if ( (response->data_start <=
-	connection->response_write_position) &&
-       (response->data_size + response->data_start >
-	connection->response_write_position) )
+  if (connection->write_buffer_send_offset <
+      connection->write_buffer_append_offset)
     return MHD_YES; /* response already ready */
 #if LINUX
   if ( (MHD_INVALID_SOCKET != response->fd) &&
@@ -560,20 +974,39 @@ try_ready_normal_body (struct MHD_Connection *connection)
       return MHD_YES;
     }
 #endif
-
-  ret = response->crc (response->crc_cls,
-                       connection->response_write_position,
-                       response->data,
-                       (size_t)MHD_MIN ((uint64_t)response->data_buffer_size,
-                                response->total_size -
-                                connection->response_write_position));
+#if SENDV_SUPPORT
+  if ( (NULL != response->iov) &&
+       (NULL != connection->sendv_cls) )
+    {
+      /* will send the segments directly, no need to copy them */
+      return MHD_YES;
+    }
+  if ( (NULL != response->push) &&
+       (NULL != connection->sendv_cls) )
+    {
+      /* will send the pushed buffers directly, if there are any */
+      if ( (MHD_NO == MHD_response_push_aborted_ (response)) &&
+           (0 != MHD_response_push_peek_ (response, 1, 1)) )
+        return MHD_YES;
+      ret = wait_for_push (connection);
+    }
+  else
+#endif
+    {
+      if (MHD_YES != alloc_body_buffer (connection,
+                                        response->data_buffer_size))
+        return MHD_NO;
+      ret = call_content_reader (connection,
+                                 connection->write_buffer,
+                                 (size_t) MHD_MIN ((uint64_t) connection->write_buffer_size,
+                                                   response->total_size -
+                                                   connection->response_write_position));
+    }
   if ( (((ssize_t) MHD_CONTENT_READER_END_OF_STREAM) == ret) ||
        (((ssize_t) MHD_CONTENT_READER_END_WITH_ERROR) == ret) )
     {
       /* either error or http 1.0 transfer, close socket! */
       response->total_size = connection->response_write_position;
-      if (NULL != response->crc)
-        (void) MHD_mutex_unlock_ (&response->mutex);
       if ( ((ssize_t)MHD_CONTENT_READER_END_OF_STREAM) == ret)
 	MHD_connection_close_ (connection,
                                MHD_REQUEST_TERMINATED_COMPLETED_OK);
@@ -582,22 +1015,87 @@ try_ready_normal_body (struct MHD_Connection *connection)
 				"Closing connection (stream error)\n");
       return MHD_NO;
     }
-  response->data_start = connection->response_write_position;
-  response->data_size = ret;
+  connection->write_buffer_send_offset = 0;
+  connection->write_buffer_append_offset = ret;
   if (0 == ret)
     {
       connection->state = MHD_CONNECTION_NORMAL_BODY_UNREADY;
-      if (NULL != response->crc)
-        (void) MHD_mutex_unlock_ (&response->mutex);
       return MHD_NO;
     }
   return MHD_YES;
 }
 
 
+#if SENDV_SUPPORT
+/**
+ * Prepare the next chunk of the pushed data of the response of this
+ * connection (see #MHD_create_response_for_push()).  Only the chunk
+ * header (preceded by the end of the previous chunk) is put into the
+ * write buffer; do_writev() sends the data of the chunk directly
+ * from the pushed buffers.
+ *
+ * @param connection the connection
+ * @return #MHD_NO if readying the response failed
+ */
+static int
+try_ready_push_chunk (struct MHD_Connection *connection)
+{
+  struct MHD_Response *response = connection->response;
+  size_t len;
+  ssize_t ret;
+  int off;
+
+  /* 16: "\r\n%X\r\n" for the largest chunk */
+  if (MHD_YES != alloc_body_buffer (connection, 16))
+    return MHD_NO;
+  off = 0;
+  if (0 != connection->response_write_position)
+    {
+      memcpy (connection->write_buffer, "\r\n", 2);
+      off = 2;
+    }
+  if (MHD_YES == MHD_response_push_aborted_ (response))
+    len = 0;
+  else
+    len = MHD_response_push_peek_ (response,
+                                   MHD_SENDV_MAX_SEGMENTS - 1,
+                                   0xFFFFFF);
+  if (0 == len)
+    {
+      ret = wait_for_push (connection);
+      if (((ssize_t) MHD_CONTENT_READER_END_WITH_ERROR) == ret)
+        {
+          response->total_size = connection->response_write_position;
+          CONNECTION_CLOSE_ERROR (connection,
+                                  "Closing connection (error generating response)\n");
+          return MHD_NO;
+        }
+      if (0 == ret)
+        {
+          connection->state = MHD_CONNECTION_CHUNKED_BODY_UNREADY;
+          return MHD_NO;
+        }
+      /* end of message, signal other side! */
+      memcpy (&connection->write_buffer[off], "0\r\n", 3);
+      connection->write_buffer_append_offset = off + 3;
+      connection->write_buffer_send_offset = 0;
+      response->total_size = connection->response_write_position;
+      return MHD_YES;
+    }
+  off += MHD_snprintf_ (&connection->write_buffer[off],
+                        connection->write_buffer_size - off,
+                        "%X\r\n",
+                        (unsigned int) len);
+  connection->write_buffer_append_offset = off;
+  connection->write_buffer_send_offset = 0;
+  connection->push_chunk_left = len;
+  return MHD_YES;
+}
+#endif
+
+
 /**
- * Prepare the response buffer of this connection for sending.
- * Assumes that the response mutex is already held.  If the
+ * Prepare the response buffer of this connection for sending.  If the
  * transmission is complete, this function may close the socket (and
  * return MHD_NO).
  *
@@ -608,58 +1106,26 @@ static int
 try_ready_chunked_body (struct MHD_Connection *connection)
 {
   ssize_t ret;
-  char *buf;
   struct MHD_Response *response;
-  size_t size;
   char cbuf[10];                /* 10: max strlen of "%x\r\n" */
   int cblen;
 
   response = connection->response;
-  if (0 == connection->write_buffer_size)
-    {
-      size = MHD_MIN(connection->daemon->pool_size, 2 * (0xFFFFFF + sizeof(cbuf) + 2));
-      do
-        {
-          size /= 2;
-          if (size < 128)
-            {
-              /* not enough memory */
-              CONNECTION_CLOSE_ERROR (connection,
-				      "Closing connection (out of memory)\n");
-              return MHD_NO;
-            }
-          buf = MHD_pool_allocate (connection->pool, size, MHD_NO);
-        }
-      while (NULL == buf);
-      connection->write_buffer_size = size;
-      connection->write_buffer = buf;
-    }
+#if SENDV_SUPPORT
+  if ( (NULL != response->push) &&
+       (NULL != connection->sendv_cls) )
+    return try_ready_push_chunk (connection);
+#endif
+  if (MHD_YES != alloc_body_buffer (connection,
+                                    0xFFFFFF + sizeof (cbuf) + 2))
+    return MHD_NO;
 
   if (0 == response->total_size)
     ret = 0; /* response must be empty, don't bother calling crc */
-  else if ( (response->data_start <=
-	connection->response_write_position) &&
-       (response->data_start + response->data_size >
-	connection->response_write_position) )
-    {
-      /* difference between response_write_position and data_start is less
-         than data_size which is size_t type, no need to check for overflow */
-      const size_t data_write_offset = (size_t)(connection->response_write_position - response->data_start);
-      /* buffer already ready, use what is there for the chunk */
-      ret = response->data_size - data_write_offset;
-      if ( ((size_t) ret) > connection->write_buffer_size - sizeof (cbuf) - 2 )
-	ret = connection->write_buffer_size - sizeof (cbuf) - 2;
-      memcpy (&connection->write_buffer[sizeof (cbuf)],
-              &response->data[data_write_offset], ret);
-    }
   else
-    {
-      /* buffer not in range, try to fill it */
-      ret = response->crc (response->crc_cls,
-                           connection->response_write_position,
-                           &connection->write_buffer[sizeof (cbuf)],
-                           connection->write_buffer_size - sizeof (cbuf) - 2);
-    }
+    ret = call_content_reader (connection,
+                               &connection->write_buffer[sizeof (cbuf)],
+                               connection->write_buffer_size - sizeof (cbuf) - 2);
   if ( ((ssize_t) MHD_CONTENT_READER_END_WITH_ERROR) == ret)
     {
       /* error, close socket! */
@@ -725,9 +1191,8 @@ keepalive_possible (struct MHD_Connection *connection)
   if ( (NULL != connection->response) &&
        (0 != (connection->response->flags & MHD_RF_HTTP_VERSION_1_0_ONLY) ) )
     return MHD_NO;
-  end = MHD_lookup_connection_value (connection,
-                                     MHD_HEADER_KIND,
-                                     MHD_HTTP_HEADER_CONNECTION);
+  end = lookup_header (connection,
+                       MHD_HEADER_TOKEN_CONNECTION);
   if (MHD_str_equal_caseless_(connection->version,
                        MHD_HTTP_VERSION_1_1))
   {
@@ -756,9 +1221,11 @@ keepalive_possible (struct MHD_Connection *connection)
  *
  * @param date where to write the header, with
  *        at least 128 bytes available space.
+ * @param t time to produce the header for
  */
 static void
-get_date_string (char *date)
+get_date_string (char *date,
+                 time_t t)
 {
   static const char *const days[] =
     { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
@@ -767,13 +1234,11 @@ get_date_string (char *date)
     "Nov", "Dec"
   };
   struct tm now;
-  time_t t;
 #if !defined(HAVE_C11_GMTIME_S) && !defined(HAVE_W32_GMTIME_S) && !defined(HAVE_GMTIME_R)
   struct tm* pNow;
 #endif
 
   date[0] = 0;
-  time (&t);
 #if defined(HAVE_C11_GMTIME_S)
   if (NULL == gmtime_s (&t, &now))
     return;
@@ -801,6 +1266,45 @@ get_date_string (char *date)
 }
 
 
+/**
+ * Obtain the HTTP "Date:" header line for the current second.
+ * The line is formatted at most once per second and cached in
+ * the daemon, except with #MHD_USE_THREAD_PER_CONNECTION where
+ * the daemon is shared by the threads of all connections.
+ *
+ * @param connection connection the header is for
+ * @param date buffer with at least 128 bytes available space,
+ *        used if the line is not cached
+ * @param[out] len set to the length of the line
+ * @return the header line, empty on error
+ */
+static const char *
+get_date_line (struct MHD_Connection *connection,
+               char *date,
+               size_t *len)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+  time_t t;
+
+  time (&t);
+  if (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION))
+    {
+      get_date_string (date, t);
+      *len = strlen (date);
+      return date;
+    }
+  if ( (t != daemon->date_time) ||
+       (0 == daemon->date_line_len) )
+    {
+      get_date_string (daemon->date_line, t);
+      daemon->date_line_len = strlen (daemon->date_line);
+      daemon->date_time = t;
+    }
+  *len = daemon->date_line_len;
+  return daemon->date_line;
+}
+
+
 /**
  * Try growing the read buffer.  We initially claim half the
  * available buffer space for the read buffer (the other half
@@ -836,41 +1340,360 @@ try_grow_read_buffer (struct MHD_Connection *connection)
 
 
 /**
- * Allocate the connection's write buffer and fill it with all of the
- * headers (or footers, if we have already sent the body) from the
- * HTTPd's response.  If headers are missing in the response supplied
- * by the application, additional headers may be added here.
+ * Serialize the status line (for headers), the headers that MHD
+ * adds and the headers (or footers) of the response of @a connection,
+ * without the "Date:" header and the final CRLF.
  *
  * @param connection the connection
- * @return #MHD_YES on success, #MHD_NO on failure (out of memory)
+ * @param data where to write the result, NULL to only
+ *        compute the size
+ * @param kind #MHD_HEADER_KIND or #MHD_FOOTER_KIND
+ * @param must_add_close add "Connection: close"?
+ * @param must_add_keep_alive add "Connection: Keep-Alive"?
+ * @param must_add_chunked_encoding add "Transfer-Encoding: chunked"?
+ * @param must_add_content_length add "Content-Length"?
+ * @param response_has_keepalive value of the "Connection: Keep-Alive"
+ *        header of the response (skipped if @a must_add_close)
+ * @return number of bytes (to be) written
  */
-static int
-build_header_response (struct MHD_Connection *connection)
+static size_t
+serialize_headers (struct MHD_Connection *connection,
+                   char *data,
+                   enum MHD_ValueKind kind,
+                   int must_add_close,
+                   int must_add_keep_alive,
+                   int must_add_chunked_encoding,
+                   int must_add_content_length,
+                   const char *response_has_keepalive)
 {
-  size_t size;
-  size_t off;
   struct MHD_HTTP_Header *pos;
   char code[256];
-  char date[128];
-  char content_length_buf[128];
-  size_t content_length_len;
-  char *data;
-  enum MHD_ValueKind kind;
+  char content_length[128];
   const char *reason_phrase;
   uint32_t rc;
-  const char *client_requested_close;
-  const char *response_has_close;
-  const char *response_has_keepalive;
-  const char *have_encoding;
-  const char *have_content_length;
-  int must_add_close;
-  int must_add_chunked_encoding;
+  size_t off;
+  size_t hlen;
+  size_t vlen;
+
+  off = 0;
+  if (MHD_HEADER_KIND == kind)
+    {
+      rc = connection->responseCode & (~MHD_ICY_FLAG);
+      reason_phrase = MHD_get_reason_phrase_for (rc);
+      off = sprintf (code,
+                     "%s %u %s\r\n",
+                     (0 != (connection->responseCode & MHD_ICY_FLAG))
+                     ? "ICY"
+                     : ( (MHD_str_equal_caseless_ (MHD_HTTP_VERSION_1_0,
+                                                   connection->version))
+                         ? MHD_HTTP_VERSION_1_0
+                         : MHD_HTTP_VERSION_1_1),
+                     rc,
+                     reason_phrase);
+      if (NULL != data)
+        memcpy (data, code, off);
+    }
+  if (must_add_close)
+    {
+      /* we must add the 'Connection: close' header */
+      if (NULL != data)
+        memcpy (&data[off],
+                "Connection: close\r\n",
+                strlen ("Connection: close\r\n"));
+      off += strlen ("Connection: close\r\n");
+    }
+  if (must_add_keep_alive)
+    {
+      /* we must add the 'Connection: Keep-Alive' header */
+      if (NULL != data)
+        memcpy (&data[off],
+                "Connection: Keep-Alive\r\n",
+                strlen ("Connection: Keep-Alive\r\n"));
+      off += strlen ("Connection: Keep-Alive\r\n");
+    }
+  if (must_add_chunked_encoding)
+    {
+      /* we must add the 'Transfer-Encoding: chunked' header */
+      if (NULL != data)
+        memcpy (&data[off],
+                "Transfer-Encoding: chunked\r\n",
+                strlen ("Transfer-Encoding: chunked\r\n"));
+      off += strlen ("Transfer-Encoding: chunked\r\n");
+    }
+  if (must_add_content_length)
+    {
+      /* we must add the 'Content-Length' header */
+      hlen = sprintf (content_length,
+                      MHD_HTTP_HEADER_CONTENT_LENGTH ": " MHD_UNSIGNED_LONG_LONG_PRINTF "\r\n",
+                      (MHD_UNSIGNED_LONG_LONG) connection->response->total_size);
+      if (NULL != data)
+        memcpy (&data[off],
+                content_length,
+                hlen);
+      off += hlen;
+    }
+  for (pos = connection->response->first_header; NULL != pos; pos = pos->next)
+    {
+      if ( (pos->kind != kind) ||
+           ( (pos->value == response_has_keepalive) &&
+             (MHD_YES == must_add_close) &&
+             (MHD_str_equal_caseless_ (pos->header,
+                                       MHD_HTTP_HEADER_CONNECTION) ) ) )
+        continue;
+      hlen = strlen (pos->header);
+      vlen = strlen (pos->value);
+      if (NULL != data)
+        {
+          memcpy (&data[off], pos->header, hlen);
+          memcpy (&data[off + hlen], ": ", 2);
+          memcpy (&data[off + hlen + 2], pos->value, vlen);
+          memcpy (&data[off + hlen + 2 + vlen], "\r\n", 2);
+        }
+      off += hlen + vlen + 4; /* colon, space, linefeeds */
+    }
+  return off;
+}
+
+
+/**
+ * Copy the serialized status line and headers for @a connection
+ * from the block cached in its response into @a data, (re)building
+ * the block if it was produced for a different status code, HTTP
+ * version or set of headers added by MHD, or if the headers of the
+ * response changed since.  The caller must hold the mutex of the
+ * response.
+ *
+ * @param connection the connection
+ * @param key identifies the status code, version and added headers
+ * @param must_add_close add "Connection: close"?
+ * @param must_add_keep_alive add "Connection: Keep-Alive"?
+ * @param must_add_chunked_encoding add "Transfer-Encoding: chunked"?
+ * @param must_add_content_length add "Content-Length"?
+ * @param response_has_keepalive value of the "Connection: Keep-Alive"
+ *        header of the response (skipped if @a must_add_close)
+ * @return #MHD_YES if the block is available, #MHD_NO if it
+ *         could not be built (out of memory)
+ */
+static int
+update_header_block (struct MHD_Connection *connection,
+                     uint64_t key,
+                     int must_add_close,
+                     int must_add_keep_alive,
+                     int must_add_chunked_encoding,
+                     int must_add_content_length,
+                     const char *response_has_keepalive)
+{
+  struct MHD_Response *response = connection->response;
+  unsigned int generation;
+  size_t size;
+  char *block;
+
+  generation = MHD_counter_load_ (&response->header_generation);
+  if ( (NULL != response->header_block) &&
+       (key == response->header_block_key) &&
+       (generation == response->header_block_generation) )
+    return MHD_YES;
+  size = serialize_headers (connection,
+                            NULL,
+                            MHD_HEADER_KIND,
+                            must_add_close,
+                            must_add_keep_alive,
+                            must_add_chunked_encoding,
+                            must_add_content_length,
+                            response_has_keepalive);
+  if (NULL == (block = malloc (size + 1)))
+    return MHD_NO;
+  serialize_headers (connection,
+                     block,
+                     MHD_HEADER_KIND,
+                     must_add_close,
+                     must_add_keep_alive,
+                     must_add_chunked_encoding,
+                     must_add_content_length,
+                     response_has_keepalive);
+  free (response->header_block);
+  response->header_block = block;
+  response->header_block_size = size;
+  response->header_block_key = key;
+  response->header_block_generation = generation;
+  return MHD_YES;
+}
+
+
+/**
+ * Check whether the rest of the body of the response of @a connection
+ * is readily available in the buffer of the response.  Must only be
+ * called once it is known whether the response uses chunked encoding.
+ *
+ * @param connection connection to check
+ * @return #MHD_YES if the body remains to be sent from `response->data`
+ */
+static int
+body_in_buffer (struct MHD_Connection *connection)
+{
+  struct MHD_Response *response = connection->response;
+
+  return ( (NULL == response->crc) &&
+           (MHD_NO == connection->have_chunked_upload) &&
+           (connection->response_write_position < response->total_size) &&
+           (response->data_size == response->total_size) ) ? MHD_YES : MHD_NO;
+}
+
+
+/**
+ * Check whether the body of the response of @a connection is small
+ * enough and readily available to be copied behind the headers
+ * (see #MHD_INLINE_BODY_SIZE).  Must only be called once it is known
+ * whether the response uses chunked encoding.
+ *
+ * @param connection connection to check
+ * @return #MHD_YES if the body can be copied behind the headers
+ */
+static int
+can_inline_body (struct MHD_Connection *connection)
+{
+#if SENDV_SUPPORT
+  /* do_writev() sends it without copying, unless the client already
+     pipelined the next request: then the response may be batched
+     with the next one, which needs it in the write buffer */
+  if ( (NULL != connection->sendv_cls) &&
+       (0 == connection->read_buffer_offset) )
+    return MHD_NO;
+#endif
+  return ( (0 == connection->response_write_position) &&
+           (connection->response->total_size <= MHD_INLINE_BODY_SIZE) &&
+           (MHD_YES == body_in_buffer (connection)) ) ? MHD_YES : MHD_NO;
+}
+
+
+/**
+ * Check whether @a connection still has to send (parts of) the
+ * responses to earlier pipelined requests before it got to send
+ * anything for the current one.
+ *
+ * @param connection connection to check
+ * @return #MHD_YES if the write buffer holds carried bytes
+ */
+static int
+have_carried_response (struct MHD_Connection *connection)
+{
+  return ( (connection->state < MHD_CONNECTION_HEADERS_SENDING) &&
+           (connection->write_buffer_append_offset !=
+            connection->write_buffer_send_offset) ) ? MHD_YES : MHD_NO;
+}
+
+
+/**
+ * Check whether the complete response of @a connection is in the
+ * write buffer and the client already pipelined the next request.
+ * In that case, the response need not be sent right away: its
+ * unsent bytes are carried over to the next request, and the next
+ * response is appended to them (see #MHD_pool_reset_carry()).
+ *
+ * @param connection connection to check
+ * @return #MHD_YES if sending the response can be deferred
+ */
+static int
+can_batch_response (struct MHD_Connection *connection)
+{
+  struct MHD_Response *response = connection->response;
+  const char *end;
+
+  if ( (MHD_YES == connection->have_chunked_upload) ||
+       (connection->response_write_position != response->total_size) ||
+       (0 == connection->read_buffer_offset) ||
+       (connection->read_buffer_offset > connection->daemon->pool_size / 2) ||
+       (MHD_YES == connection->read_closed) ||
+       (connection->write_buffer_append_offset -
+        connection->write_buffer_send_offset >
+        connection->daemon->pool_size / 8) ||
+       (MHD_NO == keepalive_possible (connection)) )
+    return MHD_NO;
+  end = MHD_get_response_header (response,
+                                 MHD_HTTP_HEADER_CONNECTION);
+  if ( (NULL != end) &&
+       (MHD_str_equal_caseless_ (end, "close")) )
+    return MHD_NO;
+  return MHD_YES;
+}
+
+
+/**
+ * Make room for @a size more bytes (plus a 0-terminator) in the
+ * write buffer of @a connection.  If @a carried bytes of earlier
+ * responses are still in the write buffer, it is grown and the
+ * returned space follows them; otherwise a new buffer is allocated
+ * (and the caller must set up the write buffer to point to it).
+ *
+ * @param connection the connection
+ * @param carried number of bytes carried in the write buffer
+ * @param size number of bytes needed
+ * @return where to write the @a size bytes, NULL if out of memory
+ */
+static char *
+allocate_write_space (struct MHD_Connection *connection,
+                      size_t carried,
+                      size_t size)
+{
+  char *buf;
+
+  if (0 == carried)
+    return MHD_pool_allocate (connection->pool, size + 1, MHD_NO);
+  buf = MHD_pool_reallocate (connection->pool,
+                             connection->write_buffer,
+                             connection->write_buffer_size,
+                             carried + size + 1);
+  if (NULL == buf)
+    return NULL;
+  connection->write_buffer = buf;
+  connection->write_buffer_size = carried + size + 1;
+  return &buf[carried];
+}
+
+
+/**
+ * Allocate the connection's write buffer and fill it with all of the
+ * headers (or footers, if we have already sent the body) from the
+ * HTTPd's response.  If headers are missing in the response supplied
+ * by the application, additional headers may be added here.  The
+ * status line and headers are taken from the block cached in the
+ * response, so only the "Date:" header is produced per request.
+ * Headers are appended to the responses to earlier pipelined
+ * requests that are still in the write buffer (see
+ * #can_batch_response()).
+ *
+ * @param connection the connection
+ * @return #MHD_YES on success, #MHD_NO on failure (out of memory)
+ */
+static int
+build_header_response (struct MHD_Connection *connection)
+{
+  size_t size;
+  size_t off;
+  char date_buf[128];
+  const char *date;
+  size_t date_len;
+  char *data;
+  enum MHD_ValueKind kind;
+  uint64_t key;
+  int have_block;
+  const char *client_requested_close;
+  const char *response_has_close;
+  const char *response_has_keepalive;
+  const char *have_encoding;
+  const char *have_content_length;
+  int must_add_close;
+  int must_add_chunked_encoding;
   int must_add_keep_alive;
   int must_add_content_length;
+  size_t body_size;
+  size_t carried;
 
   EXTRA_CHECK (NULL != connection->version);
   if (0 == connection->version[0])
     {
+      if (0 != connection->write_buffer_append_offset)
+        return MHD_YES; /* keep the carried responses */
       data = MHD_pool_allocate (connection->pool, 0, MHD_YES);
       connection->write_buffer = data;
       connection->write_buffer_append_offset = 0;
@@ -880,37 +1703,26 @@ build_header_response (struct MHD_Connection *connection)
     }
   if (MHD_CONNECTION_FOOTERS_RECEIVED == connection->state)
     {
-      rc = connection->responseCode & (~MHD_ICY_FLAG);
-      reason_phrase = MHD_get_reason_phrase_for (rc);
-      sprintf (code,
-               "%s %u %s\r\n",
-	       (0 != (connection->responseCode & MHD_ICY_FLAG))
-	       ? "ICY"
-	       : ( (MHD_str_equal_caseless_ (MHD_HTTP_VERSION_1_0,
-				     connection->version))
-		   ? MHD_HTTP_VERSION_1_0
-		   : MHD_HTTP_VERSION_1_1),
-	       rc,
-	       reason_phrase);
-      off = strlen (code);
-      /* estimate size */
-      size = off + 2;           /* +2 for extra "\r\n" at the end */
       kind = MHD_HEADER_KIND;
       if ( (0 == (connection->daemon->options & MHD_SUPPRESS_DATE_NO_CLOCK)) &&
 	   (NULL == MHD_get_response_header (connection->response,
 					     MHD_HTTP_HEADER_DATE)) )
-        get_date_string (date);
+        date = get_date_line (connection,
+                              date_buf,
+                              &date_len);
       else
-        date[0] = '\0';
-      size += strlen (date);
+        {
+          date = "";
+          date_len = 0;
+        }
     }
   else
     {
-      /* 2 bytes for final CRLF of a Chunked-Body */
-      size = 2;
       kind = MHD_FOOTER_KIND;
-      off = 0;
+      date = "";
+      date_len = 0;
     }
+  response_has_keepalive = NULL;
 
   /* calculate extra headers we need to add, such as 'Connection: close',
      first see what was explicitly requested by the application */
@@ -930,9 +1742,8 @@ build_header_response (struct MHD_Connection *connection)
       if ( (NULL != response_has_keepalive) &&
            (!MHD_str_equal_caseless_ (response_has_keepalive, "Keep-Alive")) )
         response_has_keepalive = NULL;
-      client_requested_close = MHD_lookup_connection_value (connection,
-                                                            MHD_HEADER_KIND,
-                                                            MHD_HTTP_HEADER_CONNECTION);
+      client_requested_close = lookup_header (connection,
+                                              MHD_HEADER_TOKEN_CONNECTION);
       if ( (NULL != client_requested_close) &&
            (!MHD_str_equal_caseless_ (client_requested_close, "close")) )
         client_requested_close = NULL;
@@ -1011,10 +1822,6 @@ build_header_response (struct MHD_Connection *connection)
             Note that the change from 'SHOULD NOT' to 'MUST NOT' is
             a recent development of the HTTP 1.1 specification.
           */
-          content_length_len
-            = sprintf (content_length_buf,
-                       MHD_HTTP_HEADER_CONTENT_LENGTH ": " MHD_UNSIGNED_LONG_LONG_PRINTF "\r\n",
-                       (MHD_UNSIGNED_LONG_LONG) connection->response->total_size);
           must_add_content_length = MHD_YES;
         }
 
@@ -1031,27 +1838,69 @@ build_header_response (struct MHD_Connection *connection)
     default:
       EXTRA_CHECK (0);
     }
-
-  if (must_add_close)
-    size += strlen ("Connection: close\r\n");
-  if (must_add_keep_alive)
-    size += strlen ("Connection: Keep-Alive\r\n");
-  if (must_add_chunked_encoding)
-    size += strlen ("Transfer-Encoding: chunked\r\n");
-  if (must_add_content_length)
-    size += content_length_len;
   EXTRA_CHECK (! (must_add_close && must_add_keep_alive) );
   EXTRA_CHECK (! (must_add_chunked_encoding && must_add_content_length) );
 
-  for (pos = connection->response->first_header; NULL != pos; pos = pos->next)
-    if ( (pos->kind == kind) &&
-         (! ( (MHD_YES == must_add_close) &&
-              (pos->value == response_has_keepalive) &&
-              (MHD_str_equal_caseless_(pos->header,
-                                MHD_HTTP_HEADER_CONNECTION) ) ) ) )
-      size += strlen (pos->header) + strlen (pos->value) + 4; /* colon, space, linefeeds */
-  /* produce data */
-  data = MHD_pool_allocate (connection->pool, size + 1, MHD_NO);
+  /* produce data; +2 for the final "\r\n" */
+  data = NULL;
+  size = 0;
+  off = 0;
+  have_block = MHD_NO;
+  carried = (MHD_HEADER_KIND == kind)
+    ? connection->write_buffer_append_offset : 0;
+  body_size = ( (MHD_HEADER_KIND == kind) &&
+                (MHD_YES == can_inline_body (connection)) )
+    ? (size_t) connection->response->total_size : 0;
+  if (MHD_HEADER_KIND == kind)
+    {
+      key = (((uint64_t) connection->responseCode) << 5)
+        | ( (MHD_str_equal_caseless_ (MHD_HTTP_VERSION_1_0,
+                                      connection->version)) ? 16 : 0)
+        | ( (MHD_YES == must_add_close) ? 8 : 0)
+        | ( (MHD_YES == must_add_keep_alive) ? 4 : 0)
+        | ( (MHD_YES == must_add_chunked_encoding) ? 2 : 0)
+        | ( (MHD_YES == must_add_content_length) ? 1 : 0);
+      (void) MHD_mutex_lock_ (&connection->response->mutex);
+      if (MHD_YES == update_header_block (connection,
+                                          key,
+                                          must_add_close,
+                                          must_add_keep_alive,
+                                          must_add_chunked_encoding,
+                                          must_add_content_length,
+                                          response_has_keepalive))
+        {
+          have_block = MHD_YES;
+          off = connection->response->header_block_size;
+          size = off + date_len + 2 + body_size;
+          data = allocate_write_space (connection, carried, size);
+          if (NULL != data)
+            memcpy (data,
+                    connection->response->header_block,
+                    off);
+        }
+      (void) MHD_mutex_unlock_ (&connection->response->mutex);
+    }
+  if (MHD_NO == have_block)
+    {
+      size = serialize_headers (connection,
+                                NULL,
+                                kind,
+                                must_add_close,
+                                must_add_keep_alive,
+                                must_add_chunked_encoding,
+                                must_add_content_length,
+                                response_has_keepalive) + date_len + 2 + body_size;
+      data = allocate_write_space (connection, carried, size);
+      if (NULL != data)
+        off = serialize_headers (connection,
+                                 data,
+                                 kind,
+                                 must_add_close,
+                                 must_add_keep_alive,
+                                 must_add_chunked_encoding,
+                                 must_add_content_length,
+                                 response_has_keepalive);
+    }
   if (NULL == data)
     {
 #ifdef HAVE_MESSAGES
@@ -1060,62 +1909,26 @@ build_header_response (struct MHD_Connection *connection)
 #endif
       return MHD_NO;
     }
-  if (MHD_CONNECTION_FOOTERS_RECEIVED == connection->state)
-    {
-      memcpy (data, code, off);
-    }
-  if (must_add_close)
-    {
-      /* we must add the 'Connection: close' header */
-      memcpy (&data[off],
-              "Connection: close\r\n",
-	      strlen ("Connection: close\r\n"));
-      off += strlen ("Connection: close\r\n");
-    }
-  if (must_add_keep_alive)
-    {
-      /* we must add the 'Connection: Keep-Alive' header */
-      memcpy (&data[off],
-              "Connection: Keep-Alive\r\n",
-	      strlen ("Connection: Keep-Alive\r\n"));
-      off += strlen ("Connection: Keep-Alive\r\n");
-    }
-  if (must_add_chunked_encoding)
-    {
-      /* we must add the 'Transfer-Encoding: chunked' header */
-      memcpy (&data[off],
-              "Transfer-Encoding: chunked\r\n",
-	      strlen ("Transfer-Encoding: chunked\r\n"));
-      off += strlen ("Transfer-Encoding: chunked\r\n");
-    }
-  if (must_add_content_length)
+  memcpy (&data[off], date, date_len);
+  off += date_len;
+  memcpy (&data[off], "\r\n", 2);
+  off += 2;
+  if (0 != body_size)
     {
-      /* we must add the 'Content-Length' header */
       memcpy (&data[off],
-              content_length_buf,
-	      content_length_len);
-      off += content_length_len;
+              connection->response->data,
+              body_size);
+      off += body_size;
+      connection->response_write_position = body_size;
     }
-  for (pos = connection->response->first_header; NULL != pos; pos = pos->next)
-    if ( (pos->kind == kind) &&
-         (! ( (pos->value == response_has_keepalive) &&
-              (MHD_YES == must_add_close) &&
-              (MHD_str_equal_caseless_(pos->header,
-                                MHD_HTTP_HEADER_CONNECTION) ) ) ) )
-      off += sprintf (&data[off],
-		      "%s: %s\r\n",
-		      pos->header,
-		      pos->value);
-  if (MHD_CONNECTION_FOOTERS_RECEIVED == connection->state)
-    {
-      strcpy (&data[off], date);
-      off += strlen (date);
-    }
-  memcpy (&data[off], "\r\n", 2);
-  off += 2;
 
   if (off != size)
     mhd_panic (mhd_panic_cls, __FILE__, __LINE__, NULL);
+  if (0 != carried)
+    {
+      connection->write_buffer_append_offset += size;
+      return MHD_YES;
+    }
   connection->write_buffer = data;
   connection->write_buffer_append_offset = size;
   connection->write_buffer_send_offset = 0;
@@ -1125,21 +1938,19 @@ build_header_response (struct MHD_Connection *connection)
 
 
 /**
- * We encountered an error processing the request.
- * Handle it properly by stopping to read data
- * and sending the indicated response code and message.
+ * Queue @a response as the final response of the connection: the
+ * rest of the request is not read, and the connection is closed
+ * once the response was sent.
  *
  * @param connection the connection
- * @param status_code the response code to send (400, 413 or 414)
- * @param message the error message to send
+ * @param status_code the response code to send
+ * @param response the response to send
  */
 static void
-transmit_error_response (struct MHD_Connection *connection,
+transmit_final_response (struct MHD_Connection *connection,
                          unsigned int status_code,
-			 const char *message)
+                         struct MHD_Response *response)
 {
-  struct MHD_Response *response;
-
   if (NULL == connection->version)
     {
       /* we were unable to process the full header line, so we don't
@@ -1148,18 +1959,9 @@ transmit_error_response (struct MHD_Connection *connection,
     }
   connection->state = MHD_CONNECTION_FOOTERS_RECEIVED;
   connection->read_closed = MHD_YES;
-#ifdef HAVE_MESSAGES
-  MHD_DLOG (connection->daemon,
-            "Error %u (`%s') processing request, closing connection.\n",
-            status_code, message);
-#endif
   EXTRA_CHECK (NULL == connection->response);
-  response = MHD_create_response_from_buffer (strlen (message),
-					      (void *) message,
-					      MHD_RESPMEM_PERSISTENT);
   MHD_queue_response (connection, status_code, response);
   EXTRA_CHECK (NULL != connection->response);
-  MHD_destroy_response (response);
   if (MHD_NO == build_header_response (connection))
     {
       /* oops - close! */
@@ -1173,6 +1975,73 @@ transmit_error_response (struct MHD_Connection *connection,
 }
 
 
+/**
+ * We encountered an error processing the request.
+ * Handle it properly by stopping to read data
+ * and sending the indicated response code and message.
+ *
+ * @param connection the connection
+ * @param status_code the response code to send (400, 413 or 414)
+ * @param message the error message to send
+ */
+static void
+transmit_error_response (struct MHD_Connection *connection,
+                         unsigned int status_code,
+			 const char *message)
+{
+  struct MHD_Response *response;
+
+#ifdef HAVE_MESSAGES
+  MHD_DLOG (connection->daemon,
+            "Error %u (`%s') processing request, closing connection.\n",
+            status_code, message);
+#endif
+  response = MHD_create_response_from_buffer (strlen (message),
+					      (void *) message,
+					      MHD_RESPMEM_PERSISTENT);
+  transmit_final_response (connection, status_code, response);
+  MHD_destroy_response (response);
+}
+
+
+/**
+ * Check whether the application wants to process the request
+ * whose request line was just parsed (see
+ * #MHD_OPTION_REQUEST_LINE_CALLBACK).  If not, the response
+ * given by the application is queued or the connection is
+ * closed.
+ *
+ * @param connection the connection
+ * @return #MHD_YES to continue with the headers, #MHD_NO if
+ *         the request was rejected
+ */
+static int
+check_request_line (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+  struct MHD_Response *response;
+  unsigned int status_code;
+
+  if (NULL == daemon->request_line_callback)
+    return MHD_YES;
+  response = NULL;
+  status_code = MHD_HTTP_FORBIDDEN;
+  if (MHD_NO != daemon->request_line_callback (daemon->request_line_callback_cls,
+                                               connection,
+                                               connection->method,
+                                               connection->url,
+                                               &status_code,
+                                               &response))
+    return MHD_YES;
+  if (NULL == response)
+    CONNECTION_CLOSE_ERROR (connection,
+                            NULL);
+  else
+    transmit_final_response (connection, status_code, response);
+  return MHD_NO;
+}
+
+
 /**
  * Update the 'event_loop_info' field of this connection based on the state
  * that the connection is now in.  May also close the connection or
@@ -1232,6 +2101,14 @@ MHD_connection_update_event_loop_info (struct MHD_Connection *connection)
           connection->event_loop_info = MHD_EVENT_LOOP_INFO_WRITE;
           break;
         case MHD_CONNECTION_CONTINUE_SENT:
+          if (MHD_CONNECTION_OFFLOAD_NONE != connection->offload_state)
+            {
+              /* the upload data of the offloaded call stays in the
+                 read buffer until the call completed; a full buffer
+                 is expected here and handled once it did */
+              connection->event_loop_info = MHD_EVENT_LOOP_INFO_BLOCK;
+              break;
+            }
           if (connection->read_buffer_offset == connection->read_buffer_size)
             {
               if ((MHD_YES != try_grow_read_buffer (connection)) &&
@@ -1315,6 +2192,21 @@ MHD_connection_update_event_loop_info (struct MHD_Connection *connection)
         }
       break;
     }
+  if ( (MHD_YES == have_carried_response (connection)) &&
+       (MHD_EVENT_LOOP_INFO_CLEANUP != connection->event_loop_info) )
+    {
+      /* send the responses to earlier pipelined requests before
+         waiting for anything else */
+      connection->event_loop_info = MHD_EVENT_LOOP_INFO_WRITE;
+    }
+  if ( (MHD_YES == connection->flush_pending) &&
+       (MHD_EVENT_LOOP_INFO_WRITE != connection->event_loop_info) )
+    {
+      /* end of a batch of pipelined responses: push out what is
+         buffered before waiting for the client */
+      socket_start_no_buffering_flush (connection);
+      connection->flush_pending = MHD_NO;
+    }
 }
 
 
@@ -1337,15 +2229,14 @@ get_next_header_line (struct MHD_Connection *connection)
 
   if (0 == connection->read_buffer_offset)
     return NULL;
-  pos = 0;
   rbuf = connection->read_buffer;
-  while ((pos < connection->read_buffer_offset - 1) &&
-         ('\r' != rbuf[pos]) && ('\n' != rbuf[pos]))
-    pos++;
-  if ( (pos == connection->read_buffer_offset - 1) &&
-       ('\n' != rbuf[pos]) )
+  if ( (MHD_NO == MHD_line_scan_ (&connection->line_scan,
+                                  rbuf,
+                                  connection->read_buffer_offset)) ||
+       ( (connection->line_scan.pos == connection->read_buffer_offset - 1) &&
+         ('\n' != rbuf[connection->line_scan.pos]) ) )
     {
-      /* not found, consider growing... */
+      /* not found (or CR without the LF yet), consider growing... */
       if ( (connection->read_buffer_offset == connection->read_buffer_size) &&
 	   (MHD_NO ==
 	    try_grow_read_buffer (connection)) )
@@ -1358,6 +2249,14 @@ get_next_header_line (struct MHD_Connection *connection)
 	}
       return NULL;
     }
+  pos = connection->line_scan.pos;
+  connection->line_colon = (0 != connection->line_scan.colon)
+    ? &rbuf[connection->line_scan.colon - 1]
+    : NULL;
+  connection->line_space = (0 != connection->line_scan.space)
+    ? &rbuf[connection->line_scan.space - 1]
+    : NULL;
+  MHD_line_scan_reset_ (&connection->line_scan);
   /* found, check if we have proper LFCR */
   if (('\r' == rbuf[pos]) && ('\n' == rbuf[pos + 1]))
     rbuf[pos++] = '\0';         /* skip both r and n */
@@ -1405,6 +2304,41 @@ connection_add_header (struct MHD_Connection *connection,
 }
 
 
+/**
+ * Add an argument or cookie parsed on first use to the
+ * headers of the connection.  As the request is already being
+ * processed at that point, running out of memory only stops
+ * the parsing.
+ *
+ * @param connection the connection for which a
+ *  value should be set
+ * @param kind kind of the value
+ * @param key key for the value
+ * @param value the value itself
+ * @return #MHD_NO on failure (out of memory), #MHD_YES for success
+ */
+static int
+add_parsed_value (struct MHD_Connection *connection,
+                  const char *key,
+                  const char *value,
+                  enum MHD_ValueKind kind)
+{
+  if (MHD_NO ==
+      MHD_set_connection_value (connection,
+				kind,
+				key,
+				value))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (connection->daemon,
+                "Not enough memory to parse all arguments and cookies!\n");
+#endif
+      return MHD_NO;
+    }
+  return MHD_YES;
+}
+
+
 /**
  * Parse the cookie header (see RFC 2109).
  *
@@ -1424,9 +2358,8 @@ parse_cookie_header (struct MHD_Connection *connection)
   char old;
   int quotes;
 
-  hdr = MHD_lookup_connection_value (connection,
-				     MHD_HEADER_KIND,
-				     MHD_HTTP_HEADER_COOKIE);
+  hdr = lookup_header (connection,
+                       MHD_HEADER_TOKEN_COOKIE);
   if (NULL == hdr)
     return MHD_YES;
   cpy = MHD_pool_allocate (connection->pool, strlen (hdr) + 1, MHD_YES);
@@ -1436,8 +2369,6 @@ parse_cookie_header (struct MHD_Connection *connection)
       MHD_DLOG (connection->daemon,
                 "Not enough memory to parse cookies!\n");
 #endif
-      transmit_error_response (connection, MHD_HTTP_REQUEST_ENTITY_TOO_LARGE,
-                               REQUEST_TOO_BIG);
       return MHD_NO;
     }
   memcpy (cpy, hdr, strlen (hdr) + 1);
@@ -1461,7 +2392,7 @@ parse_cookie_header (struct MHD_Connection *connection)
         {
           /* value part omitted, use empty string... */
           if (MHD_NO ==
-              connection_add_header (connection, pos, "", MHD_COOKIE_KIND))
+              add_parsed_value (connection, pos, "", MHD_COOKIE_KIND))
             return MHD_NO;
           if (old == '\0')
             break;
@@ -1495,10 +2426,10 @@ parse_cookie_header (struct MHD_Connection *connection)
           equals++;
         }
       if (MHD_NO ==
-	  connection_add_header (connection,
-				 pos,
-				 equals,
-				 MHD_COOKIE_KIND))
+	  add_parsed_value (connection,
+                            pos,
+                            equals,
+                            MHD_COOKIE_KIND))
         return MHD_NO;
       pos = semicolon;
     }
@@ -1506,6 +2437,43 @@ parse_cookie_header (struct MHD_Connection *connection)
 }
 
 
+/**
+ * Parse the values of the given kind(s) of the request that are
+ * only parsed on first use (arguments of the URL and cookies), if
+ * that did not happen yet.
+ *
+ * @param connection connection to parse values of
+ * @param kind kind(s) of values needed
+ */
+void
+MHD_connection_parse_values_ (struct MHD_Connection *connection,
+                              enum MHD_ValueKind kind)
+{
+  char *args;
+  unsigned int unused_num_headers;
+
+  if ( (0 != (kind & MHD_GET_ARGUMENT_KIND)) &&
+       (NULL != connection->args) )
+    {
+      args = connection->args;
+      connection->args = NULL;
+      /* note that this call clobbers 'args' */
+      MHD_parse_arguments_ (connection,
+			    MHD_GET_ARGUMENT_KIND,
+			    args,
+			    &add_parsed_value,
+			    &unused_num_headers);
+    }
+  if ( (0 != (kind & MHD_COOKIE_KIND)) &&
+       (MHD_NO == connection->cookies_parsed) &&
+       (connection->state >= MHD_CONNECTION_HEADERS_RECEIVED) )
+    {
+      connection->cookies_parsed = MHD_YES;
+      parse_cookie_header (connection);
+    }
+}
+
+
 /**
  * Parse the first line of the HTTP HEADER.
  *
@@ -1521,9 +2489,9 @@ parse_initial_message_line (struct MHD_Connection *connection,
   char *uri;
   char *http_version;
   char *args;
-  unsigned int unused_num_headers;
 
-  if (NULL == (uri = strchr (line, ' ')))
+  /* the first space was found while scanning for the end of the line */
+  if (NULL == (uri = connection->line_space))
     return MHD_NO;              /* serious error */
   uri[0] = '\0';
   connection->method = line;
@@ -1546,12 +2514,8 @@ parse_initial_message_line (struct MHD_Connection *connection,
     {
       args[0] = '\0';
       args++;
-      /* note that this call clobbers 'args' */
-      MHD_parse_arguments_ (connection,
-			    MHD_GET_ARGUMENT_KIND,
-			    args,
-			    &connection_add_header,
-			    &unused_num_headers);
+      /* parsed on first use, see MHD_connection_parse_values_() */
+      connection->args = args;
     }
   daemon->unescape_callback (daemon->unescape_callback_cls,
 			     connection,
@@ -1565,6 +2529,101 @@ parse_initial_message_line (struct MHD_Connection *connection,
 }
 
 
+/**
+ * Queue the response registered with #MHD_OPTION_STATIC_RESPONSES
+ * for the request of @a connection, if there is one.  The body of
+ * the request is not read; if the request has one, the connection
+ * is closed after the response.
+ *
+ * @param connection connection whose headers were processed
+ * @return #MHD_YES if a response was queued
+ */
+static int
+queue_static_response (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+  const struct MHD_StaticEntry *entry;
+  size_t url_len;
+  unsigned int i;
+
+  if (0 == daemon->num_static_responses)
+    return MHD_NO;
+  url_len = strlen (connection->url);
+  for (i = 0; i < daemon->num_static_responses; i++)
+    {
+      entry = &daemon->static_responses[i];
+      if ( (url_len != entry->url_len) ||
+           (0 != memcmp (connection->url, entry->url, url_len)) ||
+           ( (NULL != entry->method) &&
+             (0 != strcmp (connection->method, entry->method)) ) )
+        continue;
+      if (0 != connection->remaining_upload_size)
+        {
+          connection->remaining_upload_size = 0;
+          connection->read_closed = MHD_YES;
+        }
+      if (MHD_YES == entry->notify_completed)
+        connection->client_aware = MHD_YES;
+      return MHD_queue_response (connection,
+                                 entry->status_code,
+                                 entry->response);
+    }
+  return MHD_NO;
+}
+
+
+/**
+ * Call the access handler of the application.  If the request is
+ * offloaded (#MHD_offload_request()), the connection is suspended
+ * instead and the call is handed to the offload pool at the end of
+ * #MHD_connection_handle_idle().  Once the call completed, the
+ * state machine calls this function again with the same data (plus
+ * whatever was received in the meantime) and obtains the result of
+ * the offloaded call.
+ *
+ * @param connection connection we're processing
+ * @param upload_data data uploaded by the client
+ * @param[in,out] upload_data_size number of bytes in @a upload_data,
+ *        set to the number of bytes the handler did not process
+ * @return result of the access handler, #MHD_YES if the call
+ *         was offloaded
+ */
+static int
+call_access_handler (struct MHD_Connection *connection,
+                     const char *upload_data,
+                     size_t *upload_data_size)
+{
+  if (MHD_CONNECTION_OFFLOAD_DONE == connection->offload_state)
+    {
+      /* more data may have arrived since the call was offloaded,
+         which the handler did not see */
+      connection->offload_state = MHD_CONNECTION_OFFLOAD_NONE;
+      *upload_data_size -= connection->offload_upload_data_size;
+      return connection->offload_result;
+    }
+  if ( (NULL == connection->handler) &&
+       (MHD_NO == MHD_router_dispatch_ (connection)) )
+    return MHD_NO;
+  connection->client_aware = MHD_YES;
+  if (MHD_YES == connection->offload)
+    {
+      connection->offload_upload_data = upload_data;
+      connection->offload_upload_data_size = *upload_data_size;
+      connection->offload_state = MHD_CONNECTION_OFFLOAD_PENDING;
+      MHD_suspend_connection (connection);
+      return MHD_YES;
+    }
+  return connection->handler (connection->handler_cls,
+                              connection,
+                              connection->url,
+                              connection->method,
+                              connection->version,
+                              upload_data,
+                              upload_data_size,
+                              &connection->client_context);
+}
+
+
 /**
  * Call the handler of the application for this
  * connection.  Handles chunking of the upload
@@ -1577,18 +2636,14 @@ call_connection_handler (struct MHD_Connection *connection)
 {
   size_t processed;
 
-  if (NULL != connection->response)
+  if ( (NULL != connection->response) &&
+       (MHD_CONNECTION_OFFLOAD_DONE != connection->offload_state) )
     return;                     /* already queued a response */
   processed = 0;
-  connection->client_aware = MHD_YES;
   if (MHD_NO ==
-      connection->daemon->default_handler (connection->daemon-> default_handler_cls,
-					   connection,
-                                           connection->url,
-					   connection->method,
-					   connection->version,
-					   NULL, &processed,
-					   &connection->client_context))
+      call_access_handler (connection,
+                           NULL,
+                           &processed))
     {
       /* serious internal error, close connection */
       CONNECTION_CLOSE_ERROR (connection,
@@ -1618,7 +2673,8 @@ process_request_body (struct MHD_Connection *connection)
   char *buffer_head;
   char *end;
 
-  if (NULL != connection->response)
+  if ( (NULL != connection->response) &&
+       (MHD_CONNECTION_OFFLOAD_DONE != connection->offload_state) )
     return;                     /* already queued a response */
 
   buffer_head = connection->read_buffer;
@@ -1736,22 +2792,29 @@ process_request_body (struct MHD_Connection *connection)
 	    }
         }
       used = processed;
-      connection->client_aware = MHD_YES;
+      if ( (MHD_YES == connection->offload) &&
+           (MHD_CONNECTION_OFFLOAD_DONE != connection->offload_state) )
+        {
+          /* the offloaded call completes later; until then, keep
+             the data for it at the start of the read buffer, from
+             where we will pass the same data again */
+          if (buffer_head != connection->read_buffer)
+            memmove (connection->read_buffer, buffer_head, available);
+          buffer_head = connection->read_buffer;
+          connection->read_buffer_offset = available;
+        }
       if (MHD_NO ==
-          connection->daemon->default_handler (connection->daemon->default_handler_cls,
-                                               connection,
-                                               connection->url,
-                                               connection->method,
-                                               connection->version,
-                                               buffer_head,
-                                               &processed,
-                                               &connection->client_context))
+          call_access_handler (connection,
+                               buffer_head,
+                               &processed))
         {
           /* serious internal error, close connection */
 	  CONNECTION_CLOSE_ERROR (connection,
 				  "Internal application error, closing connection.\n");
           return;
         }
+      if (MHD_CONNECTION_OFFLOAD_NONE != connection->offload_state)
+        return; /* call was offloaded, read buffer is already up to date */
       if (processed > used)
         mhd_panic (mhd_panic_cls, __FILE__, __LINE__
 #ifdef HAVE_MESSAGES
@@ -1868,6 +2931,170 @@ do_write (struct MHD_Connection *connection)
 }
 
 
+#if SENDV_SUPPORT
+/**
+ * Check whether the rest of the body of the response of @a connection
+ * can be sent directly from memory with do_writev(), that is from
+ * the buffer of the response, from its segments or from the buffers
+ * pushed to it (as far as they are available).  Chunked encoding is
+ * only supported for pushed buffers, once the chunk is prepared
+ * (see try_ready_push_chunk()).
+ *
+ * @param connection connection to check
+ * @return #MHD_YES if do_writev() can send the body
+ */
+static int
+can_gather_body (struct MHD_Connection *connection)
+{
+  struct MHD_Response *response = connection->response;
+
+  if (NULL == connection->sendv_cls)
+    return MHD_NO;
+  if ( (NULL == response->iov) &&
+       (NULL == response->push) )
+    return body_in_buffer (connection);
+  return ( (MHD_NO == connection->have_chunked_upload) &&
+           (connection->response_write_position < response->total_size) )
+    ? MHD_YES : MHD_NO;
+}
+
+
+/**
+ * Try writing the rest of the write buffer of the connection
+ * together with (the next part of) the body of the response using
+ * a single system call.  The body must be available in memory, see
+ * can_gather_body().
+ *
+ * @param connection connection we're processing
+ * @return #MHD_YES if something changed,
+ *         #MHD_NO if we were interrupted
+ */
+static int
+do_writev (struct MHD_Connection *connection)
+{
+  struct MHD_Response *response = connection->response;
+  struct iovec iov[MHD_SENDV_MAX_SEGMENTS];
+  uint64_t pos;
+  unsigned int i;
+  int cnt;
+  size_t max;
+  ssize_t ret;
+#if ZEROCOPY_SUPPORT
+  size_t body;
+  int zerocopy;
+#endif
+
+  max = connection->write_buffer_append_offset - connection->write_buffer_send_offset;
+  cnt = 0;
+  if (0 != max)
+    {
+      iov[0].iov_base = &connection->write_buffer[connection->write_buffer_send_offset];
+      iov[0].iov_len = max;
+      cnt++;
+    }
+  pos = connection->response_write_position;
+  if (NULL != response->push)
+    {
+      /* only the data of the current chunk with chunked encoding */
+      cnt += MHD_response_push_gather_ (response,
+                                        &iov[cnt],
+                                        MHD_SENDV_MAX_SEGMENTS - cnt,
+                                        (MHD_YES == connection->have_chunked_upload)
+                                        ? connection->push_chunk_left
+                                        : (size_t) MHD_MIN ((uint64_t) SIZE_MAX,
+                                                            response->total_size - pos));
+    }
+  else if (NULL == response->iov)
+    {
+      iov[cnt].iov_base = (void *) &response->data[(size_t) pos];
+      iov[cnt].iov_len = (size_t) (response->total_size - pos);
+      cnt++;
+    }
+  else
+    {
+      for (i = 0; i < response->iov_cnt; i++)
+        {
+          if (pos < response->iov[i].iov_len)
+            break;
+          pos -= response->iov[i].iov_len;
+        }
+      for (; (i < response->iov_cnt) && (cnt < MHD_SENDV_MAX_SEGMENTS); i++)
+        {
+          if (0 == response->iov[i].iov_len)
+            continue;
+          iov[cnt].iov_base = (char *) response->iov[i].iov_base + (size_t) pos;
+          iov[cnt].iov_len = response->iov[i].iov_len - (size_t) pos;
+          cnt++;
+          pos = 0;
+        }
+    }
+#if ZEROCOPY_SUPPORT
+  /* only the data of the response, not the headers in the memory
+     pool of the connection, may be sent without copying; pushed
+     buffers are released as soon as they are sent */
+  zerocopy = MHD_NO;
+  if ( (0 != connection->daemon->zerocopy_threshold) &&
+       (0 == max) &&
+       (NULL == response->push) )
+    {
+      body = 0;
+      for (i = 0; i < (unsigned int) cnt; i++)
+        body += iov[i].iov_len;
+      if (body >= connection->daemon->zerocopy_threshold)
+        zerocopy = MHD_zerocopy_prepare_ (&connection->zerocopy,
+                                          connection->socket_fd,
+                                          response);
+    }
+  ret = connection->sendv_cls (connection,
+                               iov,
+                               cnt,
+                               (MHD_YES == zerocopy) ? MSG_ZEROCOPY : 0);
+  if ( (ret < 0) &&
+       (MHD_YES == zerocopy) &&
+       (ENOBUFS == MHD_socket_errno_) )
+    {
+      /* too many sends are pending */
+      zerocopy = MHD_NO;
+      ret = connection->sendv_cls (connection, iov, cnt, 0);
+    }
+  if ( (0 <= ret) &&
+       (MHD_YES == zerocopy) )
+    MHD_zerocopy_sent_ (&connection->zerocopy);
+#else
+  ret = connection->sendv_cls (connection, iov, cnt, 0);
+#endif
+  if (ret < 0)
+    {
+      const int err = MHD_socket_errno_;
+      if ((EINTR == err) || (EAGAIN == err) || (EWOULDBLOCK == err))
+        return MHD_NO;
+      CONNECTION_CLOSE_ERROR (connection, NULL);
+      return MHD_YES;
+    }
+#if DEBUG_SEND_DATA
+  fprintf (stderr,
+           "Sent response: `%.*s'\n",
+           (int) ((size_t) ret < max ? (size_t) ret : max),
+           &connection->write_buffer[connection->write_buffer_send_offset]);
+#endif
+  if ((size_t) ret <= max)
+    {
+      connection->write_buffer_send_offset += ret;
+      return MHD_YES;
+    }
+  connection->write_buffer_send_offset += max;
+  connection->response_write_position += (size_t) ret - max;
+  if (NULL != response->push)
+    {
+      MHD_response_push_consume_ (response, (size_t) ret - max);
+      if (MHD_YES == connection->have_chunked_upload)
+        connection->push_chunk_left -= (size_t) ret - max;
+    }
+  return MHD_YES;
+}
+#endif
+
+
 /**
  * Check if we are done sending the write-buffer.
  * If so, transition into "next_state".
@@ -1895,6 +3122,40 @@ check_write_done (struct MHD_Connection *connection,
 }
 
 
+/**
+ * Check whether the application wants to keep a request header
+ * (see #MHD_OPTION_HEADER_FILTER).
+ *
+ * @param connection connection we're processing
+ * @param name name of the header
+ * @return #MHD_YES to keep the header, #MHD_NO to discard it
+ */
+static int
+keep_header (struct MHD_Connection *connection,
+             const char *name)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+  uint32_t hash;
+
+  if (NULL == daemon->header_filter)
+    return MHD_YES;
+  switch (MHD_header_token_ (name, &hash))
+    {
+    case MHD_HEADER_TOKEN_CONNECTION:
+    case MHD_HEADER_TOKEN_CONTENT_LENGTH:
+    case MHD_HEADER_TOKEN_EXPECT:
+    case MHD_HEADER_TOKEN_HOST:
+    case MHD_HEADER_TOKEN_TRANSFER_ENCODING:
+      /* needed by MHD itself */
+      return MHD_YES;
+    default:
+      return daemon->header_filter (daemon->header_filter_cls,
+                                    connection,
+                                    name);
+    }
+}
+
+
 /**
  * We have received (possibly the beginning of) a line in the
  * header (or footer).  Validate (check for ":") and prepare
@@ -1909,8 +3170,9 @@ process_header_line (struct MHD_Connection *connection, char *line)
 {
   char *colon;
 
-  /* line should be normal header line, find colon */
-  colon = strchr (line, ':');
+  /* line should be normal header line, the colon was
+     found while scanning for its end */
+  colon = connection->line_colon;
   if (NULL == colon)
     {
       /* error in header line, die hard */
@@ -1927,8 +3189,11 @@ process_header_line (struct MHD_Connection *connection, char *line)
      header at the beginning of the while
      loop since we need to be able to inspect
      the *next* header line (in case it starts
-     with a space...) */
-  connection->last = line;
+     with a space...); a NULL 'last' marks a
+     header the application does not want */
+  connection->last = (MHD_YES == keep_header (connection, line))
+    ? line
+    : NULL;
   connection->colon = colon;
   return MHD_YES;
 }
@@ -1954,6 +3219,9 @@ process_broken_line (struct MHD_Connection *connection,
   size_t tmp_len;
 
   last = connection->last;
+  if ( ((line[0] == ' ') || (line[0] == '\t')) &&
+       (NULL == last) )
+    return MHD_YES;             /* continues a discarded header */
   if ((line[0] == ' ') || (line[0] == '\t'))
     {
       /* value was continued on the next line, see
@@ -1988,11 +3256,12 @@ process_broken_line (struct MHD_Connection *connection,
       connection->last = last;
       return MHD_YES;           /* possibly more than 2 lines... */
     }
-  EXTRA_CHECK ((NULL != last) && (NULL != connection->colon));
-  if ((MHD_NO == connection_add_header (connection,
-                                        last,
-					connection->colon,
-					kind)))
+  EXTRA_CHECK (NULL != connection->colon);
+  if ( (NULL != last) &&
+       (MHD_NO == connection_add_header (connection,
+                                         last,
+                                         connection->colon,
+                                         kind)) )
     {
       transmit_error_response (connection, MHD_HTTP_REQUEST_ENTITY_TOO_LARGE,
                                REQUEST_TOO_BIG);
@@ -2028,14 +3297,12 @@ parse_connection_headers (struct MHD_Connection *connection)
   const char *enc;
   char *end;
 
-  parse_cookie_header (connection);
   if ( (0 != (MHD_USE_PEDANTIC_CHECKS & connection->daemon->options)) &&
        (NULL != connection->version) &&
        (MHD_str_equal_caseless_(MHD_HTTP_VERSION_1_1, connection->version)) &&
        (NULL ==
-        MHD_lookup_connection_value (connection,
-                                     MHD_HEADER_KIND,
-                                     MHD_HTTP_HEADER_HOST)) )
+        lookup_header (connection,
+                       MHD_HEADER_TOKEN_HOST)) )
     {
       /* die, http 1.1 request without host and we are pedantic */
       connection->state = MHD_CONNECTION_FOOTERS_RECEIVED;
@@ -2056,9 +3323,8 @@ parse_connection_headers (struct MHD_Connection *connection)
     }
 
   connection->remaining_upload_size = 0;
-  enc = MHD_lookup_connection_value (connection,
-				     MHD_HEADER_KIND,
-				     MHD_HTTP_HEADER_TRANSFER_ENCODING);
+  enc = lookup_header (connection,
+                       MHD_HEADER_TOKEN_TRANSFER_ENCODING);
   if (NULL != enc)
     {
       connection->remaining_upload_size = MHD_SIZE_UNKNOWN;
@@ -2067,9 +3333,8 @@ parse_connection_headers (struct MHD_Connection *connection)
     }
   else
     {
-      clen = MHD_lookup_connection_value (connection,
-					  MHD_HEADER_KIND,
-					  MHD_HTTP_HEADER_CONTENT_LENGTH);
+      clen = lookup_header (connection,
+                            MHD_HEADER_TOKEN_CONTENT_LENGTH);
       if (NULL != clen)
         {
           cval = strtoul (clen, &end, 10);
@@ -2091,35 +3356,45 @@ parse_connection_headers (struct MHD_Connection *connection)
 }
 
 
+/**
+ * Schedule the timeout of the connection in the timer wheel of its
+ * daemon, based on the time of the last activity.  Unschedules the
+ * connection if it has no timeout.  Does nothing for
+ * #MHD_USE_THREAD_PER_CONNECTION, where each thread tracks the timeout
+ * of its own connection.
+ *
+ * @param connection the connection to (re)schedule
+ */
+void
+MHD_connection_update_timeout_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+
+  if (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION))
+    return;
+  if (0 == connection->connection_timeout_ms)
+    {
+      MHD_timer_wheel_remove (&daemon->timeout_wheel,
+                              &connection->timeout_timer);
+      return;
+    }
+  MHD_timer_wheel_add (&daemon->timeout_wheel,
+                       &connection->timeout_timer,
+                       connection->last_activity + connection->connection_timeout_ms);
+}
+
+
 /**
  * Update the 'last_activity' field of the connection to the current time
- * and move the connection to the head of the 'normal_timeout' list if
- * the timeout for the connection uses the default value.
+ * and reschedule the timeout of the connection accordingly.
  *
  * @param connection the connection that saw some activity
  */
 static void
 update_last_activity (struct MHD_Connection *connection)
 {
-  struct MHD_Daemon *daemon = connection->daemon;
-
-  connection->last_activity = MHD_monotonic_sec_counter();
-  if (connection->connection_timeout != daemon->connection_timeout)
-    return; /* custom timeout, no need to move it in "normal" DLL */
-
-  /* move connection to head of timeout list (by remove + add operation) */
-  if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
-       (MHD_YES != MHD_mutex_lock_ (&daemon->cleanup_connection_mutex)) )
-    MHD_PANIC ("Failed to acquire cleanup mutex\n");
-  XDLL_remove (daemon->normal_timeout_head,
-	       daemon->normal_timeout_tail,
-	       connection);
-  XDLL_insert (daemon->normal_timeout_head,
-	       daemon->normal_timeout_tail,
-	       connection);
-  if  ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
-	(MHD_YES != MHD_mutex_unlock_ (&daemon->cleanup_connection_mutex)) )
-    MHD_PANIC ("Failed to release cleanup mutex\n");
+  connection->last_activity = MHD_monotonic_msec_counter();
+  MHD_connection_update_timeout_ (connection);
 }
 
 
@@ -2201,6 +3476,25 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
   ssize_t ret;
 
   update_last_activity (connection);
+  if (MHD_YES == have_carried_response (connection))
+    {
+      /* responses to earlier pipelined requests go out first */
+      do_write (connection);
+      if (MHD_CONNECTION_CLOSED == connection->state)
+        return MHD_YES;
+      if (connection->write_buffer_append_offset ==
+          connection->write_buffer_send_offset)
+        {
+          MHD_pool_reallocate (connection->pool,
+                               connection->write_buffer,
+                               connection->write_buffer_size, 0);
+          connection->write_buffer = NULL;
+          connection->write_buffer_size = 0;
+          connection->write_buffer_send_offset = 0;
+          connection->write_buffer_append_offset = 0;
+        }
+      return MHD_YES;
+    }
   while (1)
     {
 #if DEBUG_STATES
@@ -2252,7 +3546,12 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
           EXTRA_CHECK (0);
           break;
         case MHD_CONNECTION_HEADERS_SENDING:
-          do_write (connection);
+#if SENDV_SUPPORT
+          if (MHD_YES == can_gather_body (connection))
+            do_writev (connection);
+          else
+#endif
+            do_write (connection);
 	  if (connection->state != MHD_CONNECTION_HEADERS_SENDING)
  	     break;
           check_write_done (connection, MHD_CONNECTION_HEADERS_SENT);
@@ -2262,24 +3561,56 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
           break;
         case MHD_CONNECTION_NORMAL_BODY_READY:
           response = connection->response;
+#if SENDV_SUPPORT
+          if ( ( (NULL != response->iov) ||
+                 (NULL != response->push)
+#if ZEROCOPY_SUPPORT
+                 /* buffers, for MSG_ZEROCOPY */
+                 || (0 != connection->daemon->zerocopy_threshold)
+#endif
+                 ) &&
+               (MHD_YES == can_gather_body (connection)) )
+          {
+            /* no need to lock: the segments never change, and
+               pushed buffers are only consumed by this connection */
+            do_writev (connection);
+            if (MHD_CONNECTION_NORMAL_BODY_READY != connection->state)
+              break;
+            /* the idle handler checks for more pushed data */
+            if (NULL != response->push)
+              connection->state = MHD_CONNECTION_NORMAL_BODY_UNREADY;
+          }
+          else
+#endif
           if (connection->response_write_position <
               connection->response->total_size)
           {
             int err;
-            uint64_t data_write_offset;
-            if (NULL != response->crc)
-              (void) MHD_mutex_lock_ (&response->mutex);
+            const char *data;
+            size_t len;
+
             if (MHD_YES != try_ready_normal_body (connection))
               break;
-            data_write_offset = connection->response_write_position
-                                - response->data_start;
-            if (data_write_offset > (uint64_t)SIZE_MAX)
-              MHD_PANIC("Data offset exceeds limit");
+            if (NULL == response->crc)
+              {
+                data = &response->data[(size_t) connection->response_write_position];
+                len = response->data_size - (size_t) connection->response_write_position;
+              }
+            else
+              {
+                /* read-ahead window of the connection, empty if
+                   sendfile() is used */
+                data = &connection->write_buffer[connection->write_buffer_send_offset];
+                len = connection->write_buffer_append_offset
+                  - connection->write_buffer_send_offset;
+                if (0 == len)
+                  len = (size_t) MHD_MIN ((uint64_t) SIZE_MAX,
+                                          response->total_size -
+                                          connection->response_write_position);
+              }
             ret = connection->send_cls (connection,
-                                        &response->data
-                                        [(size_t)data_write_offset],
-                                        response->data_size -
-                                        (size_t)data_write_offset);
+                                        data,
+                                        len);
             err = MHD_socket_errno_;
 #if DEBUG_SEND_DATA
             if (ret > 0)
@@ -2287,11 +3618,8 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
                        "Sent %d-byte DATA response: `%.*s'\n",
                        (int) ret,
                        (int) ret,
-                       &response->data[connection->response_write_position -
-                                       response->data_start]);
+                       data);
 #endif
-            if (NULL != response->crc)
-              (void) MHD_mutex_unlock_ (&response->mutex);
             if (ret < 0)
               {
                 if ((err == EINTR) || (err == EAGAIN) || (EWOULDBLOCK == err))
@@ -2305,6 +3633,9 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
                 return MHD_YES;
               }
             connection->response_write_position += ret;
+            if (connection->write_buffer_send_offset <
+                connection->write_buffer_append_offset)
+              connection->write_buffer_send_offset += ret;
           }
           if (connection->response_write_position ==
               connection->response->total_size)
@@ -2314,7 +3645,18 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
           EXTRA_CHECK (0);
           break;
         case MHD_CONNECTION_CHUNKED_BODY_READY:
-          do_write (connection);
+#if SENDV_SUPPORT
+          if ( (NULL != connection->response->push) &&
+               (NULL != connection->sendv_cls) )
+            {
+              do_writev (connection);
+              if ( (MHD_CONNECTION_CHUNKED_BODY_READY != connection->state) ||
+                   (0 != connection->push_chunk_left) )
+                break;
+            }
+          else
+#endif
+            do_write (connection);
 	  if (MHD_CONNECTION_CHUNKED_BODY_READY != connection->state)
 	     break;
           check_write_done (connection,
@@ -2353,6 +3695,38 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
 }
 
 
+/**
+ * Update the number of response bytes the connection still has to
+ * send, and the total of its daemon.  Only done if the thread pool
+ * dispatches connections by #MHD_DISPATCH_LEAST_QUEUED_BYTES.
+ *
+ * @param connection connection to update
+ */
+static void
+update_queued_bytes (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+  struct MHD_Response *response = connection->response;
+  uint64_t queued;
+
+  if (MHD_DISPATCH_LEAST_QUEUED_BYTES != daemon->dispatch_policy)
+    return;
+  queued = 0;
+  if (MHD_CONNECTION_CLOSED != connection->state)
+    {
+      if ( (NULL != response) &&
+           (MHD_SIZE_UNKNOWN != response->total_size) &&
+           (response->total_size > connection->response_write_position) )
+        queued += response->total_size - connection->response_write_position;
+      queued += connection->write_buffer_append_offset
+        - connection->write_buffer_send_offset;
+    }
+  MHD_counter_store_ (&daemon->queued_bytes,
+                      daemon->queued_bytes + queued - connection->queued_bytes);
+  connection->queued_bytes = queued;
+}
+
+
 /**
  * Clean up the state of the given connection and move it into the
  * clean up queue for final disposal.
@@ -2364,6 +3738,7 @@ cleanup_connection (struct MHD_Connection *connection)
 {
   struct MHD_Daemon *daemon = connection->daemon;
 
+  update_queued_bytes (connection);
   if (NULL != connection->response)
     {
       MHD_destroy_response (connection->response);
@@ -2372,14 +3747,11 @@ cleanup_connection (struct MHD_Connection *connection)
   if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
        (MHD_YES != MHD_mutex_lock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to acquire cleanup mutex\n");
-  if (connection->connection_timeout == daemon->connection_timeout)
-    XDLL_remove (daemon->normal_timeout_head,
-		 daemon->normal_timeout_tail,
-		 connection);
-  else
-    XDLL_remove (daemon->manual_timeout_head,
-		 daemon->manual_timeout_tail,
-		 connection);
+  MHD_timer_wheel_remove (&daemon->timeout_wheel,
+                          &connection->timeout_timer);
+#ifdef HAVE_POLL
+  MHD_connection_poll_remove_ (connection);
+#endif
   if (MHD_YES == connection->suspended)
     DLL_remove (daemon->suspended_connections_head,
                 daemon->suspended_connections_tail,
@@ -2412,11 +3784,18 @@ int
 MHD_connection_handle_idle (struct MHD_Connection *connection)
 {
   struct MHD_Daemon *daemon = connection->daemon;
-  unsigned int timeout;
+  uint64_t timeout;
   const char *end;
   char *line;
   int client_close;
 
+#if ZEROCOPY_SUPPORT
+  /* completed sends make select() and poll() report the socket */
+  if ( (NULL != connection->zerocopy.head) &&
+       (MHD_INVALID_SOCKET != connection->socket_fd) )
+    (void) MHD_zerocopy_reap_ (&connection->zerocopy,
+                               connection->socket_fd);
+#endif
   connection->in_idle = MHD_YES;
   while (1)
     {
@@ -2448,7 +3827,7 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
             }
           if (MHD_NO == parse_initial_message_line (connection, line))
             CONNECTION_CLOSE_ERROR (connection, NULL);
-          else
+          else if (MHD_YES == check_request_line (connection))
             connection->state = MHD_CONNECTION_URL_RECEIVED;
           continue;
         case MHD_CONNECTION_URL_RECEIVED:
@@ -2509,9 +3888,16 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
           connection->state = MHD_CONNECTION_HEADERS_PROCESSED;
           continue;
         case MHD_CONNECTION_HEADERS_PROCESSED:
+          if (MHD_YES == queue_static_response (connection))
+            {
+              connection->state = MHD_CONNECTION_FOOTERS_RECEIVED;
+              continue;
+            }
           call_connection_handler (connection); /* first call */
           if (MHD_CONNECTION_CLOSED == connection->state)
             continue;
+          if (MHD_CONNECTION_OFFLOAD_NONE != connection->offload_state)
+            break;              /* continue once the call completed */
           if (need_100_continue (connection))
             {
               connection->state = MHD_CONNECTION_CONTINUE_SENDING;
@@ -2555,6 +3941,8 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
               process_request_body (connection);     /* loop call */
               if (MHD_CONNECTION_CLOSED == connection->state)
                 continue;
+              if (MHD_CONNECTION_OFFLOAD_NONE != connection->offload_state)
+                break;          /* continue once the call completed */
             }
           if ((0 == connection->remaining_upload_size) ||
               ((connection->remaining_upload_size == MHD_SIZE_UNKNOWN) &&
@@ -2624,6 +4012,8 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
           call_connection_handler (connection); /* "final" call */
           if (connection->state == MHD_CONNECTION_CLOSED)
             continue;
+          if (MHD_CONNECTION_OFFLOAD_NONE != connection->offload_state)
+            break;              /* continue once the call completed */
           if (NULL == connection->response)
             break;              /* try again next time */
           if (MHD_NO == build_header_response (connection))
@@ -2634,7 +4024,16 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
               continue;
             }
           connection->state = MHD_CONNECTION_HEADERS_SENDING;
-          if (MHD_NO != socket_flush_possible (connection))
+          if (MHD_YES == can_batch_response (connection))
+            {
+              /* send it together with the response to the next
+                 pipelined request */
+              connection->state = MHD_CONNECTION_FOOTERS_SENT;
+              continue;
+            }
+          if (MHD_YES == connection->flush_pending)
+            ; /* still buffering the previous response */
+          else if (MHD_NO != socket_flush_possible (connection))
             socket_start_extra_buffering (connection);
           else
             socket_start_no_buffering (connection);
@@ -2644,8 +4043,21 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
           /* no default action */
           break;
         case MHD_CONNECTION_HEADERS_SENT:
-          /* Some clients may take some actions right after header receive */
-          if (MHD_NO != socket_flush_possible (connection))
+          if ( (MHD_NO == connection->have_chunked_upload) &&
+               (connection->response_write_position ==
+                connection->response->total_size) )
+            {
+              /* the body was sent with the headers (or there is
+                 none to send) */
+              connection->state = MHD_CONNECTION_FOOTERS_SENT;
+              continue;
+            }
+          /* Some clients may take some actions right after header
+             receive; a client that pipelines requests is not
+             waiting for them */
+          if (MHD_YES == connection->flush_pending)
+            ; /* keep buffering */
+          else if (MHD_NO != socket_flush_possible (connection))
             {
               socket_start_no_buffering_flush (connection);
               socket_start_extra_buffering (connection);
@@ -2662,19 +4074,15 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
           /* nothing to do here */
           break;
         case MHD_CONNECTION_NORMAL_BODY_UNREADY:
-          if (NULL != connection->response->crc)
-            (void) MHD_mutex_lock_ (&connection->response->mutex);
           if (0 == connection->response->total_size)
             {
-              if (NULL != connection->response->crc)
-                (void) MHD_mutex_unlock_ (&connection->response->mutex);
               connection->state = MHD_CONNECTION_BODY_SENT;
               continue;
             }
+          if (MHD_YES == wait_for_data (connection))
+            break;
           if (MHD_YES == try_ready_normal_body (connection))
             {
-	      if (NULL != connection->response->crc)
-	        (void) MHD_mutex_unlock_ (&connection->response->mutex);
               connection->state = MHD_CONNECTION_NORMAL_BODY_READY;
               /* Buffering for flushable socket was already enabled*/
               if (MHD_NO == socket_flush_possible (connection))
@@ -2688,21 +4096,17 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
           /* nothing to do here */
           break;
         case MHD_CONNECTION_CHUNKED_BODY_UNREADY:
-          if (NULL != connection->response->crc)
-            (void) MHD_mutex_lock_ (&connection->response->mutex);
           if ( (0 == connection->response->total_size) ||
                (connection->response_write_position ==
                 connection->response->total_size) )
             {
-              if (NULL != connection->response->crc)
-                (void) MHD_mutex_unlock_ (&connection->response->mutex);
               connection->state = MHD_CONNECTION_BODY_SENT;
               continue;
             }
+          if (MHD_YES == wait_for_data (connection))
+            break;
           if (MHD_YES == try_ready_chunked_body (connection))
             {
-              if (NULL != connection->response->crc)
-                (void) MHD_mutex_unlock_ (&connection->response->mutex);
               connection->state = MHD_CONNECTION_CHUNKED_BODY_READY;
               /* Buffering for flushable socket was already enabled */
               if (MHD_NO == socket_flush_possible (connection))
@@ -2710,10 +4114,14 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
 
               continue;
             }
-          if (NULL != connection->response->crc)
-            (void) MHD_mutex_unlock_ (&connection->response->mutex);
           break;
         case MHD_CONNECTION_BODY_SENT:
+          if (MHD_NO == connection->have_chunked_upload)
+            {
+              /* no footers without chunked encoding */
+              connection->state = MHD_CONNECTION_FOOTERS_SENT;
+              continue;
+            }
           if (MHD_NO == build_header_response (connection))
             {
               /* oops - close! */
@@ -2721,9 +4129,8 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
 				      "Closing connection (failed to create response header)\n");
               continue;
             }
-          if ( (MHD_NO == connection->have_chunked_upload) ||
-               (connection->write_buffer_send_offset ==
-                connection->write_buffer_append_offset) )
+          if (connection->write_buffer_send_offset ==
+              connection->write_buffer_append_offset)
             connection->state = MHD_CONNECTION_FOOTERS_SENT;
           else
             connection->state = MHD_CONNECTION_FOOTERS_SENDING;
@@ -2732,15 +4139,30 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
           /* no default action */
           break;
         case MHD_CONNECTION_FOOTERS_SENT:
-          if (MHD_NO != socket_flush_possible (connection))
-            socket_start_no_buffering_flush (connection);
+          if ( (MHD_NO != socket_flush_possible (connection)) &&
+               (0 != connection->read_buffer_offset) &&
+               (MHD_NO == connection->read_closed) )
+            {
+              /* the client pipelined the next request; keep buffering
+                 so that the next response shares packets with this
+                 one, and flush once we have to wait for the client
+                 (see #MHD_connection_update_event_loop_info()) */
+              connection->flush_pending = MHD_YES;
+            }
           else
-            socket_start_normal_buffering (connection);
+            {
+              if (MHD_NO != socket_flush_possible (connection))
+                socket_start_no_buffering_flush (connection);
+              else
+                socket_start_normal_buffering (connection);
+              connection->flush_pending = MHD_NO;
+            }
 
           end =
             MHD_get_response_header (connection->response,
 				     MHD_HTTP_HEADER_CONNECTION);
           client_close = ((NULL != end) && (MHD_str_equal_caseless_(end, "close")));
+          detach_push_response (connection);
           MHD_destroy_response (connection->response);
           connection->response = NULL;
           if ( (NULL != daemon->notify_completed) &&
@@ -2753,9 +4175,8 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
             connection->client_aware = MHD_NO;
           }
           end =
-            MHD_lookup_connection_value (connection,
-					 MHD_HEADER_KIND,
-                                         MHD_HTTP_HEADER_CONNECTION);
+            lookup_header (connection,
+                           MHD_HEADER_TOKEN_CONNECTION);
           if ( (MHD_YES == connection->read_closed) ||
                (client_close) ||
                ( (NULL != end) &&
@@ -2771,43 +4192,88 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
               /* have to close for some reason */
               MHD_connection_close_ (connection,
                                      MHD_REQUEST_TERMINATED_COMPLETED_OK);
-              MHD_pool_destroy (connection->pool);
-              connection->pool = NULL;
+              /* release the memory right away, unless the pool is
+                 to be reused with the connection object */
+              if (0 == connection->daemon->cache_limit)
+                {
+                  MHD_pool_destroy (connection->pool);
+                  connection->pool = NULL;
+                }
               connection->read_buffer = NULL;
               connection->read_buffer_size = 0;
               connection->read_buffer_offset = 0;
+              connection->write_buffer = NULL;
+              connection->write_buffer_size = 0;
+              connection->write_buffer_send_offset = 0;
+              connection->write_buffer_append_offset = 0;
             }
           else
             {
               /* can try to keep-alive */
-              if (MHD_NO != socket_flush_possible (connection))
+              if ( (MHD_NO != socket_flush_possible (connection)) &&
+                   (MHD_NO == connection->flush_pending) )
                 socket_start_normal_buffering (connection);
               connection->version = NULL;
               connection->state = MHD_CONNECTION_INIT;
               /* Reset the read buffer to the starting size,
-                 preserving the bytes we have already read. */
-              connection->read_buffer
-                = MHD_pool_reset (connection->pool,
-                                  connection->read_buffer,
-                                  connection->read_buffer_offset,
-                                  connection->daemon->pool_size / 2);
+                 preserving the bytes we have already read
+                 and the responses we have not yet sent. */
+              if (connection->write_buffer_append_offset !=
+                  connection->write_buffer_send_offset)
+                {
+                  void *carry;
+                  size_t carry_bytes;
+
+                  carry = &connection->write_buffer
+                    [connection->write_buffer_send_offset];
+                  carry_bytes = connection->write_buffer_append_offset
+                    - connection->write_buffer_send_offset;
+                  connection->read_buffer
+                    = MHD_pool_reset_carry (connection->pool,
+                                            connection->read_buffer,
+                                            connection->read_buffer_offset,
+                                            connection->daemon->pool_size / 2,
+                                            &carry,
+                                            carry_bytes);
+                  if (NULL == connection->read_buffer)
+                    MHD_PANIC ("Carried response does not fit into the pool\n");
+                  connection->write_buffer = carry;
+                  connection->write_buffer_size = carry_bytes;
+                  connection->write_buffer_send_offset = 0;
+                  connection->write_buffer_append_offset = carry_bytes;
+                }
+              else
+                {
+                  connection->read_buffer
+                    = MHD_pool_reset (connection->pool,
+                                      connection->read_buffer,
+                                      connection->read_buffer_offset,
+                                      connection->daemon->pool_size / 2);
+                  connection->write_buffer = NULL;
+                  connection->write_buffer_size = 0;
+                  connection->write_buffer_send_offset = 0;
+                  connection->write_buffer_append_offset = 0;
+                }
               connection->read_buffer_size
                 = connection->daemon->pool_size / 2;
             }
 	  connection->client_aware = MHD_NO;
           connection->client_context = NULL;
+          connection->handler = NULL;
+          connection->offload = MHD_NO;
+          connection->data_wait = MHD_CONNECTION_DATA_WAIT_NONE;
+          connection->push_chunk_left = 0;
           connection->continue_message_write_offset = 0;
           connection->responseCode = 0;
           connection->headers_received = NULL;
 	  connection->headers_received_tail = NULL;
+          connection->headers_index = NULL;
+          connection->args = NULL;
+          connection->cookies_parsed = MHD_NO;
           connection->response_write_position = 0;
           connection->have_chunked_upload = MHD_NO;
           connection->method = NULL;
           connection->url = NULL;
-          connection->write_buffer = NULL;
-          connection->write_buffer_size = 0;
-          connection->write_buffer_send_offset = 0;
-          connection->write_buffer_append_offset = 0;
           continue;
         case MHD_CONNECTION_CLOSED:
 	  cleanup_connection (connection);
@@ -2818,16 +4284,20 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
         }
       break;
     }
-  timeout = connection->connection_timeout;
+  timeout = connection->connection_timeout_ms;
   if ( (0 != timeout) &&
-       (timeout <= (MHD_monotonic_sec_counter() - connection->last_activity)) )
+       (timeout <= (MHD_monotonic_msec_counter() - connection->last_activity)) )
     {
       MHD_connection_close_ (connection,
                              MHD_REQUEST_TERMINATED_TIMEOUT_REACHED);
       connection->in_idle = MHD_NO;
       return MHD_YES;
     }
+  update_queued_bytes (connection);
   MHD_connection_update_event_loop_info (connection);
+#ifdef HAVE_POLL
+  MHD_connection_poll_update_ (connection);
+#endif
 #if EPOLL_SUPPORT
   switch (connection->event_loop_info)
     {
@@ -2869,10 +4339,17 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
       /* This connection is finished, nothing left to do */
       break;
     }
-  return MHD_connection_epoll_update_ (connection);
-#else
-  return MHD_YES;
+  if (MHD_NO == MHD_connection_epoll_update_ (connection))
+    return MHD_NO;
 #endif
+  /* only now that we are done with the connection, the
+     offload pool may start to use it */
+  if (MHD_CONNECTION_OFFLOAD_PENDING == connection->offload_state)
+    {
+      connection->offload_state = MHD_CONNECTION_OFFLOAD_RUNNING;
+      MHD_offload_submit_ (connection);
+    }
+  return MHD_YES;
 }
 
 
@@ -2916,6 +4393,7 @@ MHD_connection_epoll_update_ (struct MHD_Connection *connection)
 		      MHD_socket_last_strerr_ ());
 #endif
 	  connection->state = MHD_CONNECTION_CLOSED;
+          detach_push_response (connection);
 	  cleanup_connection (connection);
 	  return MHD_NO;
 	}
@@ -3002,43 +4480,22 @@ MHD_set_connection_option (struct MHD_Connection *connection,
 			   ...)
 {
   va_list ap;
-  struct MHD_Daemon *daemon;
 
-  daemon = connection->daemon;
   switch (option)
     {
     case MHD_CONNECTION_OPTION_TIMEOUT:
-      if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
-	   (MHD_YES != MHD_mutex_lock_ (&daemon->cleanup_connection_mutex)) )
-	MHD_PANIC ("Failed to acquire cleanup mutex\n");
+      va_start (ap, option);
+      connection->connection_timeout_ms = 1000LLU * va_arg (ap, unsigned int);
+      va_end (ap);
       if (MHD_YES != connection->suspended)
-        {
-          if (connection->connection_timeout == daemon->connection_timeout)
-            XDLL_remove (daemon->normal_timeout_head,
-                         daemon->normal_timeout_tail,
-                         connection);
-          else
-            XDLL_remove (daemon->manual_timeout_head,
-                         daemon->manual_timeout_tail,
-                         connection);
-        }
+        MHD_connection_update_timeout_ (connection);
+      return MHD_YES;
+    case MHD_CONNECTION_OPTION_TIMEOUT_MS:
       va_start (ap, option);
-      connection->connection_timeout = va_arg (ap, unsigned int);
+      connection->connection_timeout_ms = va_arg (ap, unsigned int);
       va_end (ap);
       if (MHD_YES != connection->suspended)
-        {
-          if (connection->connection_timeout == daemon->connection_timeout)
-            XDLL_insert (daemon->normal_timeout_head,
-                         daemon->normal_timeout_tail,
-                         connection);
-          else
-            XDLL_insert (daemon->manual_timeout_head,
-                         daemon->manual_timeout_tail,
-                         connection);
-        }
-      if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
-	   (MHD_YES != MHD_mutex_unlock_ (&daemon->cleanup_connection_mutex)) )
-	MHD_PANIC ("Failed to release cleanup mutex\n");
+        MHD_connection_update_timeout_ (connection);
       return MHD_YES;
     default:
       return MHD_NO;
@@ -3068,6 +4525,9 @@ MHD_queue_response (struct MHD_Connection *connection,
        ( (MHD_CONNECTION_HEADERS_PROCESSED != connection->state) &&
 	 (MHD_CONNECTION_FOOTERS_RECEIVED != connection->state) ) )
     return MHD_NO;
+  if ( (NULL != response->push) &&
+       (MHD_YES != MHD_response_push_attach_ (response)) )
+    return MHD_NO; /* pushed data can only be sent once */
   MHD_increment_response_rc (response);
   connection->response = response;
   connection->responseCode = status_code;
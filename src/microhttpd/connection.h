@@ -81,6 +81,56 @@ int
 MHD_connection_handle_idle (struct MHD_Connection *connection);
 
 
+/**
+ * Schedule the timeout of the connection in the timer wheel of its
+ * daemon, based on the time of the last activity.  Unschedules the
+ * connection if it has no timeout.  Does nothing for
+ * #MHD_USE_THREAD_PER_CONNECTION.
+ *
+ * @param connection the connection to (re)schedule
+ */
+void
+MHD_connection_update_timeout_ (struct MHD_Connection *connection);
+
+
+#ifdef HAVE_POLL
+/**
+ * Add the connection to the poll set of its daemon, growing the
+ * poll set if needed.
+ *
+ * @param connection connection to add
+ * @param process_now #MHD_YES if the connection must be processed
+ *        in the next iteration of the event loop even if there are
+ *        no events for it
+ * @return #MHD_YES on success, #MHD_NO if we failed to grow the
+ *         poll set
+ */
+int
+MHD_connection_poll_add_ (struct MHD_Connection *connection,
+                          int process_now);
+
+
+/**
+ * Remove the connection from the poll set of its daemon (if it is
+ * in the poll set).
+ *
+ * @param connection connection to remove
+ */
+void
+MHD_connection_poll_remove_ (struct MHD_Connection *connection);
+
+
+/**
+ * Update the events of the poll set entry of the connection to
+ * match its 'event_loop_info'.
+ *
+ * @param connection connection to update
+ */
+void
+MHD_connection_poll_update_ (struct MHD_Connection *connection);
+#endif
+
+
 /**
  * Close the given connection and give the
  * specified termination code to the user.
@@ -107,4 +157,17 @@ MHD_connection_epoll_update_ (struct MHD_Connection *connection);
 #endif
 
 
+/**
+ * Parse the values of the given kind(s) of the request that are
+ * only parsed on first use (arguments of the URL and cookies), if
+ * that did not happen yet.
+ *
+ * @param connection connection to parse values of
+ * @param kind kind(s) of values needed
+ */
+void
+MHD_connection_parse_values_ (struct MHD_Connection *connection,
+                              enum MHD_ValueKind kind);
+
+
 #endif
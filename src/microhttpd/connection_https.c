@@ -48,7 +48,8 @@ run_tls_handshake (struct MHD_Connection *connection)
 {
   int ret;
 
-  connection->last_activity = MHD_monotonic_sec_counter();
+  connection->last_activity = MHD_monotonic_msec_counter();
+  MHD_connection_update_timeout_ (connection);
   if (connection->state == MHD_TLS_CONNECTION_INIT)
     {
       ret = gnutls_handshake (connection->tls_session);
@@ -132,7 +133,7 @@ MHD_tls_connection_handle_write (struct MHD_Connection *connection)
 static int
 MHD_tls_connection_handle_idle (struct MHD_Connection *connection)
 {
-  unsigned int timeout;
+  uint64_t timeout;
 
 #if DEBUG_STATES
   MHD_DLOG (connection->daemon,
@@ -140,8 +141,8 @@ MHD_tls_connection_handle_idle (struct MHD_Connection *connection)
             __FUNCTION__,
             MHD_state_to_string (connection->state));
 #endif
-  timeout = connection->connection_timeout;
-  if ( (timeout != 0) && (timeout <= (MHD_monotonic_sec_counter() - connection->last_activity)))
+  timeout = connection->connection_timeout_ms;
+  if ( (timeout != 0) && (timeout <= (MHD_monotonic_msec_counter() - connection->last_activity)))
     MHD_connection_close_ (connection,
                            MHD_REQUEST_TERMINATED_TIMEOUT_REACHED);
   switch (connection->state)
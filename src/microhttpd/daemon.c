@@ -32,6 +32,8 @@
 #include "mhd_limits.h"
 #include "autoinit_funcs.h"
 #include "mhd_mono_clock.h"
+#include "router.h"
+#include "zerocopy.h"
 
 #if HAVE_SEARCH_H
 #include <search.h>
@@ -52,6 +54,10 @@
 #include <sys/sendfile.h>
 #endif
 
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+#include <sched.h>
+#endif
+
 #ifndef _MHD_FD_SETSIZE_IS_DEFAULT
 #include "sysfdsetsize.h"
 #endif /* !_MHD_FD_SETSIZE_IS_DEFAULT */
@@ -107,6 +113,15 @@
 #endif
 #endif
 
+#ifndef SO_REUSEPORT
+#ifdef LINUX
+/* Supported since Linux 3.9, but often not present (or commented out)
+   in the headers at this time; but 15 is reserved for this and
+   thus should be safe to use. */
+#define SO_REUSEPORT 15
+#endif
+#endif
+
 #ifndef SOCK_CLOEXEC
 #define SOCK_CLOEXEC 0
 #endif
@@ -731,6 +746,13 @@ MHD_get_fdset2 (struct MHD_Daemon *daemon,
 
       return add_to_fd_set (daemon->epoll_fd, read_fd_set, max_fd, fd_setsize);
     }
+#endif
+#if IO_URING_SUPPORT
+  if (0 != (daemon->options & MHD_USE_IO_URING))
+    {
+      /* the ring FD becomes readable whenever operations complete */
+      return add_to_fd_set (daemon->uring.fd, read_fd_set, max_fd, fd_setsize);
+    }
 #endif
   if (MHD_INVALID_SOCKET != daemon->socket_fd &&
       MHD_YES != add_to_fd_set (daemon->socket_fd, read_fd_set, max_fd, fd_setsize))
@@ -790,8 +812,8 @@ MHD_handle_connection (void *data)
   MHD_socket maxsock;
   struct timeval tv;
   struct timeval *tvp;
-  unsigned int timeout;
-  time_t now;
+  uint64_t timeout;
+  uint64_t now;
 #if WINDOWS
   MHD_pipe spipe = con->daemon->wpipe[0];
   char tmp;
@@ -806,11 +828,11 @@ MHD_handle_connection (void *data)
   struct pollfd p[1 + EXTRA_SLOTS];
 #endif
 
-  timeout = con->daemon->connection_timeout;
   while ( (MHD_YES != con->daemon->shutdown) &&
 	  (MHD_CONNECTION_CLOSED != con->state) )
     {
       tvp = NULL;
+      timeout = con->connection_timeout_ms;
 #if HTTPS_SUPPORT
       if (MHD_YES == con->tls_read_ready)
 	{
@@ -822,22 +844,25 @@ MHD_handle_connection (void *data)
 #endif
       if (NULL == tvp && timeout > 0)
 	{
-	  now = MHD_monotonic_sec_counter();
+	  now = MHD_monotonic_msec_counter();
 	  if (now - con->last_activity > timeout)
-	    tv.tv_sec = 0;
+            {
+              tv.tv_sec = 0;
+              tv.tv_usec = 0;
+            }
           else
             {
-              const time_t seconds_left = timeout - (now - con->last_activity);
+              const uint64_t millis_left = timeout - (now - con->last_activity);
 #ifndef _WIN32
-              tv.tv_sec = seconds_left;
+              tv.tv_sec = millis_left / 1000;
 #else  /* _WIN32 */
-              if (seconds_left > TIMEVAL_TV_SEC_MAX)
+              if (millis_left / 1000 > TIMEVAL_TV_SEC_MAX)
                 tv.tv_sec = TIMEVAL_TV_SEC_MAX;
               else
-                tv.tv_sec = (_MHD_TIMEVAL_TV_SEC_TYPE)seconds_left;
+                tv.tv_sec = (_MHD_TIMEVAL_TV_SEC_TYPE) (millis_left / 1000);
 #endif /* _WIN32 */
+              tv.tv_usec = (millis_left % 1000) * 1000;
             }
-	  tv.tv_usec = 0;
 	  tvp = &tv;
 	}
       if (0 == (con->daemon->options & MHD_USE_POLL))
@@ -967,7 +992,7 @@ MHD_handle_connection (void *data)
 #else
                     1,
 #endif
-		    (NULL == tvp) ? -1 : tv.tv_sec * 1000) < 0)
+		    (NULL == tvp) ? -1 : tv.tv_sec * 1000 + tv.tv_usec / 1000) < 0)
 	    {
 	      if (EINTR == MHD_socket_errno_)
 		continue;
@@ -1183,6 +1208,200 @@ send_param_adapter (struct MHD_Connection *connection,
 }
 
 
+#if SENDV_SUPPORT
+/**
+ * Callback for writing data from several buffers to the socket
+ * with a single system call.
+ *
+ * @param connection the MHD connection structure
+ * @param iov buffers to transmit, in order
+ * @param iovcnt number of entries in @a iov
+ * @param flags additional flags for `sendmsg()`
+ * @return number of bytes written, -1 on error
+ */
+static ssize_t
+sendv_param_adapter (struct MHD_Connection *connection,
+                     const struct iovec *iov,
+                     int iovcnt,
+                     int flags)
+{
+  struct msghdr msg;
+  ssize_t ret;
+#if EPOLL_SUPPORT
+  size_t requested_size;
+  int i;
+#endif
+
+  if ( (MHD_INVALID_SOCKET == connection->socket_fd) ||
+       (MHD_CONNECTION_CLOSED == connection->state) )
+    {
+      MHD_set_socket_errno_ (ENOTCONN);
+      return -1;
+    }
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_iov = (struct iovec *) iov;
+  msg.msg_iovlen = iovcnt;
+  ret = sendmsg (connection->socket_fd, &msg, MSG_NOSIGNAL | flags);
+#if EPOLL_SUPPORT
+  requested_size = 0;
+  for (i = 0; i < iovcnt; i++)
+    requested_size += iov[i].iov_len;
+  if ( (0 > ret) || (requested_size > (size_t) ret) )
+    {
+      /* partial write --- no longer write-ready */
+      connection->epoll_state &= ~MHD_EPOLL_STATE_WRITE_READY;
+    }
+#endif
+  /* see send_param_adapter() */
+  if ( (0 > ret) && (0 == MHD_socket_errno_) )
+    MHD_set_socket_errno_(ECONNRESET);
+  return ret;
+}
+#endif
+
+
+#if IO_URING_SUPPORT
+/**
+ * Queue @a connection for processing by the next iteration of the
+ * io_uring event loop.
+ *
+ * @param connection connection to queue
+ * @param busy #MHD_YES if the connection can make progress right
+ *        away, #MHD_NO if it is merely waiting for the application
+ */
+static void
+uring_ready (struct MHD_Connection *connection,
+             int busy)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+
+  if (MHD_YES == busy)
+    daemon->uring_busy = MHD_YES;
+  if (0 != (connection->uring_state & MHD_URING_STATE_IN_UREADY_UDLL))
+    return;
+  UDLL_insert_tail (daemon->uready_head,
+                    daemon->uready_tail,
+                    connection);
+  connection->uring_state |= MHD_URING_STATE_IN_UREADY_UDLL;
+}
+
+
+/**
+ * Return the result of the io_uring operation that completed for
+ * @a connection to the read or write handler.
+ *
+ * @param connection the MHD connection structure
+ * @return result of the operation, as the socket call would have
+ *         returned it
+ */
+static ssize_t
+uring_take_result (struct MHD_Connection *connection)
+{
+  connection->uring_state &= ~MHD_URING_STATE_DONE;
+  if (0 > connection->uring_res)
+    {
+      MHD_set_socket_errno_ (- connection->uring_res);
+      return -1;
+    }
+  return (ssize_t) connection->uring_res;
+}
+
+
+/**
+ * Callback for receiving data from the socket in io_uring mode.
+ * The first call only records the request (to be submitted by
+ * the event loop) and reports `EAGAIN`; once the operation has
+ * completed, the event loop calls the read handler again and we
+ * return the result.
+ *
+ * @param connection the MHD connection structure
+ * @param other where to write received data to
+ * @param i maximum size of other (in bytes)
+ * @return number of bytes actually received
+ */
+static ssize_t
+recv_uring_adapter (struct MHD_Connection *connection,
+                    void *other,
+                    size_t i)
+{
+  ssize_t ret;
+
+  if ( (MHD_INVALID_SOCKET == connection->socket_fd) ||
+       (MHD_CONNECTION_CLOSED == connection->state) )
+    {
+      MHD_set_socket_errno_ (ENOTCONN);
+      return -1;
+    }
+  if (0 != (connection->uring_state & MHD_URING_STATE_DONE))
+    {
+      ret = uring_take_result (connection);
+      if ( (0 < ret) &&
+           (other != connection->uring_buf) )
+        memmove (other, connection->uring_buf, (size_t) ret);
+      return ret;
+    }
+  if (i > INT_MAX)
+    i = INT_MAX; /* completion result limit */
+  connection->uring_buf = other;
+  connection->uring_len = i;
+  connection->uring_state |= MHD_URING_STATE_WANT_RECV;
+  MHD_set_socket_errno_ (EAGAIN);
+  return -1;
+}
+
+
+/**
+ * Callback for writing data to the socket in io_uring mode.
+ * Works like #recv_uring_adapter(), except for bodies produced
+ * by a content reader (including files, which we give to
+ * `sendfile()`): their buffer is shared between connections
+ * and only valid while the response mutex is held, so those
+ * are sent right away and we only ask the ring to tell us when
+ * the socket becomes writable again.
+ *
+ * @param connection the MHD connection structure
+ * @param other data to write
+ * @param i number of bytes to write
+ * @return actual number of bytes written
+ */
+static ssize_t
+send_uring_adapter (struct MHD_Connection *connection,
+                    const void *other,
+                    size_t i)
+{
+  ssize_t ret;
+  int err;
+
+  if ( (MHD_INVALID_SOCKET == connection->socket_fd) ||
+       (MHD_CONNECTION_CLOSED == connection->state) )
+    {
+      MHD_set_socket_errno_ (ENOTCONN);
+      return -1;
+    }
+  if (0 != (connection->uring_state & MHD_URING_STATE_DONE))
+    return uring_take_result (connection);
+  if ( (MHD_CONNECTION_NORMAL_BODY_READY == connection->state) &&
+       (NULL != connection->response->crc) )
+    {
+      ret = send_param_adapter (connection, other, i);
+      err = MHD_socket_errno_;
+      if ( (0 == ret) ||
+           ( (0 > ret) &&
+             ( (EAGAIN == err) || (EWOULDBLOCK == err) || (EINTR == err) ) ) )
+        connection->uring_state |= MHD_URING_STATE_WANT_POLLOUT;
+      return ret;
+    }
+  if (i > INT_MAX)
+    i = INT_MAX; /* completion result limit */
+  connection->uring_buf = (void *) other;
+  connection->uring_len = i;
+  connection->uring_state |= MHD_URING_STATE_WANT_SEND;
+  MHD_set_socket_errno_ (EAGAIN);
+  return -1;
+}
+#endif
+
+
 /**
  * Signature of main function for a thread.
  *
@@ -1210,17 +1429,43 @@ create_thread (MHD_thread_handle_ *thread,
 #if defined(MHD_USE_POSIX_THREADS)
   pthread_attr_t attr;
   pthread_attr_t *pattr;
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  cpu_set_t cpus;
+  unsigned int i;
+#endif
   int ret;
 
-  if (0 != daemon->thread_stack_size)
+  if ( (0 != daemon->thread_stack_size) ||
+       (NULL != daemon->cpus) )
     {
       if (0 != (ret = pthread_attr_init (&attr)))
 	goto ERR;
-      if (0 != (ret = pthread_attr_setstacksize (&attr, daemon->thread_stack_size)))
+      if ( (0 != daemon->thread_stack_size) &&
+           (0 != (ret = pthread_attr_setstacksize (&attr, daemon->thread_stack_size))) )
 	{
 	  pthread_attr_destroy (&attr);
 	  goto ERR;
 	}
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+      if (NULL != daemon->cpus)
+        {
+          CPU_ZERO (&cpus);
+          for (i = 0; i < daemon->num_cpus; i++)
+            CPU_SET (daemon->cpus[i], &cpus);
+          if (0 != (ret = pthread_attr_setaffinity_np (&attr,
+                                                       sizeof (cpus),
+                                                       &cpus)))
+            {
+              pthread_attr_destroy (&attr);
+#ifdef HAVE_MESSAGES
+              MHD_DLOG (daemon,
+                        "Failed to set thread CPU affinity\n");
+#endif
+              errno = EINVAL;
+              return ret;
+            }
+        }
+#endif
       pattr = &attr;
     }
   else
@@ -1232,7 +1477,7 @@ create_thread (MHD_thread_handle_ *thread,
 #ifdef HAVE_PTHREAD_SETNAME_NP
   (void) pthread_setname_np (*thread, "libmicrohttpd");
 #endif /* HAVE_PTHREAD_SETNAME_NP */
-  if (0 != daemon->thread_stack_size)
+  if (NULL != pattr)
     pthread_attr_destroy (&attr);
   return ret;
  ERR:
@@ -1257,108 +1502,503 @@ create_thread (MHD_thread_handle_ *thread,
 
 
 /**
- * Add another client connection to the set of connections
- * managed by MHD.  This API is usually not needed (since
- * MHD will accept inbound connections on the server socket).
- * Use this API in special cases, for example if your HTTP
- * server is behind NAT and needs to connect out to the
- * HTTP client.
+ * Get the number of connections a worker of a thread pool is
+ * handling or has been assigned.
  *
- * The given client socket will be managed (and closed!) by MHD after
- * this call and must no longer be used directly by the application
- * afterwards.
+ * @param worker worker to check
+ * @return number of active and pending connections of @a worker
+ */
+static unsigned int
+worker_load (struct MHD_Daemon *worker)
+{
+  return MHD_counter_load_ (&worker->connections)
+    + MHD_counter_load_ (&worker->pending_count);
+}
+
+
+/**
+ * Check if the workers of a thread pool keep queues of pending
+ * connections that other threads assign to them.  This is the case
+ * with a dispatch policy, and if the workers are pinned to CPUs
+ * (so that connections added with #MHD_add_connection() are set
+ * up by the thread of the worker, on its NUMA node).
  *
- * Per-IP connection limits are ignored when using this API.
+ * @param daemon master or worker daemon
+ * @return #MHD_YES if pending connection queues are used
+ */
+static int
+use_pending_queues (const struct MHD_Daemon *daemon)
+{
+  if ( (MHD_DISPATCH_DEFAULT != daemon->dispatch_policy) ||
+       (NULL != daemon->cpus) )
+    return MHD_YES;
+  return MHD_NO;
+}
+
+
+/**
+ * Check if worker @a a of a thread pool is less loaded than
+ * worker @a b according to the dispatch policy.  The counters of
+ * other workers are read without locking; they only serve as a
+ * hint, so a slightly outdated value does no harm.
  *
- * @param daemon daemon that manages the connection
- * @param client_socket socket to manage (MHD will expect
- *        to receive an HTTP request from this socket next).
- * @param addr IP address of the client
- * @param addrlen number of bytes in @a addr
- * @param external_add perform additional operations needed due
- *        to the application calling us directly
- * @return #MHD_YES on success, #MHD_NO if this daemon could
- *        not handle the connection (i.e. malloc failed, etc).
- *        The socket will be closed in any case; 'errno' is
- *        set to indicate further details about the error.
+ * @param policy dispatch policy of the daemon
+ * @param a first worker
+ * @param b second worker
+ * @return #MHD_YES if @a a should be preferred over @a b
  */
 static int
-internal_add_connection (struct MHD_Daemon *daemon,
-			 MHD_socket client_socket,
-			 const struct sockaddr *addr,
-			 socklen_t addrlen,
-			 int external_add)
+worker_less_loaded (enum MHD_WorkerDispatchPolicy policy,
+                    struct MHD_Daemon *a,
+                    struct MHD_Daemon *b)
+{
+  uint64_t qa;
+  uint64_t qb;
+
+  if (MHD_DISPATCH_LEAST_QUEUED_BYTES == policy)
+    {
+      qa = MHD_counter_load_ (&a->queued_bytes);
+      qb = MHD_counter_load_ (&b->queued_bytes);
+      if (qa != qb)
+        return (qa < qb) ? MHD_YES : MHD_NO;
+    }
+  return (worker_load (a) < worker_load (b)) ? MHD_YES : MHD_NO;
+}
+
+
+/**
+ * Select the worker of the thread pool that is to handle a new
+ * connection, according to the dispatch policy of @a daemon.
+ * Workers that reached their connection limit are skipped.
+ *
+ * @param daemon master daemon of the thread pool
+ * @return NULL if all workers are at their connection limit
+ */
+static struct MHD_Daemon *
+select_worker (struct MHD_Daemon *daemon)
 {
-  struct MHD_Connection *connection;
-  int res_thread_create;
-  unsigned int i;
-  int eno;
   struct MHD_Daemon *worker;
-#if OSX
-  static int on = 1;
-#endif
+  struct MHD_Daemon *best;
+  unsigned int num;
+  unsigned int start;
+  unsigned int i;
 
-  if (NULL != daemon->worker_pool)
+  /* rotate the starting point for all policies, so that ties
+     do not always go to the first worker */
+  if (MHD_YES != MHD_mutex_lock_ (&daemon->pending_mutex))
+    MHD_PANIC ("Failed to acquire dispatch mutex\n");
+  num = daemon->dispatch_workers;
+  start = daemon->dispatch_next % num;
+  daemon->dispatch_next = start + 1;
+  if (MHD_YES != MHD_mutex_unlock_ (&daemon->pending_mutex))
+    MHD_PANIC ("Failed to release dispatch mutex\n");
+  best = NULL;
+  for (i = 0; i < num; i++)
     {
-      /* have a pool, try to find a pool with capacity; we use the
-	 socket as the initial offset into the pool for load
-	 balancing */
-      for (i=0;i<daemon->worker_pool_size;i++)
+      worker = &daemon->worker_pool[(start + i) % num];
+      if (worker_load (worker) >= worker->connection_limit)
+        continue;
+      if (MHD_DISPATCH_ROUND_ROBIN == daemon->dispatch_policy)
+        return worker;
+      if ( (NULL == best) ||
+           (MHD_YES == worker_less_loaded (daemon->dispatch_policy,
+                                           worker,
+                                           best)) )
+        best = worker;
+    }
+  return best;
+}
+
+
+/**
+ * A connection was queued for @a target.  Wake up the least loaded
+ * other worker without pending connections, so that it can take
+ * over the connection in case @a target is busy and does not get
+ * to it first.  A worker that was already woken up for this and
+ * did not yet look for work is not signalled again.
+ *
+ * @param daemon master daemon of the thread pool
+ * @param target worker the connection was queued for
+ */
+static void
+wake_idle_worker (struct MHD_Daemon *daemon,
+                  const struct MHD_Daemon *target)
+{
+  struct MHD_Daemon *worker;
+  struct MHD_Daemon *best;
+  unsigned int best_connections;
+  unsigned int connections;
+  unsigned int num;
+  unsigned int i;
+  int signalled;
+
+  if (MHD_YES != MHD_mutex_lock_ (&daemon->pending_mutex))
+    MHD_PANIC ("Failed to acquire dispatch mutex\n");
+  num = daemon->dispatch_workers;
+  if (MHD_YES != MHD_mutex_unlock_ (&daemon->pending_mutex))
+    MHD_PANIC ("Failed to release dispatch mutex\n");
+  best = NULL;
+  best_connections = 0;
+  for (i = 0; i < num; i++)
+    {
+      worker = &daemon->worker_pool[i];
+      if ( (worker == target) ||
+           (0 != MHD_counter_load_ (&worker->pending_count)) )
+        continue;
+      connections = MHD_counter_load_ (&worker->connections);
+      if (connections >= worker->connection_limit)
+        continue;
+      if ( (NULL == best) ||
+           (connections < best_connections) )
         {
-          worker = &daemon->worker_pool[(i + client_socket) % daemon->worker_pool_size];
-          if (worker->connections < worker->connection_limit)
-            return internal_add_connection (worker,
-                                            client_socket,
-                                            addr, addrlen,
-                                            external_add);
+          best = worker;
+          best_connections = connections;
         }
-      /* all pools are at their connection limit, must refuse */
-      if (0 != MHD_socket_close_ (client_socket))
-	MHD_PANIC ("close failed\n");
-#if ENFILE
-      errno = ENFILE;
-#endif
-      return MHD_NO;
     }
-
-#ifndef MHD_WINSOCK_SOCKETS
-  if ( (client_socket >= FD_SETSIZE) &&
-       (0 == (daemon->options & (MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY))) )
+  if (NULL == best)
+    return;
+  if (MHD_YES != MHD_mutex_lock_ (&best->pending_mutex))
+    MHD_PANIC ("Failed to acquire pending connection mutex\n");
+  signalled = best->steal_signalled;
+  MHD_counter_store_ (&best->steal_signalled, MHD_YES);
+  if (MHD_YES != MHD_mutex_unlock_ (&best->pending_mutex))
+    MHD_PANIC ("Failed to release pending connection mutex\n");
+  if ( (MHD_NO == signalled) &&
+       (1 != MHD_pipe_write_ (best->wpipe[1], "s", 1)) )
     {
 #ifdef HAVE_MESSAGES
       MHD_DLOG (daemon,
-		"Socket descriptor larger than FD_SETSIZE: %d > %d\n",
-		client_socket,
-		FD_SETSIZE);
-#endif
-      if (0 != MHD_socket_close_ (client_socket))
-	MHD_PANIC ("close failed\n");
-#if EINVAL
-      errno = EINVAL;
+                "Failed to signal idle worker via pipe");
 #endif
-      return MHD_NO;
     }
-#endif
+}
 
 
-#ifdef HAVE_MESSAGES
-#if DEBUG_CONNECT
-  MHD_DLOG (daemon,
-            "Accepted connection on socket %d\n",
-            client_socket);
-#endif
-#endif
-  if ( (daemon->connections == daemon->connection_limit) ||
-       (MHD_NO == MHD_ip_limit_add (daemon, addr, addrlen)) )
+/**
+ * Queue a new connection for a worker of the thread pool, which
+ * starts to process it in its next event loop iteration.
+ *
+ * @param daemon master daemon of the thread pool
+ * @param worker worker to hand the connection to
+ * @param client_socket socket of the new connection
+ * @param addr IP address of the client
+ * @param addrlen number of bytes in @a addr
+ * @return #MHD_YES on success, #MHD_NO if malloc failed; the
+ *        socket is closed in that case and `errno` is set to
+ *        indicate the error
+ */
+static int
+queue_connection (struct MHD_Daemon *daemon,
+                  struct MHD_Daemon *worker,
+                  MHD_socket client_socket,
+                  const struct sockaddr *addr,
+                  socklen_t addrlen)
+{
+  struct MHD_PendingConnection *pc;
+  unsigned int pending;
+  int eno;
+
+  if ( (addrlen > sizeof (pc->addr)) ||
+       (NULL == (pc = malloc (sizeof (struct MHD_PendingConnection)))) )
     {
-      /* above connection limit - reject */
+      eno = (addrlen > sizeof (pc->addr)) ? EINVAL : errno;
 #ifdef HAVE_MESSAGES
       MHD_DLOG (daemon,
-                "Server reached connection limit (closing inbound connection)\n");
+                "Failed to queue connection for worker: %s\n",
+                MHD_strerror_ (eno));
 #endif
       if (0 != MHD_socket_close_ (client_socket))
-	MHD_PANIC ("close failed\n");
-#if ENFILE
+        MHD_PANIC ("close failed\n");
+      errno = eno;
+      return MHD_NO;
+    }
+  pc->next = NULL;
+  pc->socket_fd = client_socket;
+  memcpy (&pc->addr, addr, addrlen);
+  pc->addrlen = addrlen;
+  if (MHD_YES != MHD_mutex_lock_ (&worker->pending_mutex))
+    MHD_PANIC ("Failed to acquire pending connection mutex\n");
+  if (NULL == worker->pending_tail)
+    worker->pending_head = pc;
+  else
+    worker->pending_tail->next = pc;
+  worker->pending_tail = pc;
+  pending = worker->pending_count;
+  MHD_counter_store_ (&worker->pending_count, pending + 1);
+  if (MHD_YES != MHD_mutex_unlock_ (&worker->pending_mutex))
+    MHD_PANIC ("Failed to release pending connection mutex\n");
+  /* the worker takes all of its pending connections at once, so
+     it only needs to be woken up for the first one */
+  if ( (0 == pending) &&
+       (1 != MHD_pipe_write_ (worker->wpipe[1], "n", 1)) )
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Failed to signal new connection via pipe");
+#endif
+    }
+  if (MHD_YES == daemon->work_stealing)
+    wake_idle_worker (daemon,
+                      worker);
+  return MHD_YES;
+}
+
+
+/**
+ * Hand a new connection to the worker of the thread pool selected
+ * by the dispatch policy.
+ *
+ * @param daemon master daemon of the thread pool
+ * @param client_socket socket of the new connection
+ * @param addr IP address of the client
+ * @param addrlen number of bytes in @a addr
+ * @return #MHD_YES on success, #MHD_NO if no worker could take
+ *        the connection or malloc failed; the socket is closed
+ *        in that case and `errno` is set to indicate the error
+ */
+static int
+dispatch_connection (struct MHD_Daemon *daemon,
+                     MHD_socket client_socket,
+                     const struct sockaddr *addr,
+                     socklen_t addrlen)
+{
+  struct MHD_Daemon *worker;
+
+  worker = select_worker (daemon);
+  if (NULL == worker)
+    {
+      /* all workers are at their connection limit, must refuse */
+      if (0 != MHD_socket_close_ (client_socket))
+        MHD_PANIC ("close failed\n");
+#if ENFILE
+      errno = ENFILE;
+#endif
+      return MHD_NO;
+    }
+  return queue_connection (daemon,
+                           worker,
+                           client_socket,
+                           addr, addrlen);
+}
+
+
+/**
+ * Keep a closed connection for reuse if the cache of @a daemon
+ * has room for it.  Must be called with the cleanup mutex held
+ * for #MHD_USE_THREAD_PER_CONNECTION.
+ *
+ * @param daemon daemon the connection belonged to
+ * @param connection closed connection, no longer in any list
+ * @return #MHD_YES if the connection was cached, #MHD_NO if
+ *         it must be freed
+ */
+static int
+cache_connection (struct MHD_Daemon *daemon,
+                  struct MHD_Connection *connection)
+{
+  if ( (daemon->cache_count >= daemon->cache_limit) ||
+       (NULL == connection->pool) )
+    return MHD_NO;
+  MHD_pool_reset (connection->pool,
+                  NULL,
+                  0,
+                  0);
+  connection->next = daemon->cache_head;
+  daemon->cache_head = connection;
+  daemon->cache_count++;
+  return MHD_YES;
+}
+
+
+/**
+ * Take a connection from the cache of @a daemon.
+ *
+ * @param daemon daemon to take the connection from
+ * @param addrlen number of bytes needed for the address of the client
+ * @return NULL if the cache is empty, otherwise a cleared connection
+ *         with its empty memory pool and an address buffer of at
+ *         least @a addrlen bytes
+ */
+static struct MHD_Connection *
+get_cached_connection (struct MHD_Daemon *daemon,
+                       socklen_t addrlen)
+{
+  struct MHD_Connection *connection;
+  struct MemoryPool *pool;
+  struct sockaddr *addr;
+
+  if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
+       (MHD_YES != MHD_mutex_lock_ (&daemon->cleanup_connection_mutex)) )
+    MHD_PANIC ("Failed to acquire cleanup mutex\n");
+  connection = daemon->cache_head;
+  if (NULL != connection)
+    {
+      daemon->cache_head = connection->next;
+      daemon->cache_count--;
+    }
+  if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
+       (MHD_YES != MHD_mutex_unlock_ (&daemon->cleanup_connection_mutex)) )
+    MHD_PANIC ("Failed to release cleanup mutex\n");
+  if (NULL == connection)
+    return NULL;
+  pool = connection->pool;
+  addr = connection->addr;
+  if (connection->addr_len < addrlen)
+    {
+      /* address of another family, buffer is too small */
+      free (addr);
+      if (NULL == (addr = malloc (addrlen)))
+        {
+          MHD_pool_destroy (pool);
+          free (connection);
+          return NULL;
+        }
+    }
+  memset (connection,
+          0,
+          sizeof (struct MHD_Connection));
+  connection->pool = pool;
+  connection->addr = addr;
+  return connection;
+}
+
+
+/**
+ * Free the connections in the cache of @a daemon.
+ *
+ * @param daemon daemon to clean up
+ */
+static void
+free_cached_connections (struct MHD_Daemon *daemon)
+{
+  struct MHD_Connection *pos;
+
+  while (NULL != (pos = daemon->cache_head))
+    {
+      daemon->cache_head = pos->next;
+      MHD_pool_destroy (pos->pool);
+      free (pos->addr);
+      free (pos);
+    }
+  daemon->cache_count = 0;
+}
+
+
+/**
+ * Add another client connection to the set of connections
+ * managed by MHD.  This API is usually not needed (since
+ * MHD will accept inbound connections on the server socket).
+ * Use this API in special cases, for example if your HTTP
+ * server is behind NAT and needs to connect out to the
+ * HTTP client.
+ *
+ * The given client socket will be managed (and closed!) by MHD after
+ * this call and must no longer be used directly by the application
+ * afterwards.
+ *
+ * Per-IP connection limits are ignored when using this API.
+ *
+ * @param daemon daemon that manages the connection
+ * @param client_socket socket to manage (MHD will expect
+ *        to receive an HTTP request from this socket next).
+ * @param addr IP address of the client
+ * @param addrlen number of bytes in @a addr
+ * @param external_add perform additional operations needed due
+ *        to the application calling us directly
+ * @return #MHD_YES on success, #MHD_NO if this daemon could
+ *        not handle the connection (i.e. malloc failed, etc).
+ *        The socket will be closed in any case; 'errno' is
+ *        set to indicate further details about the error.
+ */
+static int
+internal_add_connection (struct MHD_Daemon *daemon,
+			 MHD_socket client_socket,
+			 const struct sockaddr *addr,
+			 socklen_t addrlen,
+			 int external_add)
+{
+  struct MHD_Connection *connection;
+  int res_thread_create;
+  unsigned int i;
+  int eno;
+  struct MHD_Daemon *worker;
+#if OSX
+  static int on = 1;
+#endif
+
+  if (NULL != daemon->worker_pool)
+    {
+      if (MHD_DISPATCH_DEFAULT != daemon->dispatch_policy)
+        return dispatch_connection (daemon,
+                                    client_socket,
+                                    addr, addrlen);
+      /* have a pool, try to find a pool with capacity; we use the
+	 socket as the initial offset into the pool for load
+	 balancing */
+      for (i=0;i<daemon->worker_pool_size;i++)
+        {
+          worker = &daemon->worker_pool[(i + client_socket) % daemon->worker_pool_size];
+          if (MHD_counter_load_ (&worker->connections) >= worker->connection_limit)
+            continue;
+          /* let the worker set up the connection, so that its
+             memory is allocated on the NUMA node of the worker */
+          if (NULL != daemon->cpus)
+            return queue_connection (daemon,
+                                     worker,
+                                     client_socket,
+                                     addr, addrlen);
+          return internal_add_connection (worker,
+                                          client_socket,
+                                          addr, addrlen,
+                                          external_add);
+        }
+      /* all pools are at their connection limit, must refuse */
+      if (0 != MHD_socket_close_ (client_socket))
+	MHD_PANIC ("close failed\n");
+#if ENFILE
+      errno = ENFILE;
+#endif
+      return MHD_NO;
+    }
+
+#ifndef MHD_WINSOCK_SOCKETS
+  if ( (client_socket >= FD_SETSIZE) &&
+       (0 == (daemon->options & (MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY | MHD_USE_IO_URING))) )
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+		"Socket descriptor larger than FD_SETSIZE: %d > %d\n",
+		client_socket,
+		FD_SETSIZE);
+#endif
+      if (0 != MHD_socket_close_ (client_socket))
+	MHD_PANIC ("close failed\n");
+#if EINVAL
+      errno = EINVAL;
+#endif
+      return MHD_NO;
+    }
+#endif
+
+
+#ifdef HAVE_MESSAGES
+#if DEBUG_CONNECT
+  MHD_DLOG (daemon,
+            "Accepted connection on socket %d\n",
+            client_socket);
+#endif
+#endif
+  if ( (daemon->connections == daemon->connection_limit) ||
+       (MHD_NO == MHD_ip_limit_add (daemon, addr, addrlen)) )
+    {
+      /* above connection limit - reject */
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Server reached connection limit (closing inbound connection)\n");
+#endif
+      if (0 != MHD_socket_close_ (client_socket))
+	MHD_PANIC ("close failed\n");
+#if ENFILE
       errno = ENFILE;
 #endif
       return MHD_NO;
@@ -1394,7 +2034,14 @@ internal_add_connection (struct MHD_Daemon *daemon,
 #endif
 #endif
 
-  if (NULL == (connection = malloc (sizeof (struct MHD_Connection))))
+  /* connections added by the application may come from another
+     thread, only take those accepted by this thread from the cache */
+  connection = NULL;
+  if (MHD_NO == external_add)
+    connection = get_cached_connection (daemon,
+                                        addrlen);
+  if ( (NULL == connection) &&
+       (NULL == (connection = calloc (1, sizeof (struct MHD_Connection)))) )
     {
       eno = errno;
 #ifdef HAVE_MESSAGES
@@ -1408,11 +2055,8 @@ internal_add_connection (struct MHD_Daemon *daemon,
       errno = eno;
       return MHD_NO;
     }
-  memset (connection,
-          0,
-          sizeof (struct MHD_Connection));
-  connection->pool = MHD_pool_create (daemon->pool_size);
-  if (NULL == connection->pool)
+  if ( (NULL == connection->pool) &&
+       (NULL == (connection->pool = MHD_pool_create (daemon->pool_size))) )
     {
 #ifdef HAVE_MESSAGES
       MHD_DLOG (daemon,
@@ -1429,8 +2073,9 @@ internal_add_connection (struct MHD_Daemon *daemon,
       return MHD_NO;
     }
 
-  connection->connection_timeout = daemon->connection_timeout;
-  if (NULL == (connection->addr = malloc (addrlen)))
+  connection->connection_timeout_ms = daemon->connection_timeout_ms;
+  if ( (NULL == connection->addr) &&
+       (NULL == (connection->addr = malloc (addrlen))) )
     {
       eno = errno;
 #ifdef HAVE_MESSAGES
@@ -1450,12 +2095,26 @@ internal_add_connection (struct MHD_Daemon *daemon,
   connection->addr_len = addrlen;
   connection->socket_fd = client_socket;
   connection->daemon = daemon;
-  connection->last_activity = MHD_monotonic_sec_counter();
+  connection->last_activity = MHD_monotonic_msec_counter();
+  connection->timeout_timer.cls = connection;
 
   /* set default connection handlers  */
   MHD_set_http_callbacks_ (connection);
   connection->recv_cls = &recv_param_adapter;
   connection->send_cls = &send_param_adapter;
+#if SENDV_SUPPORT
+  connection->sendv_cls = &sendv_param_adapter;
+#endif
+#if IO_URING_SUPPORT
+  if (0 != (daemon->options & MHD_USE_IO_URING))
+    {
+      connection->recv_cls = &recv_uring_adapter;
+      connection->send_cls = &send_uring_adapter;
+#if SENDV_SUPPORT
+      connection->sendv_cls = NULL;
+#endif
+    }
+#endif
 
   if (0 == (connection->daemon->options & MHD_USE_EPOLL_TURBO))
     {
@@ -1498,6 +2157,9 @@ internal_add_connection (struct MHD_Daemon *daemon,
     {
       connection->recv_cls = &recv_tls_adapter;
       connection->send_cls = &send_tls_adapter;
+#if SENDV_SUPPORT
+      connection->sendv_cls = NULL;
+#endif
       connection->state = MHD_TLS_CONNECTION_INIT;
       MHD_set_https_callbacks (connection);
       gnutls_init (&connection->tls_session, GNUTLS_SERVER);
@@ -1544,12 +2206,10 @@ internal_add_connection (struct MHD_Daemon *daemon,
   if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
        (MHD_YES != MHD_mutex_lock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to acquire cleanup mutex\n");
-  XDLL_insert (daemon->normal_timeout_head,
-	       daemon->normal_timeout_tail,
-	       connection);
   DLL_insert (daemon->connections_head,
 	      daemon->connections_tail,
 	      connection);
+  MHD_connection_update_timeout_ (connection);
   if  ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
 	(MHD_YES != MHD_mutex_unlock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to release cleanup mutex\n");
@@ -1622,7 +2282,33 @@ internal_add_connection (struct MHD_Daemon *daemon,
 	}
     }
 #endif
-  daemon->connections++;
+#if IO_URING_SUPPORT
+  if (0 != (daemon->options & MHD_USE_IO_URING))
+    {
+      /* nothing was submitted for this socket yet, let the event
+         loop start by running the state machine */
+      uring_ready (connection, MHD_YES);
+    }
+#endif
+  MHD_counter_store_ (&daemon->connections,
+                      daemon->connections + 1);
+#ifdef HAVE_POLL
+  if ( (0 != (daemon->options & MHD_USE_POLL)) &&
+       (0 == (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
+       (MHD_YES != MHD_connection_poll_add_ (connection,
+                                             MHD_NO)) )
+    {
+      MHD_counter_store_ (&daemon->connections,
+                          daemon->connections - 1);
+      eno = ENOMEM;
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Error allocating memory: %s\n",
+                MHD_strerror_ (eno));
+#endif
+      goto cleanup;
+    }
+#endif
   return MHD_YES;
  cleanup:
   if (NULL != daemon->notify_connection)
@@ -1639,9 +2325,11 @@ internal_add_connection (struct MHD_Daemon *daemon,
   DLL_remove (daemon->connections_head,
 	      daemon->connections_tail,
 	      connection);
-  XDLL_remove (daemon->normal_timeout_head,
-	       daemon->normal_timeout_tail,
-	       connection);
+  MHD_timer_wheel_remove (&daemon->timeout_wheel,
+                          &connection->timeout_timer);
+#ifdef HAVE_POLL
+  MHD_connection_poll_remove_ (connection);
+#endif
   if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
        (MHD_YES != MHD_mutex_unlock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to release cleanup mutex\n");
@@ -1655,6 +2343,153 @@ internal_add_connection (struct MHD_Daemon *daemon,
 }
 
 
+/**
+ * Take over some of the pending connections of the worker of the
+ * thread pool with the most pending connections: half of them,
+ * but no more than @a daemon can still accept.  The connections
+ * that have been waiting the longest are taken.
+ *
+ * @param daemon worker that is looking for work
+ * @return list of the connections taken, NULL if none
+ */
+static struct MHD_PendingConnection *
+steal_pending_connections (struct MHD_Daemon *daemon)
+{
+  struct MHD_Daemon *master = daemon->master;
+  struct MHD_Daemon *victim;
+  struct MHD_Daemon *worker;
+  struct MHD_PendingConnection *head;
+  struct MHD_PendingConnection *pos;
+  unsigned int room;
+  unsigned int most;
+  unsigned int pending;
+  unsigned int num;
+  unsigned int i;
+
+  if (daemon->connections >= daemon->connection_limit)
+    return NULL;
+  room = daemon->connection_limit - daemon->connections;
+  if (MHD_YES != MHD_mutex_lock_ (&master->pending_mutex))
+    MHD_PANIC ("Failed to acquire dispatch mutex\n");
+  num = master->dispatch_workers;
+  if (MHD_YES != MHD_mutex_unlock_ (&master->pending_mutex))
+    MHD_PANIC ("Failed to release dispatch mutex\n");
+  victim = NULL;
+  most = 0;
+  for (i = 0; i < num; i++)
+    {
+      worker = &master->worker_pool[i];
+      if (worker == daemon)
+        continue;
+      pending = MHD_counter_load_ (&worker->pending_count);
+      if (pending > most)
+        {
+          victim = worker;
+          most = pending;
+        }
+    }
+  if (NULL == victim)
+    return NULL;
+  if (MHD_YES != MHD_mutex_lock_ (&victim->pending_mutex))
+    MHD_PANIC ("Failed to acquire pending connection mutex\n");
+  num = (victim->pending_count + 1) / 2;
+  if (num > room)
+    num = room;
+  head = victim->pending_head;
+  pos = NULL;
+  for (i = 0; i < num; i++)
+    pos = (NULL == pos) ? head : pos->next;
+  if (NULL != pos)
+    {
+      victim->pending_head = pos->next;
+      if (NULL == victim->pending_head)
+        victim->pending_tail = NULL;
+      MHD_counter_store_ (&victim->pending_count,
+                          victim->pending_count - num);
+      pos->next = NULL;
+    }
+  else
+    head = NULL;
+  if (MHD_YES != MHD_mutex_unlock_ (&victim->pending_mutex))
+    MHD_PANIC ("Failed to release pending connection mutex\n");
+  return head;
+}
+
+
+/**
+ * Start processing the connections that were assigned to a worker
+ * of the thread pool by the dispatch policy.  If there are none
+ * and work stealing is enabled, take over some of the pending
+ * connections of a busy worker instead.
+ *
+ * @param daemon worker to process pending connections for
+ */
+static void
+process_pending_connections (struct MHD_Daemon *daemon)
+{
+  struct MHD_PendingConnection *head;
+  struct MHD_PendingConnection *pos;
+  int stealing;
+
+  head = NULL;
+  stealing = MHD_NO;
+  if ( (0 != MHD_counter_load_ (&daemon->pending_count)) ||
+       (MHD_YES == MHD_counter_load_ (&daemon->steal_signalled)) )
+    {
+      if (MHD_YES != MHD_mutex_lock_ (&daemon->pending_mutex))
+        MHD_PANIC ("Failed to acquire pending connection mutex\n");
+      head = daemon->pending_head;
+      daemon->pending_head = NULL;
+      daemon->pending_tail = NULL;
+      MHD_counter_store_ (&daemon->pending_count, 0);
+      /* clear before looking for work, so that we are woken up
+         again for connections queued after this point */
+      stealing = daemon->steal_signalled;
+      MHD_counter_store_ (&daemon->steal_signalled, MHD_NO);
+      if (MHD_YES != MHD_mutex_unlock_ (&daemon->pending_mutex))
+        MHD_PANIC ("Failed to release pending connection mutex\n");
+    }
+  if ( (NULL == head) &&
+       (MHD_YES == daemon->work_stealing) &&
+       (MHD_YES == stealing) )
+    head = steal_pending_connections (daemon);
+  while (NULL != (pos = head))
+    {
+      head = pos->next;
+      (void) internal_add_connection (daemon,
+                                      pos->socket_fd,
+                                      (const struct sockaddr *) &pos->addr,
+                                      pos->addrlen,
+                                      MHD_NO);
+      free (pos);
+    }
+}
+
+
+/**
+ * Close the connections still queued for a worker of the thread
+ * pool; must only be called after the worker thread was joined.
+ *
+ * @param daemon worker to clean up
+ */
+static void
+close_pending_connections (struct MHD_Daemon *daemon)
+{
+  struct MHD_PendingConnection *pos;
+
+  while (NULL != (pos = daemon->pending_head))
+    {
+      daemon->pending_head = pos->next;
+      if (0 != MHD_socket_close_ (pos->socket_fd))
+        MHD_PANIC ("close failed\n");
+      free (pos);
+    }
+  daemon->pending_tail = NULL;
+  daemon->pending_count = 0;
+  daemon->steal_signalled = MHD_NO;
+}
+
+
 /**
  * Suspend handling of network data for a given connection.  This can
  * be used to dequeue a connection from MHD's event loop (external
@@ -1699,14 +2534,11 @@ MHD_suspend_connection (struct MHD_Connection *connection)
   DLL_insert (daemon->suspended_connections_head,
               daemon->suspended_connections_tail,
               connection);
-  if (connection->connection_timeout == daemon->connection_timeout)
-    XDLL_remove (daemon->normal_timeout_head,
-                 daemon->normal_timeout_tail,
-                 connection);
-  else
-    XDLL_remove (daemon->manual_timeout_head,
-                 daemon->manual_timeout_tail,
-                 connection);
+  MHD_timer_wheel_remove (&daemon->timeout_wheel,
+                          &connection->timeout_timer);
+#ifdef HAVE_POLL
+  MHD_connection_poll_remove_ (connection);
+#endif
 #if EPOLL_SUPPORT
   if (0 != (daemon->options & MHD_USE_EPOLL_LINUX_ONLY))
     {
@@ -1728,6 +2560,15 @@ MHD_suspend_connection (struct MHD_Connection *connection)
         }
       connection->epoll_state |= MHD_EPOLL_STATE_SUSPENDED;
     }
+#endif
+#if IO_URING_SUPPORT
+  if (0 != (connection->uring_state & MHD_URING_STATE_IN_UREADY_UDLL))
+    {
+      UDLL_remove (daemon->uready_head,
+                   daemon->uready_tail,
+                   connection);
+      connection->uring_state &= ~MHD_URING_STATE_IN_UREADY_UDLL;
+    }
 #endif
   connection->suspended = MHD_YES;
   if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
@@ -1748,6 +2589,7 @@ void
 MHD_resume_connection (struct MHD_Connection *connection)
 {
   struct MHD_Daemon *daemon;
+  int must_signal;
 
   daemon = connection->daemon;
   if (MHD_USE_SUSPEND_RESUME != (daemon->options & MHD_USE_SUSPEND_RESUME))
@@ -1756,8 +2598,18 @@ MHD_resume_connection (struct MHD_Connection *connection)
        (MHD_YES != MHD_mutex_lock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to acquire cleanup mutex\n");
   connection->resuming = MHD_YES;
+#if HAVE_ATOMIC_BUILTINS
+  /* only the first resume until the event loop picks them up has to
+     wake it up; a pipe full of wakeups could block this call */
+  must_signal = (MHD_NO == __atomic_exchange_n (&daemon->resuming,
+                                                MHD_YES,
+                                                __ATOMIC_SEQ_CST));
+#else
   daemon->resuming = MHD_YES;
-  if ( (MHD_INVALID_PIPE_ != daemon->wpipe[1]) &&
+  must_signal = MHD_YES;
+#endif
+  if ( (must_signal) &&
+       (MHD_INVALID_PIPE_ != daemon->wpipe[1]) &&
        (1 != MHD_pipe_write_ (daemon->wpipe[1], "r", 1)) )
     {
 #ifdef HAVE_MESSAGES
@@ -1771,6 +2623,44 @@ MHD_resume_connection (struct MHD_Connection *connection)
 }
 
 
+/**
+ * Signal that the content reader of the response queued for
+ * @a connection has new data, after it returned
+ * #MHD_CONTENT_READER_WAIT.  Can be called from any thread.
+ *
+ * @param connection the connection with the response
+ */
+void
+MHD_response_data_ready (struct MHD_Connection *connection)
+{
+#if HAVE_ATOMIC_BUILTINS
+  /* only the thread that sees the connection parked resumes it */
+  if (MHD_CONNECTION_DATA_WAIT_PARKED ==
+      __atomic_exchange_n (&connection->data_wait,
+                           MHD_CONNECTION_DATA_WAIT_SIGNALED,
+                           __ATOMIC_ACQ_REL))
+    MHD_resume_connection (connection);
+#endif
+}
+
+
+/**
+ * Read everything from the signalling pipe of @a daemon (whose read
+ * end is non-blocking), so that a burst of signals does not keep the
+ * event loop busy for several rounds.
+ *
+ * @param daemon daemon context
+ */
+static void
+drain_pipe (struct MHD_Daemon *daemon)
+{
+  char tmp[64];
+
+  while (sizeof (tmp) == MHD_pipe_read_ (daemon->wpipe[0], tmp, sizeof (tmp)))
+    ;
+}
+
+
 /**
  * Run through the suspended connections and move any that are no
  * longer suspended back to the active state.
@@ -1783,13 +2673,24 @@ resume_suspended_connections (struct MHD_Daemon *daemon)
 {
   struct MHD_Connection *pos;
   struct MHD_Connection *next = NULL;
+  int resuming;
   int ret;
 
   ret = MHD_NO;
   if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
        (MHD_YES != MHD_mutex_lock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to acquire cleanup mutex\n");
-  if (MHD_YES == daemon->resuming)
+  /* reset the flag before looking at the connections: a connection
+     resumed from now on signals the event loop again */
+#if HAVE_ATOMIC_BUILTINS
+  resuming = __atomic_exchange_n (&daemon->resuming,
+                                  MHD_NO,
+                                  __ATOMIC_SEQ_CST);
+#else
+  resuming = daemon->resuming;
+  daemon->resuming = MHD_NO;
+#endif
+  if (MHD_YES == resuming)
     next = daemon->suspended_connections_head;
 
   while (NULL != (pos = next))
@@ -1804,14 +2705,17 @@ resume_suspended_connections (struct MHD_Daemon *daemon)
       DLL_insert (daemon->connections_head,
                   daemon->connections_tail,
                   pos);
-      if (pos->connection_timeout == daemon->connection_timeout)
-        XDLL_insert (daemon->normal_timeout_head,
-                     daemon->normal_timeout_tail,
-                     pos);
-      else
-        XDLL_insert (daemon->manual_timeout_head,
-                     daemon->manual_timeout_tail,
-                     pos);
+      /* the time spent suspended does not count towards the timeout */
+      pos->last_activity = MHD_monotonic_msec_counter ();
+      MHD_connection_update_timeout_ (pos);
+#ifdef HAVE_POLL
+      /* cannot fail, the poll set has room for all connections */
+      if ( (0 != (daemon->options & MHD_USE_POLL)) &&
+           (0 == (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
+           (MHD_YES != MHD_connection_poll_add_ (pos,
+                                                 MHD_YES)) )
+        MHD_PANIC ("Failed to add resumed connection to poll set\n");
+#endif
 #if EPOLL_SUPPORT
       if (0 != (daemon->options & MHD_USE_EPOLL_LINUX_ONLY))
         {
@@ -1825,11 +2729,18 @@ resume_suspended_connections (struct MHD_Daemon *daemon)
           pos->epoll_state |= MHD_EPOLL_STATE_IN_EREADY_EDLL;
           pos->epoll_state &= ~MHD_EPOLL_STATE_SUSPENDED;
         }
+#endif
+#if IO_URING_SUPPORT
+      if (0 != (daemon->options & MHD_USE_IO_URING))
+        {
+          /* nothing is pending in the ring for suspended connections,
+             so we must run the state machine to get going again */
+          uring_ready (pos, MHD_YES);
+        }
 #endif
       pos->suspended = MHD_NO;
       pos->resuming = MHD_NO;
     }
-  daemon->resuming = MHD_NO;
   if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
        (MHD_YES != MHD_mutex_unlock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to release cleanup mutex\n");
@@ -1837,6 +2748,263 @@ resume_suspended_connections (struct MHD_Daemon *daemon)
 }
 
 
+/**
+ * Run all further calls of the #MHD_AccessHandlerCallback for the
+ * current request of @a connection on a thread of the offload pool.
+ *
+ * @param connection the connection the request belongs to
+ * @return #MHD_YES on success, #MHD_NO if the daemon has no
+ *         offload pool
+ */
+int
+MHD_offload_request (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *daemon;
+
+  daemon = connection->daemon;
+  if (NULL != daemon->master)
+    daemon = daemon->master;
+  if (NULL == daemon->offload_threads)
+    return MHD_NO;
+  connection->offload = MHD_YES;
+  return MHD_YES;
+}
+
+
+/**
+ * Run the offloaded access handler call of a connection and
+ * resume the connection afterwards.
+ *
+ * @param connection suspended connection with an offloaded call
+ */
+static void
+run_offloaded_call (struct MHD_Connection *connection)
+{
+  size_t left = connection->offload_upload_data_size;
+
+  /* the event loop does not touch the connection while it is
+     suspended; make sure #MHD_queue_response() does not run the
+     state machine on this thread either */
+  connection->in_idle = MHD_YES;
+  connection->offload_result
+    = connection->handler (connection->handler_cls,
+                           connection,
+                           connection->url,
+                           connection->method,
+                           connection->version,
+                           connection->offload_upload_data,
+                           &left,
+                           &connection->client_context);
+  connection->offload_upload_data_size -= left;
+  connection->offload_state = MHD_CONNECTION_OFFLOAD_DONE;
+  MHD_resume_connection (connection);
+}
+
+
+/**
+ * Hand the offloaded access handler call of @a connection to the
+ * offload pool of its daemon.  The connection is resumed once the
+ * call completed.
+ *
+ * @param connection suspended connection with an offloaded call
+ */
+void
+MHD_offload_submit_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *daemon;
+
+  daemon = connection->daemon;
+  if (NULL != daemon->master)
+    daemon = daemon->master;
+  if (MHD_YES != MHD_mutex_lock_ (&daemon->offload_mutex))
+    MHD_PANIC ("Failed to acquire offload mutex\n");
+  if (MHD_YES == daemon->offload_shutdown)
+    {
+      /* the pool is going away, do the call ourselves */
+      if (MHD_YES != MHD_mutex_unlock_ (&daemon->offload_mutex))
+        MHD_PANIC ("Failed to release offload mutex\n");
+      run_offloaded_call (connection);
+      return;
+    }
+  connection->offload_next = NULL;
+  if (NULL == daemon->offload_tail)
+    daemon->offload_head = connection;
+  else
+    daemon->offload_tail->offload_next = connection;
+  daemon->offload_tail = connection;
+  if (MHD_YES != MHD_mutex_unlock_ (&daemon->offload_mutex))
+    MHD_PANIC ("Failed to release offload mutex\n");
+  if (1 != MHD_pipe_write_ (daemon->offload_pipe[1], "j", 1))
+    MHD_PANIC ("Failed to signal offload pool via pipe\n");
+}
+
+
+/**
+ * Main function of the threads of the offload pool.  Each byte in
+ * the offload pipe stands for one queued call; a thread that finds
+ * the queue empty stops (see #offload_pool_stop()).
+ *
+ * @param cls master daemon
+ * @return always 0 (on shutdown)
+ */
+static MHD_THRD_RTRN_TYPE_ MHD_THRD_CALL_SPEC_
+MHD_offload_thread (void *cls)
+{
+  struct MHD_Daemon *daemon = cls;
+  struct MHD_Connection *pos;
+  char tmp;
+
+  while (1)
+    {
+      if (1 != MHD_pipe_read_ (daemon->offload_pipe[0], &tmp, sizeof (tmp)))
+        {
+          if (EINTR == MHD_pipe_errno_)
+            continue;
+          MHD_PANIC ("Failed to read from offload pipe\n");
+        }
+      if (MHD_YES != MHD_mutex_lock_ (&daemon->offload_mutex))
+        MHD_PANIC ("Failed to acquire offload mutex\n");
+      pos = daemon->offload_head;
+      if (NULL != pos)
+        {
+          daemon->offload_head = pos->offload_next;
+          if (NULL == daemon->offload_head)
+            daemon->offload_tail = NULL;
+        }
+      if (MHD_YES != MHD_mutex_unlock_ (&daemon->offload_mutex))
+        MHD_PANIC ("Failed to release offload mutex\n");
+      if (NULL == pos)
+        break;
+      run_offloaded_call (pos);
+    }
+  return (MHD_THRD_RTRN_TYPE_) 0;
+}
+
+
+/**
+ * Stop the threads of the offload pool, if any.  Calls that were
+ * already queued are still run (and their connections resumed);
+ * calls offloaded afterwards run on the event loop.
+ *
+ * @param daemon master daemon
+ */
+static void
+offload_pool_stop (struct MHD_Daemon *daemon)
+{
+  unsigned int i;
+
+  if (NULL == daemon->offload_threads)
+    return;
+  if (MHD_YES != MHD_mutex_lock_ (&daemon->offload_mutex))
+    MHD_PANIC ("Failed to acquire offload mutex\n");
+  daemon->offload_shutdown = MHD_YES;
+  if (MHD_YES != MHD_mutex_unlock_ (&daemon->offload_mutex))
+    MHD_PANIC ("Failed to release offload mutex\n");
+  /* one more byte than queued calls for each thread */
+  for (i = 0; i < daemon->offload_pool_size; i++)
+    if (1 != MHD_pipe_write_ (daemon->offload_pipe[1], "q", 1))
+      MHD_PANIC ("Failed to signal offload pool via pipe\n");
+  for (i = 0; i < daemon->offload_pool_size; i++)
+    if (0 != MHD_join_thread_ (daemon->offload_threads[i]))
+      MHD_PANIC ("Failed to join an offload thread\n");
+  free (daemon->offload_threads);
+  daemon->offload_threads = NULL;
+}
+
+
+/**
+ * Stop the offload pool and release its resources.  Must only be
+ * called once the event loops of the daemon no longer run.
+ *
+ * @param daemon master daemon
+ */
+static void
+offload_pool_destroy (struct MHD_Daemon *daemon)
+{
+  offload_pool_stop (daemon);
+  if (MHD_INVALID_PIPE_ == daemon->offload_pipe[0])
+    return;
+  (void) MHD_mutex_destroy_ (&daemon->offload_mutex);
+  if ( (0 != MHD_pipe_close_ (daemon->offload_pipe[0])) ||
+       (0 != MHD_pipe_close_ (daemon->offload_pipe[1])) )
+    MHD_PANIC ("close failed\n");
+  daemon->offload_pipe[0] = MHD_INVALID_PIPE_;
+  daemon->offload_pipe[1] = MHD_INVALID_PIPE_;
+}
+
+
+/**
+ * Start the threads of the offload pool.
+ *
+ * @param daemon master daemon with @e offload_pool_size set
+ * @return #MHD_YES on success
+ */
+static int
+offload_pool_start (struct MHD_Daemon *daemon)
+{
+  unsigned int i;
+  int res_thread_create;
+
+  if (0 != MHD_pipe_ (daemon->offload_pipe))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Failed to create offload pipe: %s\n",
+                MHD_pipe_last_strerror_ ());
+#endif
+      return MHD_NO;
+    }
+  if (MHD_YES != MHD_mutex_create_ (&daemon->offload_mutex))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "MHD failed to initialize offload mutex\n");
+#endif
+      goto close_pipe;
+    }
+  daemon->offload_threads = malloc (daemon->offload_pool_size
+                                    * sizeof (MHD_thread_handle_));
+  if (NULL == daemon->offload_threads)
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Failed to allocate memory for offload pool: %s\n",
+                MHD_strerror_ (errno));
+#endif
+      goto destroy_mutex;
+    }
+  for (i = 0; i < daemon->offload_pool_size; i++)
+    {
+      if (0 == (res_thread_create =
+                create_thread (&daemon->offload_threads[i],
+                               daemon,
+                               &MHD_offload_thread,
+                               daemon)))
+        continue;
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Failed to create offload thread: %s\n",
+                MHD_strerror_ (res_thread_create));
+#endif
+      /* stop the threads we did start */
+      daemon->offload_pool_size = i;
+      offload_pool_destroy (daemon);
+      return MHD_NO;
+    }
+  return MHD_YES;
+
+ destroy_mutex:
+  (void) MHD_mutex_destroy_ (&daemon->offload_mutex);
+ close_pipe:
+  if ( (0 != MHD_pipe_close_ (daemon->offload_pipe[0])) ||
+       (0 != MHD_pipe_close_ (daemon->offload_pipe[1])) )
+    MHD_PANIC ("close failed\n");
+  daemon->offload_pipe[0] = MHD_INVALID_PIPE_;
+  daemon->offload_pipe[1] = MHD_INVALID_PIPE_;
+  return MHD_NO;
+}
+
+
 /**
  * Change socket options to be non-blocking, non-inheritable.
  *
@@ -1893,6 +3061,33 @@ make_nonblocking_noninheritable (struct MHD_Daemon *daemon,
 }
 
 
+/**
+ * Make the read end of a signalling pipe non-blocking, so that
+ * drain_pipe() can read everything from it.
+ *
+ * @param fd read end of the pipe
+ * @return #MHD_YES on success, #MHD_NO on error
+ */
+static int
+make_pipe_nonblocking (MHD_pipe fd)
+{
+#ifdef MHD_WINSOCK_SOCKETS
+  unsigned long flags = 1;
+
+  if (0 != ioctlsocket (fd, FIONBIO, &flags))
+    return MHD_NO;
+#else
+  int flags;
+
+  flags = fcntl (fd, F_GETFL);
+  if ( (-1 == flags) ||
+       (0 != fcntl (fd, F_SETFL, flags | O_NONBLOCK)) )
+    return MHD_NO;
+#endif
+  return MHD_YES;
+}
+
+
 /**
  * Add another client connection to the set of connections managed by
  * MHD.  This API is usually not needed (since MHD will accept inbound
@@ -1937,6 +3132,35 @@ MHD_add_connection (struct MHD_Daemon *daemon,
 }
 
 
+/**
+ * Manage a connection accepted by @a daemon.  A worker of a thread
+ * pool with a dispatch policy hands the connection to the worker
+ * selected by the policy (possibly itself).
+ *
+ * @param daemon daemon that accepted the connection
+ * @param client_socket socket of the new connection
+ * @param addr IP address of the client
+ * @param addrlen number of bytes in @a addr
+ */
+static void
+add_accepted_connection (struct MHD_Daemon *daemon,
+                         MHD_socket client_socket,
+                         const struct sockaddr *addr,
+                         socklen_t addrlen)
+{
+  if ( (NULL != daemon->master) &&
+       (MHD_DISPATCH_DEFAULT != daemon->dispatch_policy) )
+    (void) dispatch_connection (daemon->master,
+                                client_socket,
+                                addr, addrlen);
+  else
+    (void) internal_add_connection (daemon,
+                                    client_socket,
+                                    addr, addrlen,
+                                    MHD_NO);
+}
+
+
 /**
  * Accept an incoming connection and create the MHD_Connection object for
  * it.  This function also enforces policy by way of checking with the
@@ -2012,9 +3236,8 @@ MHD_accept_connection (struct MHD_Daemon *daemon)
             s);
 #endif
 #endif
-  (void) internal_add_connection (daemon, s,
-				  addr, addrlen,
-				  MHD_NO);
+  add_accepted_connection (daemon, s,
+                           addr, addrlen);
   return MHD_YES;
 }
 
@@ -2047,12 +3270,12 @@ MHD_cleanup_connections (struct MHD_Daemon *daemon)
 	      MHD_PANIC ("Failed to join a thread\n");
 	    }
 	}
-      MHD_pool_destroy (pos->pool);
 #if HTTPS_SUPPORT
       if (NULL != pos->tls_session)
 	gnutls_deinit (pos->tls_session);
 #endif
-      daemon->connections--;
+      MHD_counter_store_ (&daemon->connections,
+                          daemon->connections - 1);
       if (NULL != daemon->notify_connection)
         daemon->notify_connection (daemon->notify_connection_cls,
                                    pos,
@@ -2090,6 +3313,19 @@ MHD_cleanup_connections (struct MHD_Daemon *daemon)
 	  MHD_destroy_response (pos->response);
 	  pos->response = NULL;
 	}
+#if ZEROCOPY_SUPPORT
+      /* the kernel may still send from the responses; it reports
+         the completion on the socket, so keep that open */
+      if ( (NULL != pos->zerocopy.head) &&
+           (MHD_INVALID_SOCKET != pos->socket_fd) &&
+           (MHD_YES == MHD_zerocopy_reap_ (&pos->zerocopy,
+                                           pos->socket_fd)) &&
+           (MHD_YES == MHD_zerocopy_orphan_ (daemon,
+                                             pos->socket_fd,
+                                             &pos->zerocopy)) )
+        pos->socket_fd = MHD_INVALID_SOCKET;
+      MHD_zerocopy_release_ (&pos->zerocopy);
+#endif
       if (MHD_INVALID_SOCKET != pos->socket_fd)
 	{
 #ifdef WINDOWS
@@ -2098,10 +3334,19 @@ MHD_cleanup_connections (struct MHD_Daemon *daemon)
 	  if (0 != MHD_socket_close_ (pos->socket_fd))
 	    MHD_PANIC ("close failed\n");
 	}
+      if (MHD_YES == cache_connection (daemon,
+                                       pos))
+        continue;
+      MHD_pool_destroy (pos->pool);
       if (NULL != pos->addr)
 	free (pos->addr);
       free (pos);
     }
+#if ZEROCOPY_SUPPORT
+  if (NULL != daemon->zerocopy_orphans_head)
+    MHD_zerocopy_reap_orphans_ (daemon,
+                                MHD_NO);
+#endif
   if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
        (MHD_YES != MHD_mutex_unlock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to release cleanup mutex\n");
@@ -2126,10 +3371,8 @@ int
 MHD_get_timeout (struct MHD_Daemon *daemon,
 		 MHD_UNSIGNED_LONG_LONG *timeout)
 {
-  time_t earliest_deadline;
-  time_t now;
-  struct MHD_Connection *pos;
-  int have_timeout;
+  uint64_t earliest_deadline;
+  uint64_t now;
 
   if (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION))
     {
@@ -2148,54 +3391,62 @@ MHD_get_timeout (struct MHD_Daemon *daemon,
       *timeout = 0;
       return MHD_YES;
     }
+  if (0 != (daemon->options & MHD_USE_SSL))
+    {
+      struct MHD_Connection *pos;
+
+      /* records that gnutls already received and buffered do not
+         make the socket readable again, so we must not block on them */
+      for (pos = daemon->connections_head; NULL != pos; pos = pos->next)
+        if (0 != gnutls_record_check_pending (pos->tls_session))
+          {
+            *timeout = 0;
+            return MHD_YES;
+          }
+    }
+#endif
+#if EPOLL_SUPPORT
+  if (NULL != daemon->eready_head)
+    {
+      /* connections are ready to be processed */
+      *timeout = 0;
+      return MHD_YES;
+    }
 #endif
-
-  have_timeout = MHD_NO;
-  earliest_deadline = 0; /* avoid compiler warnings */
-  for (pos = daemon->manual_timeout_head; NULL != pos; pos = pos->nextX)
+#if IO_URING_SUPPORT
+  if (MHD_YES == daemon->uring_busy)
     {
-      if (0 != pos->connection_timeout)
-	{
-	  if ( (! have_timeout) ||
-	       (earliest_deadline > pos->last_activity + pos->connection_timeout) )
-	    earliest_deadline = pos->last_activity + pos->connection_timeout;
-#if HTTPS_SUPPORT
-	  if (  (0 != (daemon->options & MHD_USE_SSL)) &&
-		(0 != gnutls_record_check_pending (pos->tls_session)) )
-	    earliest_deadline = 0;
-#endif
-	  have_timeout = MHD_YES;
-	}
+      /* completed operations are waiting to be processed */
+      *timeout = 0;
+      return MHD_YES;
     }
-  /* normal timeouts are sorted, so we only need to look at the 'head' */
-  pos = daemon->normal_timeout_head;
-  if ( (NULL != pos) &&
-       (0 != pos->connection_timeout) )
+#endif
+
+  now = MHD_monotonic_msec_counter();
+  MHD_timer_wheel_advance (&daemon->timeout_wheel,
+                           now);
+  if (MHD_NO == MHD_timer_wheel_next (&daemon->timeout_wheel,
+                                      &earliest_deadline))
     {
-      if ( (! have_timeout) ||
-	   (earliest_deadline > pos->last_activity + pos->connection_timeout) )
-	earliest_deadline = pos->last_activity + pos->connection_timeout;
-#if HTTPS_SUPPORT
-      if (  (0 != (daemon->options & MHD_USE_SSL)) &&
-	    (0 != gnutls_record_check_pending (pos->tls_session)) )
-	earliest_deadline = 0;
+#if ZEROCOPY_SUPPORT
+      if (NULL != daemon->zerocopy_orphans_head)
+        {
+          /* check the sockets of closed connections again soon */
+          *timeout = MHD_ZEROCOPY_REAP_INTERVAL_MS;
+          return MHD_YES;
+        }
 #endif
-      have_timeout = MHD_YES;
+      return MHD_NO;
     }
-
-  if (MHD_NO == have_timeout)
-    return MHD_NO;
-  now = MHD_monotonic_sec_counter();
-  if (earliest_deadline < now)
+  if (earliest_deadline <= now)
     *timeout = 0;
   else
-    {
-      const time_t second_left = earliest_deadline - now;
-      if (second_left > ULLONG_MAX / 1000)
-        *timeout = ULLONG_MAX;
-      else
-        *timeout = 1000 * second_left;
-  }
+    *timeout = earliest_deadline - now;
+#if ZEROCOPY_SUPPORT
+  if ( (NULL != daemon->zerocopy_orphans_head) &&
+       (*timeout > MHD_ZEROCOPY_REAP_INTERVAL_MS) )
+    *timeout = MHD_ZEROCOPY_REAP_INTERVAL_MS;
+#endif
   return MHD_YES;
 }
 
@@ -2226,7 +3477,6 @@ MHD_run_from_select (struct MHD_Daemon *daemon,
 		     const fd_set *except_fd_set)
 {
   MHD_socket ds;
-  char tmp;
   struct MHD_Connection *pos;
   struct MHD_Connection *next;
   unsigned int mask = MHD_USE_SUSPEND_RESUME | MHD_USE_EPOLL_INTERNALLY_LINUX_ONLY |
@@ -2248,6 +3498,14 @@ MHD_run_from_select (struct MHD_Daemon *daemon,
       return MHD_YES;
     }
 #endif
+#if IO_URING_SUPPORT
+  if (0 != (daemon->options & MHD_USE_IO_URING))
+    {
+      /* even if no completion arrived, queued operations may
+         still have to be submitted */
+      return MHD_run (daemon);
+    }
+#endif
 
   /* select connection thread handling type */
   if ( (MHD_INVALID_SOCKET != (ds = daemon->socket_fd)) &&
@@ -2256,7 +3514,7 @@ MHD_run_from_select (struct MHD_Daemon *daemon,
   /* drain signaling pipe to avoid spinning select */
   if ( (MHD_INVALID_PIPE_ != daemon->wpipe[0]) &&
        (FD_ISSET (daemon->wpipe[0], read_fd_set)) )
-    (void) MHD_pipe_read_ (daemon->wpipe[0], &tmp, sizeof (tmp));
+    drain_pipe (daemon);
 
   if (0 == (daemon->options & MHD_USE_THREAD_PER_CONNECTION))
     {
@@ -2456,173 +3714,119 @@ static int
 MHD_poll_all (struct MHD_Daemon *daemon,
 	      int may_block)
 {
-  unsigned int num_connections;
+  struct pollfd *p;
   struct MHD_Connection *pos;
-  struct MHD_Connection *next;
+  struct MHD_Timer *timer;
+  MHD_UNSIGNED_LONG_LONG ltimeout;
+  unsigned int i;
+  int timeout;
+  short revents;
 
   if ( (MHD_USE_SUSPEND_RESUME == (daemon->options & MHD_USE_SUSPEND_RESUME)) &&
        (MHD_YES == resume_suspended_connections (daemon)) )
     may_block = MHD_NO;
 
-  /* count number of connections and thus determine poll set size */
-  num_connections = 0;
-  for (pos = daemon->connections_head; NULL != pos; pos = pos->next)
-    num_connections++;
-  {
-    MHD_UNSIGNED_LONG_LONG ltimeout;
-    unsigned int i;
-    int timeout;
-    unsigned int poll_server;
-    int poll_listen;
-    int poll_pipe;
-    char tmp;
-    struct pollfd *p;
-
-    p = malloc(sizeof (struct pollfd) * (2 + num_connections));
-    if (NULL == p)
-      {
-#ifdef HAVE_MESSAGES
-        MHD_DLOG(daemon,
-                 "Error allocating memory: %s\n",
-                 MHD_strerror_(errno));
-#endif
-        return MHD_NO;
-      }
-    memset (p, 0, sizeof (struct pollfd) * (2 + num_connections));
-    poll_server = 0;
-    poll_listen = -1;
-    if ( (MHD_INVALID_SOCKET != daemon->socket_fd) &&
-	 (daemon->connections < daemon->connection_limit) )
-      {
-	/* only listen if we are not at the connection limit */
-	p[poll_server].fd = daemon->socket_fd;
-	p[poll_server].events = POLLIN;
-	p[poll_server].revents = 0;
-	poll_listen = (int) poll_server;
-	poll_server++;
-      }
-    poll_pipe = -1;
-    if (MHD_INVALID_PIPE_ != daemon->wpipe[0])
-      {
-	p[poll_server].fd = daemon->wpipe[0];
-	p[poll_server].events = POLLIN;
-	p[poll_server].revents = 0;
-        poll_pipe = (int) poll_server;
-	poll_server++;
-      }
-    if (may_block == MHD_NO)
-      timeout = 0;
-    else if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) ||
-	      (MHD_YES != MHD_get_timeout (daemon, &ltimeout)) )
-      timeout = -1;
-    else
-      timeout = (ltimeout > INT_MAX) ? INT_MAX : (int) ltimeout;
-
-    i = 0;
-    for (pos = daemon->connections_head; NULL != pos; pos = pos->next)
-      {
-	p[poll_server+i].fd = pos->socket_fd;
-	switch (pos->event_loop_info)
-	  {
-	  case MHD_EVENT_LOOP_INFO_READ:
-	    p[poll_server+i].events |= POLLIN;
-	    break;
-	  case MHD_EVENT_LOOP_INFO_WRITE:
-	    p[poll_server+i].events |= POLLOUT;
-	    if (pos->read_buffer_size > pos->read_buffer_offset)
-	      p[poll_server+i].events |= POLLIN;
-	    break;
-	  case MHD_EVENT_LOOP_INFO_BLOCK:
-	    if (pos->read_buffer_size > pos->read_buffer_offset)
-	      p[poll_server+i].events |= POLLIN;
-	    break;
-	  case MHD_EVENT_LOOP_INFO_CLEANUP:
-	    timeout = 0; /* clean up "pos" immediately */
-	    break;
-	  }
-	i++;
-      }
-    if (0 == poll_server + num_connections)
-      {
-        free(p);
-        return MHD_YES;
-      }
-    if (MHD_sys_poll_(p, poll_server + num_connections, timeout) < 0)
-      {
-	if (EINTR == MHD_socket_errno_)
-      {
-        free(p);
+  /* the entries of the connections are kept up-to-date by
+     the connections themselves, we only need to update the
+     listen socket (connection limit) and the pipe */
+  p = daemon->poll_fds;
+  /* only listen if we are not at the connection limit; poll()
+     ignores negative file descriptors */
+  if ( (MHD_INVALID_SOCKET != daemon->socket_fd) &&
+       (daemon->connections < daemon->connection_limit) )
+    p[MHD_POLL_SLOT_LISTEN].fd = daemon->socket_fd;
+  else
+    p[MHD_POLL_SLOT_LISTEN].fd = MHD_INVALID_SOCKET;
+  p[MHD_POLL_SLOT_LISTEN].events = POLLIN;
+  p[MHD_POLL_SLOT_LISTEN].revents = 0;
+  p[MHD_POLL_SLOT_PIPE].fd = daemon->wpipe[0];
+  p[MHD_POLL_SLOT_PIPE].events = POLLIN;
+  p[MHD_POLL_SLOT_PIPE].revents = 0;
+  if (may_block == MHD_NO)
+    timeout = 0;
+  else if (0 != daemon->poll_num_cleanup)
+    timeout = 0; /* clean up connections immediately */
+  else if (MHD_YES != MHD_get_timeout (daemon, &ltimeout))
+    timeout = -1;
+  else
+    timeout = (ltimeout > INT_MAX) ? INT_MAX : (int) ltimeout;
+  if (MHD_sys_poll_(p, daemon->poll_used, timeout) < 0)
+    {
+      if (EINTR == MHD_socket_errno_)
         return MHD_YES;
-      }
 #ifdef HAVE_MESSAGES
-	MHD_DLOG (daemon,
-		  "poll failed: %s\n",
-		  MHD_socket_last_strerr_ ());
+      MHD_DLOG (daemon,
+                "poll failed: %s\n",
+                MHD_socket_last_strerr_ ());
 #endif
-        free(p);
-	return MHD_NO;
-      }
-    /* handle shutdown */
-    if (MHD_YES == daemon->shutdown)
-      {
-        free(p);
-        return MHD_NO;
-      }
-    i = 0;
-    next = daemon->connections_head;
-    while (NULL != (pos = next))
-      {
-	next = pos->next;
-	switch (pos->event_loop_info)
-	  {
-	  case MHD_EVENT_LOOP_INFO_READ:
-	    /* first, sanity checks */
-	    if (i >= num_connections)
-	      break; /* connection list changed somehow, retry later ... */
-	    if (p[poll_server+i].fd != pos->socket_fd)
-	      break; /* fd mismatch, something else happened, retry later ... */
-	    /* normal handling */
-	    if (0 != (p[poll_server+i].revents & POLLIN))
-	      pos->read_handler (pos);
-	    pos->idle_handler (pos);
-	    i++;
-	    break;
-	  case MHD_EVENT_LOOP_INFO_WRITE:
-	    /* first, sanity checks */
-	    if (i >= num_connections)
-	      break; /* connection list changed somehow, retry later ... */
-	    if (p[poll_server+i].fd != pos->socket_fd)
-	      break; /* fd mismatch, something else happened, retry later ... */
-	    /* normal handling */
-	    if (0 != (p[poll_server+i].revents & POLLIN))
-	      pos->read_handler (pos);
-	    if (0 != (p[poll_server+i].revents & POLLOUT))
-	      pos->write_handler (pos);
-	    pos->idle_handler (pos);
-	    i++;
-	    break;
-	  case MHD_EVENT_LOOP_INFO_BLOCK:
-	    if (0 != (p[poll_server+i].revents & POLLIN))
-	      pos->read_handler (pos);
-	    pos->idle_handler (pos);
-	    break;
-	  case MHD_EVENT_LOOP_INFO_CLEANUP:
-	    pos->idle_handler (pos);
-	    break;
-	  }
-      }
-    /* handle 'listen' FD */
-    if ( (-1 != poll_listen) &&
-	 (0 != (p[poll_listen].revents & POLLIN)) )
-      (void) MHD_accept_connection (daemon);
+      return MHD_NO;
+    }
+  /* handle shutdown */
+  if (MHD_YES == daemon->shutdown)
+    return MHD_NO;
+
+  /* Only connections with events, or that are waiting on the
+     application or to be cleaned up, need to be processed.  We
+     go backwards as processing a connection may remove it from
+     the poll set, in which case the last entry (which we have
+     already seen) takes its place. */
+  for (i = daemon->poll_used - 1; i >= MHD_POLL_SLOT_FIRST; i--)
+    {
+      /* handlers may grow (and thus move) the poll set */
+      revents = daemon->poll_fds[i].revents;
+      if ( (0 == revents) &&
+           (0 == daemon->poll_num_block + daemon->poll_num_cleanup) )
+        continue;
+      pos = daemon->poll_connections[i];
+      if ( (0 == revents) &&
+           (MHD_EVENT_LOOP_INFO_BLOCK != pos->poll_info) &&
+           (MHD_EVENT_LOOP_INFO_CLEANUP != pos->poll_info) )
+        continue;
+      switch (pos->event_loop_info)
+        {
+        case MHD_EVENT_LOOP_INFO_READ:
+          if (0 != (revents & POLLIN))
+            pos->read_handler (pos);
+          pos->idle_handler (pos);
+          break;
+        case MHD_EVENT_LOOP_INFO_WRITE:
+          if (0 != (revents & POLLIN))
+            pos->read_handler (pos);
+          if (0 != (revents & POLLOUT))
+            pos->write_handler (pos);
+          pos->idle_handler (pos);
+          break;
+        case MHD_EVENT_LOOP_INFO_BLOCK:
+          if (0 != (revents & POLLIN))
+            pos->read_handler (pos);
+          pos->idle_handler (pos);
+          break;
+        case MHD_EVENT_LOOP_INFO_CLEANUP:
+          pos->idle_handler (pos);
+          break;
+        }
+    }
+
+  /* Finally, handle timed-out connections; as with epoll, connections
+     without events are not processed above, so the timer wheel
+     tells us which connections timed out. */
+  MHD_timer_wheel_advance (&daemon->timeout_wheel,
+                           MHD_monotonic_msec_counter());
+  while (NULL != (timer = MHD_timer_wheel_pop_expired (&daemon->timeout_wheel)))
+    {
+      pos = timer->cls;
+      pos->idle_handler (pos);
+    }
 
-    /* handle pipe FD */
-    if ( (-1 != poll_pipe) &&
-         (0 != (p[poll_pipe].revents & POLLIN)) )
-      (void) MHD_pipe_read_ (daemon->wpipe[0], &tmp, sizeof (tmp));
+  /* handle 'listen' FD; accepting may grow (and thus move) the
+     poll set, so get the events of the pipe first */
+  revents = daemon->poll_fds[MHD_POLL_SLOT_PIPE].revents;
+  if (0 != (daemon->poll_fds[MHD_POLL_SLOT_LISTEN].revents & POLLIN))
+    (void) MHD_accept_connection (daemon);
 
-    free(p);
-  }
+  /* handle pipe FD */
+  if (0 != (revents & POLLIN))
+    drain_pipe (daemon);
   return MHD_YES;
 }
 
@@ -2739,7 +3943,7 @@ MHD_epoll (struct MHD_Daemon *daemon,
 	   int may_block)
 {
   struct MHD_Connection *pos;
-  struct MHD_Connection *next;
+  struct MHD_Timer *timer;
   struct epoll_event events[MAX_EVENTS];
   struct epoll_event event;
   int timeout_ms;
@@ -2747,7 +3951,7 @@ MHD_epoll (struct MHD_Daemon *daemon,
   int num_events;
   unsigned int i;
   unsigned int series_length;
-  char tmp;
+  unsigned int num_ready;
 
   if (-1 == daemon->epoll_fd)
     return MHD_NO; /* we're down! */
@@ -2829,7 +4033,7 @@ MHD_epoll (struct MHD_Daemon *daemon,
           if ( (MHD_INVALID_PIPE_ != daemon->wpipe[0]) &&
                (daemon->wpipe[0] == events[i].data.fd) )
             {
-              (void) MHD_pipe_read_ (daemon->wpipe[0], &tmp, sizeof (tmp));
+              drain_pipe (daemon);
               continue;
             }
 	  if (daemon != events[i].data.ptr)
@@ -2838,6 +4042,13 @@ MHD_epoll (struct MHD_Daemon *daemon,
 		 remember the event and if appropriate mark the
 		 connection as 'eready'. */
 	      pos = events[i].data.ptr;
+#if ZEROCOPY_SUPPORT
+	      /* completed MSG_ZEROCOPY sends are reported as errors */
+	      if ( (0 != (events[i].events & EPOLLERR)) &&
+		   (NULL != pos->zerocopy.head) )
+		(void) MHD_zerocopy_reap_ (&pos->zerocopy,
+					   pos->socket_fd);
+#endif
 	      if (0 != (events[i].events & EPOLLIN))
 		{
 		  pos->epoll_state |= MHD_EPOLL_STATE_READ_READY;
@@ -2883,47 +4094,493 @@ MHD_epoll (struct MHD_Daemon *daemon,
        (MHD_YES == resume_suspended_connections (daemon)) )
     may_block = MHD_NO;
 
-  /* process events for connections */
-  while (NULL != (pos = daemon->eready_tail))
+  /* process events for connections; only as many as were ready
+     when we started, as connections that remain ready (for example
+     while streaming a response) are inserted again and would
+     otherwise keep us from ever accepting new connections */
+  num_ready = 0;
+  for (pos = daemon->eready_head; NULL != pos; pos = pos->nextE)
+    num_ready++;
+  while ( (0 != num_ready--) &&
+          (NULL != (pos = daemon->eready_tail)) )
+    {
+      EDLL_remove (daemon->eready_head,
+		   daemon->eready_tail,
+		   pos);
+      pos->epoll_state &= ~MHD_EPOLL_STATE_IN_EREADY_EDLL;
+      if (MHD_EVENT_LOOP_INFO_READ == pos->event_loop_info)
+	pos->read_handler (pos);
+      if (MHD_EVENT_LOOP_INFO_WRITE == pos->event_loop_info)
+	pos->write_handler (pos);
+      pos->idle_handler (pos);
+    }
+
+  /* Finally, handle timed-out connections; we need to do this here
+     as the epoll mechanism won't call the 'idle_handler' on everything,
+     as the other event loops do.  As timeouts do not get an explicit
+     event, the timer wheel tells us which connections timed out. */
+  MHD_timer_wheel_advance (&daemon->timeout_wheel,
+                           MHD_monotonic_msec_counter());
+  while (NULL != (timer = MHD_timer_wheel_pop_expired (&daemon->timeout_wheel)))
+    {
+      pos = timer->cls;
+      pos->idle_handler (pos);
+    }
+  return MHD_YES;
+}
+#endif
+
+
+#if IO_URING_SUPPORT
+
+/**
+ * How many submission queue entries do we ask the kernel for?  Each
+ * connection has at most one operation pending; if more are queued
+ * in one iteration, we simply pass the queue to the kernel early.
+ */
+#define MHD_URING_ENTRIES 256
+
+/**
+ * User data of the accept operation on the listen socket (connection
+ * operations use the address of the connection as user data).
+ */
+#define URING_TAG_ACCEPT ((uint64_t) 1)
+
+/**
+ * User data of the poll operation on the signal pipe.
+ */
+#define URING_TAG_WPIPE ((uint64_t) 2)
+
+/**
+ * User data of cancellation requests (their completion is ignored).
+ */
+#define URING_TAG_CANCEL ((uint64_t) 3)
+
+
+/**
+ * Submit the operation requested by the read or write handler of
+ * @a pos to the ring.
+ *
+ * @param daemon daemon the connection belongs to
+ * @param pos connection with one of the "WANT" bits set
+ */
+static void
+uring_submit_connection (struct MHD_Daemon *daemon,
+                         struct MHD_Connection *pos)
+{
+  struct io_uring_sqe *sqe;
+
+  if (NULL == (sqe = MHD_uring_get_sqe_ (&daemon->uring)))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Failed to queue operation to io_uring: %s\n",
+                MHD_strerror_ (errno));
+#endif
+      pos->uring_state &= ~(MHD_URING_STATE_WANT_RECV |
+                            MHD_URING_STATE_WANT_SEND |
+                            MHD_URING_STATE_WANT_POLLOUT);
+      MHD_connection_close_ (pos,
+                             MHD_REQUEST_TERMINATED_WITH_ERROR);
+      uring_ready (pos, MHD_YES);
+      return;
+    }
+  if (0 != (pos->uring_state & MHD_URING_STATE_WANT_RECV))
+    MHD_uring_prep_recv_ (sqe,
+                          pos->socket_fd,
+                          pos->uring_buf,
+                          pos->uring_len,
+                          (uint64_t) (uintptr_t) pos);
+  else if (0 != (pos->uring_state & MHD_URING_STATE_WANT_SEND))
+    MHD_uring_prep_send_ (sqe,
+                          pos->socket_fd,
+                          pos->uring_buf,
+                          pos->uring_len,
+                          (uint64_t) (uintptr_t) pos);
+  else
+    MHD_uring_prep_poll_ (sqe,
+                          pos->socket_fd,
+                          POLLOUT,
+                          (uint64_t) (uintptr_t) pos);
+  pos->uring_state |= MHD_URING_STATE_IN_FLIGHT;
+  daemon->uring_in_flight++;
+}
+
+
+/**
+ * Run the state machine of a connection that has no operation
+ * pending and queue whatever it needs next.
+ *
+ * @param daemon daemon the connection belongs to
+ * @param pos connection to process
+ */
+static void
+uring_process_connection (struct MHD_Daemon *daemon,
+                          struct MHD_Connection *pos)
+{
+  enum MHD_CONNECTION_STATE old_state;
+
+  if (MHD_NO == pos->idle_handler (pos))
+    return; /* connection was cleaned up */
+  if (MHD_YES == pos->suspended)
+    return;
+  switch (pos->event_loop_info)
+    {
+    case MHD_EVENT_LOOP_INFO_READ:
+      old_state = pos->state;
+      pos->read_handler (pos);
+      if (0 != (pos->uring_state & MHD_URING_STATE_WANT_RECV))
+        uring_submit_connection (daemon, pos);
+      else if ( (old_state != pos->state) ||
+                (MHD_CONNECTION_CLOSED == pos->state) )
+        uring_ready (pos, MHD_YES);
+      /* otherwise there is no space to read into; we will
+         get back to it once the connection times out */
+      break;
+    case MHD_EVENT_LOOP_INFO_WRITE:
+      pos->write_handler (pos);
+      if (0 != (pos->uring_state & (MHD_URING_STATE_WANT_SEND |
+                                    MHD_URING_STATE_WANT_POLLOUT)))
+        uring_submit_connection (daemon, pos);
+      else
+        uring_ready (pos, MHD_YES);
+      break;
+    case MHD_EVENT_LOOP_INFO_BLOCK:
+      /* we should look at this connection again in the next iteration
+	 of the event loop, as we're waiting on the application */
+      uring_ready (pos, MHD_NO);
+      break;
+    case MHD_EVENT_LOOP_INFO_CLEANUP:
+      /* closed, let the idle handler clean up */
+      uring_ready (pos, MHD_YES);
+      break;
+    }
+}
+
+
+/**
+ * Pass the result of a completed operation to the connection's
+ * read or write handler.
+ *
+ * @param daemon daemon the connection belongs to
+ * @param pos connection the operation was submitted for
+ * @param res result of the operation
+ */
+static void
+uring_complete_connection (struct MHD_Daemon *daemon,
+                           struct MHD_Connection *pos,
+                           int res)
+{
+  daemon->uring_in_flight--;
+  pos->uring_state &= ~MHD_URING_STATE_IN_FLIGHT;
+  if (0 != (pos->uring_state & MHD_URING_STATE_WANT_POLLOUT))
+    {
+      /* socket is writable again, the write handler will retry */
+      pos->uring_state &= ~MHD_URING_STATE_WANT_POLLOUT;
+    }
+  else
+    {
+      pos->uring_res = res;
+      pos->uring_state |= MHD_URING_STATE_DONE;
+      if (0 != (pos->uring_state & MHD_URING_STATE_WANT_RECV))
+        {
+          pos->uring_state &= ~MHD_URING_STATE_WANT_RECV;
+          pos->read_handler (pos);
+        }
+      else
+        {
+          pos->uring_state &= ~MHD_URING_STATE_WANT_SEND;
+          pos->write_handler (pos);
+        }
+      /* if the connection was closed meanwhile, nobody took the result */
+      pos->uring_state &= ~MHD_URING_STATE_DONE;
+    }
+  uring_ready (pos, MHD_YES);
+}
+
+
+/**
+ * Handle one completion from the ring.
+ *
+ * @param daemon daemon the ring belongs to
+ * @param cqe the completion
+ */
+static void
+uring_dispatch (struct MHD_Daemon *daemon,
+                const struct io_uring_cqe *cqe)
+{
+  switch (cqe->user_data)
+    {
+    case URING_TAG_CANCEL:
+      break;
+    case URING_TAG_WPIPE:
+      daemon->uring_in_flight--;
+      daemon->uring_wpipe_armed = MHD_NO;
+      if (0 < cqe->res)
+        drain_pipe (daemon);
+      break;
+    case URING_TAG_ACCEPT:
+      daemon->uring_in_flight--;
+      daemon->uring_accept_armed = MHD_NO;
+      if (0 > cqe->res)
+        {
+#ifdef HAVE_MESSAGES
+          if ( (-ECANCELED != cqe->res) &&
+               (-EAGAIN != cqe->res) &&
+               (-EINTR != cqe->res) &&
+               (MHD_INVALID_SOCKET != daemon->socket_fd) )
+            MHD_DLOG (daemon,
+                      "Error accepting connection: %s\n",
+                      MHD_strerror_ (- cqe->res));
+#endif
+          break;
+        }
+      if ( (MHD_INVALID_SOCKET == daemon->socket_fd) ||
+           (MHD_YES == daemon->shutdown) )
+        {
+          /* raced with MHD_quiesce_daemon() or shutdown */
+          if (0 != MHD_socket_close_ (cqe->res))
+            MHD_PANIC ("close failed\n");
+          break;
+        }
+#ifdef HAVE_MESSAGES
+#if DEBUG_CONNECT
+      MHD_DLOG (daemon,
+                "Accepted connection on socket %d\n",
+                cqe->res);
+#endif
+#endif
+      add_accepted_connection (daemon,
+                               cqe->res,
+                               (const struct sockaddr *) &daemon->uring_accept_addr,
+                               daemon->uring_accept_addrlen);
+      break;
+    default:
+      uring_complete_connection (daemon,
+                                 (struct MHD_Connection *) (uintptr_t) cqe->user_data,
+                                 cqe->res);
+      break;
+    }
+}
+
+
+/**
+ * Handle the timeout of @a pos.  Connections without pending operation
+ * are handed to the idle handler (which closes them), for the others
+ * we shut down the socket, which makes their operation complete.
+ *
+ * @param pos connection that timed out
+ */
+static void
+uring_handle_timeout (struct MHD_Connection *pos)
+{
+  if (0 != (pos->uring_state & MHD_URING_STATE_IN_UREADY_UDLL))
+    return; /* will be handled by the idle handler soon enough */
+  if (0 == (pos->uring_state & MHD_URING_STATE_IN_FLIGHT))
+    {
+      uring_ready (pos, MHD_YES);
+      return;
+    }
+  if (MHD_CONNECTION_CLOSED != pos->state)
+    {
+      MHD_connection_close_ (pos,
+                             MHD_REQUEST_TERMINATED_TIMEOUT_REACHED);
+      /* make sure the pending operation returns, even in turbo mode */
+      (void) shutdown (pos->socket_fd, SHUT_RDWR);
+    }
+}
+
+
+/**
+ * Do io_uring-based processing (this function is allowed to
+ * block if @a may_block is set to #MHD_YES).
+ *
+ * @param daemon daemon to run the io_uring loop for
+ * @param may_block #MHD_YES if blocking, #MHD_NO if non-blocking
+ * @return #MHD_NO on serious errors, #MHD_YES on success
+ */
+static int
+MHD_uring (struct MHD_Daemon *daemon,
+	   int may_block)
+{
+  struct MHD_Connection *pos;
+  struct MHD_Connection *head;
+  struct io_uring_sqe *sqe;
+  struct io_uring_cqe *cqe;
+  struct MHD_Timer *timer;
+  MHD_UNSIGNED_LONG_LONG timeout_ll;
+  int timeout_ms;
+
+  if (-1 == daemon->uring.fd)
+    return MHD_NO; /* we're down! */
+  if (MHD_YES == daemon->shutdown)
+    return MHD_NO;
+  if (MHD_USE_SUSPEND_RESUME == (daemon->options & MHD_USE_SUSPEND_RESUME))
+    (void) resume_suspended_connections (daemon);
+
+  if ( (MHD_INVALID_SOCKET != daemon->socket_fd) &&
+       (daemon->connections < daemon->connection_limit) &&
+       (MHD_NO == daemon->uring_accept_armed) &&
+       (NULL != (sqe = MHD_uring_get_sqe_ (&daemon->uring))) )
+    {
+      daemon->uring_accept_addrlen = sizeof (daemon->uring_accept_addr);
+      MHD_uring_prep_accept_ (sqe,
+                              daemon->socket_fd,
+                              (struct sockaddr *) &daemon->uring_accept_addr,
+                              &daemon->uring_accept_addrlen,
+                              URING_TAG_ACCEPT);
+      daemon->uring_accept_armed = MHD_YES;
+      daemon->uring_in_flight++;
+    }
+  if ( (MHD_INVALID_SOCKET == daemon->socket_fd) &&
+       (MHD_YES == daemon->uring_accept_armed) &&
+       (NULL != (sqe = MHD_uring_get_sqe_ (&daemon->uring))) )
+    {
+      /* listen socket was quiesced, stop using it */
+      MHD_uring_prep_cancel_ (sqe,
+                              URING_TAG_ACCEPT,
+                              URING_TAG_CANCEL);
+    }
+  if ( (MHD_INVALID_PIPE_ != daemon->wpipe[0]) &&
+       (MHD_NO == daemon->uring_wpipe_armed) &&
+       (NULL != (sqe = MHD_uring_get_sqe_ (&daemon->uring))) )
+    {
+      MHD_uring_prep_poll_ (sqe,
+                            daemon->wpipe[0],
+                            POLLIN,
+                            URING_TAG_WPIPE);
+      daemon->uring_wpipe_armed = MHD_YES;
+      daemon->uring_in_flight++;
+    }
+
+  /* run the state machine of all connections that are ready; we
+     take the list as a whole, connections that need another round
+     will be queued again for the next iteration */
+  head = daemon->uready_head;
+  daemon->uready_head = NULL;
+  daemon->uready_tail = NULL;
+  daemon->uring_busy = MHD_NO;
+  while (NULL != (pos = head))
+    {
+      head = pos->nextU;
+      pos->nextU = NULL;
+      pos->prevU = NULL;
+      pos->uring_state &= ~MHD_URING_STATE_IN_UREADY_UDLL;
+      uring_process_connection (daemon, pos);
+    }
+
+  timeout_ms = 0;
+  if ( (MHD_YES == may_block) &&
+       (MHD_NO == daemon->uring_busy) )
+    {
+      if (MHD_YES == MHD_get_timeout (daemon,
+				      &timeout_ll))
+	{
+	  if (timeout_ll >= (MHD_UNSIGNED_LONG_LONG) INT_MAX)
+	    timeout_ms = INT_MAX;
+	  else
+	    timeout_ms = (int) timeout_ll;
+	}
+      else
+	timeout_ms = -1;
+    }
+
+  /* pass everything to the kernel and wait for completions, all in
+     one system call */
+  if (0 != MHD_uring_submit_ (&daemon->uring,
+                              (0 != timeout_ms) ? 1 : 0,
+                              timeout_ms))
     {
-      EDLL_remove (daemon->eready_head,
-		   daemon->eready_tail,
-		   pos);
-      pos->epoll_state &= ~MHD_EPOLL_STATE_IN_EREADY_EDLL;
-      if (MHD_EVENT_LOOP_INFO_READ == pos->event_loop_info)
-	pos->read_handler (pos);
-      if (MHD_EVENT_LOOP_INFO_WRITE == pos->event_loop_info)
-	pos->write_handler (pos);
-      pos->idle_handler (pos);
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Call to io_uring_enter failed: %s\n",
+                MHD_strerror_ (errno));
+#endif
+      return MHD_NO;
+    }
+  while (NULL != (cqe = MHD_uring_peek_cqe_ (&daemon->uring)))
+    {
+      uring_dispatch (daemon, cqe);
+      MHD_uring_cqe_seen_ (&daemon->uring);
     }
 
-  /* Finally, handle timed-out connections; we need to do this here
-     as the epoll mechanism won't call the 'idle_handler' on everything,
-     as the other event loops do.  As timeouts do not get an explicit
-     event, we need to find those connections that might have timed out
-     here.
+  /* Finally, handle timed-out connections; as with epoll, timeouts
+     do not get an explicit event */
+  MHD_timer_wheel_advance (&daemon->timeout_wheel,
+                           MHD_monotonic_msec_counter ());
+  while (NULL != (timer = MHD_timer_wheel_pop_expired (&daemon->timeout_wheel)))
+    uring_handle_timeout (timer->cls);
+  return MHD_YES;
+}
 
-     Connections with custom timeouts must all be looked at, as we
-     do not bother to sort that (presumably very short) list. */
-  next = daemon->manual_timeout_head;
-  while (NULL != (pos = next))
+
+/**
+ * Wait until the kernel is done with all operations submitted to
+ * the ring of @a daemon.  Must only be called after the event loop
+ * has stopped and all connection sockets have been shut down.
+ *
+ * @param daemon daemon to drain the ring for
+ */
+static void
+uring_drain (struct MHD_Daemon *daemon)
+{
+  struct MHD_Connection *pos;
+  struct io_uring_sqe *sqe;
+  struct io_uring_cqe *cqe;
+
+  if (-1 == daemon->uring.fd)
+    return;
+  if ( (MHD_YES == daemon->uring_accept_armed) &&
+       (NULL != (sqe = MHD_uring_get_sqe_ (&daemon->uring))) )
+    MHD_uring_prep_cancel_ (sqe,
+                            URING_TAG_ACCEPT,
+                            URING_TAG_CANCEL);
+  if ( (MHD_YES == daemon->uring_wpipe_armed) &&
+       (NULL != (sqe = MHD_uring_get_sqe_ (&daemon->uring))) )
+    MHD_uring_prep_cancel_ (sqe,
+                            URING_TAG_WPIPE,
+                            URING_TAG_CANCEL);
+  while (0 != daemon->uring_in_flight)
     {
-      next = pos->nextX;
-      pos->idle_handler (pos);
+      if (0 != MHD_uring_submit_ (&daemon->uring, 1, -1))
+        MHD_PANIC ("Failed to drain io_uring\n");
+      while (NULL != (cqe = MHD_uring_peek_cqe_ (&daemon->uring)))
+        {
+          switch (cqe->user_data)
+            {
+            case URING_TAG_CANCEL:
+              break;
+            case URING_TAG_WPIPE:
+              daemon->uring_wpipe_armed = MHD_NO;
+              daemon->uring_in_flight--;
+              break;
+            case URING_TAG_ACCEPT:
+              daemon->uring_accept_armed = MHD_NO;
+              daemon->uring_in_flight--;
+              if ( (0 <= cqe->res) &&
+                   (0 != MHD_socket_close_ (cqe->res)) )
+                MHD_PANIC ("close failed\n");
+              break;
+            default:
+              pos = (struct MHD_Connection *) (uintptr_t) cqe->user_data;
+              pos->uring_state &= ~(MHD_URING_STATE_IN_FLIGHT |
+                                    MHD_URING_STATE_WANT_RECV |
+                                    MHD_URING_STATE_WANT_SEND |
+                                    MHD_URING_STATE_WANT_POLLOUT);
+              daemon->uring_in_flight--;
+              break;
+            }
+          MHD_uring_cqe_seen_ (&daemon->uring);
+        }
     }
-  /* Connections with the default timeout are sorted by prepending
-     them to the head of the list whenever we touch the connection;
-     thus it sufficies to iterate from the tail until the first
-     connection is NOT timed out */
-  next = daemon->normal_timeout_tail;
-  while (NULL != (pos = next))
+  /* the ready list is meaningless now */
+  while (NULL != (pos = daemon->uready_head))
     {
-      next = pos->prevX;
-      pos->idle_handler (pos);
-      if (MHD_CONNECTION_CLOSED != pos->state)
-	break; /* sorted by timeout, no need to visit the rest! */
+      UDLL_remove (daemon->uready_head,
+                   daemon->uready_tail,
+                   pos);
+      pos->uring_state &= ~MHD_URING_STATE_IN_UREADY_UDLL;
     }
-  return MHD_YES;
 }
 #endif
 
@@ -2965,6 +4622,13 @@ MHD_run (struct MHD_Daemon *daemon)
     MHD_epoll (daemon, MHD_NO);
     MHD_cleanup_connections (daemon);
   }
+#endif
+#if IO_URING_SUPPORT
+  else if (0 != (daemon->options & MHD_USE_IO_URING))
+  {
+    MHD_uring (daemon, MHD_NO);
+    MHD_cleanup_connections (daemon);
+  }
 #endif
   else
   {
@@ -2989,11 +4653,18 @@ MHD_select_thread (void *cls)
 
   while (MHD_YES != daemon->shutdown)
     {
+      if ( (NULL != daemon->master) &&
+           (MHD_YES == use_pending_queues (daemon)) )
+        process_pending_connections (daemon);
       if (0 != (daemon->options & MHD_USE_POLL))
 	MHD_poll (daemon, MHD_YES);
 #if EPOLL_SUPPORT
       else if (0 != (daemon->options & MHD_USE_EPOLL_LINUX_ONLY))
 	MHD_epoll (daemon, MHD_YES);
+#endif
+#if IO_URING_SUPPORT
+      else if (0 != (daemon->options & MHD_USE_IO_URING))
+	MHD_uring (daemon, MHD_YES);
 #endif
       else
 	MHD_select (daemon, MHD_YES);
@@ -3080,6 +4751,7 @@ MHD_quiesce_daemon (struct MHD_Daemon *daemon)
 {
   unsigned int i;
   MHD_socket ret;
+  MHD_socket fd;
 
   ret = daemon->socket_fd;
   if (MHD_INVALID_SOCKET == ret)
@@ -3097,6 +4769,7 @@ MHD_quiesce_daemon (struct MHD_Daemon *daemon)
   if (NULL != daemon->worker_pool)
     for (i = 0; i < daemon->worker_pool_size; i++)
       {
+	fd = daemon->worker_pool[i].socket_fd;
 	daemon->worker_pool[i].socket_fd = MHD_INVALID_SOCKET;
 #if EPOLL_SUPPORT
 	if ( (0 != (daemon->options & MHD_USE_EPOLL_LINUX_ONLY)) &&
@@ -3105,11 +4778,25 @@ MHD_quiesce_daemon (struct MHD_Daemon *daemon)
 	  {
 	    if (0 != epoll_ctl (daemon->worker_pool[i].epoll_fd,
 				EPOLL_CTL_DEL,
-				ret,
+				fd,
 				NULL))
 	      MHD_PANIC ("Failed to remove listen FD from epoll set\n");
 	    daemon->worker_pool[i].listen_socket_in_epoll = MHD_NO;
 	  }
+#endif
+#ifdef HAVE_LISTEN_SHUTDOWN
+	/* The kernel must stop handing connections to the sockets of
+	   the workers, only the returned socket stays usable.  They
+	   are closed by MHD_stop_daemon(). */
+	if (MHD_INVALID_SOCKET != daemon->worker_pool[i].worker_socket_fd)
+	  (void) shutdown (daemon->worker_pool[i].worker_socket_fd, SHUT_RDWR);
+#endif
+#if IO_URING_SUPPORT
+	/* wake up the worker so that it cancels its pending accept */
+	if ( (0 != (daemon->options & MHD_USE_IO_URING)) &&
+	     (MHD_INVALID_PIPE_ != daemon->worker_pool[i].wpipe[1]) &&
+	     (1 != MHD_pipe_write_ (daemon->worker_pool[i].wpipe[1], "q", 1)) )
+	  MHD_PANIC ("failed to signal quiesce via pipe");
 #endif
       }
   daemon->socket_fd = MHD_INVALID_SOCKET;
@@ -3125,6 +4812,13 @@ MHD_quiesce_daemon (struct MHD_Daemon *daemon)
 	MHD_PANIC ("Failed to remove listen FD from epoll set\n");
       daemon->listen_socket_in_epoll = MHD_NO;
     }
+#endif
+#if IO_URING_SUPPORT
+  if ( (0 != (daemon->options & MHD_USE_IO_URING)) &&
+       (NULL == daemon->worker_pool) &&
+       (MHD_INVALID_PIPE_ != daemon->wpipe[1]) &&
+       (1 != MHD_pipe_write_ (daemon->wpipe[1], "q", 1)) )
+    MHD_PANIC ("failed to signal quiesce via pipe");
 #endif
   return ret;
 }
@@ -3142,6 +4836,85 @@ typedef void (*VfprintfFunctionPointerType)(void *cls,
 					    va_list va);
 
 
+/**
+ * Release the responses of #MHD_OPTION_STATIC_RESPONSES.
+ *
+ * @param daemon the daemon to clean up
+ */
+static void
+free_static_responses (struct MHD_Daemon *daemon)
+{
+  unsigned int i;
+
+  for (i = 0; i < daemon->num_static_responses; i++)
+    {
+      MHD_destroy_response (daemon->static_responses[i].response);
+      free (daemon->static_responses[i].method);
+      free (daemon->static_responses[i].url);
+    }
+  free (daemon->static_responses);
+  daemon->static_responses = NULL;
+  daemon->num_static_responses = 0;
+}
+
+
+/**
+ * Add the entries of an array given with
+ * #MHD_OPTION_STATIC_RESPONSES to the static responses of
+ * @a daemon.
+ *
+ * @param daemon the daemon to initialize
+ * @param sr array of static responses, terminated by an
+ *        entry with a NULL @e url
+ * @return #MHD_YES on success, #MHD_NO on error
+ */
+static int
+add_static_responses (struct MHD_Daemon *daemon,
+                      const struct MHD_StaticResponse *sr)
+{
+  struct MHD_StaticEntry *entries;
+  struct MHD_StaticEntry *entry;
+  unsigned int num;
+
+  for (num = 0; NULL != sr[num].url; num++)
+    if (NULL == sr[num].response)
+      return MHD_NO;
+  if (0 == num)
+    return MHD_YES;
+  if (num > UINT_MAX / sizeof (struct MHD_StaticEntry) - daemon->num_static_responses)
+    return MHD_NO;
+  entries = realloc (daemon->static_responses,
+                     (daemon->num_static_responses + num) * sizeof (struct MHD_StaticEntry));
+  if (NULL == entries)
+    return MHD_NO;
+  daemon->static_responses = entries;
+  for (; NULL != sr->url; sr++)
+    {
+      entry = &entries[daemon->num_static_responses];
+      entry->method = NULL;
+      entry->url = strdup (sr->url);
+      if ( (NULL == entry->url) ||
+           ( (NULL != sr->method) &&
+             (NULL == (entry->method = strdup (sr->method))) ) )
+        {
+          free (entry->url);
+#ifdef HAVE_MESSAGES
+          MHD_DLOG (daemon,
+                    "Failed to allocate memory for static response\n");
+#endif
+          return MHD_NO;
+        }
+      entry->url_len = strlen (entry->url);
+      entry->status_code = sr->status_code;
+      entry->notify_completed = sr->notify_completed;
+      entry->response = sr->response;
+      MHD_increment_response_rc (entry->response);
+      daemon->num_static_responses++;
+    }
+  return MHD_YES;
+}
+
+
 /**
  * Parse a list of options given as varargs.
  *
@@ -3214,7 +4987,10 @@ parse_options_va (struct MHD_Daemon *daemon,
           daemon->connection_limit = va_arg (ap, unsigned int);
           break;
         case MHD_OPTION_CONNECTION_TIMEOUT:
-          daemon->connection_timeout = va_arg (ap, unsigned int);
+          daemon->connection_timeout_ms = 1000LLU * va_arg (ap, unsigned int);
+          break;
+        case MHD_OPTION_CONNECTION_TIMEOUT_MS:
+          daemon->connection_timeout_ms = va_arg (ap, unsigned int);
           break;
         case MHD_OPTION_NOTIFY_COMPLETED:
           daemon->notify_completed =
@@ -3226,6 +5002,26 @@ parse_options_va (struct MHD_Daemon *daemon,
             va_arg (ap, MHD_NotifyConnectionCallback);
           daemon->notify_connection_cls = va_arg (ap, void *);
           break;
+        case MHD_OPTION_HEADER_FILTER:
+          daemon->header_filter =
+            va_arg (ap, MHD_HeaderFilterCallback);
+          daemon->header_filter_cls = va_arg (ap, void *);
+          break;
+        case MHD_OPTION_REQUEST_LINE_CALLBACK:
+          daemon->request_line_callback =
+            va_arg (ap, MHD_RequestLineCallback);
+          daemon->request_line_callback_cls = va_arg (ap, void *);
+          break;
+        case MHD_OPTION_ROUTER:
+          daemon->router = va_arg (ap, struct MHD_Router *);
+          if (NULL != daemon->router)
+            MHD_router_freeze_ (daemon->router);
+          break;
+        case MHD_OPTION_STATIC_RESPONSES:
+          if (MHD_YES != add_static_responses (daemon,
+                                               va_arg (ap, const struct MHD_StaticResponse *)))
+            return MHD_NO;
+          break;
         case MHD_OPTION_PER_IP_CONNECTION_LIMIT:
           daemon->per_ip_connection_limit = va_arg (ap, unsigned int);
           break;
@@ -3400,6 +5196,91 @@ parse_options_va (struct MHD_Daemon *daemon,
 	case MHD_OPTION_LISTEN_BACKLOG_SIZE:
 	  daemon->listen_backlog_size = va_arg (ap, unsigned int);
 	  break;
+	case MHD_OPTION_LISTEN_SOCKET_PER_WORKER:
+	  daemon->listen_socket_per_worker = va_arg (ap, unsigned int) ? MHD_YES : MHD_NO;
+	  break;
+	case MHD_OPTION_WORKER_DISPATCH_POLICY:
+	  daemon->dispatch_policy = (enum MHD_WorkerDispatchPolicy) va_arg (ap, int);
+	  if ( (MHD_DISPATCH_DEFAULT != daemon->dispatch_policy) &&
+	       (MHD_DISPATCH_ROUND_ROBIN != daemon->dispatch_policy) &&
+	       (MHD_DISPATCH_LEAST_CONNECTIONS != daemon->dispatch_policy) &&
+	       (MHD_DISPATCH_LEAST_QUEUED_BYTES != daemon->dispatch_policy) )
+	    {
+#ifdef HAVE_MESSAGES
+	      MHD_DLOG (daemon,
+			"Invalid worker dispatch policy %d\n",
+			(int) daemon->dispatch_policy);
+#endif
+	      return MHD_NO;
+	    }
+	  break;
+	case MHD_OPTION_WORKER_WORK_STEALING:
+	  daemon->work_stealing = va_arg (ap, unsigned int) ? MHD_YES : MHD_NO;
+	  break;
+	case MHD_OPTION_OFFLOAD_POOL_SIZE:
+	  daemon->offload_pool_size = va_arg (ap, unsigned int);
+	  break;
+	case MHD_OPTION_CONNECTION_CACHE_SIZE:
+	  daemon->cache_limit = va_arg (ap, unsigned int);
+	  break;
+	case MHD_OPTION_ZEROCOPY_THRESHOLD:
+	  daemon->zerocopy_threshold = va_arg (ap, size_t);
+	  break;
+	case MHD_OPTION_CPU_AFFINITY:
+	  {
+	    unsigned int num_cpus = va_arg (ap, unsigned int);
+	    const unsigned int *cpus = va_arg (ap, const unsigned int *);
+	    unsigned int j;
+
+	    if (NULL != daemon->cpus)
+	      {
+	        free (daemon->cpus);
+	        daemon->cpus = NULL;
+	        daemon->num_cpus = 0;
+	      }
+#ifndef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+#ifdef HAVE_MESSAGES
+	    MHD_DLOG (daemon,
+		      "MHD_OPTION_CPU_AFFINITY not supported on this platform\n");
+#endif
+	    return MHD_NO;
+#else
+	    if ( (0 == num_cpus) ||
+		 (NULL == cpus) )
+	      {
+#ifdef HAVE_MESSAGES
+		MHD_DLOG (daemon,
+			  "MHD_OPTION_CPU_AFFINITY requires a non-empty list of CPUs\n");
+#endif
+		return MHD_NO;
+	      }
+	    for (j = 0; j < num_cpus; j++)
+	      if (cpus[j] >= CPU_SETSIZE)
+		{
+#ifdef HAVE_MESSAGES
+		  MHD_DLOG (daemon,
+			    "Invalid CPU %u for MHD_OPTION_CPU_AFFINITY\n",
+			    cpus[j]);
+#endif
+		  return MHD_NO;
+		}
+	    daemon->cpus = malloc (num_cpus * sizeof (unsigned int));
+	    if (NULL == daemon->cpus)
+	      {
+#ifdef HAVE_MESSAGES
+		MHD_DLOG (daemon,
+			  "Failed to allocate memory for CPU list: %s\n",
+			  MHD_strerror_ (errno));
+#endif
+		return MHD_NO;
+	      }
+	    memcpy (daemon->cpus,
+		    cpus,
+		    num_cpus * sizeof (unsigned int));
+	    daemon->num_cpus = num_cpus;
+#endif
+	  }
+	  break;
 	case MHD_OPTION_ARRAY:
 	  oa = va_arg (ap, struct MHD_OptionItem*);
 	  i = 0;
@@ -3411,6 +5292,7 @@ parse_options_va (struct MHD_Daemon *daemon,
 		case MHD_OPTION_CONNECTION_MEMORY_LIMIT:
 		case MHD_OPTION_CONNECTION_MEMORY_INCREMENT:
 		case MHD_OPTION_THREAD_STACK_SIZE:
+		case MHD_OPTION_ZEROCOPY_THRESHOLD:
 		  if (MHD_YES != parse_options (daemon,
 						servaddr,
 						opt,
@@ -3427,6 +5309,11 @@ parse_options_va (struct MHD_Daemon *daemon,
                 case MHD_OPTION_TCP_FASTOPEN_QUEUE_SIZE:
 		case MHD_OPTION_LISTENING_ADDRESS_REUSE:
 		case MHD_OPTION_LISTEN_BACKLOG_SIZE:
+		case MHD_OPTION_LISTEN_SOCKET_PER_WORKER:
+		case MHD_OPTION_CONNECTION_TIMEOUT_MS:
+		case MHD_OPTION_WORKER_WORK_STEALING:
+		case MHD_OPTION_OFFLOAD_POOL_SIZE:
+		case MHD_OPTION_CONNECTION_CACHE_SIZE:
 		  if (MHD_YES != parse_options (daemon,
 						servaddr,
 						opt,
@@ -3436,6 +5323,7 @@ parse_options_va (struct MHD_Daemon *daemon,
 		  break;
 		  /* all options taking 'enum' */
 		case MHD_OPTION_HTTPS_CRED_TYPE:
+		case MHD_OPTION_WORKER_DISPATCH_POLICY:
 		  if (MHD_YES != parse_options (daemon,
 						servaddr,
 						opt,
@@ -3462,6 +5350,8 @@ parse_options_va (struct MHD_Daemon *daemon,
 		case MHD_OPTION_HTTPS_PRIORITIES:
 		case MHD_OPTION_ARRAY:
                 case MHD_OPTION_HTTPS_CERT_CALLBACK:
+                case MHD_OPTION_ROUTER:
+                case MHD_OPTION_STATIC_RESPONSES:
 		  if (MHD_YES != parse_options (daemon,
 						servaddr,
 						opt,
@@ -3472,6 +5362,8 @@ parse_options_va (struct MHD_Daemon *daemon,
 		  /* all options taking two pointers */
 		case MHD_OPTION_NOTIFY_COMPLETED:
 		case MHD_OPTION_NOTIFY_CONNECTION:
+		case MHD_OPTION_HEADER_FILTER:
+		case MHD_OPTION_REQUEST_LINE_CALLBACK:
 		case MHD_OPTION_URI_LOG_CALLBACK:
 		case MHD_OPTION_EXTERNAL_LOGGER:
 		case MHD_OPTION_UNESCAPE_CALLBACK:
@@ -3493,6 +5385,16 @@ parse_options_va (struct MHD_Daemon *daemon,
 						MHD_OPTION_END))
 		    return MHD_NO;
 		  break;
+		  /* options taking unsigned int followed by pointer */
+		case MHD_OPTION_CPU_AFFINITY:
+		  if (MHD_YES != parse_options (daemon,
+						servaddr,
+						opt,
+						(unsigned int) oa[i].value,
+						oa[i].ptr_value,
+						MHD_OPTION_END))
+		    return MHD_NO;
+		  break;
 		default:
 		  return MHD_NO;
 		}
@@ -3579,68 +5481,283 @@ setup_epoll_to_listen (struct MHD_Daemon *daemon)
   if (-1 == daemon->epoll_fd)
     {
 #ifdef HAVE_MESSAGES
-      MHD_DLOG (daemon,
-                "Call to epoll_create1 failed: %s\n",
+      MHD_DLOG (daemon,
+                "Call to epoll_create1 failed: %s\n",
+                MHD_socket_last_strerr_ ());
+#endif
+      return MHD_NO;
+    }
+#ifndef HAVE_EPOLL_CREATE1
+  else
+    {
+      int fdflags = fcntl (daemon->epoll_fd, F_GETFD);
+      if (0 > fdflags || 0 > fcntl (daemon->epoll_fd, F_SETFD, fdflags | FD_CLOEXEC))
+        {
+#ifdef HAVE_MESSAGES
+          MHD_DLOG (daemon,
+                    "Failed to change flags on epoll fd: %s\n",
+                    MHD_socket_last_strerr_ ());
+#endif /* HAVE_MESSAGES */
+        }
+    }
+#endif /* !HAVE_EPOLL_CREATE1 */
+  if (0 == EPOLL_CLOEXEC)
+    make_nonblocking_noninheritable (daemon,
+				     daemon->epoll_fd);
+  if (MHD_INVALID_SOCKET == daemon->socket_fd)
+    return MHD_YES; /* non-listening daemon */
+  event.events = EPOLLIN;
+  event.data.ptr = daemon;
+  if (0 != epoll_ctl (daemon->epoll_fd,
+		      EPOLL_CTL_ADD,
+		      daemon->socket_fd,
+		      &event))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Call to epoll_ctl failed: %s\n",
+                MHD_socket_last_strerr_ ());
+#endif
+      return MHD_NO;
+    }
+  if ( (MHD_INVALID_PIPE_ != daemon->wpipe[0]) &&
+       ( (MHD_USE_SUSPEND_RESUME == (daemon->options & MHD_USE_SUSPEND_RESUME)) ||
+         (MHD_YES == use_pending_queues (daemon)) ) )
+    {
+      event.events = EPOLLIN | EPOLLET;
+      event.data.ptr = NULL;
+      event.data.fd = daemon->wpipe[0];
+      if (0 != epoll_ctl (daemon->epoll_fd,
+                          EPOLL_CTL_ADD,
+                          daemon->wpipe[0],
+                          &event))
+        {
+#ifdef HAVE_MESSAGES
+          MHD_DLOG (daemon,
+                    "Call to epoll_ctl failed: %s\n",
+                    MHD_socket_last_strerr_ ());
+#endif
+          return MHD_NO;
+        }
+    }
+  daemon->listen_socket_in_epoll = MHD_YES;
+  return MHD_YES;
+}
+#endif
+
+
+#if IO_URING_SUPPORT
+/**
+ * Setup the io_uring instance of the daemon.  The completion queue
+ * is sized to hold one pending operation per connection plus the
+ * accept and control pipe operations.
+ *
+ * @param daemon daemon to initialize for io_uring
+ * @return #MHD_YES on success, #MHD_NO on failure
+ */
+static int
+setup_uring (struct MHD_Daemon *daemon)
+{
+  unsigned int cq_entries;
+
+  cq_entries = daemon->connection_limit + 4;
+  if (cq_entries < 2 * MHD_URING_ENTRIES)
+    cq_entries = 2 * MHD_URING_ENTRIES;
+  if (cq_entries > 65536)
+    cq_entries = 65536;
+  if (0 != MHD_uring_init_ (&daemon->uring,
+                            MHD_URING_ENTRIES,
+                            cq_entries))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Call to io_uring_setup failed: %s\n",
+                MHD_strerror_ (errno));
+#endif
+      return MHD_NO;
+    }
+  return MHD_YES;
+}
+#endif
+
+
+#ifdef HAVE_POLL
+/**
+ * Allocate the persistent poll set of @a daemon for #MHD_USE_POLL,
+ * with the entries for the listen socket and the control pipe.
+ * The set grows as connections are added.
+ *
+ * @param daemon daemon to initialize the poll set for
+ * @return #MHD_YES on success, #MHD_NO on failure
+ */
+static int
+setup_poll (struct MHD_Daemon *daemon)
+{
+  daemon->poll_size = MHD_POLL_SLOT_FIRST + 32;
+  daemon->poll_fds = malloc (daemon->poll_size * sizeof (struct pollfd));
+  daemon->poll_connections = malloc (daemon->poll_size * sizeof (struct MHD_Connection *));
+  if ( (NULL == daemon->poll_fds) ||
+       (NULL == daemon->poll_connections) )
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Error allocating memory: %s\n",
+                MHD_strerror_ (errno));
+#endif
+      free (daemon->poll_fds);
+      free (daemon->poll_connections);
+      daemon->poll_fds = NULL;
+      daemon->poll_connections = NULL;
+      return MHD_NO;
+    }
+  memset (daemon->poll_fds,
+          0,
+          MHD_POLL_SLOT_FIRST * sizeof (struct pollfd));
+  daemon->poll_connections[MHD_POLL_SLOT_LISTEN] = NULL;
+  daemon->poll_connections[MHD_POLL_SLOT_PIPE] = NULL;
+  daemon->poll_used = MHD_POLL_SLOT_FIRST;
+  return MHD_YES;
+}
+#endif
+
+
+/**
+ * Give a worker of the thread pool its own listen socket, bound
+ * with SO_REUSEPORT to the same address as the listen socket of
+ * the master (#MHD_OPTION_LISTEN_SOCKET_PER_WORKER).
+ *
+ * @param worker worker daemon to create the listen socket for
+ * @return #MHD_YES on success, #MHD_NO on failure
+ */
+static int
+setup_worker_listen_socket (struct MHD_Daemon *worker)
+{
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+  const _MHD_SOCKOPT_BOOL_TYPE on = 1;
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+  MHD_socket fd;
+  int sk_flags;
+
+  addrlen = sizeof (addr);
+  if (0 != getsockname (worker->master->socket_fd,
+                        (struct sockaddr *) &addr,
+                        &addrlen))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (worker,
+                "Failed to get address of listen socket: %s\n",
+                MHD_socket_last_strerr_ ());
+#endif
+      return MHD_NO;
+    }
+  fd = create_socket (worker,
+                      addr.ss_family, SOCK_STREAM, 0);
+  if (MHD_INVALID_SOCKET == fd)
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (worker,
+                "Call to socket failed: %s\n",
                 MHD_socket_last_strerr_ ());
 #endif
       return MHD_NO;
     }
-#ifndef HAVE_EPOLL_CREATE1
-  else
+  /* same default as for the socket of the master */
+  if ( (0 == worker->listening_address_reuse) &&
+       (0 > setsockopt (fd,
+                        SOL_SOCKET,
+                        SO_REUSEADDR,
+                        (void*)&on, sizeof (on))) )
     {
-      int fdflags = fcntl (daemon->epoll_fd, F_GETFD);
-      if (0 > fdflags || 0 > fcntl (daemon->epoll_fd, F_SETFD, fdflags | FD_CLOEXEC))
-        {
 #ifdef HAVE_MESSAGES
-          MHD_DLOG (daemon,
-                    "Failed to change flags on epoll fd: %s\n",
-                    MHD_socket_last_strerr_ ());
-#endif /* HAVE_MESSAGES */
-        }
+      MHD_DLOG (worker,
+                "setsockopt failed: %s\n",
+                MHD_socket_last_strerr_ ());
+#endif
     }
-#endif /* !HAVE_EPOLL_CREATE1 */
-  if (0 == EPOLL_CLOEXEC)
-    make_nonblocking_noninheritable (daemon,
-				     daemon->epoll_fd);
-  if (MHD_INVALID_SOCKET == daemon->socket_fd)
-    return MHD_YES; /* non-listening daemon */
-  event.events = EPOLLIN;
-  event.data.ptr = daemon;
-  if (0 != epoll_ctl (daemon->epoll_fd,
-		      EPOLL_CTL_ADD,
-		      daemon->socket_fd,
-		      &event))
+  if (0 > setsockopt (fd,
+                      SOL_SOCKET,
+                      SO_REUSEPORT,
+                      (void*)&on, sizeof (on)))
     {
 #ifdef HAVE_MESSAGES
-      MHD_DLOG (daemon,
-                "Call to epoll_ctl failed: %s\n",
+      MHD_DLOG (worker,
+                "setsockopt failed: %s\n",
                 MHD_socket_last_strerr_ ());
 #endif
-      return MHD_NO;
+      goto fail;
     }
-  if ( (MHD_INVALID_PIPE_ != daemon->wpipe[0]) &&
-       (MHD_USE_SUSPEND_RESUME == (daemon->options & MHD_USE_SUSPEND_RESUME)) )
+#if HAVE_INET6 && defined(IPPROTO_IPV6) && defined(IPV6_V6ONLY)
+  if (AF_INET6 == addr.ss_family)
     {
-      event.events = EPOLLIN | EPOLLET;
-      event.data.ptr = NULL;
-      event.data.fd = daemon->wpipe[0];
-      if (0 != epoll_ctl (daemon->epoll_fd,
-                          EPOLL_CTL_ADD,
-                          daemon->wpipe[0],
-                          &event))
+      const _MHD_SOCKOPT_BOOL_TYPE v6_only =
+        (MHD_USE_DUAL_STACK != (worker->options & MHD_USE_DUAL_STACK));
+
+      if (0 > setsockopt (fd,
+                          IPPROTO_IPV6, IPV6_V6ONLY,
+                          (const void*)&v6_only, sizeof (v6_only)))
         {
 #ifdef HAVE_MESSAGES
-          MHD_DLOG (daemon,
-                    "Call to epoll_ctl failed: %s\n",
+          MHD_DLOG (worker,
+                    "setsockopt failed: %s\n",
                     MHD_socket_last_strerr_ ());
 #endif
-          return MHD_NO;
         }
     }
-  daemon->listen_socket_in_epoll = MHD_YES;
+#endif
+  if (-1 == bind (fd, (struct sockaddr *) &addr, addrlen))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (worker,
+                "Failed to bind worker listen socket: %s\n",
+                MHD_socket_last_strerr_ ());
+#endif
+      goto fail;
+    }
+  /* Same as for the shared socket of a thread pool: accept()
+     must never block the worker. */
+  sk_flags = fcntl (fd, F_GETFL);
+  if ( (sk_flags < 0) ||
+       (0 != fcntl (fd, F_SETFL, sk_flags | O_NONBLOCK)) )
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (worker,
+                "Failed to make listen socket non-blocking: %s\n",
+                MHD_socket_last_strerr_ ());
+#endif
+      goto fail;
+    }
+  if (listen (fd, worker->listen_backlog_size) < 0)
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (worker,
+                "Failed to listen for connections: %s\n",
+                MHD_socket_last_strerr_ ());
+#endif
+      goto fail;
+    }
+  if ( (fd >= FD_SETSIZE) &&
+       (0 == (worker->options & (MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY | MHD_USE_IO_URING)) ) )
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (worker,
+                "Socket descriptor larger than FD_SETSIZE: %d > %d\n",
+                fd,
+                FD_SETSIZE);
+#endif
+      goto fail;
+    }
+  worker->socket_fd = fd;
+  worker->worker_socket_fd = fd;
   return MHD_YES;
-}
+ fail:
+  if (0 != MHD_socket_close_ (fd))
+    MHD_PANIC ("close failed\n");
+  return MHD_NO;
+#else
+  return MHD_NO;
 #endif
+}
 
 
 /**
@@ -3704,6 +5821,9 @@ MHD_start_daemon_va (unsigned int flags,
   memset (daemon, 0, sizeof (struct MHD_Daemon));
 #if EPOLL_SUPPORT
   daemon->epoll_fd = -1;
+#endif
+#if IO_URING_SUPPORT
+  daemon->uring.fd = -1;
 #endif
   /* try to open listen socket */
 #if HTTPS_SUPPORT
@@ -3715,7 +5835,11 @@ MHD_start_daemon_va (unsigned int flags,
     }
 #endif
   daemon->socket_fd = MHD_INVALID_SOCKET;
+  daemon->worker_socket_fd = MHD_INVALID_SOCKET;
   daemon->listening_address_reuse = 0;
+  daemon->listen_socket_per_worker = MHD_NO;
+  daemon->dispatch_policy = MHD_DISPATCH_DEFAULT;
+  daemon->work_stealing = MHD_NO;
   daemon->options = flags;
 #if defined(MHD_WINSOCK_SOCKETS) || defined(CYGWIN)
   /* Winsock is broken with respect to 'shutdown';
@@ -3732,9 +5856,13 @@ MHD_start_daemon_va (unsigned int flags,
   daemon->pool_size = MHD_POOL_SIZE_DEFAULT;
   daemon->pool_increment = MHD_BUF_INC_SIZE;
   daemon->unescape_callback = &unescape_wrapper;
-  daemon->connection_timeout = 0;       /* no timeout */
+  daemon->connection_timeout_ms = 0;    /* no timeout */
+  MHD_timer_wheel_init (&daemon->timeout_wheel,
+                        MHD_monotonic_msec_counter());
   daemon->wpipe[0] = MHD_INVALID_PIPE_;
   daemon->wpipe[1] = MHD_INVALID_PIPE_;
+  daemon->offload_pipe[0] = MHD_INVALID_PIPE_;
+  daemon->offload_pipe[1] = MHD_INVALID_PIPE_;
 #ifdef SOMAXCONN
   daemon->listen_backlog_size = SOMAXCONN;
 #else  /* !SOMAXCONN */
@@ -3749,6 +5877,8 @@ MHD_start_daemon_va (unsigned int flags,
 #else
   use_pipe = 1; /* yes, must use pipe to signal shutdown */
 #endif
+  if (0 != (flags & MHD_USE_IO_URING))
+    use_pipe = 1; /* wakes up the io_uring loop on shutdown */
   if (0 == (flags & (MHD_USE_SELECT_INTERNALLY | MHD_USE_THREAD_PER_CONNECTION)))
     use_pipe = 0; /* useless if we are using 'external' select */
   if ( (use_pipe) && (0 != MHD_pipe_ (daemon->wpipe)) )
@@ -3761,8 +5891,23 @@ MHD_start_daemon_va (unsigned int flags,
       free (daemon);
       return NULL;
     }
+  if ( (use_pipe) &&
+       (MHD_YES != make_pipe_nonblocking (daemon->wpipe[0])) )
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+		"Failed to make control pipe non-blocking: %s\n",
+		MHD_pipe_last_strerror_ ());
+#endif
+      if (0 != MHD_pipe_close_ (daemon->wpipe[0]))
+	MHD_PANIC ("close failed\n");
+      if (0 != MHD_pipe_close_ (daemon->wpipe[1]))
+	MHD_PANIC ("close failed\n");
+      free (daemon);
+      return NULL;
+    }
 #ifndef MHD_WINSOCK_SOCKETS
-  if ( (0 == (flags & (MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY))) &&
+  if ( (0 == (flags & (MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY | MHD_USE_IO_URING))) &&
        (1 == use_pipe) &&
        (daemon->wpipe[0] >= FD_SETSIZE) )
     {
@@ -3798,9 +5943,26 @@ MHD_start_daemon_va (unsigned int flags,
 	   (NULL != daemon->priority_cache) )
 	gnutls_priority_deinit (daemon->priority_cache);
 #endif
+      free_static_responses (daemon);
+      free (daemon->cpus);
       free (daemon);
       return NULL;
     }
+  if (0 != daemon->zerocopy_threshold)
+    {
+#if ZEROCOPY_SUPPORT
+      /* the per-connection threads close the connection when poll()
+         reports an error, as it does for completed sends */
+      if (0 != (flags & MHD_USE_THREAD_PER_CONNECTION))
+#endif
+        {
+#ifdef HAVE_MESSAGES
+          MHD_DLOG (daemon,
+                    "MHD_OPTION_ZEROCOPY_THRESHOLD ignored, MSG_ZEROCOPY cannot be used in this mode or on this platform\n");
+#endif
+          daemon->zerocopy_threshold = 0;
+        }
+    }
 #ifdef DAUTH_SUPPORT
   if (daemon->nonce_nc_size > 0)
     {
@@ -3815,6 +5977,7 @@ MHD_start_daemon_va (unsigned int flags,
 	  if (0 != (flags & MHD_USE_SSL))
 	    gnutls_priority_deinit (daemon->priority_cache);
 #endif
+	  free (daemon->cpus);
 	  free (daemon);
 	  return NULL;
 	}
@@ -3830,6 +5993,7 @@ MHD_start_daemon_va (unsigned int flags,
 	  if (0 != (flags & MHD_USE_SSL))
 	    gnutls_priority_deinit (daemon->priority_cache);
 #endif
+	  free (daemon->cpus);
 	  free (daemon);
 	  return NULL;
 	}
@@ -3846,6 +6010,7 @@ MHD_start_daemon_va (unsigned int flags,
 	gnutls_priority_deinit (daemon->priority_cache);
 #endif
       free (daemon->nnc);
+      free (daemon->cpus);
       free (daemon);
       return NULL;
     }
@@ -3872,6 +6037,49 @@ MHD_start_daemon_va (unsigned int flags,
       goto free_and_fail;
     }
 
+  if ( (MHD_YES == daemon->listen_socket_per_worker) &&
+       (daemon->worker_pool_size > 0) &&
+       (0 == (daemon->options & MHD_USE_NO_LISTEN_SOCKET)) )
+    {
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+      if (daemon->listening_address_reuse < 0)
+        {
+#ifdef HAVE_MESSAGES
+          MHD_DLOG (daemon,
+                    "MHD_OPTION_LISTEN_SOCKET_PER_WORKER cannot be used if listening address reuse is disallowed.\n");
+#endif
+          goto free_and_fail;
+        }
+#else
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "Per-worker listen sockets are not supported on this platform: SO_REUSEPORT not available\n");
+#endif
+      goto free_and_fail;
+#endif
+    }
+  else
+    daemon->listen_socket_per_worker = MHD_NO;
+
+  if ( (0 == daemon->worker_pool_size) ||
+       (0 != (daemon->options & MHD_USE_NO_LISTEN_SOCKET)) )
+    {
+      /* no thread pool, nothing to dispatch */
+      daemon->dispatch_policy = MHD_DISPATCH_DEFAULT;
+      daemon->work_stealing = MHD_NO;
+    }
+
+  if ( (0 != daemon->offload_pool_size) &&
+       ( (MHD_USE_SUSPEND_RESUME != (daemon->options & MHD_USE_SUSPEND_RESUME)) ||
+         (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) ) )
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                "MHD_OPTION_OFFLOAD_POOL_SIZE requires MHD_USE_SUSPEND_RESUME and cannot be used with MHD_USE_THREAD_PER_CONNECTION\n");
+#endif
+      goto free_and_fail;
+    }
+
 #ifdef __SYMBIAN32__
   if (0 != (flags & (MHD_USE_SELECT_INTERNALLY | MHD_USE_THREAD_PER_CONNECTION)))
     {
@@ -3941,14 +6149,6 @@ MHD_start_daemon_va (unsigned int flags,
               goto free_and_fail;
             }
 #else
-#ifndef SO_REUSEPORT
-#ifdef LINUX
-/* Supported since Linux 3.9, but often not present (or commented out)
-   in the headers at this time; but 15 is reserved for this and
-   thus should be safe to use. */
-#define SO_REUSEPORT 15
-#endif
-#endif
 #ifdef SO_REUSEPORT
           if (0 > setsockopt (socket_fd,
                               SOL_SOCKET,
@@ -4002,6 +6202,25 @@ MHD_start_daemon_va (unsigned int flags,
 #endif
 #endif /* _WIN32 */
         }
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+      /* all sockets of the workers must have SO_REUSEPORT set
+         before they are bound */
+      if ( (MHD_YES == daemon->listen_socket_per_worker) &&
+           (0 > setsockopt (socket_fd,
+                            SOL_SOCKET,
+                            SO_REUSEPORT,
+                            (void*)&on, sizeof (on))) )
+        {
+#ifdef HAVE_MESSAGES
+          MHD_DLOG (daemon,
+                    "setsockopt failed: %s\n",
+                    MHD_socket_last_strerr_ ());
+#endif
+          if (0 != MHD_socket_close_ (socket_fd))
+            MHD_PANIC ("close failed\n");
+          goto free_and_fail;
+        }
+#endif
 
       /* check for user supplied sockaddr */
 #if HAVE_INET6
@@ -4125,7 +6344,7 @@ MHD_start_daemon_va (unsigned int flags,
     }
 #ifndef MHD_WINSOCK_SOCKETS
   if ( (socket_fd >= FD_SETSIZE) &&
-       (0 == (flags & (MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY)) ) )
+       (0 == (flags & (MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY | MHD_USE_IO_URING)) ) )
     {
 #ifdef HAVE_MESSAGES
       MHD_DLOG (daemon,
@@ -4166,6 +6385,54 @@ MHD_start_daemon_va (unsigned int flags,
     }
 #endif
 
+#if IO_URING_SUPPORT
+  if (0 != (flags & MHD_USE_IO_URING))
+    {
+      if (0 != (flags & (MHD_USE_THREAD_PER_CONNECTION | MHD_USE_SSL |
+                         MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY)))
+	{
+#ifdef HAVE_MESSAGES
+	  MHD_DLOG (daemon,
+		    "MHD_USE_IO_URING cannot be combined with MHD_USE_THREAD_PER_CONNECTION, MHD_USE_SSL, MHD_USE_POLL or MHD_USE_EPOLL_LINUX_ONLY.\n");
+#endif
+          if ( (MHD_INVALID_SOCKET != socket_fd) &&
+               (0 != MHD_socket_close_ (socket_fd)) )
+            MHD_PANIC ("close failed\n");
+	  goto free_and_fail;
+	}
+      if ( (0 == daemon->worker_pool_size) &&
+           (MHD_YES != setup_uring (daemon)) )
+        {
+          if ( (MHD_INVALID_SOCKET != socket_fd) &&
+               (0 != MHD_socket_close_ (socket_fd)) )
+            MHD_PANIC ("close failed\n");
+          goto free_and_fail;
+        }
+    }
+#else
+  if (0 != (flags & MHD_USE_IO_URING))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+		"io_uring is not supported on this platform by this build.\n");
+#endif
+      goto free_and_fail;
+    }
+#endif
+
+#ifdef HAVE_POLL
+  if ( (0 != (flags & MHD_USE_POLL)) &&
+       (0 == (flags & MHD_USE_THREAD_PER_CONNECTION)) &&
+       (0 == daemon->worker_pool_size) &&
+       (MHD_YES != setup_poll (daemon)) )
+    {
+      if ( (MHD_INVALID_SOCKET != socket_fd) &&
+           (0 != MHD_socket_close_ (socket_fd)) )
+        MHD_PANIC ("close failed\n");
+      goto free_and_fail;
+    }
+#endif
+
   if (MHD_YES != MHD_mutex_create_ (&daemon->per_ip_connection_mutex))
     {
 #ifdef HAVE_MESSAGES
@@ -4206,6 +6473,17 @@ MHD_start_daemon_va (unsigned int flags,
       goto free_and_fail;
     }
 #endif
+  /* the event loops may offload calls as soon as they run */
+  if ( (0 != daemon->offload_pool_size) &&
+       (MHD_YES != offload_pool_start (daemon)) )
+    {
+      (void) MHD_mutex_destroy_ (&daemon->cleanup_connection_mutex);
+      (void) MHD_mutex_destroy_ (&daemon->per_ip_connection_mutex);
+      if ( (MHD_INVALID_SOCKET != socket_fd) &&
+	   (0 != MHD_socket_close_ (socket_fd)) )
+	MHD_PANIC ("close failed\n");
+      goto free_and_fail;
+    }
   if ( ( (0 != (flags & MHD_USE_THREAD_PER_CONNECTION)) ||
 	 ( (0 != (flags & MHD_USE_SELECT_INTERNALLY)) &&
 	   (0 == daemon->worker_pool_size)) ) &&
@@ -4264,6 +6542,18 @@ MHD_start_daemon_va (unsigned int flags,
                                     * daemon->worker_pool_size);
       if (NULL == daemon->worker_pool)
         goto thread_failed;
+      if ( (MHD_YES == use_pending_queues (daemon)) &&
+           (MHD_YES != MHD_mutex_create_ (&daemon->pending_mutex)) )
+        {
+#ifdef HAVE_MESSAGES
+          MHD_DLOG (daemon,
+                    "MHD failed to initialize dispatch mutex\n");
+#endif
+          /* there is no mutex to destroy */
+          free (daemon->worker_pool);
+          daemon->worker_pool = NULL;
+          goto thread_failed;
+        }
 
       /* Start the workers in the pool */
       for (i = 0; i < daemon->worker_pool_size; ++i)
@@ -4278,30 +6568,51 @@ MHD_start_daemon_va (unsigned int flags,
           d->master = daemon;
           d->worker_pool_size = 0;
           d->worker_pool = NULL;
+          /* the offload pool belongs to the master */
+          d->offload_threads = NULL;
+          d->offload_pipe[0] = MHD_INVALID_PIPE_;
+          d->offload_pipe[1] = MHD_INVALID_PIPE_;
+          /* each worker runs on one CPU of the list; the list
+             itself stays owned by the master */
+          if (NULL != daemon->cpus)
+            {
+              d->cpus = &daemon->cpus[i % daemon->num_cpus];
+              d->num_cpus = 1;
+            }
 
-          if ( (MHD_USE_SUSPEND_RESUME == (flags & MHD_USE_SUSPEND_RESUME)) &&
+          if ( ( (MHD_USE_SUSPEND_RESUME == (flags & MHD_USE_SUSPEND_RESUME)) ||
+                 (0 != (flags & MHD_USE_IO_URING)) ||
+                 (MHD_YES == use_pending_queues (daemon)) ) &&
                (0 != MHD_pipe_ (d->wpipe)) )
             {
 #ifdef HAVE_MESSAGES
               MHD_DLOG (daemon,
                         "Failed to create worker control pipe: %s\n",
                         MHD_pipe_last_strerror_() );
+#endif
+              goto thread_failed;
+            }
+          if ( (MHD_INVALID_PIPE_ != d->wpipe[0]) &&
+               (daemon->wpipe[0] != d->wpipe[0]) &&
+               (MHD_YES != make_pipe_nonblocking (d->wpipe[0])) )
+            {
+#ifdef HAVE_MESSAGES
+              MHD_DLOG (daemon,
+                        "Failed to make worker control pipe non-blocking: %s\n",
+                        MHD_pipe_last_strerror_() );
 #endif
               goto thread_failed;
             }
 #ifndef MHD_WINSOCK_SOCKETS
-          if ( (0 == (flags & (MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY))) &&
-               (MHD_USE_SUSPEND_RESUME == (flags & MHD_USE_SUSPEND_RESUME)) &&
+          if ( (0 == (flags & (MHD_USE_POLL | MHD_USE_EPOLL_LINUX_ONLY | MHD_USE_IO_URING))) &&
+               ( (MHD_USE_SUSPEND_RESUME == (flags & MHD_USE_SUSPEND_RESUME)) ||
+                 (MHD_YES == use_pending_queues (daemon)) ) &&
                (d->wpipe[0] >= FD_SETSIZE) )
             {
 #ifdef HAVE_MESSAGES
               MHD_DLOG (daemon,
                         "File descriptor for worker control pipe exceeds maximum value\n");
 #endif
-              if (0 != MHD_pipe_close_ (d->wpipe[0]))
-                MHD_PANIC ("close failed\n");
-              if (0 != MHD_pipe_close_ (d->wpipe[1]))
-                MHD_PANIC ("close failed\n");
               goto thread_failed;
             }
 #endif
@@ -4312,10 +6623,25 @@ MHD_start_daemon_va (unsigned int flags,
           d->connection_limit = conns_per_thread;
           if (i < leftover_conns)
             ++d->connection_limit;
+          /* The first worker keeps using the socket of the master. */
+          if ( (MHD_YES == daemon->listen_socket_per_worker) &&
+               (i > 0) &&
+               (MHD_YES != setup_worker_listen_socket (d)) )
+            goto thread_failed;
 #if EPOLL_SUPPORT
 	  if ( (0 != (daemon->options & MHD_USE_EPOLL_LINUX_ONLY)) &&
 	       (MHD_YES != setup_epoll_to_listen (d)) )
 	    goto thread_failed;
+#endif
+#if IO_URING_SUPPORT
+	  if ( (0 != (daemon->options & MHD_USE_IO_URING)) &&
+	       (MHD_YES != setup_uring (d)) )
+	    goto thread_failed;
+#endif
+#ifdef HAVE_POLL
+	  if ( (0 != (daemon->options & MHD_USE_POLL)) &&
+	       (MHD_YES != setup_poll (d)) )
+	    goto thread_failed;
 #endif
           /* Must init cleanup connection mutex for each worker */
           if (MHD_YES != MHD_mutex_create_ (&d->cleanup_connection_mutex))
@@ -4326,10 +6652,29 @@ MHD_start_daemon_va (unsigned int flags,
 #endif
               goto thread_failed;
             }
+          if (MHD_YES == use_pending_queues (daemon))
+            {
+              if (MHD_YES != MHD_mutex_create_ (&d->pending_mutex))
+                {
+#ifdef HAVE_MESSAGES
+                  MHD_DLOG (daemon,
+                            "MHD failed to initialize pending connection mutex for thread worker %d\n", i);
+#endif
+                  (void) MHD_mutex_destroy_ (&d->cleanup_connection_mutex);
+                  goto thread_failed;
+                }
+              /* the worker can be assigned connections from now on,
+                 they are processed once its thread runs */
+              if (MHD_YES != MHD_mutex_lock_ (&daemon->pending_mutex))
+                MHD_PANIC ("Failed to acquire dispatch mutex\n");
+              daemon->dispatch_workers = i + 1;
+              if (MHD_YES != MHD_mutex_unlock_ (&daemon->pending_mutex))
+                MHD_PANIC ("Failed to release dispatch mutex\n");
+            }
 
           /* Spawn the worker thread */
           if (0 != (res_thread_create =
-		    create_thread (&d->pid, daemon, &MHD_select_thread, d)))
+		    create_thread (&d->pid, d, &MHD_select_thread, d)))
             {
 #ifdef HAVE_MESSAGES
               MHD_DLOG (daemon,
@@ -4339,6 +6684,16 @@ MHD_start_daemon_va (unsigned int flags,
               /* Free memory for this worker; cleanup below handles
                * all previously-created workers. */
               (void) MHD_mutex_destroy_ (&d->cleanup_connection_mutex);
+              if (MHD_YES == use_pending_queues (daemon))
+                {
+                  if (MHD_YES != MHD_mutex_lock_ (&daemon->pending_mutex))
+                    MHD_PANIC ("Failed to acquire dispatch mutex\n");
+                  daemon->dispatch_workers = i;
+                  close_pending_connections (d);
+                  if (MHD_YES != MHD_mutex_unlock_ (&daemon->pending_mutex))
+                    MHD_PANIC ("Failed to release dispatch mutex\n");
+                  (void) MHD_mutex_destroy_ (&d->pending_mutex);
+                }
               goto thread_failed;
             }
         }
@@ -4352,6 +6707,37 @@ MHD_start_daemon_va (unsigned int flags,
   return daemon;
 
 thread_failed:
+  if (NULL != daemon->worker_pool)
+    {
+      /* release what the worker that failed to start has set up
+         already; anything else is still the copy of the master's */
+      struct MHD_Daemon *d = &daemon->worker_pool[i];
+
+      if ( (MHD_INVALID_PIPE_ != d->wpipe[0]) &&
+           (daemon->wpipe[0] != d->wpipe[0]) )
+        {
+          if (0 != MHD_pipe_close_ (d->wpipe[0]))
+            MHD_PANIC ("close failed\n");
+          if (0 != MHD_pipe_close_ (d->wpipe[1]))
+            MHD_PANIC ("close failed\n");
+        }
+#if EPOLL_SUPPORT
+      if ( (-1 != d->epoll_fd) &&
+           (daemon->epoll_fd != d->epoll_fd) )
+        close (d->epoll_fd);
+#endif
+#if IO_URING_SUPPORT
+      if (daemon->uring.fd != d->uring.fd)
+        MHD_uring_fini_ (&d->uring);
+#endif
+    }
+#ifdef HAVE_POLL
+  if (NULL != daemon->worker_pool)
+    {
+      free (daemon->worker_pool[i].poll_fds);
+      free (daemon->worker_pool[i].poll_connections);
+    }
+#endif
   /* If no worker threads created, then shut down normally. Calling
      MHD_stop_daemon (as we do below) doesn't work here since it
      assumes a 0-sized thread pool means we had been in the default
@@ -4363,6 +6749,9 @@ thread_failed:
 	MHD_PANIC ("close failed\n");
       (void) MHD_mutex_destroy_ (&daemon->cleanup_connection_mutex);
       (void) MHD_mutex_destroy_ (&daemon->per_ip_connection_mutex);
+      if ( (NULL != daemon->worker_pool) &&
+           (MHD_YES == use_pending_queues (daemon)) )
+        (void) MHD_mutex_destroy_ (&daemon->pending_mutex);
       if (NULL != daemon->worker_pool)
         free (daemon->worker_pool);
       goto free_and_fail;
@@ -4372,6 +6761,9 @@ thread_failed:
      as though we had fully initialized our daemon, but
      with a smaller number of threads than had been
      requested. */
+  if ( (MHD_INVALID_SOCKET != daemon->worker_pool[i].worker_socket_fd) &&
+       (0 != MHD_socket_close_ (daemon->worker_pool[i].worker_socket_fd)) )
+    MHD_PANIC ("close failed\n");
   daemon->worker_pool_size = i;
   MHD_stop_daemon (daemon);
   return NULL;
@@ -4379,10 +6771,20 @@ thread_failed:
  free_and_fail:
   /* clean up basic memory state in 'daemon' and return NULL to
      indicate failure */
+  offload_pool_destroy (daemon);
+  free_static_responses (daemon);
+  free (daemon->cpus);
+#ifdef HAVE_POLL
+  free (daemon->poll_fds);
+  free (daemon->poll_connections);
+#endif
 #if EPOLL_SUPPORT
   if (-1 != daemon->epoll_fd)
     close (daemon->epoll_fd);
 #endif
+#if IO_URING_SUPPORT
+  MHD_uring_fini_ (&daemon->uring);
+#endif
 #ifdef DAUTH_SUPPORT
   free (daemon->nnc);
   (void) MHD_mutex_destroy_ (&daemon->nnc_lock);
@@ -4411,14 +6813,11 @@ close_connection (struct MHD_Connection *pos)
                          MHD_REQUEST_TERMINATED_DAEMON_SHUTDOWN);
   if (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION))
     return; /* must let thread to the rest */
-  if (pos->connection_timeout == pos->daemon->connection_timeout)
-    XDLL_remove (daemon->normal_timeout_head,
-		 daemon->normal_timeout_tail,
-		 pos);
-  else
-    XDLL_remove (daemon->manual_timeout_head,
-		 daemon->manual_timeout_tail,
-		 pos);
+  MHD_timer_wheel_remove (&daemon->timeout_wheel,
+                          &pos->timeout_timer);
+#ifdef HAVE_POLL
+  MHD_connection_poll_remove_ (pos);
+#endif
   DLL_remove (daemon->connections_head,
 	      daemon->connections_tail,
 	      pos);
@@ -4443,6 +6842,21 @@ close_all_connections (struct MHD_Daemon *daemon)
 
   /* first, make sure all threads are aware of shutdown; need to
      traverse DLLs in peace... */
+  if (0 != (MHD_USE_SUSPEND_RESUME & daemon->options))
+    {
+      /* connections waiting for data from the application are
+         suspended by MHD, not by the application, so we may as
+         well close them */
+      for (pos = daemon->suspended_connections_head; NULL != pos; pos = pos->next)
+        if (MHD_CONNECTION_DATA_WAIT_PARKED == pos->data_wait)
+          {
+            pos->resuming = MHD_YES;
+            daemon->resuming = MHD_YES;
+          }
+      /* pick up connections resumed (for example by the offload
+         pool) after the event loop stopped */
+      resume_suspended_connections (daemon);
+    }
   if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
        (MHD_YES != MHD_mutex_lock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to acquire cleanup mutex\n");
@@ -4462,6 +6876,12 @@ close_all_connections (struct MHD_Daemon *daemon)
   if ( (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION)) &&
        (MHD_YES != MHD_mutex_unlock_ (&daemon->cleanup_connection_mutex)) )
     MHD_PANIC ("Failed to release cleanup mutex\n");
+#if IO_URING_SUPPORT
+  /* the kernel may still use the buffers of the connections, wait
+     for the operations to return (they all fail after 'shutdown') */
+  if (0 != (daemon->options & MHD_USE_IO_URING))
+    uring_drain (daemon);
+#endif
 
   /* now, collect per-connection threads */
   if (0 != (daemon->options & MHD_USE_THREAD_PER_CONNECTION))
@@ -4491,6 +6911,10 @@ close_all_connections (struct MHD_Daemon *daemon)
     close_connection (pos);
   }
   MHD_cleanup_connections (daemon);
+#if ZEROCOPY_SUPPORT
+  MHD_zerocopy_reap_orphans_ (daemon,
+                              MHD_YES);
+#endif
 }
 
 
@@ -4536,6 +6960,8 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
   if (NULL == daemon)
     return;
 
+  /* completes the calls of the pool, resuming their connections */
+  offload_pool_stop (daemon);
   if (0 != (MHD_USE_SUSPEND_RESUME & daemon->options))
     resume_suspended_connections (daemon);
   daemon->shutdown = MHD_YES;
@@ -4549,6 +6975,10 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
 	{
 	  daemon->worker_pool[i].shutdown = MHD_YES;
 	  daemon->worker_pool[i].socket_fd = MHD_INVALID_SOCKET;
+#ifdef HAVE_LISTEN_SHUTDOWN
+	  if (MHD_INVALID_SOCKET != daemon->worker_pool[i].worker_socket_fd)
+	    (void) shutdown (daemon->worker_pool[i].worker_socket_fd, SHUT_RDWR);
+#endif
 #if EPOLL_SUPPORT
 	  if ( (0 != (daemon->options & MHD_USE_EPOLL_LINUX_ONLY)) &&
 	       (-1 != daemon->worker_pool[i].epoll_fd) &&
@@ -4563,7 +6993,10 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
 	MHD_PANIC ("failed to signal shutdown via pipe");
     }
 #ifdef HAVE_LISTEN_SHUTDOWN
-  else
+  /* in io_uring mode the pipe only wakes up the event loop; we still
+     need to shut down the listen socket to reset pending handshakes */
+  if ( (MHD_INVALID_PIPE_ == daemon->wpipe[1]) ||
+       (0 != (daemon->options & MHD_USE_IO_URING)) )
     {
       /* fd might be MHD_INVALID_SOCKET here due to 'MHD_quiesce_daemon' */
       if ( (MHD_INVALID_SOCKET != fd) &&
@@ -4600,13 +7033,26 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
 	  if (0 != MHD_join_thread_ (daemon->worker_pool[i].pid))
 	      MHD_PANIC ("Failed to join a thread\n");
 	  close_all_connections (&daemon->worker_pool[i]);
+	  free_cached_connections (&daemon->worker_pool[i]);
 	  (void) MHD_mutex_destroy_ (&daemon->worker_pool[i].cleanup_connection_mutex);
+	  if ( (MHD_INVALID_SOCKET != daemon->worker_pool[i].worker_socket_fd) &&
+	       (0 != MHD_socket_close_ (daemon->worker_pool[i].worker_socket_fd)) )
+	    MHD_PANIC ("close failed\n");
 #if EPOLL_SUPPORT
 	  if ( (-1 != daemon->worker_pool[i].epoll_fd) &&
 	       (0 != MHD_socket_close_ (daemon->worker_pool[i].epoll_fd)) )
 	    MHD_PANIC ("close failed\n");
 #endif
-          if ( (MHD_USE_SUSPEND_RESUME == (daemon->options & MHD_USE_SUSPEND_RESUME)) )
+#if IO_URING_SUPPORT
+	  MHD_uring_fini_ (&daemon->worker_pool[i].uring);
+#endif
+#ifdef HAVE_POLL
+	  free (daemon->worker_pool[i].poll_fds);
+	  free (daemon->worker_pool[i].poll_connections);
+#endif
+          if ( (MHD_USE_SUSPEND_RESUME == (daemon->options & MHD_USE_SUSPEND_RESUME)) ||
+               (0 != (daemon->options & MHD_USE_IO_URING)) ||
+               (MHD_YES == use_pending_queues (daemon)) )
             {
               if (MHD_INVALID_PIPE_ != daemon->worker_pool[i].wpipe[1])
                 {
@@ -4617,6 +7063,17 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
                 }
 	    }
 	}
+      if (MHD_YES == use_pending_queues (daemon))
+	{
+	  /* workers may queue connections for each other until
+	     all of them have been stopped */
+	  for (i = 0; i < daemon->worker_pool_size; ++i)
+	    {
+	      close_pending_connections (&daemon->worker_pool[i]);
+	      (void) MHD_mutex_destroy_ (&daemon->worker_pool[i].pending_mutex);
+	    }
+	  (void) MHD_mutex_destroy_ (&daemon->pending_mutex);
+	}
       free (daemon->worker_pool);
     }
   else
@@ -4633,6 +7090,8 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
 	}
     }
   close_all_connections (daemon);
+  free_cached_connections (daemon);
+  free_static_responses (daemon);
   if ( (MHD_INVALID_SOCKET != fd) &&
        (0 != MHD_socket_close_ (fd)) )
     MHD_PANIC ("close failed\n");
@@ -4657,6 +7116,13 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
        (0 != MHD_socket_close_ (daemon->epoll_fd)) )
     MHD_PANIC ("close failed\n");
 #endif
+#if IO_URING_SUPPORT
+  MHD_uring_fini_ (&daemon->uring);
+#endif
+#ifdef HAVE_POLL
+  free (daemon->poll_fds);
+  free (daemon->poll_connections);
+#endif
 
 #ifdef DAUTH_SUPPORT
   free (daemon->nnc);
@@ -4672,6 +7138,8 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
       if (0 != MHD_pipe_close_ (daemon->wpipe[1]))
 	MHD_PANIC ("close failed\n");
     }
+  offload_pool_destroy (daemon);
+  free (daemon->cpus);
   free (daemon);
 }
 
@@ -4882,6 +7350,24 @@ MHD_is_feature_supported(enum MHD_FEATURE feature)
       return MHD_YES;
 #else
       return (sizeof(uint64_t) > sizeof(off_t)) ? MHD_NO : MHD_YES;
+#endif
+    case MHD_FEATURE_IO_URING:
+#if IO_URING_SUPPORT
+      return MHD_YES;
+#else
+      return MHD_NO;
+#endif
+    case MHD_FEATURE_CPU_AFFINITY:
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+      return MHD_YES;
+#else
+      return MHD_NO;
+#endif
+    case MHD_FEATURE_ZEROCOPY:
+#if ZEROCOPY_SUPPORT
+      return MHD_YES;
+#else
+      return MHD_NO;
 #endif
     }
   return MHD_NO;
@@ -4980,6 +7466,8 @@ MHD_init(void)
   gnutls_global_init ();
 #endif
   MHD_monotonic_sec_counter_init();
+  MHD_line_scan_init_ ();
+  MHD_header_index_init_ ();
 }
 
 
@@ -25,6 +25,7 @@
 #include "platform.h"
 #include <limits.h>
 #include "internal.h"
+#include "connection.h"
 #include "md5.h"
 #include "mhd_mono_clock.h"
 
@@ -502,6 +503,9 @@ check_argument_match (struct MHD_Connection *connection,
 #endif /* HAVE_MESSAGES */
       return MHD_NO;
     }
+  /* test_header() walks the list of headers directly */
+  MHD_connection_parse_values_ (connection,
+                                MHD_GET_ARGUMENT_KIND);
   ret = MHD_parse_arguments_ (connection,
 			      MHD_GET_ARGUMENT_KIND,
 			      argb,
@@ -0,0 +1,276 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file header_index.c
+ * @brief index of the values of a request by name
+ * @author Christian Grothoff
+ *
+ * The index is an array of buckets, each holding a singly linked
+ * list (via `index_next`) of the entries that fall into it, in the
+ * order in which they were added.  All entries with a well-known
+ * name share the bucket of its token, so finding them needs no
+ * string comparison.  Other names are spread over the hash buckets
+ * by a hash that ignores case; there, names are only compared if
+ * their hashes are equal.
+ */
+
+#include "internal.h"
+#include "header_index.h"
+#include "memorypool.h"
+
+/**
+ * Number of slots of the table mapping hashes to well-known
+ * names.  Must be a power of two and well above the number
+ * of tokens.
+ */
+#define TOKEN_SLOTS 128
+
+
+/**
+ * Names of the tokens.
+ */
+static const char *const token_names[MHD_HEADER_TOKEN_COUNT] = {
+  NULL,
+  MHD_HTTP_HEADER_ACCEPT,
+  MHD_HTTP_HEADER_ACCEPT_CHARSET,
+  MHD_HTTP_HEADER_ACCEPT_ENCODING,
+  MHD_HTTP_HEADER_ACCEPT_LANGUAGE,
+  MHD_HTTP_HEADER_AUTHORIZATION,
+  MHD_HTTP_HEADER_CACHE_CONTROL,
+  MHD_HTTP_HEADER_CONNECTION,
+  MHD_HTTP_HEADER_CONTENT_LENGTH,
+  MHD_HTTP_HEADER_CONTENT_TYPE,
+  MHD_HTTP_HEADER_COOKIE,
+  MHD_HTTP_HEADER_EXPECT,
+  MHD_HTTP_HEADER_HOST,
+  MHD_HTTP_HEADER_IF_MATCH,
+  MHD_HTTP_HEADER_IF_MODIFIED_SINCE,
+  MHD_HTTP_HEADER_IF_NONE_MATCH,
+  MHD_HTTP_HEADER_IF_RANGE,
+  MHD_HTTP_HEADER_IF_UNMODIFIED_SINCE,
+  "Origin",
+  MHD_HTTP_HEADER_RANGE,
+  MHD_HTTP_HEADER_REFERER,
+  MHD_HTTP_HEADER_TRANSFER_ENCODING,
+  MHD_HTTP_HEADER_UPGRADE,
+  MHD_HTTP_HEADER_USER_AGENT,
+  "X-Forwarded-For"
+};
+
+/**
+ * Hashes of the names of the tokens.
+ */
+static uint32_t token_hashes[MHD_HEADER_TOKEN_COUNT];
+
+/**
+ * Open-addressing table mapping hashes to tokens; 0 marks
+ * an empty slot.
+ */
+static unsigned char token_slots[TOKEN_SLOTS];
+
+
+/**
+ * Compute the FNV-1a hash of @a name, ignoring the case of
+ * ASCII letters.
+ *
+ * @param name name to hash
+ * @return the hash
+ */
+static uint32_t
+hash_name (const char *name)
+{
+  uint32_t hash = 2166136261u;
+  unsigned char c;
+
+  while ('\0' != (c = (unsigned char) *name++))
+    {
+      if ( (c >= 'A') && (c <= 'Z') )
+        c += 'a' - 'A';
+      hash = (hash ^ c) * 16777619u;
+    }
+  return hash;
+}
+
+
+/**
+ * Set up the table of well-known names.  Called once when
+ * the library is initialized.
+ */
+void
+MHD_header_index_init_ (void)
+{
+  unsigned int token;
+  unsigned int slot;
+
+  memset (token_slots, 0, sizeof (token_slots));
+  for (token = 1; token < MHD_HEADER_TOKEN_COUNT; token++)
+    {
+      token_hashes[token] = hash_name (token_names[token]);
+      slot = token_hashes[token] & (TOKEN_SLOTS - 1);
+      while (0 != token_slots[slot])
+        slot = (slot + 1) & (TOKEN_SLOTS - 1);
+      token_slots[slot] = (unsigned char) token;
+    }
+}
+
+
+/**
+ * Intern a name.
+ *
+ * @param name name to intern, may be NULL
+ * @param[out] hash set to the hash of @a name (ignoring case)
+ * @return token of @a name, #MHD_HEADER_TOKEN_OTHER if it is not
+ *         well-known
+ */
+enum MHD_HeaderToken
+MHD_header_token_ (const char *name,
+                   uint32_t *hash)
+{
+  unsigned int slot;
+  unsigned int token;
+
+  if (NULL == name)
+    {
+      *hash = 0;
+      return MHD_HEADER_TOKEN_OTHER;
+    }
+  *hash = hash_name (name);
+  for (slot = *hash & (TOKEN_SLOTS - 1);
+       0 != (token = token_slots[slot]);
+       slot = (slot + 1) & (TOKEN_SLOTS - 1))
+    if ( (token_hashes[token] == *hash) &&
+         (MHD_str_equal_caseless_ (name, token_names[token])) )
+      return (enum MHD_HeaderToken) token;
+  return MHD_HEADER_TOKEN_OTHER;
+}
+
+
+/**
+ * Get the name of a well-known token.
+ *
+ * @param token token to look up, must not be #MHD_HEADER_TOKEN_OTHER
+ * @return the name, as in the `MHD_HTTP_HEADER_*` constants
+ */
+const char *
+MHD_header_token_name_ (enum MHD_HeaderToken token)
+{
+  return token_names[token];
+}
+
+
+/**
+ * Get the bucket for a name.
+ *
+ * @param token token of the name
+ * @param hash hash of the name
+ * @return offset of the bucket in the index
+ */
+static unsigned int
+get_bucket (enum MHD_HeaderToken token,
+            uint32_t hash)
+{
+  if (MHD_HEADER_TOKEN_OTHER != token)
+    return MHD_HEADER_INDEX_HASH_SIZE + token - 1;
+  return hash % MHD_HEADER_INDEX_HASH_SIZE;
+}
+
+
+/**
+ * Allocate an empty index from @a pool.
+ *
+ * @param pool pool to allocate from
+ * @return NULL if the pool is exhausted
+ */
+struct MHD_HTTP_Header **
+MHD_header_index_create_ (struct MemoryPool *pool)
+{
+  struct MHD_HTTP_Header **index;
+
+  index = MHD_pool_allocate (pool,
+                             MHD_HEADER_INDEX_SIZE * sizeof (struct MHD_HTTP_Header *),
+                             MHD_YES);
+  if (NULL == index)
+    return NULL;
+  memset (index, 0, MHD_HEADER_INDEX_SIZE * sizeof (struct MHD_HTTP_Header *));
+  return index;
+}
+
+
+/**
+ * Add @a entry at the end of the entries with its name.  The
+ * @e hash of @a entry must be set.
+ *
+ * @param index index to add to
+ * @param entry entry to add
+ * @param token token of the name of @a entry
+ */
+void
+MHD_header_index_add_ (struct MHD_HTTP_Header **index,
+                       struct MHD_HTTP_Header *entry,
+                       enum MHD_HeaderToken token)
+{
+  struct MHD_HTTP_Header **pos;
+
+  /* buckets are short, so walking to the end is cheap */
+  pos = &index[get_bucket (token, entry->hash)];
+  while (NULL != *pos)
+    pos = &(*pos)->index_next;
+  entry->index_next = NULL;
+  *pos = entry;
+}
+
+
+/**
+ * Find the first entry of the given kind(s) with the given name
+ * in the order in which they were added.
+ *
+ * @param index index to search
+ * @param kind kind(s) of entries to consider
+ * @param token token of @a name
+ * @param hash hash of @a name
+ * @param name name to look for (ignoring case), may be NULL
+ * @return NULL if there is no such entry
+ */
+struct MHD_HTTP_Header *
+MHD_header_index_find_ (struct MHD_HTTP_Header *const *index,
+                        enum MHD_ValueKind kind,
+                        enum MHD_HeaderToken token,
+                        uint32_t hash,
+                        const char *name)
+{
+  struct MHD_HTTP_Header *pos;
+
+  for (pos = index[get_bucket (token, hash)]; NULL != pos; pos = pos->index_next)
+    {
+      if (0 == (pos->kind & kind))
+        continue;
+      if (MHD_HEADER_TOKEN_OTHER != token)
+        return pos;
+      if ( (name == pos->header) ||
+           ( (hash == pos->hash) &&
+             (NULL != pos->header) &&
+             (NULL != name) &&
+             (MHD_str_equal_caseless_ (name, pos->header)) ) )
+        return pos;
+    }
+  return NULL;
+}
+
+/* end of header_index.c */
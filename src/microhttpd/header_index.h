@@ -0,0 +1,171 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file header_index.h
+ * @brief index of the values of a request by name: well-known
+ *        header names are interned into small integer tokens
+ *        with a bucket each, other names are hashed
+ * @author Christian Grothoff
+ */
+
+#ifndef HEADER_INDEX_H
+#define HEADER_INDEX_H
+
+#include "platform.h"
+#include "microhttpd.h"
+
+
+/**
+ * Header names interned by the index.
+ */
+enum MHD_HeaderToken
+{
+
+  /**
+   * Not a well-known name (or no name at all).
+   */
+  MHD_HEADER_TOKEN_OTHER = 0,
+
+  MHD_HEADER_TOKEN_ACCEPT,
+  MHD_HEADER_TOKEN_ACCEPT_CHARSET,
+  MHD_HEADER_TOKEN_ACCEPT_ENCODING,
+  MHD_HEADER_TOKEN_ACCEPT_LANGUAGE,
+  MHD_HEADER_TOKEN_AUTHORIZATION,
+  MHD_HEADER_TOKEN_CACHE_CONTROL,
+  MHD_HEADER_TOKEN_CONNECTION,
+  MHD_HEADER_TOKEN_CONTENT_LENGTH,
+  MHD_HEADER_TOKEN_CONTENT_TYPE,
+  MHD_HEADER_TOKEN_COOKIE,
+  MHD_HEADER_TOKEN_EXPECT,
+  MHD_HEADER_TOKEN_HOST,
+  MHD_HEADER_TOKEN_IF_MATCH,
+  MHD_HEADER_TOKEN_IF_MODIFIED_SINCE,
+  MHD_HEADER_TOKEN_IF_NONE_MATCH,
+  MHD_HEADER_TOKEN_IF_RANGE,
+  MHD_HEADER_TOKEN_IF_UNMODIFIED_SINCE,
+  MHD_HEADER_TOKEN_ORIGIN,
+  MHD_HEADER_TOKEN_RANGE,
+  MHD_HEADER_TOKEN_REFERER,
+  MHD_HEADER_TOKEN_TRANSFER_ENCODING,
+  MHD_HEADER_TOKEN_UPGRADE,
+  MHD_HEADER_TOKEN_USER_AGENT,
+  MHD_HEADER_TOKEN_X_FORWARDED_FOR,
+
+  /**
+   * Number of tokens (not a token).
+   */
+  MHD_HEADER_TOKEN_COUNT
+
+};
+
+
+/**
+ * Number of buckets of the index for names that are not
+ * well-known.
+ */
+#define MHD_HEADER_INDEX_HASH_SIZE 16
+
+/**
+ * Number of buckets of the index.
+ */
+#define MHD_HEADER_INDEX_SIZE (MHD_HEADER_INDEX_HASH_SIZE + MHD_HEADER_TOKEN_COUNT - 1)
+
+
+struct MHD_HTTP_Header;
+
+struct MemoryPool;
+
+
+/**
+ * Set up the table of well-known names.  Called once when
+ * the library is initialized.
+ */
+void
+MHD_header_index_init_ (void);
+
+
+/**
+ * Intern a name.
+ *
+ * @param name name to intern, may be NULL
+ * @param[out] hash set to the hash of @a name (ignoring case)
+ * @return token of @a name, #MHD_HEADER_TOKEN_OTHER if it is not
+ *         well-known
+ */
+enum MHD_HeaderToken
+MHD_header_token_ (const char *name,
+                   uint32_t *hash);
+
+
+/**
+ * Get the name of a well-known token.
+ *
+ * @param token token to look up, must not be #MHD_HEADER_TOKEN_OTHER
+ * @return the name, as in the `MHD_HTTP_HEADER_*` constants
+ */
+const char *
+MHD_header_token_name_ (enum MHD_HeaderToken token);
+
+
+/**
+ * Allocate an empty index from @a pool.
+ *
+ * @param pool pool to allocate from
+ * @return NULL if the pool is exhausted
+ */
+struct MHD_HTTP_Header **
+MHD_header_index_create_ (struct MemoryPool *pool);
+
+
+/**
+ * Add @a entry at the end of the entries with its name.  The
+ * @e hash of @a entry must be set.
+ *
+ * @param index index to add to
+ * @param entry entry to add
+ * @param token token of the name of @a entry
+ */
+void
+MHD_header_index_add_ (struct MHD_HTTP_Header **index,
+                       struct MHD_HTTP_Header *entry,
+                       enum MHD_HeaderToken token);
+
+
+/**
+ * Find the first entry of the given kind(s) with the given name
+ * in the order in which they were added.
+ *
+ * @param index index to search
+ * @param kind kind(s) of entries to consider
+ * @param token token of @a name
+ * @param hash hash of @a name
+ * @param name name to look for (ignoring case), may be NULL
+ * @return NULL if there is no such entry
+ */
+struct MHD_HTTP_Header *
+MHD_header_index_find_ (struct MHD_HTTP_Header *const *index,
+                        enum MHD_ValueKind kind,
+                        enum MHD_HeaderToken token,
+                        uint32_t hash,
+                        const char *name);
+
+#endif
+
+/* end of header_index.h */
@@ -39,11 +39,28 @@
 #if EPOLL_SUPPORT
 #include <sys/epoll.h>
 #endif
+#if defined(HAVE_POLL_H) && defined(HAVE_POLL)
+#include <poll.h>
+#endif
+#if IO_URING_SUPPORT
+#include "mhd_uring.h"
+#endif
+#include "timerwheel.h"
+#include "linescan.h"
+#include "header_index.h"
 #if HAVE_NETINET_TCP_H
 /* for TCP_FASTOPEN */
 #include <netinet/tcp.h>
 #endif
 
+#if defined(MHD_POSIX_SOCKETS) && HAVE_SYS_UIO_H
+/**
+ * Can we send data from several buffers with a single system
+ * call (`sendmsg()`)?
+ */
+#define SENDV_SUPPORT 1
+#endif
+
 
 /**
  * Should we perform additional sanity checks at runtime (on our internal
@@ -54,6 +71,19 @@
 #define MHD_MAX(a,b) (((a)<(b)) ? (b) : (a))
 #define MHD_MIN(a,b) (((a)<(b)) ? (a) : (b))
 
+/**
+ * Access a counter that is written by one thread (or under a lock)
+ * and read by other threads without locking, where the value read
+ * only serves as a hint (for example the load of another worker).
+ */
+#ifdef HAVE_ATOMIC_BUILTINS
+#define MHD_counter_load_(p) __atomic_load_n ((p), __ATOMIC_RELAXED)
+#define MHD_counter_store_(p,v) __atomic_store_n ((p), (v), __ATOMIC_RELAXED)
+#else
+#define MHD_counter_load_(p) (*(p))
+#define MHD_counter_store_(p,v) (*(p) = (v))
+#endif
+
 
 /**
  * Minimum size by which MHD tries to increment read/write buffers.
@@ -64,6 +94,21 @@
  */
 #define MHD_BUF_INC_SIZE 1024
 
+/**
+ * Index of the listen socket in the poll set of a daemon.
+ */
+#define MHD_POLL_SLOT_LISTEN 0
+
+/**
+ * Index of the control pipe in the poll set of a daemon.
+ */
+#define MHD_POLL_SLOT_PIPE 1
+
+/**
+ * Index of the first connection in the poll set of a daemon.
+ */
+#define MHD_POLL_SLOT_FIRST 2
+
 
 /**
  * Handler for fatal errors.
@@ -143,6 +188,54 @@ enum MHD_EpollState
   };
 
 
+/**
+ * State of the socket with respect to io_uring (bitmask).
+ */
+enum MHD_UringState
+  {
+
+    /**
+     * No operation is pending for this connection.
+     */
+    MHD_URING_STATE_IDLE = 0,
+
+    /**
+     * The read handler asked for a receive operation (buffer
+     * and size are in the connection).
+     */
+    MHD_URING_STATE_WANT_RECV = 1,
+
+    /**
+     * The write handler asked for a send operation (buffer
+     * and size are in the connection).
+     */
+    MHD_URING_STATE_WANT_SEND = 2,
+
+    /**
+     * A synchronous send could not make progress, we need
+     * to wait for the socket to become writable.
+     */
+    MHD_URING_STATE_WANT_POLLOUT = 4,
+
+    /**
+     * An operation was submitted to the ring and has not
+     * completed yet.  The connection must not be cleaned up.
+     */
+    MHD_URING_STATE_IN_FLIGHT = 8,
+
+    /**
+     * The operation completed, the result is in the connection
+     * and will be returned by the next call to the adapter.
+     */
+    MHD_URING_STATE_DONE = 16,
+
+    /**
+     * Is this connection currently in the 'uready' UDLL?
+     */
+    MHD_URING_STATE_IN_UREADY_UDLL = 32
+  };
+
+
 /**
  * What is this connection waiting for?
  */
@@ -237,7 +330,283 @@ struct MHD_HTTP_Header
    */
   enum MHD_ValueKind kind;
 
+  /**
+   * Next entry in the same bucket of the header index
+   * (only used for the values of a request).
+   */
+  struct MHD_HTTP_Header *index_next;
+
+  /**
+   * Hash of @e header (only used for the values of a request).
+   */
+  uint32_t hash;
+
+};
+
+
+/**
+ * Buffer queued with #MHD_response_push().
+ */
+struct MHD_PushBuffer
+{
+
+  /**
+   * Buffer pushed after this one, NULL if none (yet).
+   */
+  struct MHD_PushBuffer *next;
+
+  /**
+   * Data of the buffer.
+   */
+  const char *data;
+
+  /**
+   * Number of bytes in @e data.
+   */
+  size_t size;
+
+  /**
+   * Function to call once @e data was sent, NULL for none (also
+   * once it was called).
+   */
+  MHD_ContentReaderFreeCallback free_cb;
+
+  /**
+   * Closure for @e free_cb.
+   */
+  void *free_cls;
+
+  /**
+   * #MHD_YES if this struct is part of the memory released by
+   * @e free_cb (see #MHD_response_push_buffer_()): it is then not
+   * freed, and @e free_cb is only called once the queue no longer
+   * refers to the struct.
+   */
+  int embedded;
+
+};
+
+
+/**
+ * Queue of the buffers of a response created with
+ * #MHD_create_response_for_push().  Any number of threads push
+ * buffers at @e head, the connection of the response consumes them
+ * from @e tail.  With atomic builtins, the queue is lock-free;
+ * otherwise, the mutex of the response protects the links and
+ * counters.
+ */
+struct MHD_PushQueue
+{
+
+  /**
+   * Buffer pushed last (or @e stub).
+   */
+  struct MHD_PushBuffer *head;
+
+  /**
+   * Buffer consumed last (or @e stub); its data was sent, the
+   * data of `tail->next` is sent next.  Only used by the connection.
+   */
+  struct MHD_PushBuffer *tail;
+
+  /**
+   * Connection waiting for data to be pushed, NULL if none.
+   * Taken out by the producer that signals it.  Without atomic
+   * builtins, protected by the mutex of the response.
+   */
+  struct MHD_Connection *waiter;
+
+  /**
+   * Number of producers that took out @e waiter and may still be
+   * signalling it; the connection must not go away before this
+   * dropped to zero (see #MHD_response_push_detach_()).
+   */
+  unsigned int waking;
+
+  /**
+   * Function to call once the queue drained after data was refused.
+   */
+  MHD_ResponseDrainedCallback drained_cb;
+
+  /**
+   * Closure for @e drained_cb.
+   */
+  void *drained_cls;
+
+  /**
+   * Number of bytes of `tail->next` that were already consumed.
+   */
+  size_t tail_off;
+
+  /**
+   * Number of bytes pushed but not yet consumed.
+   */
+  size_t queued;
+
+  /**
+   * Number of queued bytes from which on pushes are refused, 0 for
+   * no limit.
+   */
+  size_t high_water;
+
+  /**
+   * Total number of bytes pushed.
+   */
+  uint64_t pushed;
+
+  /**
+   * #MHD_YES if a push was refused and @e drained_cb was not yet
+   * called.
+   */
+  int refused;
+
+  /**
+   * #MHD_YES once #MHD_response_push_end() was called.
+   */
+  int ended;
+
+  /**
+   * #MHD_YES if the connection has to be closed without sending the
+   * remaining data (see #MHD_BROADCAST_DISCONNECT).
+   */
+  int aborted;
+
+  /**
+   * #MHD_YES once the response was queued for a connection.
+   */
+  int attached;
+
+  /**
+   * Initial element, so that the queue is never empty.
+   */
+  struct MHD_PushBuffer stub;
+
+};
+
+
+#if ZEROCOPY_SUPPORT
+/**
+ * Whether `MSG_ZEROCOPY` can be used on a socket.
+ */
+enum MHD_ZeroCopyState
+{
+
+  /**
+   * `SO_ZEROCOPY` was not set yet.
+   */
+  MHD_ZEROCOPY_UNTRIED = 0,
+
+  /**
+   * `SO_ZEROCOPY` is set.
+   */
+  MHD_ZEROCOPY_ON = 1,
+
+  /**
+   * Not to be used: not supported, or the kernel copies the data
+   * anyway (for example on loopback).
+   */
+  MHD_ZEROCOPY_OFF = 2
+
+};
+
+
+/**
+ * Reference to a response whose data the kernel may still use for
+ * sends with `MSG_ZEROCOPY`.
+ */
+struct MHD_ZeroCopyPin
+{
+
+  /**
+   * Next pin, for later sends.
+   */
+  struct MHD_ZeroCopyPin *next;
+
+  /**
+   * The response; we hold a reference.
+   */
+  struct MHD_Response *response;
+
+  /**
+   * Number of the first send of data of @e response.
+   */
+  uint32_t first;
+
+  /**
+   * Number of the last send of data of @e response.
+   */
+  uint32_t last;
+
+  /**
+   * Number of sends from @e first to @e last not reported as
+   * completed yet.
+   */
+  uint32_t pending;
+
+};
+
+
+/**
+ * State of `MSG_ZEROCOPY` sends on a socket.  The kernel numbers the
+ * sends of each socket and reports completed ranges of them on the
+ * error queue of the socket, not necessarily in order; until then,
+ * the responses sent from are kept alive by pins.
+ */
+struct MHD_ZeroCopy
+{
+
+  /**
+   * Pins for the oldest sends, in the order of the sends.
+   */
+  struct MHD_ZeroCopyPin *head;
+
+  /**
+   * Pin for the latest sends.
+   */
+  struct MHD_ZeroCopyPin *tail;
+
+  /**
+   * Number of the next send.
+   */
+  uint32_t next;
+
+  /**
+   * Whether `MSG_ZEROCOPY` can be used on the socket.
+   */
+  enum MHD_ZeroCopyState state;
+
+};
+
+
+/**
+ * Socket of a closed connection whose `MSG_ZEROCOPY` sends did not
+ * complete yet; closed once they did.
+ */
+struct MHD_ZeroCopyOrphan
+{
+
+  /**
+   * Next orphan in the DLL.
+   */
+  struct MHD_ZeroCopyOrphan *next;
+
+  /**
+   * Previous orphan in the DLL.
+   */
+  struct MHD_ZeroCopyOrphan *prev;
+
+  /**
+   * The socket, shut down for writing.
+   */
+  MHD_socket fd;
+
+  /**
+   * The pending sends.
+   */
+  struct MHD_ZeroCopy zc;
+
 };
+#endif
 
 
 /**
@@ -255,7 +624,9 @@ struct MHD_Response
 
   /**
    * Buffer pointing to data that we are supposed
-   * to send as a response.
+   * to send as a response; NULL if @e crc is used
+   * (the data is then read into the write buffer
+   * of each connection).
    */
   char *data;
 
@@ -278,7 +649,9 @@ struct MHD_Response
   MHD_ContentReaderFreeCallback crfc;
 
   /**
-   * Mutex to synchronize access to @e data, @e size and
+   * Mutex to serialize calls to @e crc (unless
+   * #MHD_RF_THREAD_SAFE_READER is set), to protect the cached
+   * @e header_block and, without atomic builtins, to protect
    * @e reference_count.
    */
   MHD_mutex_ mutex;
@@ -288,25 +661,18 @@ struct MHD_Response
    */
   uint64_t total_size;
 
-  /**
-   * At what offset in the stream is the
-   * beginning of @e data located?
-   */
-  uint64_t data_start;
-
   /**
    * Offset to start reading from when using @e fd.
    */
   uint64_t fd_off;
 
   /**
-   * Number of bytes ready in @e data (buffer may be larger
-   * than what is filled with payload).
+   * Number of bytes in @e data.
    */
   size_t data_size;
 
   /**
-   * Size of the data buffer @e data.
+   * Preferred number of bytes to read from @e crc at a time.
    */
   size_t data_buffer_size;
 
@@ -321,11 +687,57 @@ struct MHD_Response
    */
   int fd;
 
+  /**
+   * Segments of the data if this response was created with
+   * #MHD_create_response_from_iovec, otherwise NULL.
+   */
+  struct MHD_IoVec *iov;
+
+  /**
+   * Number of entries in @e iov.
+   */
+  unsigned int iov_cnt;
+
+  /**
+   * Queue of the pushed data if this response was created with
+   * #MHD_create_response_for_push, otherwise NULL.
+   */
+  struct MHD_PushQueue *push;
+
   /**
    * Flags set for the MHD response.
    */
   enum MHD_ResponseFlags flags;
 
+  /**
+   * Serialized status line and headers (without the "Date:" header
+   * and the final CRLF) as last sent for this response, NULL if not
+   * built yet.  Built, copied and replaced while holding @e mutex.
+   */
+  char *header_block;
+
+  /**
+   * Number of bytes in @e header_block.
+   */
+  size_t header_block_size;
+
+  /**
+   * Status code, HTTP version and headers added by MHD that
+   * @e header_block was built for.
+   */
+  uint64_t header_block_key;
+
+  /**
+   * Incremented whenever a header (not a footer) of the response is
+   * added or removed.  Written without holding @e mutex.
+   */
+  unsigned int header_generation;
+
+  /**
+   * Value of @e header_generation when @e header_block was built.
+   */
+  unsigned int header_block_generation;
+
 };
 
 
@@ -469,6 +881,69 @@ enum MHD_CONNECTION_STATE
 
 };
 
+
+/**
+ * State of an access handler call that runs on the offload pool
+ * (see #MHD_offload_request()).
+ */
+enum MHD_ConnectionOffloadState
+{
+  /**
+   * No offloaded call.
+   */
+  MHD_CONNECTION_OFFLOAD_NONE = 0,
+
+  /**
+   * The connection was suspended for an offloaded call, which is
+   * handed to the pool once the event loop is done with the
+   * connection.
+   */
+  MHD_CONNECTION_OFFLOAD_PENDING = 1,
+
+  /**
+   * The call was handed to the offload pool.
+   */
+  MHD_CONNECTION_OFFLOAD_RUNNING = 2,
+
+  /**
+   * The call completed; its result is consumed when the state
+   * machine calls the access handler again for the same data.
+   */
+  MHD_CONNECTION_OFFLOAD_DONE = 3
+};
+
+
+/**
+ * State of a connection whose content reader returned
+ * #MHD_CONTENT_READER_WAIT.  Changed concurrently by
+ * #MHD_response_data_ready(), so only accessed atomically.
+ */
+enum MHD_ConnectionDataWait
+{
+  /**
+   * Not waiting for data.
+   */
+  MHD_CONNECTION_DATA_WAIT_NONE = 0,
+
+  /**
+   * The content reader returned #MHD_CONTENT_READER_WAIT; the
+   * connection is to be suspended by the idle handler.
+   */
+  MHD_CONNECTION_DATA_WAIT_PENDING = 1,
+
+  /**
+   * The connection is suspended until the application signals
+   * new data.
+   */
+  MHD_CONNECTION_DATA_WAIT_PARKED = 2,
+
+  /**
+   * The application signalled new data; the content reader is
+   * to be called again.
+   */
+  MHD_CONNECTION_DATA_WAIT_SIGNALED = 3
+};
+
 /**
  * Should all state transitions be printed to stderr?
  */
@@ -510,6 +985,25 @@ typedef ssize_t
                      size_t max_bytes);
 
 
+#if SENDV_SUPPORT
+/**
+ * Function to transmit plaintext data from several buffers
+ * at once.
+ *
+ * @param conn the connection struct
+ * @param iov buffers to transmit, in order
+ * @param iovcnt number of entries in @a iov
+ * @param flags additional flags for `sendmsg()` (`MSG_ZEROCOPY`)
+ * @return number of bytes transmitted
+ */
+typedef ssize_t
+(*TransmitVecCallback) (struct MHD_Connection *conn,
+                        const struct iovec *iov,
+                        int iovcnt,
+                        int flags);
+#endif
+
+
 /**
  * State kept for each HTTP request.
  */
@@ -528,6 +1022,20 @@ struct MHD_Connection
   struct MHD_Connection *prevE;
 #endif
 
+#if IO_URING_SUPPORT
+  /**
+   * Next pointer for the UDLL listing connections that are
+   * ready for processing in io_uring mode.
+   */
+  struct MHD_Connection *nextU;
+
+  /**
+   * Previous pointer for the UDLL listing connections that are
+   * ready for processing in io_uring mode.
+   */
+  struct MHD_Connection *prevU;
+#endif
+
   /**
    * Next pointer for the DLL describing our IO state.
    */
@@ -539,18 +1047,11 @@ struct MHD_Connection
   struct MHD_Connection *prev;
 
   /**
-   * Next pointer for the XDLL organizing connections by timeout.
-   * This DLL can be either the
-   * 'manual_timeout_head/manual_timeout_tail' or the
-   * 'normal_timeout_head/normal_timeout_tail', depending on whether a
-   * custom timeout is set for the connection.
+   * Timer of this connection in the @e timeout_wheel of the daemon;
+   * scheduled while the connection has a timeout and is not
+   * suspended (not used with #MHD_USE_THREAD_PER_CONNECTION).
    */
-  struct MHD_Connection *nextX;
-
-  /**
-   * Previous pointer for the XDLL organizing connections by timeout.
-   */
-  struct MHD_Connection *prevX;
+  struct MHD_Timer timeout_timer;
 
   /**
    * Reference to the MHD_Daemon struct.
@@ -567,6 +1068,20 @@ struct MHD_Connection
    */
   struct MHD_HTTP_Header *headers_received_tail;
 
+  /**
+   * Was the "Cookie:" header already parsed into @e headers_received?
+   * This happens on first use of a #MHD_COOKIE_KIND value.
+   */
+  int cookies_parsed;
+
+  /**
+   * Index of @e headers_received by name (see header_index.h),
+   * allocated from the pool together with the first entry.  NULL
+   * if that allocation failed, in which case lookups walk the
+   * list.
+   */
+  struct MHD_HTTP_Header **headers_index;
+
   /**
    * Response to transmit (initially NULL).
    */
@@ -613,6 +1128,14 @@ struct MHD_Connection
    */
   char *url;
 
+  /**
+   * Arguments of the requested URL (after the '?', not yet
+   * unescaped).  Points into the read buffer; NULL if there
+   * are none or once they were parsed into @e headers_received,
+   * which happens on first use of a #MHD_GET_ARGUMENT_KIND value.
+   */
+  char *args;
+
   /**
    * HTTP version string (i.e. http/1.1).  Allocated
    * in pool.
@@ -650,6 +1173,25 @@ struct MHD_Connection
    */
   char *colon;
 
+  /**
+   * First colon of the line last returned by
+   * get_next_header_line(), NULL if it has none.
+   */
+  char *line_colon;
+
+  /**
+   * First space of the line last returned by
+   * get_next_header_line(), NULL if it has none.
+   */
+  char *line_space;
+
+  /**
+   * State of scanning the (incomplete) line at the start of
+   * @e read_buffer, kept so that the scan resumes where it
+   * stopped once more data was read.
+   */
+  struct MHD_LineScan line_scan;
+
   /**
    * Foreign address (of length @e addr_len).  MALLOCED (not
    * in pool!).
@@ -705,6 +1247,12 @@ struct MHD_Connection
    */
   uint64_t response_write_position;
 
+  /**
+   * Contribution of this connection to the @e queued_bytes
+   * of its daemon.
+   */
+  uint64_t queued_bytes;
+
   /**
    * Position in the 100 CONTINUE message that
    * we need to send when receiving http 1.1 requests.
@@ -718,15 +1266,16 @@ struct MHD_Connection
 
   /**
    * Last time this connection had any activity
-   * (reading or writing).
+   * (reading or writing), in milliseconds of
+   * #MHD_monotonic_msec_counter().
    */
-  time_t last_activity;
+  uint64_t last_activity;
 
   /**
-   * After how many seconds of inactivity should
+   * After how many milliseconds of inactivity should
    * this connection time out?  Zero for no timeout.
    */
-  unsigned int connection_timeout;
+  uint64_t connection_timeout_ms;
 
   /**
    * Did we ever call the "default_handler" on this connection?  (this
@@ -735,6 +1284,24 @@ struct MHD_Connection
    */
   int client_aware;
 
+  /**
+   * #MHD_YES while the responses to pipelined requests are buffered
+   * in the socket (TCP_CORK); the buffer must be flushed before
+   * waiting for the client.
+   */
+  int flush_pending;
+
+  /**
+   * Access handler for the current request, set before the
+   * first call to it (see #MHD_OPTION_ROUTER).
+   */
+  MHD_AccessHandlerCallback handler;
+
+  /**
+   * Closure argument to @e handler.
+   */
+  void *handler_cls;
+
   /**
    * Socket for this connection.  Set to #MHD_INVALID_SOCKET if
    * this connection has died (daemon should clean
@@ -761,6 +1328,22 @@ struct MHD_Connection
    */
   int in_idle;
 
+#ifdef HAVE_POLL
+  /**
+   * Index of this connection in the poll set of the daemon
+   * (@e poll_fds), 0 if the connection is not in the poll set.
+   */
+  unsigned int poll_slot;
+
+  /**
+   * Event loop info the poll set entry of this connection
+   * reflects.  Connections that must be processed in the next
+   * iteration even without events are treated as
+   * #MHD_EVENT_LOOP_INFO_BLOCK.
+   */
+  enum MHD_ConnectionEventLoopInfo poll_info;
+#endif
+
 #if EPOLL_SUPPORT
   /**
    * What is the state of this socket in relation to epoll?
@@ -768,6 +1351,29 @@ struct MHD_Connection
   enum MHD_EpollState epoll_state;
 #endif
 
+#if IO_URING_SUPPORT
+  /**
+   * What is the state of this socket in relation to io_uring?
+   */
+  enum MHD_UringState uring_state;
+
+  /**
+   * Buffer of the pending (or completed) io_uring operation.
+   */
+  void *uring_buf;
+
+  /**
+   * Size of @e uring_buf.
+   */
+  size_t uring_len;
+
+  /**
+   * Result of the completed io_uring operation (number of bytes
+   * or negated error code).
+   */
+  int uring_res;
+#endif
+
   /**
    * State in the FSM for this connection.
    */
@@ -841,6 +1447,14 @@ struct MHD_Connection
    */
   TransmitCallback send_cls;
 
+#if SENDV_SUPPORT
+  /**
+   * Function used for writing HTTP response stream from several
+   * buffers at once; NULL if the transport cannot do that (TLS).
+   */
+  TransmitVecCallback sendv_cls;
+#endif
+
 #if HTTPS_SUPPORT
   /**
    * State required for HTTPS/SSL/TLS support.
@@ -853,26 +1467,80 @@ struct MHD_Connection
   int protocol;
 
   /**
-   * Memory location to return for protocol session info.
+   * Memory location to return for protocol session info.
+   */
+  int cipher;
+
+  /**
+   * Could it be that we are ready to read due to TLS buffers
+   * even though the socket is not?
+   */
+  int tls_read_ready;
+#endif
+
+  /**
+   * Is the connection suspended?
+   */
+  int suspended;
+
+  /**
+   * Is the connection wanting to resume?
+   */
+  int resuming;
+
+  /**
+   * #MHD_YES if the calls of the access handler for the current
+   * request run on the offload pool (#MHD_offload_request()).
+   */
+  int offload;
+
+  /**
+   * State of the offloaded access handler call.
+   */
+  enum MHD_ConnectionOffloadState offload_state;
+
+  /**
+   * Is the connection waiting for the application to signal new
+   * data for the response?  A value of
+   * `enum MHD_ConnectionDataWait`.
+   */
+  int data_wait;
+
+  /**
+   * Number of bytes of the pushed data that remain to be sent in the
+   * current chunk (chunked encoding of a response created with
+   * #MHD_create_response_for_push and sent without copying).
+   */
+  size_t push_chunk_left;
+
+#if ZEROCOPY_SUPPORT
+  /**
+   * Sends from the response with `MSG_ZEROCOPY`
+   * (#MHD_OPTION_ZEROCOPY_THRESHOLD).
+   */
+  struct MHD_ZeroCopy zerocopy;
+#endif
+
+  /**
+   * Upload data for the offloaded call.
    */
-  int cipher;
+  const char *offload_upload_data;
 
   /**
-   * Could it be that we are ready to read due to TLS buffers
-   * even though the socket is not?
+   * Size of the upload data for the offloaded call; once the call
+   * completed, the number of bytes the handler processed.
    */
-  int tls_read_ready;
-#endif
+  size_t offload_upload_data_size;
 
   /**
-   * Is the connection suspended?
+   * Return value of the completed offloaded call.
    */
-  int suspended;
+  int offload_result;
 
   /**
-   * Is the connection wanting to resume?
+   * Next connection in the queue of the offload pool.
    */
-  int resuming;
+  struct MHD_Connection *offload_next;
 };
 
 /**
@@ -903,6 +1571,80 @@ typedef size_t
                     char *uri);
 
 
+/**
+ * A connection that was assigned to a worker of the thread pool
+ * (#MHD_OPTION_WORKER_DISPATCH_POLICY), but that the worker did
+ * not yet start to process.
+ */
+struct MHD_PendingConnection
+{
+  /**
+   * Next pending connection of the same worker.
+   */
+  struct MHD_PendingConnection *next;
+
+  /**
+   * Socket of the connection.
+   */
+  MHD_socket socket_fd;
+
+  /**
+   * Address of the client.
+   */
+  struct sockaddr_storage addr;
+
+  /**
+   * Number of bytes in @e addr.
+   */
+  socklen_t addrlen;
+
+  /**
+   * Was the connection added with #MHD_add_connection()?
+   */
+  int external_add;
+};
+
+
+/**
+ * Response sent without calling the access handler
+ * (see #MHD_OPTION_STATIC_RESPONSES).
+ */
+struct MHD_StaticEntry
+{
+
+  /**
+   * Method of the requests to answer, NULL for all methods.
+   */
+  char *method;
+
+  /**
+   * Path of the requests to answer.
+   */
+  char *url;
+
+  /**
+   * Number of characters in @e url.
+   */
+  size_t url_len;
+
+  /**
+   * Response to send; we hold a reference to it.
+   */
+  struct MHD_Response *response;
+
+  /**
+   * HTTP status code to send.
+   */
+  unsigned int status_code;
+
+  /**
+   * Call the #MHD_OPTION_NOTIFY_COMPLETED callback for it?
+   */
+  int notify_completed;
+
+};
+
+
 /**
  * State kept for each MHD daemon.  All connections are kept in two
  * doubly-linked lists.  The first one reflects the state of the
@@ -965,38 +1707,27 @@ struct MHD_Daemon
   struct MHD_Connection *eready_tail;
 #endif
 
+#if IO_URING_SUPPORT
   /**
-   * Head of the XDLL of ALL connections with a default ('normal')
-   * timeout, sorted by timeout (earliest at the tail, most recently
-   * used connection at the head).  MHD can just look at the tail of
-   * this list to determine the timeout for all of its elements;
-   * whenever there is an event of a connection, the connection is
-   * moved back to the tail of the list.
-   *
-   * All connections by default start in this list; if a custom
-   * timeout that does not match @e connection_timeout is set, they
-   * are moved to the @e manual_timeout_head-XDLL.
-   */
-  struct MHD_Connection *normal_timeout_head;
-
-  /**
-   * Tail of the XDLL of ALL connections with a default timeout,
-   * sorted by timeout (earliest timeout at the tail).
+   * Head of UDLL of connections ready for processing (in io_uring mode).
    */
-  struct MHD_Connection *normal_timeout_tail;
+  struct MHD_Connection *uready_head;
 
   /**
-   * Head of the XDLL of ALL connections with a non-default/custom
-   * timeout, unsorted.  MHD will do a O(n) scan over this list to
-   * determine the current timeout.
+   * Tail of UDLL of connections ready for processing (in io_uring mode).
    */
-  struct MHD_Connection *manual_timeout_head;
+  struct MHD_Connection *uready_tail;
+#endif
 
   /**
-   * Tail of the XDLL of ALL connections with a non-default/custom
-   * timeout, unsorted.
+   * Timer wheel with the timeouts of all (non-suspended) connections
+   * that have a timeout, whether it is the default or a custom one.
+   * Touching a connection and finding the timed out connections is
+   * thus independent of the number of connections.  Not used with
+   * #MHD_USE_THREAD_PER_CONNECTION, where each thread watches the
+   * timeout of its own connection.
    */
-  struct MHD_Connection *manual_timeout_tail;
+  struct MHD_TimerWheel timeout_wheel;
 
   /**
    * Function to call to check if we should accept or reject an
@@ -1031,6 +1762,45 @@ struct MHD_Daemon
    */
   void *notify_connection_cls;
 
+  /**
+   * Function to call to decide whether to keep a request
+   * header.  May be NULL (keep all).
+   */
+  MHD_HeaderFilterCallback header_filter;
+
+  /**
+   * Closure argument to @e header_filter.
+   */
+  void *header_filter_cls;
+
+  /**
+   * Function to call to decide whether to process a request
+   * once its request line was received.  May be NULL.
+   */
+  MHD_RequestLineCallback request_line_callback;
+
+  /**
+   * Closure argument to @e request_line_callback.
+   */
+  void *request_line_callback_cls;
+
+  /**
+   * Routes for the requests, NULL to pass all requests
+   * to @e default_handler.
+   */
+  struct MHD_Router *router;
+
+  /**
+   * Responses sent without calling the access handler; shared
+   * with the workers of the thread pool.
+   */
+  struct MHD_StaticEntry *static_responses;
+
+  /**
+   * Number of entries in @e static_responses.
+   */
+  unsigned int num_static_responses;
+
   /**
    * Function to call with the full URI at the
    * beginning of request processing.  May be NULL.
@@ -1132,6 +1902,232 @@ struct MHD_Daemon
    */
   int listening_address_reuse;
 
+  /**
+   * #MHD_YES if each worker of the thread pool is to have its
+   * own listen socket (#MHD_OPTION_LISTEN_SOCKET_PER_WORKER).
+   */
+  int listen_socket_per_worker;
+
+  /**
+   * Listen socket created for this worker thread if
+   * #MHD_OPTION_LISTEN_SOCKET_PER_WORKER is used, otherwise
+   * #MHD_INVALID_SOCKET.  Unlike @e socket_fd, this is not reset
+   * by #MHD_quiesce_daemon(), so that the socket can be closed
+   * by #MHD_stop_daemon().
+   */
+  MHD_socket worker_socket_fd;
+
+  /**
+   * CPUs to run the threads of this daemon on
+   * (#MHD_OPTION_CPU_AFFINITY), NULL to not restrict them.  Owned
+   * by the master; a worker of a thread pool points to the single
+   * CPU it was assigned.
+   */
+  unsigned int *cpus;
+
+  /**
+   * Number of entries in @e cpus.
+   */
+  unsigned int num_cpus;
+
+  /**
+   * How are new connections assigned to the workers of the
+   * thread pool?
+   */
+  enum MHD_WorkerDispatchPolicy dispatch_policy;
+
+  /**
+   * #MHD_YES if idle workers may take over pending connections
+   * of busy workers (#MHD_OPTION_WORKER_WORK_STEALING).
+   */
+  int work_stealing;
+
+  /**
+   * Worker to consider first when dispatching the next connection
+   * (only used by the master).
+   */
+  unsigned int dispatch_next;
+
+  /**
+   * Number of workers that were started and can be assigned
+   * connections (only used by the master).
+   */
+  unsigned int dispatch_workers;
+
+  /**
+   * Head of the connections assigned to this worker that it did
+   * not yet start to process.
+   */
+  struct MHD_PendingConnection *pending_head;
+
+  /**
+   * Tail of the connections assigned to this worker that it did
+   * not yet start to process.
+   */
+  struct MHD_PendingConnection *pending_tail;
+
+  /**
+   * Number of entries in the @e pending_head list.  Written under
+   * @e pending_mutex, read by other workers without locking.
+   */
+  unsigned int pending_count;
+
+  /**
+   * #MHD_YES if another worker signalled this one to look for
+   * pending connections it can take over, and this worker did not
+   * do so yet (#MHD_OPTION_WORKER_WORK_STEALING).  Protected by
+   * @e pending_mutex.
+   */
+  int steal_signalled;
+
+  /**
+   * Mutex for the @e pending_head list, and, in the master, for
+   * @e dispatch_next and @e dispatch_workers.
+   */
+  MHD_mutex_ pending_mutex;
+
+  /**
+   * Number of response bytes the connections of this daemon
+   * still have to send, as far as the size of their responses
+   * is known (see #MHD_DISPATCH_LEAST_QUEUED_BYTES).
+   */
+  uint64_t queued_bytes;
+
+  /**
+   * Number of threads in the offload pool
+   * (#MHD_OPTION_OFFLOAD_POOL_SIZE); only used by the master.
+   */
+  unsigned int offload_pool_size;
+
+  /**
+   * Threads of the offload pool, NULL if there is no pool.
+   */
+  MHD_thread_handle_ *offload_threads;
+
+  /**
+   * Pipe with one byte for each call queued for the offload pool
+   * (and one for each thread to stop on shutdown).
+   */
+  MHD_pipe offload_pipe[2];
+
+  /**
+   * Head of the queue of connections with calls for the
+   * offload pool.
+   */
+  struct MHD_Connection *offload_head;
+
+  /**
+   * Tail of the queue of connections with calls for the
+   * offload pool.
+   */
+  struct MHD_Connection *offload_tail;
+
+  /**
+   * Mutex for the offload queue and @e offload_shutdown.
+   */
+  MHD_mutex_ offload_mutex;
+
+  /**
+   * #MHD_YES once the offload pool is stopping; calls are then
+   * run by the event loop.
+   */
+  int offload_shutdown;
+
+  /**
+   * Closed connections kept for reuse (singly linked via @e next),
+   * each with its (reset) memory pool and address buffer.
+   */
+  struct MHD_Connection *cache_head;
+
+  /**
+   * Number of connections in the @e cache_head list.
+   */
+  unsigned int cache_count;
+
+  /**
+   * Maximum number of connections in the @e cache_head list
+   * (#MHD_OPTION_CONNECTION_CACHE_SIZE).
+   */
+  unsigned int cache_limit;
+
+  /**
+   * Minimum number of bytes of an in-memory body to send with
+   * `MSG_ZEROCOPY`, 0 to never use it
+   * (#MHD_OPTION_ZEROCOPY_THRESHOLD).
+   */
+  size_t zerocopy_threshold;
+
+#if ZEROCOPY_SUPPORT
+  /**
+   * Head of the DLL of sockets of closed connections with pending
+   * `MSG_ZEROCOPY` sends.
+   */
+  struct MHD_ZeroCopyOrphan *zerocopy_orphans_head;
+
+  /**
+   * Tail of the DLL of sockets of closed connections with pending
+   * `MSG_ZEROCOPY` sends.
+   */
+  struct MHD_ZeroCopyOrphan *zerocopy_orphans_tail;
+#endif
+
+  /**
+   * Cached "Date:" header line (including the CRLF) for the
+   * second @e date_time; not used with
+   * #MHD_USE_THREAD_PER_CONNECTION.
+   */
+  char date_line[128];
+
+  /**
+   * Length of @e date_line, 0 if it is not valid.
+   */
+  size_t date_line_len;
+
+  /**
+   * Time for which @e date_line was produced.
+   */
+  time_t date_time;
+
+#ifdef HAVE_POLL
+  /**
+   * Persistent poll set for #MHD_USE_POLL (unless combined with
+   * #MHD_USE_THREAD_PER_CONNECTION).  Entries
+   * #MHD_POLL_SLOT_LISTEN and #MHD_POLL_SLOT_PIPE are reserved,
+   * the others belong to the connections in @e poll_connections.
+   */
+  struct pollfd *poll_fds;
+
+  /**
+   * Connection of each entry in @e poll_fds (NULL for the
+   * reserved entries).
+   */
+  struct MHD_Connection **poll_connections;
+
+  /**
+   * Number of entries allocated in @e poll_fds and
+   * @e poll_connections.
+   */
+  unsigned int poll_size;
+
+  /**
+   * Number of entries of @e poll_fds in use.
+   */
+  unsigned int poll_used;
+
+  /**
+   * Number of connections in the poll set whose @e poll_info is
+   * #MHD_EVENT_LOOP_INFO_BLOCK; those must be processed in each
+   * iteration, even without events.
+   */
+  unsigned int poll_num_block;
+
+  /**
+   * Number of connections in the poll set that are in
+   * #MHD_EVENT_LOOP_INFO_CLEANUP.
+   */
+  unsigned int poll_num_cleanup;
+#endif
+
 #if EPOLL_SUPPORT
   /**
    * File descriptor associated with our epoll loop.
@@ -1145,6 +2141,44 @@ struct MHD_Daemon
   int listen_socket_in_epoll;
 #endif
 
+#if IO_URING_SUPPORT
+  /**
+   * Ring used by our event loop (one per worker).
+   */
+  struct MHD_Uring uring;
+
+  /**
+   * Number of connection operations currently submitted to the ring.
+   */
+  unsigned int uring_in_flight;
+
+  /**
+   * #MHD_YES if the 'uready' UDLL contains connections that can make
+   * progress right away (so the event loop must not block).
+   */
+  int uring_busy;
+
+  /**
+   * #MHD_YES if an accept operation on the listen socket is pending.
+   */
+  int uring_accept_armed;
+
+  /**
+   * #MHD_YES if a poll operation on our end of 'wpipe' is pending.
+   */
+  int uring_wpipe_armed;
+
+  /**
+   * Address of the client filled in by the pending accept operation.
+   */
+  struct sockaddr_storage uring_accept_addr;
+
+  /**
+   * Length of @e uring_accept_addr.
+   */
+  socklen_t uring_accept_addrlen;
+#endif
+
   /**
    * Pipe we use to signal shutdown, unless
    * 'HAVE_LISTEN_SHUTDOWN' is defined AND we have a listen
@@ -1175,10 +2209,10 @@ struct MHD_Daemon
   unsigned int connection_limit;
 
   /**
-   * After how many seconds of inactivity should
+   * After how many milliseconds of inactivity should
    * connections time out?  Zero for no timeout.
    */
-  unsigned int connection_timeout;
+  uint64_t connection_timeout_ms;
 
   /**
    * Maximum number of connections per IP, or 0 for
@@ -1361,50 +2395,6 @@ struct MHD_Daemon
 
 
 
-/**
- * Insert an element at the head of a XDLL. Assumes that head, tail and
- * element are structs with prevX and nextX fields.
- *
- * @param head pointer to the head of the XDLL
- * @param tail pointer to the tail of the XDLL
- * @param element element to insert
- */
-#define XDLL_insert(head,tail,element) do { \
-  EXTRA_CHECK (NULL == (element)->nextX); \
-  EXTRA_CHECK (NULL == (element)->prevX); \
-  (element)->nextX = (head); \
-  (element)->prevX = NULL; \
-  if (NULL == (tail)) \
-    (tail) = element; \
-  else \
-    (head)->prevX = element; \
-  (head) = (element); } while (0)
-
-
-/**
- * Remove an element from a XDLL. Assumes
- * that head, tail and element are structs
- * with prevX and nextX fields.
- *
- * @param head pointer to the head of the XDLL
- * @param tail pointer to the tail of the XDLL
- * @param element element to remove
- */
-#define XDLL_remove(head,tail,element) do { \
-  EXTRA_CHECK ( (NULL != (element)->nextX) || ((element) == (tail)));  \
-  EXTRA_CHECK ( (NULL != (element)->prevX) || ((element) == (head)));  \
-  if (NULL == (element)->prevX) \
-    (head) = (element)->nextX;  \
-  else \
-    (element)->prevX->nextX = (element)->nextX; \
-  if (NULL == (element)->nextX) \
-    (tail) = (element)->prevX;  \
-  else \
-    (element)->nextX->prevX = (element)->prevX; \
-  (element)->nextX = NULL; \
-  (element)->prevX = NULL; } while (0)
-
-
 /**
  * Insert an element at the head of a EDLL. Assumes that head, tail and
  * element are structs with prevE and nextE fields.
@@ -1445,6 +2435,46 @@ struct MHD_Daemon
   (element)->prevE = NULL; } while (0)
 
 
+/**
+ * Insert an element at the tail of a UDLL. Assumes that head, tail and
+ * element are structs with prevU and nextU fields.
+ *
+ * @param head pointer to the head of the UDLL
+ * @param tail pointer to the tail of the UDLL
+ * @param element element to insert
+ */
+#define UDLL_insert_tail(head,tail,element) do { \
+  (element)->prevU = (tail); \
+  (element)->nextU = NULL; \
+  if ((head) == NULL) \
+    (head) = element; \
+  else \
+    (tail)->nextU = element; \
+  (tail) = (element); } while (0)
+
+
+/**
+ * Remove an element from a UDLL. Assumes
+ * that head, tail and element are structs
+ * with prevU and nextU fields.
+ *
+ * @param head pointer to the head of the UDLL
+ * @param tail pointer to the tail of the UDLL
+ * @param element element to remove
+ */
+#define UDLL_remove(head,tail,element) do { \
+  if ((element)->prevU == NULL) \
+    (head) = (element)->nextU;  \
+  else \
+    (element)->prevU->nextU = (element)->nextU; \
+  if ((element)->nextU == NULL) \
+    (tail) = (element)->prevU;  \
+  else \
+    (element)->nextU->prevU = (element)->prevU; \
+  (element)->nextU = NULL; \
+  (element)->prevU = NULL; } while (0)
+
+
 /**
  * Convert all occurences of '+' to ' '.
  *
@@ -1494,4 +2524,15 @@ MHD_parse_arguments_ (struct MHD_Connection *connection,
 		      unsigned int *num_headers);
 
 
+/**
+ * Hand the offloaded access handler call of @a connection to the
+ * offload pool of its daemon (see #MHD_offload_request()).  The
+ * connection is resumed once the call completed.
+ *
+ * @param connection suspended connection with an offloaded call
+ */
+void
+MHD_offload_submit_ (struct MHD_Connection *connection);
+
+
 #endif
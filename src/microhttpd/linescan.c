@@ -0,0 +1,291 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file linescan.c
+ * @brief scanner for the lines of the HTTP request header
+ * @author Christian Grothoff
+ *
+ * The vector implementations compare a block of bytes against CR,
+ * LF, ':' and ' ' at once and turn the results into bit masks.  The
+ * masks for the separators are cut off at the end of the line, and
+ * are no longer computed once the respective separator was found.
+ * The remaining bytes after the last full block are handled by the
+ * scalar implementation, so no byte beyond the data is ever read.
+ */
+
+#include "internal.h"
+#include "linescan.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define MHD_LINE_SCAN_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__SSE2__) && defined(HAVE_AVX2_TARGET)
+#define MHD_LINE_SCAN_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+
+/**
+ * Signature of the implementations of #MHD_line_scan_().
+ *
+ * @param scan scan state of the line, updated
+ * @param buf start of the line
+ * @param len number of bytes available at @a buf
+ * @return #MHD_YES if the end of the line was found
+ */
+typedef int
+(*LineScanFunction) (struct MHD_LineScan *scan,
+                     const char *buf,
+                     size_t len);
+
+
+/**
+ * Portable implementation.
+ *
+ * @param scan scan state of the line, updated
+ * @param buf start of the line
+ * @param len number of bytes available at @a buf
+ * @return #MHD_YES if the end of the line was found
+ */
+static int
+scan_scalar (struct MHD_LineScan *scan,
+             const char *buf,
+             size_t len)
+{
+  size_t pos;
+  char c;
+
+  for (pos = scan->pos; pos < len; pos++)
+    {
+      c = buf[pos];
+      if ( ('\r' == c) ||
+           ('\n' == c) )
+        {
+          scan->pos = pos;
+          return MHD_YES;
+        }
+      if ( (':' == c) &&
+           (0 == scan->colon) )
+        scan->colon = pos + 1;
+      else if ( (' ' == c) &&
+                (0 == scan->space) )
+        scan->space = pos + 1;
+    }
+  scan->pos = len;
+  return MHD_NO;
+}
+
+
+#if MHD_LINE_SCAN_HAVE_SSE2
+/**
+ * Implementation using SSE2, 16 bytes at a time.
+ *
+ * @param scan scan state of the line, updated
+ * @param buf start of the line
+ * @param len number of bytes available at @a buf
+ * @return #MHD_YES if the end of the line was found
+ */
+static int
+scan_sse2 (struct MHD_LineScan *scan,
+           const char *buf,
+           size_t len)
+{
+  const __m128i cr = _mm_set1_epi8 ('\r');
+  const __m128i lf = _mm_set1_epi8 ('\n');
+  const __m128i colon = _mm_set1_epi8 (':');
+  const __m128i space = _mm_set1_epi8 (' ');
+  __m128i v;
+  size_t pos;
+  unsigned int eol;
+  unsigned int before;
+  unsigned int m;
+
+  for (pos = scan->pos; pos + 16 <= len; pos += 16)
+    {
+      v = _mm_loadu_si128 ((const __m128i *) &buf[pos]);
+      eol = (unsigned int) _mm_movemask_epi8 (_mm_or_si128 (_mm_cmpeq_epi8 (v, cr),
+                                                            _mm_cmpeq_epi8 (v, lf)));
+      /* bits of the bytes before the end of the line */
+      before = (0 != eol) ? ((eol & (~eol + 1)) - 1) : 0xFFFFu;
+      if (0 == scan->colon)
+        {
+          m = (unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, colon)) & before;
+          if (0 != m)
+            scan->colon = pos + __builtin_ctz (m) + 1;
+        }
+      if (0 == scan->space)
+        {
+          m = (unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, space)) & before;
+          if (0 != m)
+            scan->space = pos + __builtin_ctz (m) + 1;
+        }
+      if (0 != eol)
+        {
+          scan->pos = pos + __builtin_ctz (eol);
+          return MHD_YES;
+        }
+    }
+  scan->pos = pos;
+  return scan_scalar (scan, buf, len);
+}
+#endif
+
+
+#if MHD_LINE_SCAN_HAVE_AVX2
+/**
+ * Implementation using AVX2, 32 bytes at a time.  Only used
+ * if the CPU supports AVX2 (which implies SSE2).
+ *
+ * @param scan scan state of the line, updated
+ * @param buf start of the line
+ * @param len number of bytes available at @a buf
+ * @return #MHD_YES if the end of the line was found
+ */
+__attribute__((target("avx2")))
+static int
+scan_avx2 (struct MHD_LineScan *scan,
+           const char *buf,
+           size_t len)
+{
+  const __m256i cr = _mm256_set1_epi8 ('\r');
+  const __m256i lf = _mm256_set1_epi8 ('\n');
+  const __m256i colon = _mm256_set1_epi8 (':');
+  const __m256i space = _mm256_set1_epi8 (' ');
+  __m256i v;
+  size_t pos;
+  uint32_t eol;
+  uint32_t before;
+  uint32_t m;
+
+  /* for little data, the 256-bit setup costs more than it saves */
+  if (len - scan->pos < 128)
+    return scan_sse2 (scan, buf, len);
+  for (pos = scan->pos; pos + 32 <= len; pos += 32)
+    {
+      v = _mm256_loadu_si256 ((const __m256i *) &buf[pos]);
+      eol = (uint32_t) _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, cr),
+                                                              _mm256_cmpeq_epi8 (v, lf)));
+      /* bits of the bytes before the end of the line */
+      before = (0 != eol) ? ((eol & (~eol + 1)) - 1) : UINT32_MAX;
+      if (0 == scan->colon)
+        {
+          m = (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, colon)) & before;
+          if (0 != m)
+            scan->colon = pos + __builtin_ctz (m) + 1;
+        }
+      if (0 == scan->space)
+        {
+          m = (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, space)) & before;
+          if (0 != m)
+            scan->space = pos + __builtin_ctz (m) + 1;
+        }
+      if (0 != eol)
+        {
+          scan->pos = pos + __builtin_ctz (eol);
+          return MHD_YES;
+        }
+    }
+  scan->pos = pos;
+  return scan_sse2 (scan, buf, len);
+}
+#endif
+
+
+/**
+ * Implementation in use.
+ */
+static LineScanFunction scan_function = &scan_scalar;
+
+
+/**
+ * Select the implementation of the scanner to use.
+ *
+ * @param impl implementation to use
+ * @return #MHD_YES on success, #MHD_NO if @a impl is not
+ *         supported by the build or the CPU
+ */
+int
+MHD_line_scan_select_ (enum MHD_LineScanImplementation impl)
+{
+  switch (impl)
+    {
+    case MHD_LINE_SCAN_SCALAR:
+      scan_function = &scan_scalar;
+      return MHD_YES;
+    case MHD_LINE_SCAN_SSE2:
+#if MHD_LINE_SCAN_HAVE_SSE2
+      scan_function = &scan_sse2;
+      return MHD_YES;
+#else
+      return MHD_NO;
+#endif
+    case MHD_LINE_SCAN_AVX2:
+#if MHD_LINE_SCAN_HAVE_AVX2
+      __builtin_cpu_init ();
+      if (! __builtin_cpu_supports ("avx2"))
+        return MHD_NO;
+      scan_function = &scan_avx2;
+      return MHD_YES;
+#else
+      return MHD_NO;
+#endif
+    }
+  return MHD_NO;
+}
+
+
+/**
+ * Select the fastest implementation supported by the CPU.
+ * Called once when the library is initialized.
+ */
+void
+MHD_line_scan_init_ (void)
+{
+  if (MHD_YES == MHD_line_scan_select_ (MHD_LINE_SCAN_AVX2))
+    return;
+  if (MHD_YES == MHD_line_scan_select_ (MHD_LINE_SCAN_SSE2))
+    return;
+  (void) MHD_line_scan_select_ (MHD_LINE_SCAN_SCALAR);
+}
+
+
+/**
+ * Continue scanning the line starting at @a buf for its end
+ * (the first CR or LF), recording the first colon and space
+ * before the end.
+ *
+ * @param scan scan state of the line, updated
+ * @param buf start of the line
+ * @param len number of bytes available at @a buf; must not be
+ *        smaller than in the previous call for the same line
+ * @return #MHD_YES if the end of the line was found (at
+ *         offset @a scan->pos), #MHD_NO if all @a len bytes
+ *         were scanned without finding it
+ */
+int
+MHD_line_scan_ (struct MHD_LineScan *scan,
+                const char *buf,
+                size_t len)
+{
+  return scan_function (scan, buf, len);
+}
+
+/* end of linescan.c */
@@ -0,0 +1,134 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file linescan.h
+ * @brief scanner for the lines of the HTTP request header that
+ *        finds the end of a line together with its first colon
+ *        and space in a single pass, using SSE2 or AVX2 where
+ *        available, and that can resume where it stopped when
+ *        more data of the line arrives
+ * @author Christian Grothoff
+ */
+
+#ifndef LINESCAN_H
+#define LINESCAN_H
+
+#include "platform.h"
+
+
+/**
+ * State of scanning one line; all-zero is the initial state.
+ */
+struct MHD_LineScan
+{
+
+  /**
+   * Number of bytes of the line scanned so far, or offset
+   * of the CR or LF ending the line once it was found.
+   */
+  size_t pos;
+
+  /**
+   * Offset of the first ':' of the line plus one, 0 if
+   * none was found (yet).
+   */
+  size_t colon;
+
+  /**
+   * Offset of the first ' ' of the line plus one, 0 if
+   * none was found (yet).
+   */
+  size_t space;
+
+};
+
+
+/**
+ * Implementations of the scanner.
+ */
+enum MHD_LineScanImplementation
+{
+
+  /**
+   * Portable byte-by-byte scanner.
+   */
+  MHD_LINE_SCAN_SCALAR = 0,
+
+  /**
+   * Scanner processing 16 bytes at a time with SSE2.
+   */
+  MHD_LINE_SCAN_SSE2 = 1,
+
+  /**
+   * Scanner processing 32 bytes at a time with AVX2.
+   */
+  MHD_LINE_SCAN_AVX2 = 2
+
+};
+
+
+/**
+ * Reset @a scan to start scanning a new line.
+ *
+ * @param scan scan state to reset
+ */
+#define MHD_line_scan_reset_(scan) memset ((scan), 0, sizeof (struct MHD_LineScan))
+
+
+/**
+ * Select the fastest implementation supported by the CPU.
+ * Called once when the library is initialized.
+ */
+void
+MHD_line_scan_init_ (void);
+
+
+/**
+ * Select the implementation of the scanner to use.
+ *
+ * @param impl implementation to use
+ * @return #MHD_YES on success, #MHD_NO if @a impl is not
+ *         supported by the build or the CPU
+ */
+int
+MHD_line_scan_select_ (enum MHD_LineScanImplementation impl);
+
+
+/**
+ * Continue scanning the line starting at @a buf for its end
+ * (the first CR or LF), recording the first colon and space
+ * before the end.
+ *
+ * @param scan scan state of the line, updated
+ * @param buf start of the line
+ * @param len number of bytes available at @a buf; must not be
+ *        smaller than in the previous call for the same line
+ * @return #MHD_YES if the end of the line was found (at
+ *         offset @a scan->pos), #MHD_NO if all @a len bytes
+ *         were scanned without finding it
+ */
+int
+MHD_line_scan_ (struct MHD_LineScan *scan,
+                const char *buf,
+                size_t len);
+
+#endif
+
+/* end of linescan.h */
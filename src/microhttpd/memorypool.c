@@ -257,7 +257,8 @@ MHD_pool_reallocate (struct MemoryPool *pool,
  * the first @a copy_bytes are from @a keep.
  *
  * @param pool memory pool to use for the operation
- * @param keep pointer to the entry to keep (maybe NULL)
+ * @param keep pointer to the entry to keep (maybe NULL, in which
+ *        case everything is released and @a new_size is ignored)
  * @param copy_bytes how many bytes need to be kept at this address
  * @param new_size how many bytes should the allocation we return have?
  *                 (should be larger or equal to @a copy_bytes)
@@ -286,8 +287,127 @@ MHD_pool_reset (struct MemoryPool *pool,
 	  pool->size - copy_bytes);
   if (NULL != keep)
     pool->pos = ROUND_TO_ALIGN (new_size);
+  else
+    pool->pos = 0;
   return keep;
 }
 
 
+/**
+ * Reverse the order of @a size bytes at @a mem.
+ *
+ * @param mem bytes to reverse
+ * @param size number of bytes at @a mem
+ */
+static void
+reverse_bytes (char *mem,
+               size_t size)
+{
+  size_t i;
+  char c;
+
+  for (i = 0; i < size / 2; i++)
+    {
+      c = mem[i];
+      mem[i] = mem[size - 1 - i];
+      mem[size - 1 - i] = c;
+    }
+}
+
+
+/**
+ * Check if the ranges [@a a, @a a + @a a_size) and
+ * [@a b, @a b + @a b_size) of the pool overlap.
+ *
+ * @return #MHD_YES if they overlap
+ */
+static int
+ranges_overlap (size_t a,
+                size_t a_size,
+                size_t b,
+                size_t b_size)
+{
+  return ( (a < b + b_size) &&
+           (b < a + a_size) ) ? MHD_YES : MHD_NO;
+}
+
+
+/**
+ * Like #MHD_pool_reset(), but also keep the @a carry_bytes at
+ * @a *carry.  Afterwards, the pool holds the buffer for @a keep
+ * of @a new_size at its start, followed by the @a carry_bytes.
+ *
+ * @param pool memory pool to use for the operation
+ * @param keep pointer to the entry to keep (must not be NULL)
+ * @param copy_bytes how many bytes need to be kept at this address
+ * @param new_size how many bytes should the allocation we return have?
+ *                 (should be larger or equal to @a copy_bytes)
+ * @param carry pointer to the second entry to keep, updated
+ *        to its new address
+ * @param carry_bytes how many bytes to keep at @a *carry
+ * @return addr new address of @a keep (if it had to change),
+ *         NULL if both entries do not fit into the pool (in
+ *         which case the pool is unchanged)
+ */
+void *
+MHD_pool_reset_carry (struct MemoryPool *pool,
+                      void *keep,
+                      size_t copy_bytes,
+                      size_t new_size,
+                      void **carry,
+                      size_t carry_bytes)
+{
+  size_t keep_off;
+  size_t carry_off;
+  size_t carry_dst;
+
+  keep_off = (char *) keep - pool->memory;
+  carry_off = (char *) *carry - pool->memory;
+  carry_dst = ROUND_TO_ALIGN (new_size);
+  if ( (carry_dst + ROUND_TO_ALIGN (carry_bytes) > pool->size) ||
+       (copy_bytes > new_size) )
+    return NULL;
+  if (MHD_NO == ranges_overlap (0, copy_bytes,
+                                carry_off, carry_bytes))
+    {
+      /* moving @a keep first does not clobber @a carry */
+      memmove (pool->memory, keep, copy_bytes);
+      memmove (&pool->memory[carry_dst], *carry, carry_bytes);
+    }
+  else if (MHD_NO == ranges_overlap (carry_dst, carry_bytes,
+                                     keep_off, copy_bytes))
+    {
+      /* moving @a carry first does not clobber @a keep */
+      memmove (&pool->memory[carry_dst], *carry, carry_bytes);
+      memmove (pool->memory, keep, copy_bytes);
+    }
+  else
+    {
+      /* @a carry lies below @a keep and each is in the way of the
+         other: put them next to each other at the start of the pool
+         (in the wrong order), swap them in place by rotating the
+         bytes, then move @a carry to its place */
+      memmove (pool->memory, *carry, carry_bytes);
+      memmove (&pool->memory[carry_bytes], keep, copy_bytes);
+      reverse_bytes (pool->memory, carry_bytes);
+      reverse_bytes (&pool->memory[carry_bytes], copy_bytes);
+      reverse_bytes (pool->memory, carry_bytes + copy_bytes);
+      memmove (&pool->memory[carry_dst],
+               &pool->memory[copy_bytes],
+               carry_bytes);
+    }
+  pool->end = pool->size;
+  /* technically not needed, but safer to zero out */
+  memset (&pool->memory[copy_bytes],
+          0,
+          carry_dst - copy_bytes);
+  memset (&pool->memory[carry_dst + carry_bytes],
+          0,
+          pool->size - carry_dst - carry_bytes);
+  pool->pos = carry_dst + ROUND_TO_ALIGN (carry_bytes);
+  *carry = &pool->memory[carry_dst];
+  return pool->memory;
+}
+
+
 /* end of memorypool.c */
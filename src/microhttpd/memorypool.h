@@ -104,7 +104,8 @@ MHD_pool_reallocate (struct MemoryPool *pool,
  * the first @a copy_bytes are from @a keep.
  *
  * @param pool memory pool to use for the operation
- * @param keep pointer to the entry to keep (maybe NULL)
+ * @param keep pointer to the entry to keep (maybe NULL, in which
+ *        case everything is released and @a new_size is ignored)
  * @param copy_bytes how many bytes need to be kept at this address
  * @param new_size how many bytes should the allocation we return have?
  *                 (should be larger or equal to @a copy_bytes)
@@ -116,4 +117,30 @@ MHD_pool_reset (struct MemoryPool *pool,
 		size_t copy_bytes,
                 size_t new_size);
 
+
+/**
+ * Like #MHD_pool_reset(), but also keep the @a carry_bytes at
+ * @a *carry.  Afterwards, the pool holds the buffer for @a keep
+ * of @a new_size at its start, followed by the @a carry_bytes.
+ *
+ * @param pool memory pool to use for the operation
+ * @param keep pointer to the entry to keep (must not be NULL)
+ * @param copy_bytes how many bytes need to be kept at this address
+ * @param new_size how many bytes should the allocation we return have?
+ *                 (should be larger or equal to @a copy_bytes)
+ * @param carry pointer to the second entry to keep, updated
+ *        to its new address
+ * @param carry_bytes how many bytes to keep at @a *carry
+ * @return addr new address of @a keep (if it had to change),
+ *         NULL if both entries do not fit into the pool (in
+ *         which case the pool is unchanged)
+ */
+void *
+MHD_pool_reset_carry (struct MemoryPool *pool,
+                      void *keep,
+                      size_t copy_bytes,
+                      size_t new_size,
+                      void **carry,
+                      size_t carry_bytes);
+
 #endif
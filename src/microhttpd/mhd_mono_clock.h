@@ -51,4 +51,14 @@ MHD_monotonic_sec_counter_finish(void);
 time_t
 MHD_monotonic_sec_counter(void);
 
+
+/**
+ * Monotonic milliseconds counter, useful for timeout calculation.
+ * Uses the same clock source as #MHD_monotonic_sec_counter.
+ *
+ * @return number of milliseconds from some fixed moment
+ */
+uint64_t
+MHD_monotonic_msec_counter(void);
+
 #endif /* MHD_MONO_CLOCK_H */
@@ -0,0 +1,382 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2016 Christian Grothoff
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file microhttpd/mhd_uring.c
+ * @brief  minimal wrapper around the Linux io_uring system calls
+ * @author Christian Grothoff
+ */
+
+#include "mhd_uring.h"
+#include "mhd_byteorder.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+
+
+/**
+ * Read a value shared with the kernel.
+ */
+#define URING_LOAD_ACQUIRE(p) __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+
+/**
+ * Publish a value to the kernel.
+ */
+#define URING_STORE_RELEASE(p,v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+
+
+/**
+ * Create a ring.
+ *
+ * @param ring ring to initialize
+ * @param entries minimum number of submission queue entries
+ * @param cq_entries minimum number of completion queue entries
+ * @return 0 on success, -1 on failure (with errno set)
+ */
+int
+MHD_uring_init_ (struct MHD_Uring *ring,
+                 unsigned int entries,
+                 unsigned int cq_entries)
+{
+  struct io_uring_params p;
+  int eno;
+
+  memset (ring, 0, sizeof (struct MHD_Uring));
+  memset (&p, 0, sizeof (p));
+  p.flags = IORING_SETUP_CQSIZE;
+  p.cq_entries = cq_entries;
+  ring->fd = (int) syscall (__NR_io_uring_setup, entries, &p);
+  if (0 > ring->fd)
+    return -1;
+  if ( (0 == (p.features & IORING_FEAT_NODROP)) ||
+       (0 == (p.features & IORING_FEAT_EXT_ARG)) )
+    {
+      /* kernel too old for what we need */
+      (void) close (ring->fd);
+      ring->fd = -1;
+      errno = ENOSYS;
+      return -1;
+    }
+  ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof (unsigned int);
+  ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+  if (0 != (p.features & IORING_FEAT_SINGLE_MMAP))
+    {
+      if (ring->cq_ring_size > ring->sq_ring_size)
+        ring->sq_ring_size = ring->cq_ring_size;
+      ring->cq_ring_size = ring->sq_ring_size;
+    }
+  ring->sq_ring = mmap (NULL, ring->sq_ring_size,
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+  if (MAP_FAILED == ring->sq_ring)
+    goto fail;
+  if (0 != (p.features & IORING_FEAT_SINGLE_MMAP))
+    ring->cq_ring = ring->sq_ring;
+  else
+    {
+      ring->cq_ring = mmap (NULL, ring->cq_ring_size,
+                            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+      if (MAP_FAILED == ring->cq_ring)
+        goto fail;
+    }
+  ring->sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+  ring->sqes = mmap (NULL, ring->sqes_size,
+                     PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring->fd, IORING_OFF_SQES);
+  if (MAP_FAILED == ring->sqes)
+    goto fail;
+  ring->sq_head = (unsigned int *) ((char *) ring->sq_ring + p.sq_off.head);
+  ring->sq_tail = (unsigned int *) ((char *) ring->sq_ring + p.sq_off.tail);
+  ring->sq_mask = *(unsigned int *) ((char *) ring->sq_ring + p.sq_off.ring_mask);
+  ring->sq_entries = p.sq_entries;
+  ring->sq_array = (unsigned int *) ((char *) ring->sq_ring + p.sq_off.array);
+  ring->cq_head = (unsigned int *) ((char *) ring->cq_ring + p.cq_off.head);
+  ring->cq_tail = (unsigned int *) ((char *) ring->cq_ring + p.cq_off.tail);
+  ring->cq_mask = *(unsigned int *) ((char *) ring->cq_ring + p.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ring + p.cq_off.cqes);
+  return 0;
+ fail:
+  eno = errno;
+  if ( (NULL != ring->sqes) && (MAP_FAILED != ring->sqes) )
+    (void) munmap (ring->sqes, ring->sqes_size);
+  if ( (NULL != ring->cq_ring) && (MAP_FAILED != ring->cq_ring) &&
+       (ring->cq_ring != ring->sq_ring) )
+    (void) munmap (ring->cq_ring, ring->cq_ring_size);
+  if ( (NULL != ring->sq_ring) && (MAP_FAILED != ring->sq_ring) )
+    (void) munmap (ring->sq_ring, ring->sq_ring_size);
+  (void) close (ring->fd);
+  memset (ring, 0, sizeof (struct MHD_Uring));
+  ring->fd = -1;
+  errno = eno;
+  return -1;
+}
+
+
+/**
+ * Release all resources associated with a ring.  Operations
+ * still pending in the kernel are cancelled.
+ *
+ * @param ring ring to destroy
+ */
+void
+MHD_uring_fini_ (struct MHD_Uring *ring)
+{
+  if (-1 == ring->fd)
+    return;
+  (void) munmap (ring->sqes, ring->sqes_size);
+  if (ring->cq_ring != ring->sq_ring)
+    (void) munmap (ring->cq_ring, ring->cq_ring_size);
+  (void) munmap (ring->sq_ring, ring->sq_ring_size);
+  (void) close (ring->fd);
+  ring->fd = -1;
+}
+
+
+/**
+ * Obtain a fresh submission queue entry.  If the submission queue
+ * is full, the pending entries are passed to the kernel first.
+ *
+ * @param ring ring to obtain an entry from
+ * @return zeroed entry, NULL if the queue is full and could not
+ *         be flushed
+ */
+struct io_uring_sqe *
+MHD_uring_get_sqe_ (struct MHD_Uring *ring)
+{
+  struct io_uring_sqe *sqe;
+  unsigned int tail;
+  unsigned int idx;
+
+  tail = *ring->sq_tail;
+  if (tail - URING_LOAD_ACQUIRE (ring->sq_head) >= ring->sq_entries)
+    {
+      if ( (0 != MHD_uring_submit_ (ring, 0, 0)) ||
+           (tail - URING_LOAD_ACQUIRE (ring->sq_head) >= ring->sq_entries) )
+        return NULL;
+    }
+  idx = tail & ring->sq_mask;
+  sqe = &ring->sqes[idx];
+  memset (sqe, 0, sizeof (struct io_uring_sqe));
+  ring->sq_array[idx] = idx;
+  URING_STORE_RELEASE (ring->sq_tail, tail + 1);
+  ring->to_submit++;
+  return sqe;
+}
+
+
+/**
+ * Pass all pending submission queue entries to the kernel and
+ * optionally wait for completions.
+ *
+ * @param ring ring to submit for
+ * @param wait_nr number of completions to wait for
+ * @param timeout_ms maximum time to wait in milliseconds,
+ *        -1 to wait without a time limit (ignored if
+ *        @a wait_nr is 0)
+ * @return 0 on success (including timeout or interruption
+ *         by a signal), -1 on error (with errno set)
+ */
+int
+MHD_uring_submit_ (struct MHD_Uring *ring,
+                   unsigned int wait_nr,
+                   int timeout_ms)
+{
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+  unsigned int flags;
+  long ret;
+
+  memset (&arg, 0, sizeof (arg));
+  flags = IORING_ENTER_EXT_ARG;
+  if (0 != wait_nr)
+    {
+      flags |= IORING_ENTER_GETEVENTS;
+      if (0 <= timeout_ms)
+        {
+          ts.tv_sec = timeout_ms / 1000;
+          ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+          arg.ts = (uint64_t) (uintptr_t) &ts;
+        }
+    }
+  else if (0 == ring->to_submit)
+    return 0;
+  ret = syscall (__NR_io_uring_enter, ring->fd, ring->to_submit, wait_nr,
+                 flags, &arg, sizeof (arg));
+  if (0 > ret)
+    {
+      if ( (EINTR == errno) || (ETIME == errno) || (EBUSY == errno) )
+        return 0;
+      return -1;
+    }
+  ring->to_submit -= (unsigned int) ret;
+  return 0;
+}
+
+
+/**
+ * Obtain the next completion queue entry, if any.  The entry
+ * stays valid until #MHD_uring_cqe_seen_ is called.
+ *
+ * @param ring ring to check
+ * @return NULL if no completions are available
+ */
+struct io_uring_cqe *
+MHD_uring_peek_cqe_ (struct MHD_Uring *ring)
+{
+  unsigned int head;
+
+  head = *ring->cq_head;
+  if (head == URING_LOAD_ACQUIRE (ring->cq_tail))
+    return NULL;
+  return &ring->cqes[head & ring->cq_mask];
+}
+
+
+/**
+ * Mark the completion returned by #MHD_uring_peek_cqe_ as consumed.
+ *
+ * @param ring ring the entry was obtained from
+ */
+void
+MHD_uring_cqe_seen_ (struct MHD_Uring *ring)
+{
+  URING_STORE_RELEASE (ring->cq_head, *ring->cq_head + 1);
+}
+
+
+/**
+ * Prepare @a sqe to receive data from a socket.
+ *
+ * @param sqe entry to fill in
+ * @param fd socket to read from
+ * @param buf where to store the data
+ * @param len number of bytes available in @a buf
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_recv_ (struct io_uring_sqe *sqe,
+                      int fd,
+                      void *buf,
+                      size_t len,
+                      uint64_t user_data)
+{
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) (uintptr_t) buf;
+  sqe->len = (uint32_t) len;
+  sqe->user_data = user_data;
+}
+
+
+/**
+ * Prepare @a sqe to send data over a socket (without raising SIGPIPE).
+ *
+ * @param sqe entry to fill in
+ * @param fd socket to write to
+ * @param buf data to send
+ * @param len number of bytes in @a buf
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_send_ (struct io_uring_sqe *sqe,
+                      int fd,
+                      const void *buf,
+                      size_t len,
+                      uint64_t user_data)
+{
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) (uintptr_t) buf;
+  sqe->len = (uint32_t) len;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = user_data;
+}
+
+
+/**
+ * Prepare @a sqe to wait (once) for events on a file descriptor.
+ *
+ * @param sqe entry to fill in
+ * @param fd file descriptor to watch
+ * @param events `poll()` event mask to wait for
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_poll_ (struct io_uring_sqe *sqe,
+                      int fd,
+                      unsigned int events,
+                      uint64_t user_data)
+{
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+#if _MHD_BYTE_ORDER == _MHD_BIG_ENDIAN
+  /* the kernel expects the two halves word-swapped on big endian */
+  events = (events << 16) | (events >> 16);
+#endif
+  sqe->poll32_events = events;
+  sqe->user_data = user_data;
+}
+
+
+/**
+ * Prepare @a sqe to accept a connection on a listen socket.  The
+ * new socket is created non-blocking and close-on-exec.
+ *
+ * @param sqe entry to fill in
+ * @param fd listen socket
+ * @param addr where to store the address of the client
+ * @param addrlen in: size of @a addr, out: length of the address
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_accept_ (struct io_uring_sqe *sqe,
+                        int fd,
+                        struct sockaddr *addr,
+                        socklen_t *addrlen,
+                        uint64_t user_data)
+{
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) (uintptr_t) addr;
+  sqe->addr2 = (uint64_t) (uintptr_t) addrlen;
+  sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  sqe->user_data = user_data;
+}
+
+
+/**
+ * Prepare @a sqe to cancel a pending operation.
+ *
+ * @param sqe entry to fill in
+ * @param target user data of the operation to cancel
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_cancel_ (struct io_uring_sqe *sqe,
+                        uint64_t target,
+                        uint64_t user_data)
+{
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = target;
+  sqe->user_data = user_data;
+}
+
+/* end of mhd_uring.c */
@@ -0,0 +1,286 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2016 Christian Grothoff
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file microhttpd/mhd_uring.h
+ * @brief  minimal wrapper around the Linux io_uring system calls
+ * @author Christian Grothoff
+ *
+ * We talk to the kernel directly instead of depending on liburing;
+ * MHD only needs a single submission and completion queue per
+ * event loop thread, so the ring setup and a handful of accessors
+ * are all there is to it.
+ */
+
+#ifndef MHD_URING_H
+#define MHD_URING_H 1
+#include "platform.h"
+#include <linux/io_uring.h>
+#include <poll.h>
+
+
+/**
+ * State of one io_uring instance (one per event loop thread).
+ * Must only ever be used from a single thread.
+ */
+struct MHD_Uring
+{
+
+  /**
+   * File descriptor of the ring, -1 if not initialized.
+   */
+  int fd;
+
+  /**
+   * Number of SQEs we have filled in but not yet passed to the kernel.
+   */
+  unsigned int to_submit;
+
+  /**
+   * Mapping of the submission queue ring.
+   */
+  void *sq_ring;
+
+  /**
+   * Size of @e sq_ring.
+   */
+  size_t sq_ring_size;
+
+  /**
+   * Mapping of the completion queue ring (may be equal to
+   * @e sq_ring if the kernel supports a single mapping).
+   */
+  void *cq_ring;
+
+  /**
+   * Size of @e cq_ring.
+   */
+  size_t cq_ring_size;
+
+  /**
+   * Array of submission queue entries.
+   */
+  struct io_uring_sqe *sqes;
+
+  /**
+   * Size of @e sqes (in bytes).
+   */
+  size_t sqes_size;
+
+  /**
+   * Submission queue head (written by the kernel).
+   */
+  unsigned int *sq_head;
+
+  /**
+   * Submission queue tail (written by us).
+   */
+  unsigned int *sq_tail;
+
+  /**
+   * Submission queue index mask.
+   */
+  unsigned int sq_mask;
+
+  /**
+   * Number of entries in the submission queue.
+   */
+  unsigned int sq_entries;
+
+  /**
+   * Indirection array of the submission queue.
+   */
+  unsigned int *sq_array;
+
+  /**
+   * Completion queue head (written by us).
+   */
+  unsigned int *cq_head;
+
+  /**
+   * Completion queue tail (written by the kernel).
+   */
+  unsigned int *cq_tail;
+
+  /**
+   * Completion queue index mask.
+   */
+  unsigned int cq_mask;
+
+  /**
+   * Array of completion queue entries.
+   */
+  struct io_uring_cqe *cqes;
+};
+
+
+/**
+ * Create a ring.
+ *
+ * @param ring ring to initialize
+ * @param entries minimum number of submission queue entries
+ * @param cq_entries minimum number of completion queue entries
+ * @return 0 on success, -1 on failure (with errno set)
+ */
+int
+MHD_uring_init_ (struct MHD_Uring *ring,
+                 unsigned int entries,
+                 unsigned int cq_entries);
+
+
+/**
+ * Release all resources associated with a ring.  Operations
+ * still pending in the kernel are cancelled.
+ *
+ * @param ring ring to destroy
+ */
+void
+MHD_uring_fini_ (struct MHD_Uring *ring);
+
+
+/**
+ * Obtain a fresh submission queue entry.  If the submission queue
+ * is full, the pending entries are passed to the kernel first.
+ *
+ * @param ring ring to obtain an entry from
+ * @return zeroed entry, NULL if the queue is full and could not
+ *         be flushed
+ */
+struct io_uring_sqe *
+MHD_uring_get_sqe_ (struct MHD_Uring *ring);
+
+
+/**
+ * Pass all pending submission queue entries to the kernel and
+ * optionally wait for completions.
+ *
+ * @param ring ring to submit for
+ * @param wait_nr number of completions to wait for
+ * @param timeout_ms maximum time to wait in milliseconds,
+ *        -1 to wait without a time limit (ignored if
+ *        @a wait_nr is 0)
+ * @return 0 on success (including timeout or interruption
+ *         by a signal), -1 on error (with errno set)
+ */
+int
+MHD_uring_submit_ (struct MHD_Uring *ring,
+                   unsigned int wait_nr,
+                   int timeout_ms);
+
+
+/**
+ * Obtain the next completion queue entry, if any.  The entry
+ * stays valid until #MHD_uring_cqe_seen_ is called.
+ *
+ * @param ring ring to check
+ * @return NULL if no completions are available
+ */
+struct io_uring_cqe *
+MHD_uring_peek_cqe_ (struct MHD_Uring *ring);
+
+
+/**
+ * Mark the completion returned by #MHD_uring_peek_cqe_ as consumed.
+ *
+ * @param ring ring the entry was obtained from
+ */
+void
+MHD_uring_cqe_seen_ (struct MHD_Uring *ring);
+
+
+/**
+ * Prepare @a sqe to receive data from a socket.
+ *
+ * @param sqe entry to fill in
+ * @param fd socket to read from
+ * @param buf where to store the data
+ * @param len number of bytes available in @a buf
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_recv_ (struct io_uring_sqe *sqe,
+                      int fd,
+                      void *buf,
+                      size_t len,
+                      uint64_t user_data);
+
+
+/**
+ * Prepare @a sqe to send data over a socket (without raising SIGPIPE).
+ *
+ * @param sqe entry to fill in
+ * @param fd socket to write to
+ * @param buf data to send
+ * @param len number of bytes in @a buf
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_send_ (struct io_uring_sqe *sqe,
+                      int fd,
+                      const void *buf,
+                      size_t len,
+                      uint64_t user_data);
+
+
+/**
+ * Prepare @a sqe to wait (once) for events on a file descriptor.
+ *
+ * @param sqe entry to fill in
+ * @param fd file descriptor to watch
+ * @param events `poll()` event mask to wait for
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_poll_ (struct io_uring_sqe *sqe,
+                      int fd,
+                      unsigned int events,
+                      uint64_t user_data);
+
+
+/**
+ * Prepare @a sqe to accept a connection on a listen socket.  The
+ * new socket is created non-blocking and close-on-exec.
+ *
+ * @param sqe entry to fill in
+ * @param fd listen socket
+ * @param addr where to store the address of the client
+ * @param addrlen in: size of @a addr, out: length of the address
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_accept_ (struct io_uring_sqe *sqe,
+                        int fd,
+                        struct sockaddr *addr,
+                        socklen_t *addrlen,
+                        uint64_t user_data);
+
+
+/**
+ * Prepare @a sqe to cancel a pending operation.
+ *
+ * @param sqe entry to fill in
+ * @param target user data of the operation to cancel
+ * @param user_data value to return in the completion
+ */
+void
+MHD_uring_prep_cancel_ (struct io_uring_sqe *sqe,
+                        uint64_t target,
+                        uint64_t user_data);
+
+#endif /* MHD_URING_H */
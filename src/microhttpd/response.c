@@ -40,6 +40,31 @@
 #include <io.h> /* for lseek(), read() */
 #endif /* _WIN32 */
 
+/**
+ * Size of the buffer used to combine the segments of a response
+ * created from an iovec if they cannot be sent directly (TLS); one
+ * full TLS record.
+ */
+#define MHD_IOVEC_BLOCK_SIZE (16 * 1024)
+
+
+/**
+ * Mark the serialized headers cached in @a response as outdated,
+ * as its headers changed.  The block itself is only replaced by
+ * the next connection that copies it, under the mutex of the
+ * response; this function must not take the mutex, as headers
+ * may be added from the content reader, which runs while the
+ * mutex is held.
+ *
+ * @param response response to update
+ */
+static void
+invalidate_header_block (struct MHD_Response *response)
+{
+  MHD_counter_store_ (&response->header_generation,
+                      response->header_generation + 1);
+}
+
 
 /**
  * Add a header or footer line to the response.
@@ -86,6 +111,8 @@ add_response_entry (struct MHD_Response *response,
   hdr->kind = kind;
   hdr->next = response->first_header;
   response->first_header = hdr;
+  if (MHD_HEADER_KIND == kind)
+    invalidate_header_block (response);
   return MHD_YES;
 }
 
@@ -156,6 +183,8 @@ MHD_del_response_header (struct MHD_Response *response,
       if ((0 == strcmp (header, pos->header)) &&
           (0 == strcmp (content, pos->value)))
         {
+          if (MHD_HEADER_KIND == pos->kind)
+            invalidate_header_block (response);
           free (pos->header);
           free (pos->value);
           if (NULL == prev)
@@ -251,11 +280,10 @@ MHD_create_response_from_callback (uint64_t size,
 
   if ((NULL == crc) || (0 == block_size))
     return NULL;
-  if (NULL == (response = malloc (sizeof (struct MHD_Response) + block_size)))
+  if (NULL == (response = malloc (sizeof (struct MHD_Response))))
     return NULL;
   memset (response, 0, sizeof (struct MHD_Response));
   response->fd = -1;
-  response->data = (void *) &response[1];
   response->data_buffer_size = block_size;
   if (MHD_YES != MHD_mutex_create_ (&response->mutex))
     {
@@ -484,6 +512,826 @@ MHD_create_response_from_fd64(uint64_t size,
 }
 
 
+/**
+ * Given a response created from an iovec, copy data from the segments
+ * into the provided buffer.
+ *
+ * @param cls pointer to the response
+ * @param pos offset in the data of the response
+ * @param buf where to write the data
+ * @param max number of bytes to write at most
+ * @return number of bytes written
+ */
+static ssize_t
+iovec_reader (void *cls,
+              uint64_t pos,
+              char *buf,
+              size_t max)
+{
+  struct MHD_Response *response = cls;
+  const struct MHD_IoVec *iov;
+  unsigned int i;
+  size_t off;
+  size_t len;
+
+  for (i = 0; i < response->iov_cnt; i++)
+    {
+      if (pos < response->iov[i].iov_len)
+        break;
+      pos -= response->iov[i].iov_len;
+    }
+  off = 0;
+  for (; (i < response->iov_cnt) && (off < max); i++)
+    {
+      iov = &response->iov[i];
+      len = MHD_MIN (iov->iov_len - (size_t) pos, max - off);
+      memcpy (&buf[off],
+              (const char *) iov->iov_base + (size_t) pos,
+              len);
+      off += len;
+      pos = 0;
+    }
+  if (0 == off)
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  return off;
+}
+
+
+/**
+ * Release the segments of a response created from an iovec.
+ *
+ * @param cls pointer to the response
+ */
+static void
+iovec_free (void *cls)
+{
+  struct MHD_Response *response = cls;
+  unsigned int i;
+
+  for (i = 0; i < response->iov_cnt; i++)
+    if (NULL != response->iov[i].free_cb)
+      response->iov[i].free_cb (response->iov[i].free_cls);
+  free (response->iov);
+  response->iov = NULL;
+}
+
+
+/**
+ * Create a response object whose data is the concatenation of the
+ * given segments, without copying them.  The response object can be
+ * extended with header information and then be used any number of
+ * times.
+ *
+ * @param iov segments of the data portion of the response; the array
+ *        itself is copied, the segments are not
+ * @param iovcnt number of entries in @a iov
+ * @return NULL on error (i.e. invalid arguments, out of memory)
+ * @ingroup response
+ */
+struct MHD_Response *
+MHD_create_response_from_iovec (const struct MHD_IoVec *iov,
+                                unsigned int iovcnt)
+{
+  struct MHD_Response *response;
+  struct MHD_IoVec *copy;
+  uint64_t total;
+  unsigned int i;
+
+  if ( (NULL == iov) && (0 < iovcnt) )
+    return NULL;
+  total = 0;
+  for (i = 0; i < iovcnt; i++)
+    {
+      if ( (NULL == iov[i].iov_base) &&
+           (0 < iov[i].iov_len) )
+        return NULL;
+      total += iov[i].iov_len;
+    }
+  copy = NULL;
+  if ( (0 < iovcnt) &&
+       (NULL == (copy = malloc (iovcnt * sizeof (struct MHD_IoVec)))) )
+    return NULL;
+  response = MHD_create_response_from_callback (total,
+                                                MHD_IOVEC_BLOCK_SIZE,
+                                                &iovec_reader,
+                                                NULL,
+                                                &iovec_free);
+  if (NULL == response)
+    {
+      free (copy);
+      return NULL;
+    }
+  if (0 < iovcnt)
+    memcpy (copy, iov, iovcnt * sizeof (struct MHD_IoVec));
+  response->iov = copy;
+  response->iov_cnt = iovcnt;
+  response->crc_cls = response;
+  /* iovec_reader() only reads immutable state */
+  response->flags |= MHD_RF_THREAD_SAFE_READER;
+  return response;
+}
+
+
+/**
+ * Get the buffer pushed after @a buf (to a response created with
+ * #MHD_create_response_for_push()).
+ *
+ * @param response the response
+ * @param buf a buffer of the queue of @a response
+ * @return NULL if no buffer follows @a buf (yet)
+ */
+static struct MHD_PushBuffer *
+push_next (struct MHD_Response *response,
+           struct MHD_PushBuffer *buf)
+{
+#if HAVE_ATOMIC_BUILTINS
+  return __atomic_load_n (&buf->next, __ATOMIC_SEQ_CST);
+#else
+  struct MHD_PushBuffer *next;
+
+  (void) MHD_mutex_lock_ (&response->mutex);
+  next = buf->next;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+  return next;
+#endif
+}
+
+
+/**
+ * Check whether data may be pushed to @a response, that is whether
+ * the queued data is below the high-water mark.  If not, remember
+ * that the drained callback has to be called.
+ *
+ * @param response the response
+ * @return #MHD_YES if data may be pushed
+ */
+static int
+push_below_high_water (struct MHD_Response *response)
+{
+  struct MHD_PushQueue *q = response->push;
+#if HAVE_ATOMIC_BUILTINS
+
+  if (__atomic_load_n (&q->queued, __ATOMIC_SEQ_CST) < q->high_water)
+    return MHD_YES;
+  __atomic_store_n (&q->refused, MHD_YES, __ATOMIC_SEQ_CST);
+  /* the connection may have drained the queue before it could see
+     the flag, in which case it will not call the drained callback */
+  if (__atomic_load_n (&q->queued, __ATOMIC_SEQ_CST) < q->high_water)
+    return MHD_YES;
+  return MHD_NO;
+#else
+  int ret;
+
+  (void) MHD_mutex_lock_ (&response->mutex);
+  ret = (q->queued < q->high_water) ? MHD_YES : MHD_NO;
+  if (MHD_NO == ret)
+    q->refused = MHD_YES;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+  return ret;
+#endif
+}
+
+
+/**
+ * Signal the connection waiting for data to be pushed to
+ * @a response, if any.
+ *
+ * @param response the response
+ */
+static void
+push_wake (struct MHD_Response *response)
+{
+  struct MHD_PushQueue *q = response->push;
+  struct MHD_Connection *waiter;
+
+  /* only one producer gets the waiter; the connection cannot go away
+     until we are done signalling it, see MHD_response_push_detach_() */
+#if HAVE_ATOMIC_BUILTINS
+  if (NULL == __atomic_load_n (&q->waiter, __ATOMIC_SEQ_CST))
+    return;
+  (void) __atomic_add_fetch (&q->waking, 1, __ATOMIC_SEQ_CST);
+  waiter = __atomic_exchange_n (&q->waiter, NULL, __ATOMIC_SEQ_CST);
+  if (NULL != waiter)
+    MHD_response_data_ready (waiter);
+  (void) __atomic_sub_fetch (&q->waking, 1, __ATOMIC_SEQ_CST);
+#else
+  (void) MHD_mutex_lock_ (&response->mutex);
+  waiter = q->waiter;
+  q->waiter = NULL;
+  if (NULL != waiter)
+    q->waking++;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+  if (NULL == waiter)
+    return;
+  MHD_response_data_ready (waiter);
+  (void) MHD_mutex_lock_ (&response->mutex);
+  q->waking--;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
+}
+
+
+/**
+ * Given a response created for push, copy the queued data into the
+ * provided buffer (if the connection cannot send the buffers
+ * directly).
+ *
+ * @param cls pointer to the response
+ * @param pos offset in the data of the response (unused, the data
+ *        is consumed in order)
+ * @param buf where to write the data
+ * @param max number of bytes to write at most
+ * @return number of bytes written
+ */
+static ssize_t
+push_reader (void *cls,
+             uint64_t pos,
+             char *buf,
+             size_t max)
+{
+  struct MHD_Response *response = cls;
+  struct MHD_PushQueue *q = response->push;
+  struct MHD_PushBuffer *pb;
+  size_t off;
+  size_t len;
+  size_t ret;
+  int ended;
+
+  /* once ended, all of the data is linked */
+  ended = MHD_response_push_ended_ (response);
+  if (MHD_YES == MHD_response_push_aborted_ (response))
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  ret = 0;
+  off = q->tail_off;
+  for (pb = push_next (response, q->tail);
+       (NULL != pb) && (ret < max);
+       pb = push_next (response, pb))
+    {
+      len = MHD_MIN (pb->size - off, max - ret);
+      memcpy (&buf[ret], &pb->data[off], len);
+      ret += len;
+      off = 0;
+    }
+  if (0 < ret)
+    {
+      MHD_response_push_consume_ (response, ret);
+      return ret;
+    }
+  if (MHD_NO == ended)
+    return MHD_CONTENT_READER_WAIT;
+  if (MHD_SIZE_UNKNOWN == response->total_size)
+    return MHD_CONTENT_READER_END_OF_STREAM;
+  return MHD_CONTENT_READER_END_WITH_ERROR;
+}
+
+
+/**
+ * Release the queued buffers of a response created for push.
+ *
+ * @param cls pointer to the response
+ */
+static void
+push_free (void *cls)
+{
+  struct MHD_Response *response = cls;
+  struct MHD_PushQueue *q = response->push;
+  struct MHD_PushBuffer *pb;
+  struct MHD_PushBuffer *next;
+  int must_free;
+
+  for (pb = q->tail; NULL != pb; pb = next)
+    {
+      next = pb->next;
+      /* the free callback of an embedded buffer may release 'pb' */
+      must_free = ( (&q->stub != pb) &&
+                    (MHD_NO == pb->embedded) );
+      if (NULL != pb->free_cb)
+        pb->free_cb (pb->free_cls);
+      if (must_free)
+        free (pb);
+    }
+  free (q);
+  response->push = NULL;
+}
+
+
+/**
+ * Create a response object whose data is pushed by the application
+ * with #MHD_response_push() while the response is being sent.  The
+ * response can only be queued for one connection.
+ *
+ * @param size size of the data portion of the response,
+ *        #MHD_SIZE_UNKNOWN for unknown
+ * @param high_water number of queued bytes from which on
+ *        #MHD_response_push() refuses further data, 0 for no limit
+ * @param drained_cb function to call once queued data fell below half
+ *        of @a high_water after data was refused, NULL for none
+ * @param drained_cls closure for @a drained_cb
+ * @return NULL on error (i.e. out of memory)
+ * @ingroup response
+ */
+struct MHD_Response *
+MHD_create_response_for_push (uint64_t size,
+                              size_t high_water,
+                              MHD_ResponseDrainedCallback drained_cb,
+                              void *drained_cls)
+{
+  struct MHD_Response *response;
+  struct MHD_PushQueue *q;
+
+  if (NULL == (q = malloc (sizeof (struct MHD_PushQueue))))
+    return NULL;
+  memset (q, 0, sizeof (struct MHD_PushQueue));
+  response = MHD_create_response_from_callback (size,
+                                                MHD_IOVEC_BLOCK_SIZE,
+                                                &push_reader,
+                                                NULL,
+                                                &push_free);
+  if (NULL == response)
+    {
+      free (q);
+      return NULL;
+    }
+  q->head = &q->stub;
+  q->tail = &q->stub;
+  q->stub.embedded = MHD_NO;
+  q->high_water = high_water;
+  q->drained_cb = drained_cb;
+  q->drained_cls = drained_cls;
+  q->refused = MHD_NO;
+  q->ended = MHD_NO;
+  q->aborted = MHD_NO;
+  q->attached = MHD_NO;
+  response->push = q;
+  response->crc_cls = response;
+  /* only the connection of the response calls push_reader() */
+  response->flags |= MHD_RF_THREAD_SAFE_READER;
+  return response;
+}
+
+
+/**
+ * Append a buffer to the data of a response created with
+ * #MHD_create_response_for_push().  Can be called from any thread.
+ *
+ * @param response the response
+ * @param buf data to append; must stay valid and unchanged until
+ *        @a free_cb is called
+ * @param len number of bytes in @a buf, must not be 0
+ * @param free_cb function to call once @a buf was sent (or the
+ *        response is destroyed), NULL for none
+ * @param free_cls closure for @a free_cb
+ * @return #MHD_YES if the buffer was queued, #MHD_NO if not
+ * @ingroup response
+ */
+int
+MHD_response_push (struct MHD_Response *response,
+                   const void *buf,
+                   size_t len,
+                   MHD_ContentReaderFreeCallback free_cb,
+                   void *free_cls)
+{
+  struct MHD_PushBuffer *pb;
+
+  if ( (NULL == response) ||
+       (NULL == response->push) ||
+       (NULL == buf) ||
+       (0 == len) )
+    return MHD_NO;
+  if (NULL == (pb = malloc (sizeof (struct MHD_PushBuffer))))
+    return MHD_NO;
+  pb->data = buf;
+  pb->size = len;
+  pb->free_cb = free_cb;
+  pb->free_cls = free_cls;
+  pb->embedded = MHD_NO;
+  if (MHD_YES != MHD_response_push_buffer_ (response, pb))
+    {
+      free (pb);
+      return MHD_NO;
+    }
+  push_wake (response);
+  return MHD_YES;
+}
+
+
+/**
+ * Append the buffer described by @a pb to the data of @a response,
+ * created with #MHD_create_response_for_push(), without signalling
+ * the connection (see #MHD_response_push_wake_()).  Can be called
+ * from any thread.
+ *
+ * @param response the response
+ * @param pb the buffer, with all fields but @e next set; owned by
+ *        the response if it was queued
+ * @return #MHD_YES if the buffer was queued, #MHD_NO if not
+ */
+int
+MHD_response_push_buffer_ (struct MHD_Response *response,
+                           struct MHD_PushBuffer *pb)
+{
+  struct MHD_PushQueue *q = response->push;
+  size_t len = pb->size;
+#if HAVE_ATOMIC_BUILTINS
+  struct MHD_PushBuffer *prev;
+  uint64_t pushed;
+#endif
+
+  if (MHD_YES == MHD_response_push_ended_ (response))
+    return MHD_NO;
+  if ( (0 != q->high_water) &&
+       (MHD_YES != push_below_high_water (response)) )
+    return MHD_NO;
+  pb->next = NULL;
+#if HAVE_ATOMIC_BUILTINS
+  pushed = __atomic_load_n (&q->pushed, __ATOMIC_RELAXED);
+  do
+    {
+      if ( (MHD_SIZE_UNKNOWN != response->total_size) &&
+           (pushed + len > response->total_size) )
+        return MHD_NO;
+    }
+  while (! __atomic_compare_exchange_n (&q->pushed,
+                                        &pushed,
+                                        pushed + len,
+                                        0,
+                                        __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED));
+  prev = __atomic_exchange_n (&q->head, pb, __ATOMIC_ACQ_REL);
+  __atomic_store_n (&prev->next, pb, __ATOMIC_SEQ_CST);
+  (void) __atomic_add_fetch (&q->queued, len, __ATOMIC_SEQ_CST);
+#else
+  (void) MHD_mutex_lock_ (&response->mutex);
+  if ( (MHD_SIZE_UNKNOWN != response->total_size) &&
+       (q->pushed + len > response->total_size) )
+    {
+      (void) MHD_mutex_unlock_ (&response->mutex);
+      return MHD_NO;
+    }
+  q->pushed += len;
+  q->head->next = pb;
+  q->head = pb;
+  q->queued += len;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
+  return MHD_YES;
+}
+
+
+/**
+ * Signal the connection of @a response, created with
+ * #MHD_create_response_for_push(), if it waits for data.  Must not
+ * be called while holding locks the event loop may need.
+ *
+ * @param response the response
+ */
+void
+MHD_response_push_wake_ (struct MHD_Response *response)
+{
+  push_wake (response);
+}
+
+
+/**
+ * End the data of a response created with
+ * #MHD_create_response_for_push().
+ *
+ * @param response the response
+ * @return #MHD_NO on invalid arguments or if the stream was already
+ *         ended
+ * @ingroup response
+ */
+int
+MHD_response_push_end (struct MHD_Response *response)
+{
+  struct MHD_PushQueue *q;
+  int ended;
+
+  if ( (NULL == response) ||
+       (NULL == (q = response->push)) )
+    return MHD_NO;
+#if HAVE_ATOMIC_BUILTINS
+  ended = __atomic_exchange_n (&q->ended, MHD_YES, __ATOMIC_SEQ_CST);
+#else
+  (void) MHD_mutex_lock_ (&response->mutex);
+  ended = q->ended;
+  q->ended = MHD_YES;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
+  if (MHD_YES == ended)
+    return MHD_NO;
+  push_wake (response);
+  return MHD_YES;
+}
+
+
+/**
+ * End the data of @a response, created with
+ * #MHD_create_response_for_push(), with an error: the connection is
+ * closed without sending the remaining data.  The caller must signal
+ * the connection with #MHD_response_push_wake_() afterwards.
+ *
+ * @param response the response
+ */
+void
+MHD_response_push_abort_ (struct MHD_Response *response)
+{
+  struct MHD_PushQueue *q = response->push;
+
+#if HAVE_ATOMIC_BUILTINS
+  __atomic_store_n (&q->aborted, MHD_YES, __ATOMIC_SEQ_CST);
+  __atomic_store_n (&q->ended, MHD_YES, __ATOMIC_SEQ_CST);
+#else
+  (void) MHD_mutex_lock_ (&response->mutex);
+  q->aborted = MHD_YES;
+  q->ended = MHD_YES;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
+}
+
+
+/**
+ * Check whether the data of @a response ended with an error (see
+ * MHD_response_push_abort_()).
+ *
+ * @param response the response
+ * @return #MHD_YES if the connection has to be closed
+ */
+int
+MHD_response_push_aborted_ (struct MHD_Response *response)
+{
+#if HAVE_ATOMIC_BUILTINS
+  return __atomic_load_n (&response->push->aborted, __ATOMIC_SEQ_CST);
+#else
+  int aborted;
+
+  (void) MHD_mutex_lock_ (&response->mutex);
+  aborted = response->push->aborted;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+  return aborted;
+#endif
+}
+
+
+/**
+ * Mark a response created with #MHD_create_response_for_push() as
+ * queued for a connection.
+ *
+ * @param response the response
+ * @return #MHD_NO if the response was already queued
+ */
+int
+MHD_response_push_attach_ (struct MHD_Response *response)
+{
+  struct MHD_PushQueue *q = response->push;
+  int ret;
+
+  (void) MHD_mutex_lock_ (&response->mutex);
+  ret = (MHD_YES == q->attached) ? MHD_NO : MHD_YES;
+  q->attached = MHD_YES;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+  return ret;
+}
+
+
+/**
+ * Forget that @a connection waits for data to be pushed to
+ * @a response, as the connection is done with the response.
+ * Waits for producers that are still signalling the connection.
+ *
+ * @param response the response
+ * @param connection the connection
+ */
+void
+MHD_response_push_detach_ (struct MHD_Response *response,
+                           struct MHD_Connection *connection)
+{
+  struct MHD_PushQueue *q = response->push;
+#if HAVE_ATOMIC_BUILTINS
+  struct MHD_Connection *expected;
+
+  expected = connection;
+  (void) __atomic_compare_exchange_n (&q->waiter,
+                                      &expected,
+                                      NULL,
+                                      0,
+                                      __ATOMIC_SEQ_CST,
+                                      __ATOMIC_SEQ_CST);
+  /* a producer may have taken the connection out just before */
+  while (0 != __atomic_load_n (&q->waking, __ATOMIC_SEQ_CST))
+    (void) usleep (1);
+#else
+  (void) MHD_mutex_lock_ (&response->mutex);
+  if (connection == q->waiter)
+    q->waiter = NULL;
+  while (0 != q->waking)
+    {
+      (void) MHD_mutex_unlock_ (&response->mutex);
+      (void) usleep (1);
+      (void) MHD_mutex_lock_ (&response->mutex);
+    }
+  (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
+}
+
+
+/**
+ * Register @a connection to be signalled with
+ * #MHD_response_data_ready() once data is pushed to @a response
+ * (or the stream is ended).
+ *
+ * @param response the response
+ * @param connection the connection
+ * @return #MHD_YES if the connection has to wait, #MHD_NO if data
+ *         was pushed (or the stream was ended) meanwhile
+ */
+int
+MHD_response_push_wait_ (struct MHD_Response *response,
+                         struct MHD_Connection *connection)
+{
+  struct MHD_PushQueue *q = response->push;
+
+#if HAVE_ATOMIC_BUILTINS
+  __atomic_store_n (&q->waiter, connection, __ATOMIC_SEQ_CST);
+#else
+  (void) MHD_mutex_lock_ (&response->mutex);
+  q->waiter = connection;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
+  /* a producer that pushed before it could see the waiter did not
+     signal the connection */
+  if ( (MHD_YES == MHD_response_push_ended_ (response)) ||
+       (NULL != push_next (response, q->tail)) )
+    return MHD_NO;
+  return MHD_YES;
+}
+
+
+/**
+ * Check whether #MHD_response_push_end() was called for @a response.
+ * If so, all of the data is visible to the connection.
+ *
+ * @param response the response
+ * @return #MHD_YES if the stream was ended
+ */
+int
+MHD_response_push_ended_ (struct MHD_Response *response)
+{
+#if HAVE_ATOMIC_BUILTINS
+  return __atomic_load_n (&response->push->ended, __ATOMIC_SEQ_CST);
+#else
+  int ended;
+
+  (void) MHD_mutex_lock_ (&response->mutex);
+  ended = response->push->ended;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+  return ended;
+#endif
+}
+
+
+/**
+ * Count the bytes pushed to @a response and not yet consumed.
+ *
+ * @param response the response
+ * @param max_buffers maximum number of buffers to look at
+ * @param limit maximum number of bytes to count
+ * @return number of bytes available, at most @a limit
+ */
+size_t
+MHD_response_push_peek_ (struct MHD_Response *response,
+                         unsigned int max_buffers,
+                         size_t limit)
+{
+  struct MHD_PushQueue *q = response->push;
+  struct MHD_PushBuffer *pb;
+  size_t off;
+  size_t ret;
+
+  ret = 0;
+  off = q->tail_off;
+  for (pb = push_next (response, q->tail);
+       (NULL != pb) && (0 < max_buffers) && (ret < limit);
+       pb = push_next (response, pb))
+    {
+      ret += pb->size - off;
+      off = 0;
+      max_buffers--;
+    }
+  return MHD_MIN (ret, limit);
+}
+
+
+#if SENDV_SUPPORT
+/**
+ * Fill @a iov with the data pushed to @a response and not yet
+ * consumed.
+ *
+ * @param response the response
+ * @param iov where to store the buffers
+ * @param max number of entries in @a iov
+ * @param limit maximum number of bytes to store
+ * @return number of entries used in @a iov
+ */
+unsigned int
+MHD_response_push_gather_ (struct MHD_Response *response,
+                           struct iovec *iov,
+                           unsigned int max,
+                           size_t limit)
+{
+  struct MHD_PushQueue *q = response->push;
+  struct MHD_PushBuffer *pb;
+  unsigned int cnt;
+  size_t off;
+
+  cnt = 0;
+  off = q->tail_off;
+  for (pb = push_next (response, q->tail);
+       (NULL != pb) && (cnt < max) && (0 < limit);
+       pb = push_next (response, pb))
+    {
+      iov[cnt].iov_base = (void *) &pb->data[off];
+      iov[cnt].iov_len = MHD_MIN (pb->size - off, limit);
+      limit -= iov[cnt].iov_len;
+      cnt++;
+      off = 0;
+    }
+  return cnt;
+}
+#endif
+
+
+/**
+ * Mark @a size bytes of the data pushed to @a response as sent,
+ * releasing the buffers that were sent completely.
+ *
+ * @param response the response
+ * @param size number of bytes sent
+ */
+void
+MHD_response_push_consume_ (struct MHD_Response *response,
+                            size_t size)
+{
+  struct MHD_PushQueue *q = response->push;
+  struct MHD_PushBuffer *pb;
+  struct MHD_PushBuffer *old;
+  size_t queued;
+  size_t left;
+  int drained;
+
+  if (0 == size)
+    return;
+  queued = size;
+  while (0 < size)
+    {
+      pb = push_next (response, q->tail);
+      left = pb->size - q->tail_off;
+      if (size < left)
+        {
+          q->tail_off += size;
+          break;
+        }
+      size -= left;
+      if ( (NULL != pb->free_cb) &&
+           (MHD_NO == pb->embedded) )
+        {
+          pb->free_cb (pb->free_cls);
+          pb->free_cb = NULL;
+        }
+      /* 'pb' becomes the new tail; nobody links to the old one
+         anymore, as 'pb' was linked to it */
+      old = q->tail;
+      q->tail = pb;
+      q->tail_off = 0;
+      if (&q->stub == old)
+        continue;
+      if (MHD_NO == old->embedded)
+        free (old);
+      else if (NULL != old->free_cb)
+        old->free_cb (old->free_cls); /* releases 'old' */
+    }
+#if HAVE_ATOMIC_BUILTINS
+  queued = __atomic_sub_fetch (&q->queued, queued, __ATOMIC_SEQ_CST);
+  drained = ( (queued <= q->high_water / 2) &&
+              (MHD_YES == __atomic_load_n (&q->refused, __ATOMIC_SEQ_CST)) &&
+              (MHD_YES == __atomic_exchange_n (&q->refused,
+                                               MHD_NO,
+                                               __ATOMIC_SEQ_CST)) );
+#else
+  (void) MHD_mutex_lock_ (&response->mutex);
+  q->queued -= queued;
+  drained = ( (q->queued <= q->high_water / 2) &&
+              (MHD_YES == q->refused) );
+  if (drained)
+    q->refused = MHD_NO;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
+  if ( (drained) &&
+       (NULL != q->drained_cb) )
+    q->drained_cb (q->drained_cls);
+}
+
+
 /**
  * Create a response object.  The response object can be extended with
  * header information and then be used any number of times.
@@ -577,6 +1425,12 @@ MHD_destroy_response (struct MHD_Response *response)
 
   if (NULL == response)
     return;
+#if HAVE_ATOMIC_BUILTINS
+  if (0 != __atomic_sub_fetch (&response->reference_count,
+                               1,
+                               __ATOMIC_ACQ_REL))
+    return;
+#else
   (void) MHD_mutex_lock_ (&response->mutex);
   if (0 != --(response->reference_count))
     {
@@ -584,6 +1438,7 @@ MHD_destroy_response (struct MHD_Response *response)
       return;
     }
   (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
   (void) MHD_mutex_destroy_ (&response->mutex);
   if (response->crfc != NULL)
     response->crfc (response->crc_cls);
@@ -595,16 +1450,45 @@ MHD_destroy_response (struct MHD_Response *response)
       free (pos->value);
       free (pos);
     }
+  free (response->header_block);
   free (response);
 }
 
 
+/**
+ * Check whether anybody but the caller still uses @a response.
+ *
+ * @param response the response
+ * @return #MHD_YES if the caller does not hold the only reference
+ */
+int
+MHD_response_is_shared_ (struct MHD_Response *response)
+{
+  unsigned int rc;
+
+#if HAVE_ATOMIC_BUILTINS
+  rc = __atomic_load_n (&response->reference_count, __ATOMIC_ACQUIRE);
+#else
+  (void) MHD_mutex_lock_ (&response->mutex);
+  rc = response->reference_count;
+  (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
+  return (1 < rc) ? MHD_YES : MHD_NO;
+}
+
+
 void
 MHD_increment_response_rc (struct MHD_Response *response)
 {
+#if HAVE_ATOMIC_BUILTINS
+  (void) __atomic_add_fetch (&response->reference_count,
+                             1,
+                             __ATOMIC_RELAXED);
+#else
   (void) MHD_mutex_lock_ (&response->mutex);
   (response->reference_count)++;
   (void) MHD_mutex_unlock_ (&response->mutex);
+#endif
 }
 
 
@@ -35,4 +35,158 @@ void
 MHD_increment_response_rc (struct MHD_Response *response);
 
 
+/**
+ * Mark a response created with #MHD_create_response_for_push() as
+ * queued for a connection.
+ *
+ * @param response the response
+ * @return #MHD_NO if the response was already queued
+ */
+int
+MHD_response_push_attach_ (struct MHD_Response *response);
+
+
+/**
+ * Forget that @a connection waits for data to be pushed to
+ * @a response, as the connection is done with the response.
+ *
+ * @param response the response
+ * @param connection the connection
+ */
+void
+MHD_response_push_detach_ (struct MHD_Response *response,
+                           struct MHD_Connection *connection);
+
+
+/**
+ * Register @a connection to be signalled with
+ * #MHD_response_data_ready() once data is pushed to @a response
+ * (or the stream is ended).
+ *
+ * @param response the response
+ * @param connection the connection
+ * @return #MHD_YES if the connection has to wait, #MHD_NO if data
+ *         was pushed (or the stream was ended) meanwhile
+ */
+int
+MHD_response_push_wait_ (struct MHD_Response *response,
+                         struct MHD_Connection *connection);
+
+
+/**
+ * Append the buffer described by @a pb to the data of @a response,
+ * created with #MHD_create_response_for_push(), without signalling
+ * the connection (see #MHD_response_push_wake_()).  Can be called
+ * from any thread.
+ *
+ * @param response the response
+ * @param pb the buffer, with all fields but @e next set; owned by
+ *        the response if it was queued
+ * @return #MHD_YES if the buffer was queued, #MHD_NO if not
+ */
+int
+MHD_response_push_buffer_ (struct MHD_Response *response,
+                           struct MHD_PushBuffer *pb);
+
+
+/**
+ * Signal the connection of @a response, created with
+ * #MHD_create_response_for_push(), if it waits for data.  Must not
+ * be called while holding locks the event loop may need.
+ *
+ * @param response the response
+ */
+void
+MHD_response_push_wake_ (struct MHD_Response *response);
+
+
+/**
+ * End the data of @a response, created with
+ * #MHD_create_response_for_push(), with an error: the connection is
+ * closed without sending the remaining data.  The caller must signal
+ * the connection with #MHD_response_push_wake_() afterwards.
+ *
+ * @param response the response
+ */
+void
+MHD_response_push_abort_ (struct MHD_Response *response);
+
+
+/**
+ * Check whether the data of @a response ended with an error (see
+ * MHD_response_push_abort_()).
+ *
+ * @param response the response
+ * @return #MHD_YES if the connection has to be closed
+ */
+int
+MHD_response_push_aborted_ (struct MHD_Response *response);
+
+
+/**
+ * Check whether anybody but the caller still uses @a response.
+ *
+ * @param response the response
+ * @return #MHD_YES if the caller does not hold the only reference
+ */
+int
+MHD_response_is_shared_ (struct MHD_Response *response);
+
+
+/**
+ * Check whether #MHD_response_push_end() was called for @a response.
+ * If so, all of the data is visible to the connection.
+ *
+ * @param response the response
+ * @return #MHD_YES if the stream was ended
+ */
+int
+MHD_response_push_ended_ (struct MHD_Response *response);
+
+
+/**
+ * Count the bytes pushed to @a response and not yet consumed.
+ *
+ * @param response the response
+ * @param max_buffers maximum number of buffers to look at
+ * @param limit maximum number of bytes to count
+ * @return number of bytes available, at most @a limit
+ */
+size_t
+MHD_response_push_peek_ (struct MHD_Response *response,
+                         unsigned int max_buffers,
+                         size_t limit);
+
+
+#if SENDV_SUPPORT
+/**
+ * Fill @a iov with the data pushed to @a response and not yet
+ * consumed.
+ *
+ * @param response the response
+ * @param iov where to store the buffers
+ * @param max number of entries in @a iov
+ * @param limit maximum number of bytes to store
+ * @return number of entries used in @a iov
+ */
+unsigned int
+MHD_response_push_gather_ (struct MHD_Response *response,
+                           struct iovec *iov,
+                           unsigned int max,
+                           size_t limit);
+#endif
+
+
+/**
+ * Mark @a size bytes of the data pushed to @a response as sent,
+ * releasing the buffers that were sent completely.
+ *
+ * @param response the response
+ * @param size number of bytes sent
+ */
+void
+MHD_response_push_consume_ (struct MHD_Response *response,
+                            size_t size);
+
+
 #endif
@@ -0,0 +1,678 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file router.c
+ * @brief dispatching of requests to the handlers of a router
+ * @author Christian Grothoff
+ *
+ * The routes are kept in a compressed trie (radix tree) over the
+ * fixed text of the path patterns: each node is labelled with the
+ * text on the edge leading to it, and the children of a node start
+ * with distinct characters and are sorted by them.  "{name}"
+ * segments of a pattern lead to a separate parameter child of the
+ * node, "*" marks the routes of a node as prefix routes.  The trie
+ * is only modified until the router is given to a daemon, so the
+ * threads of the daemon can look up routes without locking.
+ */
+
+#include "router.h"
+#include "memorypool.h"
+
+/**
+ * Maximum number of "{name}" segments in a path pattern.
+ */
+#define MAX_PARAMS 16
+
+
+/**
+ * A route, in the list of the routes of a node of the trie.
+ */
+struct Route
+{
+
+  /**
+   * Next route of the same node.
+   */
+  struct Route *next;
+
+  /**
+   * Method of the route, NULL to match all methods.
+   */
+  char *method;
+
+  /**
+   * Handler for the requests matching the route.
+   */
+  MHD_AccessHandlerCallback handler;
+
+  /**
+   * Closure for @e handler.
+   */
+  void *handler_cls;
+
+  /**
+   * Names of the "{name}" segments of the pattern, in order.
+   */
+  char *param_names[MAX_PARAMS];
+
+  /**
+   * Number of entries in @e param_names.
+   */
+  unsigned int num_params;
+
+};
+
+
+/**
+ * Node of the trie.
+ */
+struct RouteNode
+{
+
+  /**
+   * Text on the edge to this node (not 0-terminated); NULL for
+   * the root and for parameter nodes.
+   */
+  char *label;
+
+  /**
+   * Number of characters in @e label.
+   */
+  size_t label_len;
+
+  /**
+   * Children reached by fixed text, sorted by the first
+   * character of their label.
+   */
+  struct RouteNode **children;
+
+  /**
+   * Number of entries in @e children.
+   */
+  unsigned int num_children;
+
+  /**
+   * Child reached by a "{name}" segment, NULL if none.
+   */
+  struct RouteNode *param_child;
+
+  /**
+   * Routes of the patterns ending at this node.
+   */
+  struct Route *routes;
+
+  /**
+   * Routes of the patterns ending with a "*" at this node.
+   */
+  struct Route *prefix_routes;
+
+};
+
+
+/**
+ * Handle for a set of routes.
+ */
+struct MHD_Router
+{
+
+  /**
+   * Root of the trie.
+   */
+  struct RouteNode root;
+
+  /**
+   * #MHD_YES once the router was given to a daemon.
+   */
+  int frozen;
+
+};
+
+
+/**
+ * Value of a "{name}" segment found while matching a path.
+ */
+struct Capture
+{
+
+  /**
+   * Start of the value in the path.
+   */
+  const char *start;
+
+  /**
+   * Length of the value.
+   */
+  size_t len;
+
+};
+
+
+/**
+ * Free a list of routes.
+ *
+ * @param route head of the list
+ */
+static void
+free_routes (struct Route *route)
+{
+  struct Route *next;
+  unsigned int i;
+
+  while (NULL != route)
+    {
+      next = route->next;
+      for (i = 0; i < route->num_params; i++)
+        free (route->param_names[i]);
+      free (route->method);
+      free (route);
+      route = next;
+    }
+}
+
+
+/**
+ * Free everything below @a node, and its routes.
+ *
+ * @param node node to clean up (not freed itself)
+ */
+static void
+clean_node (struct RouteNode *node)
+{
+  unsigned int i;
+
+  for (i = 0; i < node->num_children; i++)
+    {
+      clean_node (node->children[i]);
+      free (node->children[i]);
+    }
+  free (node->children);
+  if (NULL != node->param_child)
+    {
+      clean_node (node->param_child);
+      free (node->param_child);
+    }
+  free_routes (node->routes);
+  free_routes (node->prefix_routes);
+  free (node->label);
+}
+
+
+/**
+ * Create a node.
+ *
+ * @param label text on the edge to the node, NULL for none
+ * @param label_len number of characters in @a label
+ * @return NULL on error (out of memory)
+ */
+static struct RouteNode *
+create_node (const char *label,
+             size_t label_len)
+{
+  struct RouteNode *node;
+
+  node = calloc (1, sizeof (struct RouteNode));
+  if (NULL == node)
+    return NULL;
+  if (0 == label_len)
+    return node;
+  node->label = malloc (label_len);
+  if (NULL == node->label)
+    {
+      free (node);
+      return NULL;
+    }
+  memcpy (node->label, label, label_len);
+  node->label_len = label_len;
+  return node;
+}
+
+
+/**
+ * Find the position of the child of @a node whose label starts
+ * with @a c.
+ *
+ * @param node node to search
+ * @param c character to look for
+ * @return position of the child, or the position where such a
+ *         child would have to be inserted
+ */
+static unsigned int
+find_child (const struct RouteNode *node,
+            char c)
+{
+  unsigned int lo;
+  unsigned int hi;
+  unsigned int mid;
+
+  lo = 0;
+  hi = node->num_children;
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if ((unsigned char) node->children[mid]->label[0] < (unsigned char) c)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
+
+/**
+ * Add the fixed text @a text below @a node, splitting the label
+ * of an existing child if @a text ends (or differs) within it.
+ *
+ * @param node node to start at
+ * @param text text to add
+ * @param len number of characters in @a text
+ * @return the node reached by @a text, NULL on error (out of memory)
+ */
+static struct RouteNode *
+insert_text (struct RouteNode *node,
+             const char *text,
+             size_t len)
+{
+  struct RouteNode *child;
+  struct RouteNode *mid;
+  struct RouteNode **children;
+  unsigned int pos;
+  size_t common;
+
+  while (len > 0)
+    {
+      pos = find_child (node, text[0]);
+      if ( (pos == node->num_children) ||
+           (node->children[pos]->label[0] != text[0]) )
+        {
+          child = create_node (text, len);
+          if (NULL == child)
+            return NULL;
+          children = realloc (node->children,
+                              (node->num_children + 1) * sizeof (struct RouteNode *));
+          if (NULL == children)
+            {
+              clean_node (child);
+              free (child);
+              return NULL;
+            }
+          memmove (&children[pos + 1],
+                   &children[pos],
+                   (node->num_children - pos) * sizeof (struct RouteNode *));
+          children[pos] = child;
+          node->children = children;
+          node->num_children++;
+          return child;
+        }
+      child = node->children[pos];
+      common = 1;
+      while ( (common < len) &&
+              (common < child->label_len) &&
+              (text[common] == child->label[common]) )
+        common++;
+      if (common < child->label_len)
+        {
+          /* split the label of the child */
+          mid = create_node (child->label, common);
+          if (NULL == mid)
+            return NULL;
+          mid->children = malloc (sizeof (struct RouteNode *));
+          if (NULL == mid->children)
+            {
+              clean_node (mid);
+              free (mid);
+              return NULL;
+            }
+          memmove (child->label,
+                   &child->label[common],
+                   child->label_len - common);
+          child->label_len -= common;
+          mid->children[0] = child;
+          mid->num_children = 1;
+          node->children[pos] = mid;
+          child = mid;
+        }
+      node = child;
+      text += common;
+      len -= common;
+    }
+  return node;
+}
+
+
+/**
+ * Find the route for @a method in a list of routes; a route
+ * for the method itself is preferred over one for all methods.
+ *
+ * @param route head of the list
+ * @param method method of the request
+ * @return NULL if there is no such route
+ */
+static const struct Route *
+find_method (const struct Route *route,
+             const char *method)
+{
+  const struct Route *any;
+
+  any = NULL;
+  for (; NULL != route; route = route->next)
+    {
+      if (NULL == route->method)
+        any = route;
+      else if (0 == strcmp (route->method, method))
+        return route;
+    }
+  return any;
+}
+
+
+/**
+ * Match the rest of a path against the trie below @a node.
+ *
+ * @param node node reached so far
+ * @param path rest of the path
+ * @param method method of the request
+ * @param captures values of the "{name}" segments
+ * @param num_captures number of values in @a captures so far
+ * @return the matching route, NULL if there is none
+ */
+static const struct Route *
+match_node (const struct RouteNode *node,
+            const char *path,
+            const char *method,
+            struct Capture *captures,
+            unsigned int num_captures)
+{
+  const struct Route *route;
+  const struct RouteNode *child;
+  const char *end;
+  unsigned int pos;
+
+  if ('\0' == *path)
+    {
+      route = find_method (node->routes, method);
+      if (NULL != route)
+        return route;
+    }
+  else
+    {
+      pos = find_child (node, *path);
+      if (pos < node->num_children)
+        {
+          child = node->children[pos];
+          if ( (child->label[0] == *path) &&
+               (0 == strncmp (path, child->label, child->label_len)) )
+            {
+              route = match_node (child,
+                                  &path[child->label_len],
+                                  method,
+                                  captures,
+                                  num_captures);
+              if (NULL != route)
+                return route;
+            }
+        }
+      if ( (NULL != node->param_child) &&
+           ('/' != *path) )
+        {
+          end = path;
+          while ( ('\0' != *end) &&
+                  ('/' != *end) )
+            end++;
+          captures[num_captures].start = path;
+          captures[num_captures].len = end - path;
+          route = match_node (node->param_child,
+                              end,
+                              method,
+                              captures,
+                              num_captures + 1);
+          if (NULL != route)
+            return route;
+        }
+    }
+  return find_method (node->prefix_routes, method);
+}
+
+
+/**
+ * Create an empty router.
+ *
+ * @return NULL on error (out of memory)
+ * @ingroup request
+ */
+struct MHD_Router *
+MHD_router_create (void)
+{
+  return calloc (1, sizeof (struct MHD_Router));
+}
+
+
+/**
+ * Add a route to @a router.  The path @a pattern must start with
+ * a "/" and can contain:
+ *
+ * - segments of the form "{name}", which match any non-empty
+ *   segment of the path; the matched value is made available to
+ *   the handler as #MHD_ROUTE_PARAMETER_KIND under "name";
+ * - a trailing "*", which makes the route match all paths that
+ *   start with the part of @a pattern before it.
+ *
+ * Everything else must match the path (after unescaping) exactly.
+ * If several routes match a path, fixed text is preferred over a
+ * "{name}" segment and both are preferred over a trailing "*".
+ *
+ * Routes can only be added before the router is passed to a
+ * daemon with #MHD_OPTION_ROUTER.
+ *
+ * @param router router to add the route to
+ * @param method HTTP method of the route (#MHD_HTTP_METHOD_GET,
+ *        etc.), NULL to match all methods
+ * @param pattern path pattern, see above
+ * @param handler handler for the requests matching the route
+ * @param handler_cls closure for @a handler
+ * @return #MHD_YES on success, #MHD_NO if @a pattern is malformed,
+ *         the route is already defined, the router is in use or
+ *         on error (out of memory)
+ * @ingroup request
+ */
+int
+MHD_router_add (struct MHD_Router *router,
+                const char *method,
+                const char *pattern,
+                MHD_AccessHandlerCallback handler,
+                void *handler_cls)
+{
+  struct RouteNode *node;
+  struct Route *route;
+  struct Route **list;
+  const char *pos;
+  const char *end;
+  char *name;
+  int prefix;
+
+  if ( (NULL == router) ||
+       (MHD_YES == router->frozen) ||
+       (NULL == pattern) ||
+       ('/' != pattern[0]) ||
+       (NULL == handler) )
+    return MHD_NO;
+  route = calloc (1, sizeof (struct Route));
+  if (NULL == route)
+    return MHD_NO;
+  route->handler = handler;
+  route->handler_cls = handler_cls;
+  if ( (NULL != method) &&
+       (NULL == (route->method = strdup (method))) )
+    goto fail;
+  /* nodes added before a failure stay in the trie; without
+     routes, they do not match anything */
+  node = &router->root;
+  prefix = MHD_NO;
+  pos = pattern;
+  while ('\0' != *pos)
+    {
+      if ('*' == *pos)
+        {
+          if ('\0' != pos[1])
+            goto fail;
+          prefix = MHD_YES;
+          break;
+        }
+      if ('{' != *pos)
+        {
+          end = pos + strcspn (pos, "{*");
+          node = insert_text (node, pos, end - pos);
+          if (NULL == node)
+            goto fail;
+          pos = end;
+          continue;
+        }
+      /* a "{name}" segment */
+      end = strchr (pos, '}');
+      if ( ('/' != pos[-1]) ||
+           (NULL == end) ||
+           (end == &pos[1]) ||
+           (strcspn (&pos[1], "/{*") < (size_t) (end - pos - 1)) ||
+           ( ('/' != end[1]) &&
+             ('\0' != end[1]) ) ||
+           (MAX_PARAMS == route->num_params) )
+        goto fail;
+      name = malloc (end - pos);
+      if (NULL == name)
+        goto fail;
+      memcpy (name, &pos[1], end - pos - 1);
+      name[end - pos - 1] = '\0';
+      route->param_names[route->num_params++] = name;
+      if ( (NULL == node->param_child) &&
+           (NULL == (node->param_child = create_node (NULL, 0))) )
+        goto fail;
+      node = node->param_child;
+      pos = &end[1];
+    }
+  list = (MHD_YES == prefix) ? &node->prefix_routes : &node->routes;
+  while (NULL != *list)
+    {
+      if ( ( (NULL == method) &&
+             (NULL == (*list)->method) ) ||
+           ( (NULL != method) &&
+             (NULL != (*list)->method) &&
+             (0 == strcmp (method, (*list)->method)) ) )
+        goto fail;
+      list = &(*list)->next;
+    }
+  *list = route;
+  return MHD_YES;
+ fail:
+  free_routes (route);
+  return MHD_NO;
+}
+
+
+/**
+ * Destroy a router.  All daemons using it must have been stopped.
+ *
+ * @param router router to destroy
+ * @ingroup request
+ */
+void
+MHD_router_destroy (struct MHD_Router *router)
+{
+  if (NULL == router)
+    return;
+  clean_node (&router->root);
+  free (router);
+}
+
+
+/**
+ * Prevent further changes to @a router; called when the router
+ * is given to a daemon.
+ *
+ * @param router router to freeze
+ */
+void
+MHD_router_freeze_ (struct MHD_Router *router)
+{
+  router->frozen = MHD_YES;
+}
+
+
+/**
+ * Find the route for the request of @a connection and set the
+ * @e handler (and @e handler_cls) of @a connection accordingly,
+ * falling back to the default handler of the daemon.  The
+ * parameters captured by the route are added to the values of
+ * the connection.
+ *
+ * @param connection connection with a request whose method and
+ *        url are known
+ * @return #MHD_YES on success, #MHD_NO if the parameters did not
+ *         fit into the memory pool of @a connection
+ */
+int
+MHD_router_dispatch_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *daemon = connection->daemon;
+  struct Capture captures[MAX_PARAMS];
+  const struct Route *route;
+  unsigned int i;
+  char *value;
+
+  connection->handler = daemon->default_handler;
+  connection->handler_cls = daemon->default_handler_cls;
+  if (NULL == daemon->router)
+    return MHD_YES;
+  route = match_node (&daemon->router->root,
+                      connection->url,
+                      connection->method,
+                      captures,
+                      0);
+  if (NULL == route)
+    return MHD_YES;
+  for (i = 0; i < route->num_params; i++)
+    {
+      value = MHD_pool_allocate (connection->pool,
+                                 captures[i].len + 1,
+                                 MHD_YES);
+      if (NULL != value)
+        {
+          memcpy (value,
+                  captures[i].start,
+                  captures[i].len);
+          value[captures[i].len] = '\0';
+        }
+      if ( (NULL == value) ||
+           (MHD_NO == MHD_set_connection_value (connection,
+                                                MHD_ROUTE_PARAMETER_KIND,
+                                                route->param_names[i],
+                                                value)) )
+        {
+#ifdef HAVE_MESSAGES
+          MHD_DLOG (daemon,
+                    "Not enough memory in pool to store route parameters!\n");
+#endif
+          return MHD_NO;
+        }
+    }
+  connection->handler = route->handler;
+  connection->handler_cls = route->handler_cls;
+  return MHD_YES;
+}
+
+/* end of router.c */
@@ -0,0 +1,59 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file router.h
+ * @brief dispatching of requests to the handlers of a router
+ * @author Christian Grothoff
+ */
+
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include "internal.h"
+
+
+/**
+ * Prevent further changes to @a router; called when the router
+ * is given to a daemon.
+ *
+ * @param router router to freeze
+ */
+void
+MHD_router_freeze_ (struct MHD_Router *router);
+
+
+/**
+ * Find the route for the request of @a connection and set the
+ * @e handler (and @e handler_cls) of @a connection accordingly,
+ * falling back to the default handler of the daemon.  The
+ * parameters captured by the route are added to the values of
+ * the connection.
+ *
+ * @param connection connection with a request whose method and
+ *        url are known
+ * @return #MHD_YES on success, #MHD_NO if the parameters did not
+ *         fit into the memory pool of @a connection
+ */
+int
+MHD_router_dispatch_ (struct MHD_Connection *connection);
+
+#endif
+
+/* end of router.h */
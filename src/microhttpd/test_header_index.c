@@ -0,0 +1,174 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_header_index.c
+ * @brief  Testcase for the index of request headers: lookups must
+ *         find the same entry as walking the list of all entries
+ * @author Christian Grothoff
+ */
+#include "platform.h"
+#include "microhttpd.h"
+#include "internal.h"
+#include "header_index.h"
+#include "memorypool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/**
+ * How many entries do we add?
+ */
+#define NUM_ENTRIES 200
+
+/**
+ * Names used for the entries; a mix of well-known names
+ * in various cases, other names and no name.
+ */
+static const char *const names[] = {
+  "Host", "host", "HOST", "Connection", "cONNECTION",
+  "Content-Length", "Cookie", "X-Forwarded-For", "x-forwarded-for",
+  "X-Request-Id", "x-request-id", "foo", "Foo", "bar", "a", "",
+  NULL
+};
+
+#define NUM_NAMES (sizeof (names) / sizeof (names[0]))
+
+static struct MHD_HTTP_Header entries[NUM_ENTRIES];
+
+static char values[NUM_ENTRIES][8];
+
+
+/**
+ * Find the first matching entry the way the list was searched
+ * before the index existed.
+ */
+static struct MHD_HTTP_Header *
+find_linear (unsigned int count,
+             enum MHD_ValueKind kind,
+             const char *key)
+{
+  unsigned int i;
+
+  for (i = 0; i < count; i++)
+    if ( (0 != (entries[i].kind & kind)) &&
+         ( (key == entries[i].header) ||
+           ( (NULL != entries[i].header) &&
+             (NULL != key) &&
+             (MHD_str_equal_caseless_ (key, entries[i].header)) ) ) )
+      return &entries[i];
+  return NULL;
+}
+
+
+static int
+testTokens ()
+{
+  uint32_t h1;
+  uint32_t h2;
+
+  if (MHD_HEADER_TOKEN_HOST != MHD_header_token_ ("hOsT", &h1))
+    return 1;
+  if (MHD_HEADER_TOKEN_HOST != MHD_header_token_ (MHD_HTTP_HEADER_HOST, &h2))
+    return 2;
+  if (h1 != h2)
+    return 4;
+  if (MHD_HEADER_TOKEN_OTHER != MHD_header_token_ ("Hosts", &h1))
+    return 8;
+  if (0 != strcmp (MHD_HTTP_HEADER_CONTENT_LENGTH,
+                   MHD_header_token_name_ (MHD_HEADER_TOKEN_CONTENT_LENGTH)))
+    return 16;
+  return 0;
+}
+
+
+static int
+testIndex ()
+{
+  static const enum MHD_ValueKind kinds[] = {
+    MHD_HEADER_KIND, MHD_COOKIE_KIND, MHD_GET_ARGUMENT_KIND,
+    MHD_HEADER_KIND | MHD_GET_ARGUMENT_KIND
+  };
+  struct MemoryPool *pool;
+  struct MHD_HTTP_Header **index;
+  struct MHD_HTTP_Header *found;
+  enum MHD_HeaderToken token;
+  uint32_t hash;
+  unsigned int i;
+  unsigned int j;
+  unsigned int k;
+  int ret;
+
+  pool = MHD_pool_create (4096);
+  if (NULL == pool)
+    return 32;
+  index = MHD_header_index_create_ (pool);
+  if (NULL == index)
+    {
+      MHD_pool_destroy (pool);
+      return 64;
+    }
+  ret = 0;
+  srandom (42);
+  for (i = 0; i < NUM_ENTRIES; i++)
+    {
+      snprintf (values[i], sizeof (values[i]), "%u", i);
+      entries[i].header = (char *) names[random () % NUM_NAMES];
+      entries[i].value = values[i];
+      entries[i].kind = kinds[random () % 3];
+      token = MHD_header_token_ (entries[i].header, &entries[i].hash);
+      MHD_header_index_add_ (index, &entries[i], token);
+      /* after each addition, every lookup must agree with the list */
+      for (j = 0; j < NUM_NAMES; j++)
+        for (k = 0; k < sizeof (kinds) / sizeof (kinds[0]); k++)
+          {
+            token = MHD_header_token_ (names[j], &hash);
+            found = MHD_header_index_find_ (index,
+                                            kinds[k],
+                                            token,
+                                            hash,
+                                            names[j]);
+            if (found != find_linear (i + 1, kinds[k], names[j]))
+              {
+                fprintf (stderr,
+                         "Lookup of `%s' after %u entries failed\n",
+                         (NULL == names[j]) ? "(null)" : names[j],
+                         i + 1);
+                ret = 128;
+              }
+          }
+    }
+  MHD_pool_destroy (pool);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  MHD_header_index_init_ ();
+  errorCount += testTokens ();
+  errorCount += testIndex ();
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  return errorCount != 0;       /* 0 == pass */
+}
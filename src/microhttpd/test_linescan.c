@@ -0,0 +1,275 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_linescan.c
+ * @brief  Testcase for the header line scanner; also reports the
+ *         throughput of each implementation when splitting a
+ *         typical browser request header into lines, compared
+ *         to the byte-by-byte loop plus strchr() used before
+ * @author Christian Grothoff
+ */
+#include "platform.h"
+#include "microhttpd.h"
+#include "internal.h"
+#include "linescan.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * How often do we parse the request header for the benchmark?
+ */
+#define BENCH_ROUNDS 200000
+
+/**
+ * Request header as sent by a common browser.
+ */
+static const char request[] =
+  "GET /static/js/app.min.js?v=20160205 HTTP/1.1\r\n"
+  "Host: www.example.com\r\n"
+  "Connection: keep-alive\r\n"
+  "Accept: */*\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+  "(KHTML, like Gecko) Chrome/48.0.2564.97 Safari/537.36\r\n"
+  "Referer: https://www.example.com/products/index.html?category=books&sort=price\r\n"
+  "Accept-Encoding: gzip, deflate, sdch\r\n"
+  "Accept-Language: en-US,en;q=0.8,de;q=0.6\r\n"
+  "Cookie: _ga=GA1.2.1234567890.1454000000; session=8f14e45fceea167a5a36dedd4bea2543; "
+  "prefs=lang%3Den%26theme%3Ddark; _gid=GA1.2.987654321.1454600000\r\n"
+  "If-None-Match: \"5b9a1c-3f2e-52a1b1c3d4e5f\"\r\n"
+  "If-Modified-Since: Thu, 04 Feb 2016 10:00:00 GMT\r\n"
+  "\r\n";
+
+static const char *const names[] = { "scalar", "SSE2", "AVX2" };
+
+
+/**
+ * Compute the expected result of scanning @a len bytes at @a buf.
+ */
+static int
+reference_scan (const char *buf,
+                size_t len,
+                struct MHD_LineScan *scan)
+{
+  size_t i;
+
+  memset (scan, 0, sizeof (struct MHD_LineScan));
+  for (i = 0; i < len; i++)
+    {
+      if ( ('\r' == buf[i]) || ('\n' == buf[i]) )
+        {
+          scan->pos = i;
+          return MHD_YES;
+        }
+      if ( (':' == buf[i]) && (0 == scan->colon) )
+        scan->colon = i + 1;
+      if ( (' ' == buf[i]) && (0 == scan->space) )
+        scan->space = i + 1;
+    }
+  scan->pos = len;
+  return MHD_NO;
+}
+
+
+static int
+testRandom (enum MHD_LineScanImplementation impl)
+{
+  static const char alphabet[] = "abcdefgh:: \r\n\t";
+  char buf[300];
+  struct MHD_LineScan expect;
+  struct MHD_LineScan scan;
+  unsigned int round;
+  size_t len;
+  size_t avail;
+  size_t i;
+  int eret;
+  int ret;
+
+  srandom (42);
+  for (round = 0; round < 20000; round++)
+    {
+      len = random () % sizeof (buf);
+      for (i = 0; i < len; i++)
+        buf[i] = (0 == random () % 4)
+          ? alphabet[random () % (sizeof (alphabet) - 1)]
+          : 'x';
+      eret = reference_scan (buf, len, &expect);
+      /* feed the data in pieces, as if it arrived in several reads */
+      MHD_line_scan_reset_ (&scan);
+      avail = 0;
+      do
+        {
+          avail += random () % 70;
+          if (avail > len)
+            avail = len;
+          ret = MHD_line_scan_ (&scan, buf, avail);
+        }
+      while ( (MHD_NO == ret) && (avail < len) );
+      if ( (ret != eret) ||
+           (scan.pos != expect.pos) )
+        return 1;
+      if ( (MHD_YES == ret) &&
+           ( (scan.colon != expect.colon) ||
+             (scan.space != expect.space) ) )
+        {
+          fprintf (stderr,
+                   "%s scanner disagrees on separators\n",
+                   names[impl]);
+          return 2;
+        }
+    }
+  return 0;
+}
+
+
+/**
+ * Split the request header into lines and find the separators
+ * the way the parser did before the scanner existed.
+ */
+static size_t
+parse_old (char *buf,
+           size_t len)
+{
+  size_t found = 0;
+  size_t pos;
+  char *line;
+
+  while (len > 0)
+    {
+      pos = 0;
+      while ((pos < len - 1) &&
+             ('\r' != buf[pos]) && ('\n' != buf[pos]))
+        pos++;
+      if ('\r' == buf[pos])
+        buf[pos++] = '\0';
+      buf[pos++] = '\0';
+      line = buf;
+      if (NULL != strchr (line, ':'))
+        found++;
+      else if (NULL != strchr (line, ' '))
+        found++;
+      buf += pos;
+      len -= pos;
+    }
+  return found;
+}
+
+
+/**
+ * Split the request header into lines and find the separators
+ * with the scanner.
+ */
+static size_t
+parse_new (char *buf,
+           size_t len)
+{
+  struct MHD_LineScan scan;
+  size_t found = 0;
+  size_t pos;
+
+  while (len > 0)
+    {
+      MHD_line_scan_reset_ (&scan);
+      if (MHD_NO == MHD_line_scan_ (&scan, buf, len))
+        break;
+      pos = scan.pos;
+      if ( (0 != scan.colon) ||
+           (0 != scan.space) )
+        found++;
+      if ('\r' == buf[pos])
+        buf[pos++] = '\0';
+      buf[pos++] = '\0';
+      buf += pos;
+      len -= pos;
+    }
+  return found;
+}
+
+
+/**
+ * Get the current timestamp
+ *
+ * @return current time in microseconds
+ */
+static unsigned long long
+now_us ()
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return (((unsigned long long) tv.tv_sec * 1000000LL) +
+	  ((unsigned long long) tv.tv_usec));
+}
+
+
+/**
+ * Report the throughput of parsing the request header.
+ *
+ * @param desc name of the implementation
+ * @param parse parser to use
+ * @return 0 if the lines were found correctly
+ */
+static int
+bench (const char *desc,
+       size_t (*parse)(char *buf, size_t len))
+{
+  char buf[sizeof (request)];
+  unsigned long long start;
+  unsigned long long delta;
+  unsigned int i;
+  size_t found;
+
+  found = 0;
+  start = now_us ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    {
+      memcpy (buf, request, sizeof (request) - 1);
+      found += parse (buf, sizeof (request) - 1);
+    }
+  delta = now_us () - start + 1;
+  fprintf (stderr,
+           "Parsing request headers with %s scanner: %f MB/s\n",
+           desc,
+           ((double) (sizeof (request) - 1)) * BENCH_ROUNDS / delta);
+  /* all lines but the final empty one have a separator */
+  return (found == 11 * BENCH_ROUNDS) ? 0 : 4;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  unsigned int impl;
+
+  errorCount += bench ("byte-by-byte", &parse_old);
+  for (impl = MHD_LINE_SCAN_SCALAR; impl <= MHD_LINE_SCAN_AVX2; impl++)
+    {
+      if (MHD_YES != MHD_line_scan_select_ ((enum MHD_LineScanImplementation) impl))
+        continue;
+      errorCount += testRandom ((enum MHD_LineScanImplementation) impl);
+      errorCount += bench (names[impl], &parse_new);
+    }
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  return errorCount != 0;       /* 0 == pass */
+}
@@ -0,0 +1,204 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_memorypool.c
+ * @brief  Testcase for resetting the memory pool while carrying data
+ * @author Christian Grothoff
+ */
+#include "platform.h"
+#include "microhttpd.h"
+#include "internal.h"
+#include "memorypool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/**
+ * Size of the pool we test with.
+ */
+#define POOL_SIZE 1024
+
+/**
+ * How many random layouts do we try?
+ */
+#define NUM_ROUNDS 20000
+
+
+/**
+ * Fill the pool with a pattern, reset it keeping two blocks at the
+ * given offsets and check that both survived.
+ *
+ * @return 0 on success
+ */
+static int
+check_carry (size_t keep_off,
+             size_t copy_bytes,
+             size_t new_size,
+             size_t carry_off,
+             size_t carry_bytes)
+{
+  static char orig[POOL_SIZE];
+  struct MemoryPool *pool;
+  char *mem;
+  char *keep;
+  void *carry;
+  char *next;
+  size_t i;
+  int ret;
+
+  pool = MHD_pool_create (POOL_SIZE);
+  if (NULL == pool)
+    return 1;
+  mem = MHD_pool_allocate (pool, POOL_SIZE, MHD_NO);
+  if (NULL == mem)
+    {
+      MHD_pool_destroy (pool);
+      return 2;
+    }
+  for (i = 0; i < POOL_SIZE; i++)
+    orig[i] = mem[i] = (char) (i * 7 + i / 251);
+  carry = &mem[carry_off];
+  keep = MHD_pool_reset_carry (pool,
+                               &mem[keep_off],
+                               copy_bytes,
+                               new_size,
+                               &carry,
+                               carry_bytes);
+  ret = 0;
+  if (NULL == keep)
+    ret = 4;
+  else if (0 != memcmp (keep, &orig[keep_off], copy_bytes))
+    ret = 8;
+  else if (0 != memcmp (carry, &orig[carry_off], carry_bytes))
+    ret = 16;
+  else if ( ((char *) carry < keep + new_size) &&
+            (0 != carry_bytes) )
+    ret = 32;
+  else
+    {
+      /* further allocations must not overlap the carried block */
+      next = MHD_pool_allocate (pool, 1, MHD_NO);
+      if ( (NULL != next) &&
+           (next < (char *) carry + carry_bytes) )
+        ret = 64;
+    }
+  if (0 != ret)
+    fprintf (stderr,
+             "Carrying %u bytes at %u while keeping %u (%u) bytes at %u failed\n",
+             (unsigned int) carry_bytes,
+             (unsigned int) carry_off,
+             (unsigned int) copy_bytes,
+             (unsigned int) new_size,
+             (unsigned int) keep_off);
+  MHD_pool_destroy (pool);
+  return ret;
+}
+
+
+static int
+testLayouts ()
+{
+  size_t keep_off;
+  size_t copy_bytes;
+  size_t new_size;
+  size_t carry_off;
+  size_t carry_bytes;
+  unsigned int i;
+  int ret;
+
+  /* carry directly in front of keep, both in the way of the other */
+  ret = check_carry (300, 400, 512, 0, 300);
+  if (0 != ret)
+    return ret;
+  /* carry behind keep */
+  ret = check_carry (0, 200, 256, 500, 100);
+  if (0 != ret)
+    return ret;
+  for (i = 0; i < NUM_ROUNDS; i++)
+    {
+      /* two disjoint blocks in random order */
+      copy_bytes = random () % (POOL_SIZE / 2);
+      carry_bytes = random () % (POOL_SIZE / 2 - 16);
+      new_size = copy_bytes + random () % 16;
+      if (0 != (random () % 2))
+        {
+          keep_off = random () % (POOL_SIZE - copy_bytes - carry_bytes + 1);
+          carry_off = keep_off + copy_bytes
+            + random () % (POOL_SIZE - keep_off - copy_bytes - carry_bytes + 1);
+        }
+      else
+        {
+          carry_off = random () % (POOL_SIZE - copy_bytes - carry_bytes + 1);
+          keep_off = carry_off + carry_bytes
+            + random () % (POOL_SIZE - carry_off - carry_bytes - copy_bytes + 1);
+        }
+      ret = check_carry (keep_off, copy_bytes, new_size,
+                         carry_off, carry_bytes);
+      if (0 != ret)
+        return ret;
+    }
+  return 0;
+}
+
+
+static int
+testTooLarge ()
+{
+  struct MemoryPool *pool;
+  char *mem;
+  void *carry;
+
+  pool = MHD_pool_create (POOL_SIZE);
+  if (NULL == pool)
+    return 128;
+  mem = MHD_pool_allocate (pool, POOL_SIZE, MHD_NO);
+  if (NULL == mem)
+    {
+      MHD_pool_destroy (pool);
+      return 256;
+    }
+  carry = &mem[POOL_SIZE / 2];
+  if (NULL != MHD_pool_reset_carry (pool,
+                                    mem,
+                                    POOL_SIZE / 2,
+                                    POOL_SIZE / 2 + 1,
+                                    &carry,
+                                    POOL_SIZE / 2))
+    {
+      MHD_pool_destroy (pool);
+      return 512;
+    }
+  MHD_pool_destroy (pool);
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  errorCount += testLayouts ();
+  errorCount += testTooLarge ();
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  return errorCount != 0;       /* 0 == pass */
+}
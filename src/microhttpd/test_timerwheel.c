@@ -0,0 +1,212 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_timerwheel.c
+ * @brief  Testcase for the timer wheel
+ * @author Christian Grothoff
+ */
+#include "platform.h"
+#include "microhttpd.h"
+#include "internal.h"
+#include "timerwheel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/**
+ * How many timers do we use?
+ */
+#define NUM_TIMERS 2048
+
+/**
+ * Start time of the wheel; not aligned to any slot boundary.
+ */
+#define START_TIME 1234567LLU
+
+
+static struct MHD_Timer timers[NUM_TIMERS];
+
+/**
+ * Is the respective timer expected to be scheduled?
+ */
+static int scheduled[NUM_TIMERS];
+
+
+static uint64_t
+random_delay ()
+{
+  switch (random () % 4)
+    {
+    case 0:
+      return random () % 64;
+    case 1:
+      return random () % 4096;
+    case 2:
+      return random () % (1000 * 60 * 60);
+    default:
+      return (uint64_t) random () * 1000;
+    }
+}
+
+
+/**
+ * Check that exactly the timers with a deadline at or before
+ * @a now have expired, and that the wheel reports a sane next
+ * deadline for the others.
+ */
+static int
+check_expired (struct MHD_TimerWheel *wheel,
+               uint64_t now)
+{
+  struct MHD_Timer *timer;
+  uint64_t earliest;
+  uint64_t next;
+  unsigned int i;
+  int have;
+
+  while (NULL != (timer = MHD_timer_wheel_pop_expired (wheel)))
+    {
+      i = timer - timers;
+      if ( (MHD_YES != scheduled[i]) ||
+           (timer->deadline > now) ||
+           (timer->cls != &timers[i]) )
+        return 1;
+      scheduled[i] = MHD_NO;
+    }
+  have = MHD_NO;
+  earliest = 0;
+  for (i = 0; i < NUM_TIMERS; i++)
+    {
+      if (MHD_YES != scheduled[i])
+        continue;
+      if (timers[i].deadline <= now)
+        return 2; /* should have expired */
+      if ( (MHD_NO == have) ||
+           (timers[i].deadline < earliest) )
+        earliest = timers[i].deadline;
+      have = MHD_YES;
+    }
+  if (have != MHD_timer_wheel_next (wheel, &next))
+    return 4;
+  if ( (MHD_YES == have) &&
+       ( (next <= now) ||
+         (next > earliest) ) )
+    return 8;
+  if ( (MHD_YES == have) &&
+       ( (earliest >> MHD_TIMER_WHEEL_BITS) ==
+         (now >> MHD_TIMER_WHEEL_BITS) ) &&
+       (next != earliest) )
+    return 16;
+  return 0;
+}
+
+
+static int
+testRandom ()
+{
+  struct MHD_TimerWheel wheel;
+  uint64_t now;
+  unsigned int round;
+  unsigned int i;
+  int ret;
+
+  srandom (42);
+  now = START_TIME;
+  MHD_timer_wheel_init (&wheel, now);
+  memset (timers, 0, sizeof (timers));
+  for (i = 0; i < NUM_TIMERS; i++)
+    timers[i].cls = &timers[i];
+  for (round = 0; round < 10000; round++)
+    {
+      /* schedule, move or remove a few timers */
+      for (i = 0; i < 16; i++)
+        {
+          unsigned int t = random () % NUM_TIMERS;
+
+          if (0 == random () % 5)
+            {
+              MHD_timer_wheel_remove (&wheel, &timers[t]);
+              scheduled[t] = MHD_NO;
+              continue;
+            }
+          MHD_timer_wheel_add (&wheel, &timers[t], now + random_delay ());
+          scheduled[t] = MHD_YES;
+        }
+      /* advance by a random amount, sometimes to the next deadline */
+      if (0 == random () % 3)
+        {
+          if (MHD_YES == MHD_timer_wheel_next (&wheel, &now))
+            now += random () % 2;
+        }
+      else
+        now += random_delay () / (1 + random () % 64);
+      MHD_timer_wheel_advance (&wheel, now);
+      if (0 != (ret = check_expired (&wheel, now)))
+        return ret;
+    }
+  /* drain the wheel */
+  while (MHD_YES == MHD_timer_wheel_next (&wheel, &now))
+    {
+      MHD_timer_wheel_advance (&wheel, now);
+      if (0 != (ret = check_expired (&wheel, now)))
+        return 32 + ret;
+    }
+  for (i = 0; i < NUM_TIMERS; i++)
+    if (MHD_YES == scheduled[i])
+      return 64;
+  return 0;
+}
+
+
+static int
+testPast ()
+{
+  struct MHD_TimerWheel wheel;
+  struct MHD_Timer timer;
+
+  memset (&timer, 0, sizeof (timer));
+  MHD_timer_wheel_init (&wheel, START_TIME);
+  MHD_timer_wheel_add (&wheel, &timer, START_TIME - 1);
+  if (&timer != MHD_timer_wheel_pop_expired (&wheel))
+    return 128;
+  if (NULL != MHD_timer_wheel_pop_expired (&wheel))
+    return 256;
+  MHD_timer_wheel_add (&wheel, &timer, START_TIME + 1);
+  MHD_timer_wheel_remove (&wheel, &timer);
+  MHD_timer_wheel_remove (&wheel, &timer);
+  MHD_timer_wheel_advance (&wheel, START_TIME + 1000);
+  if (NULL != MHD_timer_wheel_pop_expired (&wheel))
+    return 512;
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  errorCount += testPast ();
+  errorCount += testRandom ();
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  return errorCount != 0;       /* 0 == pass */
+}
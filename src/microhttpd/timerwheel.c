@@ -0,0 +1,364 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file timerwheel.c
+ * @brief hierarchical timer wheel with millisecond resolution
+ * @author Christian Grothoff
+ *
+ * A timer is kept on the lowest level on which its deadline and the
+ * current time of the wheel only differ in the bits of that level.
+ * Its slot on that level therefore always lies ahead of the current
+ * position, and the slot is revisited exactly when the current time
+ * reaches the start of the slot.  At that point the timers of a
+ * slot on a higher level are re-inserted ("cascaded") into the
+ * finer levels, while the timers of a level 0 slot have expired.
+ * The bitmaps of occupied slots allow jumping directly to the next
+ * slot that needs attention.
+ */
+
+#include "internal.h"
+#include "timerwheel.h"
+
+
+/**
+ * Shift to apply to a time to obtain the slot index on @a level.
+ */
+#define LEVEL_SHIFT(level) (MHD_TIMER_WHEEL_BITS * (level))
+
+/**
+ * Largest distance from the current time that the top level of
+ * the wheel can represent (one rotation minus one slot).
+ */
+#define MAX_TOP_DISTANCE \
+  ((((uint64_t) MHD_TIMER_WHEEL_SLOTS) - 1) << LEVEL_SHIFT (MHD_TIMER_WHEEL_LEVELS - 1))
+
+
+/**
+ * Find the lowest bit set in @a v.
+ *
+ * @param v value to check, must not be 0
+ * @return index of the lowest bit set
+ */
+static unsigned int
+lowest_bit (uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return (unsigned int) __builtin_ctzll (v);
+#else
+  unsigned int ret = 0;
+
+  while (0 == (v & 1))
+    {
+      v >>= 1;
+      ret++;
+    }
+  return ret;
+#endif
+}
+
+
+/**
+ * Insert @a timer at the head of the list at @a head.
+ *
+ * @param head list to insert into
+ * @param timer timer to insert
+ */
+static void
+list_insert (struct MHD_Timer **head,
+             struct MHD_Timer *timer)
+{
+  timer->head = head;
+  timer->prev = NULL;
+  timer->next = *head;
+  if (NULL != *head)
+    (*head)->prev = timer;
+  *head = timer;
+}
+
+
+/**
+ * Put @a timer into the slot matching its deadline.
+ *
+ * @param wheel wheel to insert into
+ * @param timer timer to insert, must not be scheduled
+ */
+static void
+place_timer (struct MHD_TimerWheel *wheel,
+             struct MHD_Timer *timer)
+{
+  uint64_t deadline = timer->deadline;
+  unsigned int level;
+  unsigned int idx;
+
+  if (deadline <= wheel->now)
+    {
+      list_insert (&wheel->expired,
+                   timer);
+      return;
+    }
+  for (level = 0; level < MHD_TIMER_WHEEL_LEVELS - 1; level++)
+    if ( (deadline >> LEVEL_SHIFT (level + 1)) ==
+         (wheel->now >> LEVEL_SHIFT (level + 1)) )
+      break;
+  /* the top level wraps around; deadlines beyond its range are
+     revisited (and re-inserted) in the last slot it covers */
+  if ( (MHD_TIMER_WHEEL_LEVELS - 1 == level) &&
+       (deadline - wheel->now > MAX_TOP_DISTANCE) )
+    deadline = wheel->now + MAX_TOP_DISTANCE;
+  idx = (unsigned int) (deadline >> LEVEL_SHIFT (level)) & (MHD_TIMER_WHEEL_SLOTS - 1);
+  list_insert (&wheel->slots[level][idx],
+               timer);
+  wheel->occupied[level] |= ((uint64_t) 1) << idx;
+}
+
+
+/**
+ * Initialize an (empty) timer wheel.
+ *
+ * @param wheel wheel to initialize
+ * @param now current time in milliseconds
+ */
+void
+MHD_timer_wheel_init (struct MHD_TimerWheel *wheel,
+                      uint64_t now)
+{
+  memset (wheel, 0, sizeof (struct MHD_TimerWheel));
+  wheel->now = now;
+}
+
+
+/**
+ * Unschedule a timer.  Does nothing if the timer is not scheduled.
+ *
+ * @param wheel wheel the timer is scheduled in
+ * @param timer timer to remove
+ */
+void
+MHD_timer_wheel_remove (struct MHD_TimerWheel *wheel,
+                        struct MHD_Timer *timer)
+{
+  struct MHD_Timer **head = timer->head;
+  size_t off;
+
+  if (NULL == head)
+    return;
+  if (NULL == timer->prev)
+    *head = timer->next;
+  else
+    timer->prev->next = timer->next;
+  if (NULL != timer->next)
+    timer->next->prev = timer->prev;
+  timer->next = NULL;
+  timer->prev = NULL;
+  timer->head = NULL;
+  if ( (NULL != *head) ||
+       (&wheel->expired == head) )
+    return;
+  /* slot became empty, update bitmap */
+  off = head - &wheel->slots[0][0];
+  wheel->occupied[off / MHD_TIMER_WHEEL_SLOTS]
+    &= ~(((uint64_t) 1) << (off % MHD_TIMER_WHEEL_SLOTS));
+}
+
+
+/**
+ * Schedule a timer, or move it if it is already scheduled.
+ * A deadline that has already passed makes the timer expire
+ * immediately.
+ *
+ * @param wheel wheel to schedule the timer in
+ * @param timer timer to schedule
+ * @param deadline time (in milliseconds) at which the timer expires
+ */
+void
+MHD_timer_wheel_add (struct MHD_TimerWheel *wheel,
+                     struct MHD_Timer *timer,
+                     uint64_t deadline)
+{
+  MHD_timer_wheel_remove (wheel,
+                          timer);
+  timer->deadline = deadline;
+  place_timer (wheel,
+               timer);
+}
+
+
+/**
+ * Compute the next time after the current time of the wheel at
+ * which a non-empty slot is reached.
+ *
+ * @param wheel wheel to check
+ * @return UINT64_MAX if the wheel is empty
+ */
+static uint64_t
+next_slot_time (const struct MHD_TimerWheel *wheel)
+{
+  uint64_t best = UINT64_MAX;
+  uint64_t mask;
+  uint64_t t;
+  unsigned int level;
+  unsigned int cur;
+
+  for (level = 0; level < MHD_TIMER_WHEEL_LEVELS; level++)
+    {
+      if (0 == wheel->occupied[level])
+        continue;
+      cur = (unsigned int) (wheel->now >> LEVEL_SHIFT (level)) & (MHD_TIMER_WHEEL_SLOTS - 1);
+      t = (wheel->now >> LEVEL_SHIFT (level + 1)) << LEVEL_SHIFT (level + 1);
+      /* only slots after the current position can be occupied,
+         except on the top level, where slots before it belong
+         to the next rotation */
+      mask = wheel->occupied[level] & ~((((uint64_t) 2) << cur) - 1);
+      if (0 == mask)
+        {
+          mask = wheel->occupied[level];
+          t += ((uint64_t) 1) << LEVEL_SHIFT (level + 1);
+        }
+      t |= ((uint64_t) lowest_bit (mask)) << LEVEL_SHIFT (level);
+      if (t < best)
+        best = t;
+    }
+  return best;
+}
+
+
+/**
+ * Re-insert all timers of a slot relative to the current
+ * time of the wheel.
+ *
+ * @param wheel wheel to update
+ * @param level level of the slot
+ * @param idx index of the slot
+ */
+static void
+cascade (struct MHD_TimerWheel *wheel,
+         unsigned int level,
+         unsigned int idx)
+{
+  struct MHD_Timer *pos;
+  struct MHD_Timer *next;
+
+  next = wheel->slots[level][idx];
+  wheel->slots[level][idx] = NULL;
+  wheel->occupied[level] &= ~(((uint64_t) 1) << idx);
+  while (NULL != (pos = next))
+    {
+      next = pos->next;
+      pos->next = NULL;
+      pos->prev = NULL;
+      pos->head = NULL;
+      place_timer (wheel,
+                   pos);
+    }
+}
+
+
+/**
+ * Advance the wheel, moving all timers that expire at or
+ * before @a now to the list of expired timers.
+ *
+ * @param wheel wheel to advance
+ * @param now current time in milliseconds
+ */
+void
+MHD_timer_wheel_advance (struct MHD_TimerWheel *wheel,
+                         uint64_t now)
+{
+  uint64_t next;
+  unsigned int level;
+  unsigned int idx;
+
+  while (wheel->now < now)
+    {
+      next = next_slot_time (wheel);
+      if (next > now)
+        {
+          wheel->now = now;
+          return;
+        }
+      wheel->now = next;
+      for (level = MHD_TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+        {
+          if (0 != (next & ((((uint64_t) 1) << LEVEL_SHIFT (level)) - 1)))
+            continue;
+          idx = (unsigned int) (next >> LEVEL_SHIFT (level)) & (MHD_TIMER_WHEEL_SLOTS - 1);
+          if (0 != (wheel->occupied[level] & (((uint64_t) 1) << idx)))
+            cascade (wheel, level, idx);
+        }
+      /* everything in the level 0 slot (and anything cascaded
+         into it) has expired now */
+      idx = (unsigned int) next & (MHD_TIMER_WHEEL_SLOTS - 1);
+      if (0 != (wheel->occupied[0] & (((uint64_t) 1) << idx)))
+        cascade (wheel, 0, idx);
+    }
+}
+
+
+/**
+ * Obtain the next expired timer; the timer is no longer
+ * scheduled afterwards.
+ *
+ * @param wheel wheel to check
+ * @return NULL if no (more) timers have expired
+ */
+struct MHD_Timer *
+MHD_timer_wheel_pop_expired (struct MHD_TimerWheel *wheel)
+{
+  struct MHD_Timer *ret = wheel->expired;
+
+  if (NULL != ret)
+    MHD_timer_wheel_remove (wheel,
+                            ret);
+  return ret;
+}
+
+
+/**
+ * Determine when the wheel next needs to be advanced.  The
+ * result is never after the earliest deadline; it is exact if
+ * that deadline lies in the current block of
+ * #MHD_TIMER_WHEEL_SLOTS milliseconds, otherwise it is the time
+ * at which the timer moves to a finer level of the wheel.
+ *
+ * @param wheel wheel to check
+ * @param[out] deadline set to the time (in milliseconds) when
+ *             #MHD_timer_wheel_advance() should be called next
+ * @return #MHD_YES if a timer is scheduled, #MHD_NO if the
+ *         wheel is empty (@a deadline is not set)
+ */
+int
+MHD_timer_wheel_next (const struct MHD_TimerWheel *wheel,
+                      uint64_t *deadline)
+{
+  uint64_t next;
+
+  if (NULL != wheel->expired)
+    {
+      *deadline = wheel->now;
+      return MHD_YES;
+    }
+  next = next_slot_time (wheel);
+  if (UINT64_MAX == next)
+    return MHD_NO;
+  *deadline = next;
+  return MHD_YES;
+}
+
+/* end of timerwheel.c */
@@ -0,0 +1,195 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file timerwheel.h
+ * @brief hierarchical timer wheel with millisecond resolution;
+ *        used to track connection timeouts with O(1) insertion
+ *        and removal, and expiration cost proportional to the
+ *        number of expired timers
+ * @author Christian Grothoff
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include "platform.h"
+
+/**
+ * Number of bits of the deadline covered by each level of the wheel.
+ */
+#define MHD_TIMER_WHEEL_BITS 6
+
+/**
+ * Number of slots per level of the wheel.
+ */
+#define MHD_TIMER_WHEEL_SLOTS (1 << MHD_TIMER_WHEEL_BITS)
+
+/**
+ * Number of levels of the wheel; together they cover 2^42 ms
+ * (about 139 years).
+ */
+#define MHD_TIMER_WHEEL_LEVELS 7
+
+
+/**
+ * A timer that can be scheduled in a timer wheel.  Typically
+ * embedded in the structure the timer is for.
+ */
+struct MHD_Timer
+{
+
+  /**
+   * Next timer in the same slot.
+   */
+  struct MHD_Timer *next;
+
+  /**
+   * Previous timer in the same slot.
+   */
+  struct MHD_Timer *prev;
+
+  /**
+   * Head of the list this timer is in, NULL if the
+   * timer is not scheduled.
+   */
+  struct MHD_Timer **head;
+
+  /**
+   * Time (in milliseconds) at which the timer expires.
+   */
+  uint64_t deadline;
+
+  /**
+   * Closure for the owner of the timer.
+   */
+  void *cls;
+};
+
+
+/**
+ * Hierarchical timer wheel.  Not reentrant; must not be used by
+ * multiple threads without external locking.
+ */
+struct MHD_TimerWheel
+{
+
+  /**
+   * Slots of the wheel, level 0 has a granularity of one
+   * millisecond, each further level is #MHD_TIMER_WHEEL_SLOTS
+   * times coarser.
+   */
+  struct MHD_Timer *slots[MHD_TIMER_WHEEL_LEVELS][MHD_TIMER_WHEEL_SLOTS];
+
+  /**
+   * Bitmap of the non-empty slots of each level.
+   */
+  uint64_t occupied[MHD_TIMER_WHEEL_LEVELS];
+
+  /**
+   * Timers that have expired but were not yet collected
+   * with #MHD_timer_wheel_pop_expired().
+   */
+  struct MHD_Timer *expired;
+
+  /**
+   * Time (in milliseconds) up to which the wheel was advanced.
+   */
+  uint64_t now;
+};
+
+
+/**
+ * Initialize an (empty) timer wheel.
+ *
+ * @param wheel wheel to initialize
+ * @param now current time in milliseconds
+ */
+void
+MHD_timer_wheel_init (struct MHD_TimerWheel *wheel,
+                      uint64_t now);
+
+
+/**
+ * Schedule a timer, or move it if it is already scheduled.
+ * A deadline that has already passed makes the timer expire
+ * immediately.
+ *
+ * @param wheel wheel to schedule the timer in
+ * @param timer timer to schedule
+ * @param deadline time (in milliseconds) at which the timer expires
+ */
+void
+MHD_timer_wheel_add (struct MHD_TimerWheel *wheel,
+                     struct MHD_Timer *timer,
+                     uint64_t deadline);
+
+
+/**
+ * Unschedule a timer.  Does nothing if the timer is not scheduled.
+ *
+ * @param wheel wheel the timer is scheduled in
+ * @param timer timer to remove
+ */
+void
+MHD_timer_wheel_remove (struct MHD_TimerWheel *wheel,
+                        struct MHD_Timer *timer);
+
+
+/**
+ * Advance the wheel, moving all timers that expire at or
+ * before @a now to the list of expired timers.
+ *
+ * @param wheel wheel to advance
+ * @param now current time in milliseconds
+ */
+void
+MHD_timer_wheel_advance (struct MHD_TimerWheel *wheel,
+                         uint64_t now);
+
+
+/**
+ * Obtain the next expired timer; the timer is no longer
+ * scheduled afterwards.
+ *
+ * @param wheel wheel to check
+ * @return NULL if no (more) timers have expired
+ */
+struct MHD_Timer *
+MHD_timer_wheel_pop_expired (struct MHD_TimerWheel *wheel);
+
+
+/**
+ * Determine when the wheel next needs to be advanced.  The
+ * result is never after the earliest deadline; it is exact if
+ * that deadline lies in the current block of
+ * #MHD_TIMER_WHEEL_SLOTS milliseconds, otherwise it is the time
+ * at which the timer moves to a finer level of the wheel.
+ *
+ * @param wheel wheel to check
+ * @param[out] deadline set to the time (in milliseconds) when
+ *             #MHD_timer_wheel_advance() should be called next
+ * @return #MHD_YES if a timer is scheduled, #MHD_NO if the
+ *         wheel is empty (@a deadline is not set)
+ */
+int
+MHD_timer_wheel_next (const struct MHD_TimerWheel *wheel,
+                      uint64_t *deadline);
+
+#endif
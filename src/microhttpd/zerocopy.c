@@ -0,0 +1,344 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file zerocopy.c
+ * @brief sends with MSG_ZEROCOPY and their completion notifications
+ * @author Christian Grothoff
+ *
+ * With `MSG_ZEROCOPY`, the kernel sends the data directly from the
+ * pages of the application, which thus must not be changed or freed
+ * until the kernel reports (on the error queue of the socket) that
+ * the send completed.  The kernel numbers the sends of a socket and
+ * reports ranges of completed sends, which may arrive out of order.
+ * We keep a list of pins, each holding a reference to the response
+ * of a run of consecutive sends and counting those of them not
+ * reported yet, and release a pin once all of its sends completed.
+ * A socket whose
+ * connection is closed with pending sends is kept open (it is
+ * already shut down for writing) until they completed, as only then
+ * can the kernel still report them.
+ */
+
+#include "zerocopy.h"
+#include "response.h"
+#include "mhd_mono_clock.h"
+#include <linux/errqueue.h>
+#include <poll.h>
+
+/**
+ * How long (in ms) to wait for pending sends when the daemon is
+ * stopped.
+ */
+#define ZEROCOPY_LINGER_MS 1000
+
+
+/**
+ * Compare numbers of sends, which wrap around.
+ *
+ * @param a number of a send
+ * @param b number of a send
+ * @return non-zero if @a a was before @a b
+ */
+#define SEND_BEFORE(a,b) (0 > (int32_t) ((uint32_t) (a) - (uint32_t) (b)))
+
+
+/**
+ * Note that the sends @a lo to @a hi completed.
+ *
+ * @param zc state of the socket
+ * @param lo number of the first completed send
+ * @param hi number of the last completed send
+ */
+static void
+note_completed (struct MHD_ZeroCopy *zc,
+                uint32_t lo,
+                uint32_t hi)
+{
+  struct MHD_ZeroCopyPin *pin;
+  uint32_t first;
+  uint32_t last;
+  uint32_t cnt;
+
+  for (pin = zc->head; NULL != pin; pin = pin->next)
+    {
+      if (0 == pin->pending)
+        continue;
+      first = SEND_BEFORE (lo, pin->first) ? pin->first : lo;
+      last = SEND_BEFORE (pin->last, hi) ? pin->last : hi;
+      if (SEND_BEFORE (last, first))
+        continue; /* no overlap */
+      cnt = last - first + 1;
+      pin->pending -= (cnt < pin->pending) ? cnt : pin->pending;
+    }
+}
+
+
+/**
+ * Release the pins whose sends all completed.
+ *
+ * @param zc state of the socket
+ */
+static void
+release_completed (struct MHD_ZeroCopy *zc)
+{
+  struct MHD_ZeroCopyPin *pin;
+  struct MHD_ZeroCopyPin *prev;
+  struct MHD_ZeroCopyPin *next;
+
+  prev = NULL;
+  for (pin = zc->head; NULL != pin; pin = next)
+    {
+      next = pin->next;
+      if (0 != pin->pending)
+        {
+          prev = pin;
+          continue;
+        }
+      if (NULL == prev)
+        zc->head = next;
+      else
+        prev->next = next;
+      if (zc->tail == pin)
+        zc->tail = prev;
+      MHD_destroy_response (pin->response);
+      free (pin);
+    }
+}
+
+
+/**
+ * Prepare a send of data of @a response with `MSG_ZEROCOPY`: enable
+ * `SO_ZEROCOPY` on the socket if needed and take a reference to
+ * @a response.
+ *
+ * @param zc state of the socket
+ * @param fd the socket
+ * @param response response the data to send belongs to
+ * @return #MHD_YES if the send may use `MSG_ZEROCOPY`
+ */
+int
+MHD_zerocopy_prepare_ (struct MHD_ZeroCopy *zc,
+                       MHD_socket fd,
+                       struct MHD_Response *response)
+{
+  struct MHD_ZeroCopyPin *pin;
+  int on;
+
+  if (MHD_ZEROCOPY_OFF == zc->state)
+    return MHD_NO;
+  if (MHD_ZEROCOPY_UNTRIED == zc->state)
+    {
+      on = 1;
+      if (0 != setsockopt (fd,
+                           SOL_SOCKET,
+                           SO_ZEROCOPY,
+                           &on,
+                           sizeof (on)))
+        {
+          zc->state = MHD_ZEROCOPY_OFF;
+          return MHD_NO;
+        }
+      zc->state = MHD_ZEROCOPY_ON;
+    }
+  if ( (NULL != zc->tail) &&
+       (response == zc->tail->response) )
+    return MHD_YES;
+  if (NULL == (pin = malloc (sizeof (struct MHD_ZeroCopyPin))))
+    return MHD_NO;
+  MHD_increment_response_rc (response);
+  pin->next = NULL;
+  pin->response = response;
+  /* no sends yet; released by the next reap if the send fails */
+  pin->first = zc->next;
+  pin->last = zc->next - 1;
+  pin->pending = 0;
+  if (NULL == zc->tail)
+    zc->head = pin;
+  else
+    zc->tail->next = pin;
+  zc->tail = pin;
+  return MHD_YES;
+}
+
+
+/**
+ * Note a successful send with `MSG_ZEROCOPY`, after
+ * MHD_zerocopy_prepare_().
+ *
+ * @param zc state of the socket
+ */
+void
+MHD_zerocopy_sent_ (struct MHD_ZeroCopy *zc)
+{
+  zc->tail->last = zc->next++;
+  zc->tail->pending++;
+}
+
+
+/**
+ * Read the completion notifications from the error queue of the
+ * socket and release the responses of the completed sends.
+ *
+ * @param zc state of the socket
+ * @param fd the socket
+ * @return #MHD_YES if sends are still pending
+ */
+int
+MHD_zerocopy_reap_ (struct MHD_ZeroCopy *zc,
+                    MHD_socket fd)
+{
+  struct msghdr msg;
+  struct cmsghdr *cm;
+  struct sock_extended_err *serr;
+  char control[128];
+
+  while (1)
+    {
+      memset (&msg, 0, sizeof (msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof (control);
+      if (0 > recvmsg (fd, &msg, MSG_ERRQUEUE))
+        break; /* EAGAIN: no (more) notifications */
+      for (cm = CMSG_FIRSTHDR (&msg); NULL != cm; cm = CMSG_NXTHDR (&msg, cm))
+        {
+          if (! ( ( (SOL_IP == cm->cmsg_level) &&
+                    (IP_RECVERR == cm->cmsg_type) ) ||
+                  ( (SOL_IPV6 == cm->cmsg_level) &&
+                    (IPV6_RECVERR == cm->cmsg_type) ) ) )
+            continue;
+          serr = (struct sock_extended_err *) CMSG_DATA (cm);
+          if ( (SO_EE_ORIGIN_ZEROCOPY != serr->ee_origin) ||
+               (0 != serr->ee_errno) )
+            continue;
+          /* sends ee_info to ee_data completed */
+          note_completed (zc,
+                          serr->ee_info,
+                          serr->ee_data);
+          /* the kernel had to copy the data (for example on
+             loopback); not worth the notifications */
+          if (0 != (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED))
+            zc->state = MHD_ZEROCOPY_OFF;
+        }
+    }
+  release_completed (zc);
+  return (NULL != zc->head) ? MHD_YES : MHD_NO;
+}
+
+
+/**
+ * Release all responses and reset @a zc, for a new socket.
+ *
+ * @param zc state of the socket
+ */
+void
+MHD_zerocopy_release_ (struct MHD_ZeroCopy *zc)
+{
+  struct MHD_ZeroCopyPin *pin;
+
+  while (NULL != (pin = zc->head))
+    {
+      zc->head = pin->next;
+      MHD_destroy_response (pin->response);
+      free (pin);
+    }
+  memset (zc, 0, sizeof (struct MHD_ZeroCopy));
+}
+
+
+/**
+ * Keep the socket of a closed connection open until its pending
+ * sends completed.  Takes over the responses of @a zc, which is
+ * reset.
+ *
+ * @param daemon daemon of the connection
+ * @param fd the socket, shut down for writing
+ * @param zc state of the socket
+ * @return #MHD_NO on error (out of memory), in which case the
+ *         caller remains responsible for @a fd and @a zc
+ */
+int
+MHD_zerocopy_orphan_ (struct MHD_Daemon *daemon,
+                      MHD_socket fd,
+                      struct MHD_ZeroCopy *zc)
+{
+  struct MHD_ZeroCopyOrphan *orphan;
+
+  if (NULL == (orphan = malloc (sizeof (struct MHD_ZeroCopyOrphan))))
+    return MHD_NO;
+  orphan->next = NULL;
+  orphan->prev = NULL;
+  orphan->fd = fd;
+  orphan->zc = *zc;
+  memset (zc, 0, sizeof (struct MHD_ZeroCopy));
+  DLL_insert (daemon->zerocopy_orphans_head,
+              daemon->zerocopy_orphans_tail,
+              orphan);
+  return MHD_YES;
+}
+
+
+/**
+ * Close the sockets of closed connections whose sends completed.
+ *
+ * @param daemon daemon to process
+ * @param force #MHD_YES to close all sockets (when the daemon is
+ *        stopped), after waiting a little for pending sends
+ */
+void
+MHD_zerocopy_reap_orphans_ (struct MHD_Daemon *daemon,
+                            int force)
+{
+  struct MHD_ZeroCopyOrphan *pos;
+  struct MHD_ZeroCopyOrphan *next;
+  struct pollfd p;
+  uint64_t deadline;
+  uint64_t now;
+
+  deadline = MHD_monotonic_msec_counter () + ZEROCOPY_LINGER_MS;
+  for (pos = daemon->zerocopy_orphans_head; NULL != pos; pos = next)
+    {
+      next = pos->next;
+      while ( (MHD_YES == MHD_zerocopy_reap_ (&pos->zc, pos->fd)) &&
+              (MHD_YES == force) &&
+              (deadline > (now = MHD_monotonic_msec_counter ())) )
+        {
+          /* notifications make the socket report an error */
+          p.fd = pos->fd;
+          p.events = 0;
+          p.revents = 0;
+          (void) poll (&p, 1, (int) (deadline - now));
+        }
+      if ( (NULL != pos->zc.head) &&
+           (MHD_YES != force) )
+        continue;
+      /* if sends are still pending, the daemon is being stopped;
+         the data of the released responses may be sent garbled
+         (the kernel keeps the pages), but that is all */
+      DLL_remove (daemon->zerocopy_orphans_head,
+                  daemon->zerocopy_orphans_tail,
+                  pos);
+      MHD_zerocopy_release_ (&pos->zc);
+      if (0 != MHD_socket_close_ (pos->fd))
+        MHD_PANIC ("close failed\n");
+      free (pos);
+    }
+}
+
+/* end of zerocopy.c */
@@ -0,0 +1,120 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * @file zerocopy.h
+ * @brief sends with MSG_ZEROCOPY and their completion notifications
+ * @author Christian Grothoff
+ */
+
+#ifndef ZEROCOPY_H
+#define ZEROCOPY_H
+
+#include "internal.h"
+
+#if ZEROCOPY_SUPPORT
+
+/**
+ * How often (in ms) to check the sockets of closed connections for
+ * completed sends.
+ */
+#define MHD_ZEROCOPY_REAP_INTERVAL_MS 10
+
+
+/**
+ * Prepare a send of data of @a response with `MSG_ZEROCOPY`: enable
+ * `SO_ZEROCOPY` on the socket if needed and take a reference to
+ * @a response.
+ *
+ * @param zc state of the socket
+ * @param fd the socket
+ * @param response response the data to send belongs to
+ * @return #MHD_YES if the send may use `MSG_ZEROCOPY`
+ */
+int
+MHD_zerocopy_prepare_ (struct MHD_ZeroCopy *zc,
+                       MHD_socket fd,
+                       struct MHD_Response *response);
+
+
+/**
+ * Note a successful send with `MSG_ZEROCOPY`, after
+ * MHD_zerocopy_prepare_().
+ *
+ * @param zc state of the socket
+ */
+void
+MHD_zerocopy_sent_ (struct MHD_ZeroCopy *zc);
+
+
+/**
+ * Read the completion notifications from the error queue of the
+ * socket and release the responses of the completed sends.
+ *
+ * @param zc state of the socket
+ * @param fd the socket
+ * @return #MHD_YES if sends are still pending
+ */
+int
+MHD_zerocopy_reap_ (struct MHD_ZeroCopy *zc,
+                    MHD_socket fd);
+
+
+/**
+ * Release all responses and reset @a zc, for a new socket.
+ *
+ * @param zc state of the socket
+ */
+void
+MHD_zerocopy_release_ (struct MHD_ZeroCopy *zc);
+
+
+/**
+ * Keep the socket of a closed connection open until its pending
+ * sends completed.  Takes over the responses of @a zc, which is
+ * reset.
+ *
+ * @param daemon daemon of the connection
+ * @param fd the socket, shut down for writing
+ * @param zc state of the socket
+ * @return #MHD_NO on error (out of memory), in which case the
+ *         caller remains responsible for @a fd and @a zc
+ */
+int
+MHD_zerocopy_orphan_ (struct MHD_Daemon *daemon,
+                      MHD_socket fd,
+                      struct MHD_ZeroCopy *zc);
+
+
+/**
+ * Close the sockets of closed connections whose sends completed.
+ *
+ * @param daemon daemon to process
+ * @param force #MHD_YES to close all sockets (when the daemon is
+ *        stopped), after waiting a little for pending sends
+ */
+void
+MHD_zerocopy_reap_orphans_ (struct MHD_Daemon *daemon,
+                            int force);
+
+#endif
+
+#endif
+
+/* end of zerocopy.h */
@@ -0,0 +1,316 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file perf_dispatch.c
+ * @brief benchmark the latency of short GET operations on a thread
+ *        pool where some workers are kept busy by slow streaming
+ *        responses, for the different worker dispatch policies.
+ *        As with the other benchmarks, libcurl runs on the same
+ *        machine, so only the relative scores between the
+ *        policies and between MHD versions are meaningful.
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "gauger.h"
+
+/**
+ * Number of worker threads in the pool.
+ */
+#define WORKERS 4
+
+/**
+ * Number of slow streaming connections (each keeps its worker busy).
+ */
+#define STREAMS 2
+
+/**
+ * How long does producing each block of a stream take (in microseconds)?
+ */
+#define STREAM_DELAY_US 5000
+
+/**
+ * How many short GETs do we time for each policy?
+ */
+#define ROUNDS 200
+
+/**
+ * Response to return for short GETs (re-used).
+ */
+static struct MHD_Response *response;
+
+/**
+ * Latencies of the short GETs of the current round, in microseconds.
+ */
+static unsigned long long latencies[ROUNDS];
+
+
+/**
+ * Get the current timestamp
+ *
+ * @return current time in microseconds
+ */
+static unsigned long long
+now_us ()
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return (((unsigned long long) tv.tv_sec * 1000000LL) +
+	  ((unsigned long long) tv.tv_usec));
+}
+
+
+static size_t
+copyBuffer (void *ptr,
+	    size_t size, size_t nmemb,
+	    void *ctx)
+{
+  return size * nmemb;
+}
+
+
+static ssize_t
+stream_reader (void *cls,
+               uint64_t pos,
+               char *buf,
+               size_t max)
+{
+  /* simulate an expensive generator that blocks its worker */
+  usleep (STREAM_DELAY_US);
+  if (max > 1024)
+    max = 1024;
+  memset (buf, 'S', max);
+  return max;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *stream;
+  int ret;
+
+  if (0 != strcmp ("GET", method))
+    return MHD_NO;              /* unexpected method */
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  if (0 != strcmp ("/stream", url))
+    return MHD_queue_response (connection, MHD_HTTP_OK, response);
+  /* the size is known, so the stream counts for
+     #MHD_DISPATCH_LEAST_QUEUED_BYTES */
+  stream = MHD_create_response_from_callback (1LLU << 40,
+                                              1024,
+                                              &stream_reader,
+                                              NULL,
+                                              NULL);
+  if (NULL == stream)
+    abort ();
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, stream);
+  MHD_destroy_response (stream);
+  return ret;
+}
+
+
+/**
+ * Start a process that downloads a (practically endless) stream.
+ *
+ * @param port port of the daemon
+ * @return process ID of the downloader
+ */
+static pid_t
+start_stream (int port)
+{
+  pid_t ret;
+  CURL *c;
+  char url[64];
+
+  sprintf (url, "http://127.0.0.1:%d/stream", port);
+  ret = fork ();
+  if (-1 == ret)
+    abort ();
+  if (0 != ret)
+    return ret;
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, url);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, NULL);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1);
+  (void) curl_easy_perform (c);
+  curl_easy_cleanup (c);
+  _exit (0);
+}
+
+
+static int
+compare_latency (const void *a,
+                 const void *b)
+{
+  unsigned long long la = *(const unsigned long long *) a;
+  unsigned long long lb = *(const unsigned long long *) b;
+
+  if (la < lb)
+    return -1;
+  return (la > lb) ? 1 : 0;
+}
+
+
+static int
+testDispatch (int port,
+              enum MHD_WorkerDispatchPolicy policy,
+              unsigned int stealing,
+              const char *desc)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  CURLcode errornum;
+  pid_t streams[STREAMS];
+  unsigned long long start;
+  unsigned int done;
+  unsigned int i;
+  char url[64];
+  double p50;
+  double p99;
+
+  /* with per-worker listen sockets, the kernel distributes the
+     connections without regard to the load of the workers */
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_THREAD_POOL_SIZE, WORKERS,
+                        MHD_OPTION_LISTEN_SOCKET_PER_WORKER, 1,
+                        MHD_OPTION_WORKER_DISPATCH_POLICY, policy,
+                        MHD_OPTION_WORKER_WORK_STEALING, stealing,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+                          port, NULL, NULL, &ahc_echo, NULL,
+                          MHD_OPTION_THREAD_POOL_SIZE, WORKERS,
+                          MHD_OPTION_WORKER_DISPATCH_POLICY, policy,
+                          MHD_OPTION_WORKER_WORK_STEALING, stealing,
+                          MHD_OPTION_END);
+  if (NULL == d)
+    return 1;
+  for (i = 0; i < STREAMS; i++)
+    {
+      streams[i] = start_stream (port);
+      /* let each stream settle before the next connection arrives */
+      usleep (100000);
+    }
+  sprintf (url, "http://127.0.0.1:%d/hello_world", port);
+  for (i = 0; i < ROUNDS; i++)
+    {
+      c = curl_easy_init ();
+      curl_easy_setopt (c, CURLOPT_URL, url);
+      curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+      curl_easy_setopt (c, CURLOPT_WRITEDATA, NULL);
+      curl_easy_setopt (c, CURLOPT_FAILONERROR, 1);
+      curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+      curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+      curl_easy_setopt (c, CURLOPT_FORBID_REUSE, 1);
+      curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+      /* NOTE: use of CONNECTTIMEOUT without also
+	 setting NOSIGNAL results in really weird
+	 crashes on my system! */
+      curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1);
+      start = now_us ();
+      if (CURLE_OK != (errornum = curl_easy_perform (c)))
+        {
+          fprintf (stderr,
+                   "curl_easy_perform failed: `%s'\n",
+                   curl_easy_strerror (errornum));
+          curl_easy_cleanup (c);
+          break;
+        }
+      latencies[i] = now_us () - start;
+      curl_easy_cleanup (c);
+    }
+  done = i;
+  for (i = 0; i < STREAMS; i++)
+    {
+      kill (streams[i], SIGKILL);
+      waitpid (streams[i], NULL, 0);
+    }
+  MHD_stop_daemon (d);
+  if (ROUNDS != done)
+    return 2;
+  qsort (latencies, ROUNDS, sizeof (unsigned long long), &compare_latency);
+  p50 = latencies[ROUNDS / 2] / 1000.0;
+  p99 = latencies[(ROUNDS * 99) / 100] / 1000.0;
+  fprintf (stderr,
+           "Short GETs with %u busy workers using %s: p50 %f ms, p99 %f ms\n",
+           STREAMS,
+           desc,
+           p50,
+           p99);
+  GAUGER (desc,
+          "p99 latency of short GETs with busy workers",
+          p99,
+          "ms");
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  int port = 1083;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  response = MHD_create_response_from_buffer (strlen ("/hello_world"),
+					      "/hello_world",
+					      MHD_RESPMEM_MUST_COPY);
+  errorCount += testDispatch (port, MHD_DISPATCH_DEFAULT, 0,
+                              "default dispatch");
+  errorCount += testDispatch (port, MHD_DISPATCH_ROUND_ROBIN, 0,
+                              "round-robin dispatch");
+  errorCount += testDispatch (port, MHD_DISPATCH_LEAST_CONNECTIONS, 0,
+                              "least-connections dispatch");
+  errorCount += testDispatch (port, MHD_DISPATCH_LEAST_QUEUED_BYTES, 0,
+                              "least-queued-bytes dispatch");
+  errorCount += testDispatch (port, MHD_DISPATCH_ROUND_ROBIN, 1,
+                              "round-robin dispatch with work stealing");
+  MHD_destroy_response (response);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
@@ -356,6 +356,67 @@ testMultithreadedPoolGet (int port, int poll_flag)
   return 0;
 }
 
+static int
+testCachedGet (int port, int flags, const char *desc)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  char buf[2048];
+  struct CBC cbc;
+  CURLcode errornum;
+  unsigned int i;
+  char url[64];
+
+  sprintf(url, "http://127.0.0.1:%d/hello_world", port);
+
+  cbc.buf = buf;
+  cbc.size = 2048;
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, "GET",
+                        MHD_OPTION_CONNECTION_CACHE_SIZE, 16,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return 16;
+  start_timer ();
+  for (i=0;i<ROUNDS;i++)
+    {
+      cbc.pos = 0;
+      c = curl_easy_init ();
+      curl_easy_setopt (c, CURLOPT_URL, url);
+      curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+      curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+      curl_easy_setopt (c, CURLOPT_FAILONERROR, 1);
+      curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+      if (oneone)
+	curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+      else
+	curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+      curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+      /* NOTE: use of CONNECTTIMEOUT without also
+	 setting NOSIGNAL results in really weird
+	 crashes on my system!*/
+      curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1);
+      if (CURLE_OK != (errornum = curl_easy_perform (c)))
+	{
+	  fprintf (stderr,
+		   "curl_easy_perform failed: `%s'\n",
+		   curl_easy_strerror (errornum));
+	  curl_easy_cleanup (c);
+	  MHD_stop_daemon (d);
+	  return 32;
+	}
+      curl_easy_cleanup (c);
+    }
+  stop (desc);
+  MHD_stop_daemon (d);
+  if (cbc.pos != strlen ("/hello_world"))
+    return 64;
+  if (0 != strncmp ("/hello_world", cbc.buf, strlen ("/hello_world")))
+    return 128;
+  return 0;
+}
+
+
 static int
 testExternalGet (int port)
 {
@@ -524,6 +585,13 @@ main (int argc, char *const *argv)
       errorCount += testInternalGet(port++, MHD_USE_EPOLL_LINUX_ONLY);
       errorCount += testMultithreadedPoolGet(port++, MHD_USE_EPOLL_LINUX_ONLY);
     }
+  errorCount += testCachedGet (port++, MHD_USE_SELECT_INTERNALLY,
+                               "internal select with connection cache");
+  errorCount += testCachedGet (port++, MHD_USE_THREAD_PER_CONNECTION,
+                               "thread with select and connection cache");
+  if (MHD_YES == MHD_is_feature_supported(MHD_FEATURE_EPOLL))
+    errorCount += testCachedGet (port++, MHD_USE_SELECT_INTERNALLY | MHD_USE_EPOLL_LINUX_ONLY,
+                                 "internal epoll with connection cache");
   MHD_destroy_response (response);
   if (errorCount != 0)
     fprintf (stderr, "Error (code: %u)\n", errorCount);
@@ -279,6 +279,40 @@ testMultithreadedPoolGet (int port, int poll_flag)
   return 0;
 }
 
+static int
+testMultithreadedPoolAffinityGet (int port, int poll_flag)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  struct MHD_Daemon *d;
+  cpu_set_t allowed;
+  unsigned int cpus[CPU_COUNT];
+  unsigned int num_cpus;
+  unsigned int cpu;
+
+  /* pin the workers to the CPUs we may run on */
+  if (0 != sched_getaffinity (0, sizeof (allowed), &allowed))
+    return 0;
+  num_cpus = 0;
+  for (cpu = 0; (cpu < CPU_SETSIZE) && (num_cpus < CPU_COUNT); cpu++)
+    if (CPU_ISSET (cpu, &allowed))
+      cpus[num_cpus++] = cpu;
+  if (0 == num_cpus)
+    return 0;
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | poll_flag,
+                        port, NULL, NULL, &ahc_echo, "GET",
+                        MHD_OPTION_THREAD_POOL_SIZE, CPU_COUNT,
+                        MHD_OPTION_CPU_AFFINITY, num_cpus, cpus,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return 64;
+  start_timer ();
+  join_gets (do_gets (port));
+  stop (poll_flag ? "thread pool with affinity and poll" : "thread pool with affinity and select");
+  MHD_stop_daemon (d);
+#endif
+  return 0;
+}
+
 static int
 testExternalGet (int port)
 {
@@ -346,15 +380,18 @@ main (int argc, char *const *argv)
   errorCount += testInternalGet (port++, 0);
   errorCount += testMultithreadedGet (port++, 0);
   errorCount += testMultithreadedPoolGet (port++, 0);
+  errorCount += testMultithreadedPoolAffinityGet (port++, 0);
   errorCount += testExternalGet (port++);
 #ifndef WINDOWS
   errorCount += testInternalGet (port++, MHD_USE_POLL);
   errorCount += testMultithreadedGet (port++, MHD_USE_POLL);
   errorCount += testMultithreadedPoolGet (port++, MHD_USE_POLL);
+  errorCount += testMultithreadedPoolAffinityGet (port++, MHD_USE_POLL);
 #endif
 #if EPOLL_SUPPORT
   errorCount += testInternalGet (port++, MHD_USE_EPOLL_LINUX_ONLY);
   errorCount += testMultithreadedPoolGet (port++, MHD_USE_EPOLL_LINUX_ONLY);
+  errorCount += testMultithreadedPoolAffinityGet (port++, MHD_USE_EPOLL_LINUX_ONLY);
 #endif
   MHD_destroy_response (response);
   if (errorCount != 0)
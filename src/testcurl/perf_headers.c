@@ -0,0 +1,221 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file perf_headers.c
+ * @brief benchmark the cost of producing the response headers:
+ *        many small requests are sent over a single keep-alive
+ *        connection with a plain socket (so that the client adds
+ *        as little work as possible), once with and once without
+ *        the "Date:" header.  Only the relative scores between
+ *        the two runs and between MHD versions are meaningful.
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gauger.h"
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+/**
+ * How many requests do we send?
+ */
+#define ROUNDS 50000
+
+/**
+ * Request sent for each round.
+ */
+#define REQUEST "GET /hello_world HTTP/1.1\r\nHost: localhost\r\n\r\n"
+
+/**
+ * Body of the response.
+ */
+#define BODY "/hello_world"
+
+/**
+ * Response to return (re-used).
+ */
+static struct MHD_Response *response;
+
+
+/**
+ * Get the current timestamp
+ *
+ * @return current time in ms
+ */
+static unsigned long long
+now ()
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return (((unsigned long long) tv.tv_sec * 1000LL) +
+	  ((unsigned long long) tv.tv_usec / 1000LL));
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+
+  if (0 != strcmp ("GET", method))
+    return MHD_NO;              /* unexpected method */
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  return MHD_queue_response (connection, MHD_HTTP_OK, response);
+}
+
+
+/**
+ * Read one complete response from @a fd.
+ *
+ * @param fd socket to read from
+ * @return 0 on success
+ */
+static int
+read_response (int fd)
+{
+  char buf[1024];
+  size_t off;
+  ssize_t got;
+  const char *end;
+
+  off = 0;
+  while (1)
+    {
+      got = recv (fd, &buf[off], sizeof (buf) - 1 - off, 0);
+      if (got <= 0)
+        return 1;
+      off += got;
+      buf[off] = '\0';
+      end = strstr (buf, "\r\n\r\n");
+      if ( (NULL != end) &&
+           (off == (size_t) (end - buf) + 4 + strlen (BODY)) )
+        break;
+      if (sizeof (buf) - 1 == off)
+        return 2;
+    }
+  if (0 != strncmp ("HTTP/1.1 200 ", buf, strlen ("HTTP/1.1 200 ")))
+    return 4;
+  return 0;
+}
+
+
+static int
+testHeaders (int port, unsigned int flags, const char *desc)
+{
+  struct MHD_Daemon *d;
+  struct sockaddr_in sa;
+  unsigned long long start;
+  double rps;
+  unsigned int i;
+  int fd;
+  int ret;
+
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    return 1;
+  fd = socket (PF_INET, SOCK_STREAM, 0);
+  if (-1 == fd)
+    {
+      MHD_stop_daemon (d);
+      return 2;
+    }
+  memset (&sa, 0, sizeof (sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if (0 != connect (fd, (struct sockaddr *) &sa, sizeof (sa)))
+    {
+      close (fd);
+      MHD_stop_daemon (d);
+      return 4;
+    }
+  ret = 0;
+  start = now ();
+  for (i = 0; i < ROUNDS; i++)
+    {
+      if (strlen (REQUEST) != send (fd, REQUEST, strlen (REQUEST), 0))
+        {
+          ret = 8;
+          break;
+        }
+      if (0 != read_response (fd))
+        {
+          ret = 16;
+          break;
+        }
+    }
+  rps = ((double) (ROUNDS * 1000)) / ((double) (now () - start + 1));
+  close (fd);
+  MHD_stop_daemon (d);
+  if (0 != ret)
+    return ret;
+  fprintf (stderr,
+           "Keep-alive GETs %s: %f requests/s\n",
+           desc,
+           rps);
+  GAUGER (desc,
+          "Keep-alive GETs",
+          rps,
+          "requests/s");
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  response = MHD_create_response_from_buffer (strlen (BODY),
+					      BODY,
+					      MHD_RESPMEM_MUST_COPY);
+  errorCount += testHeaders (1094, 0, "with Date header");
+  errorCount += testHeaders (1095, MHD_SUPPRESS_DATE_NO_CLOCK,
+                             "without Date header");
+  MHD_destroy_response (response);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  return errorCount != 0;       /* 0 == pass */
+}
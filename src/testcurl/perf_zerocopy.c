@@ -0,0 +1,287 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file perf_zerocopy.c
+ * @brief benchmark the CPU time MHD spends per GB of large in-memory
+ *        responses, with and without MHD_OPTION_ZEROCOPY_THRESHOLD:
+ *        a large persistent buffer is downloaded repeatedly over a
+ *        keep-alive connection with a plain socket, and the CPU time
+ *        of the client thread is subtracted from that of the process.
+ *        Over loopback the kernel copies the data anyway (and MHD
+ *        then stops using MSG_ZEROCOPY for the connection), so this
+ *        only shows the overhead of the option; the savings show with
+ *        remote clients over a real network interface.
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gauger.h"
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+/**
+ * Size of the body of the response.
+ */
+#define BODY_SIZE (16 * 1024 * 1024)
+
+/**
+ * How many requests do we send (1 GB in total)?
+ */
+#define ROUNDS 64
+
+/**
+ * Request sent for each round.
+ */
+#define REQUEST "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+
+/**
+ * Response to return (re-used).
+ */
+static struct MHD_Response *response;
+
+/**
+ * Get the current timestamp
+ *
+ * @return current time in ms
+ */
+static unsigned long long
+now ()
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return (((unsigned long long) tv.tv_sec * 1000LL) +
+	  ((unsigned long long) tv.tv_usec / 1000LL));
+}
+
+
+/**
+ * Get the CPU time used by the process.
+ *
+ * @return CPU time in ms
+ */
+static unsigned long long
+process_cpu ()
+{
+  struct rusage ru;
+
+  getrusage (RUSAGE_SELF, &ru);
+  return ((unsigned long long) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000LL +
+          (unsigned long long) (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000LL);
+}
+
+
+/**
+ * Get the CPU time used by the calling thread.
+ *
+ * @return CPU time in ms
+ */
+static unsigned long long
+thread_cpu ()
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ((unsigned long long) ts.tv_sec * 1000LL +
+          (unsigned long long) ts.tv_nsec / 1000000LL);
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+
+  if (0 != strcmp ("GET", method))
+    return MHD_NO;              /* unexpected method */
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  return MHD_queue_response (connection, MHD_HTTP_OK, response);
+}
+
+
+/**
+ * Read one complete response from @a fd, discarding the body.
+ *
+ * @param fd socket to read from
+ * @param buf buffer to read into
+ * @param size size of @a buf
+ * @return 0 on success
+ */
+static int
+read_response (int fd, char *buf, size_t size)
+{
+  size_t off;
+  size_t left;
+  ssize_t got;
+  const char *end;
+
+  /* the headers */
+  off = 0;
+  while (1)
+    {
+      got = recv (fd, &buf[off], 1024 - 1 - off, 0);
+      if (got <= 0)
+        return 1;
+      off += got;
+      buf[off] = '\0';
+      if (NULL != (end = strstr (buf, "\r\n\r\n")))
+        break;
+      if (1024 - 1 == off)
+        return 2;
+    }
+  if (0 != strncmp ("HTTP/1.1 200 ", buf, strlen ("HTTP/1.1 200 ")))
+    return 4;
+  left = BODY_SIZE - (off - (size_t) (end + 4 - buf));
+  while (0 != left)
+    {
+      got = recv (fd, buf, (left < size) ? left : size, 0);
+      if (got <= 0)
+        return 8;
+      left -= got;
+    }
+  return 0;
+}
+
+
+static int
+testZeroCopy (int port, size_t threshold, const char *desc)
+{
+  struct MHD_Daemon *d;
+  struct sockaddr_in sa;
+  unsigned long long start;
+  unsigned long long start_cpu;
+  unsigned long long start_client;
+  unsigned long long cpu;
+  unsigned int i;
+  char *buf;
+  int fd;
+  int ret;
+
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_ZEROCOPY_THRESHOLD, threshold,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    return 1;
+  buf = malloc (BODY_SIZE);
+  fd = socket (PF_INET, SOCK_STREAM, 0);
+  if ( (-1 == fd) ||
+       (NULL == buf) )
+    {
+      if (-1 != fd)
+        close (fd);
+      free (buf);
+      MHD_stop_daemon (d);
+      return 2;
+    }
+  memset (&sa, 0, sizeof (sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if (0 != connect (fd, (struct sockaddr *) &sa, sizeof (sa)))
+    {
+      close (fd);
+      free (buf);
+      MHD_stop_daemon (d);
+      return 4;
+    }
+  ret = 0;
+  start = now ();
+  start_cpu = process_cpu ();
+  start_client = thread_cpu ();
+  for (i = 0; i < ROUNDS; i++)
+    {
+      if (strlen (REQUEST) != send (fd, REQUEST, strlen (REQUEST), 0))
+        {
+          ret = 8;
+          break;
+        }
+      if (0 != read_response (fd, buf, BODY_SIZE))
+        {
+          ret = 16;
+          break;
+        }
+    }
+  /* only the time spent by MHD */
+  cpu = process_cpu () - start_cpu - (thread_cpu () - start_client);
+  start = now () - start + 1;
+  close (fd);
+  free (buf);
+  MHD_stop_daemon (d);
+  if (0 != ret)
+    return ret;
+  fprintf (stderr,
+           "Large GETs %s: %llu ms CPU per GB, %f MB/s\n",
+           desc,
+           cpu * 1024 * 1024 * 1024 / ((unsigned long long) ROUNDS * BODY_SIZE),
+           ((double) ROUNDS * BODY_SIZE / 1024 / 1024 * 1000) / start);
+  GAUGER (desc,
+          "CPU per GB of large GETs",
+          (double) cpu * 1024 * 1024 * 1024 / ((double) ROUNDS * BODY_SIZE),
+          "ms/GB");
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  char *body;
+
+  body = malloc (BODY_SIZE);
+  if (NULL == body)
+    return 2;
+  memset (body, 'z', BODY_SIZE);
+  response = MHD_create_response_from_buffer (BODY_SIZE,
+					      body,
+					      MHD_RESPMEM_PERSISTENT);
+  errorCount += testZeroCopy (1128, 0, "with copying");
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_ZEROCOPY))
+    errorCount += testZeroCopy (1129, 64 * 1024, "with MSG_ZEROCOPY");
+  MHD_destroy_response (response);
+  free (body);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  return errorCount != 0;       /* 0 == pass */
+}
@@ -0,0 +1,461 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_broadcast.c
+ * @brief  Testcase for MHD_broadcast_publish(): each subscriber must
+ *         get all events published after it subscribed, in order,
+ *         and subscribers that fall behind must be handled according
+ *         to the policy of the channel
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include "platform_interface.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+/**
+ * Number of concurrent subscribers.
+ */
+#define NUM_CLIENTS 8
+
+/**
+ * Number of events published.
+ */
+#define EVENTS 200
+
+/**
+ * Size of the buffer for the body received by each client.
+ */
+#define MAX_BODY (EVENTS * 32)
+
+/**
+ * Number of subscribers for testManySubscribers(); together with
+ * #EVENTS enough to fill the signalling pipe of the daemon if each
+ * event signalled each subscriber on its own.
+ */
+#define MANY_CLIENTS 400
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * Number of connections the broadcast response was queued for; set
+ * by the threads of the daemon.
+ */
+static volatile unsigned int subscribed;
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Broadcast *bc = cls;
+  struct MHD_Response *response;
+  int ret;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  response = MHD_broadcast_subscribe (bc);
+  if (NULL == response)
+    return MHD_NO;
+  MHD_add_response_header (response,
+                           MHD_HTTP_HEADER_CONTENT_TYPE,
+                           "text/event-stream");
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  if (MHD_YES == ret)
+    subscribed++;
+  return ret;
+}
+
+
+/**
+ * Format event @a i into @a buf.
+ *
+ * @return length of the event
+ */
+static size_t
+format_event (char *buf, unsigned int i)
+{
+  return sprintf (buf, "data: event %u\n\n", i);
+}
+
+
+/**
+ * Subscribe #NUM_CLIENTS clients to a channel, publish #EVENTS events
+ * and destroy the channel to end the streams.
+ *
+ * @param port port of the daemon
+ * @param flags flags for the daemon
+ * @return 0 on success
+ */
+static int
+testBroadcast (int port, unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  struct MHD_Broadcast *bc;
+  CURLM *multi;
+  CURL *c[NUM_CLIENTS];
+  struct CBC cbc[NUM_CLIENTS];
+  struct CURLMsg *msg;
+  fd_set rs;
+  fd_set ws;
+  fd_set es;
+  int max;
+  int running;
+  struct timeval tv;
+  char url[64];
+  char event[32];
+  char *expect;
+  size_t expect_len;
+  unsigned int published;
+  unsigned int i;
+  int ret;
+
+  subscribed = 0;
+  bc = MHD_broadcast_create (0, MHD_BROADCAST_DROP);
+  if (NULL == bc)
+    return 1;
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, bc,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    {
+      MHD_broadcast_destroy (bc);
+      return 2;
+    }
+  multi = curl_multi_init ();
+  if (NULL == multi)
+    {
+      MHD_stop_daemon (d);
+      MHD_broadcast_destroy (bc);
+      return 4;
+    }
+  expect = malloc (MAX_BODY);
+  expect_len = 0;
+  for (i = 0; i < EVENTS; i++)
+    expect_len += format_event (&expect[expect_len], i);
+  sprintf (url, "http://127.0.0.1:%d/", port);
+  for (i = 0; i < NUM_CLIENTS; i++)
+    {
+      cbc[i].buf = malloc (MAX_BODY);
+      cbc[i].size = MAX_BODY;
+      cbc[i].pos = 0;
+      c[i] = curl_easy_init ();
+      curl_easy_setopt (c[i], CURLOPT_URL, url);
+      curl_easy_setopt (c[i], CURLOPT_WRITEFUNCTION, &copyBuffer);
+      curl_easy_setopt (c[i], CURLOPT_WRITEDATA, &cbc[i]);
+      curl_easy_setopt (c[i], CURLOPT_FAILONERROR, 1L);
+      curl_easy_setopt (c[i], CURLOPT_TIMEOUT, 150L);
+      curl_easy_setopt (c[i], CURLOPT_CONNECTTIMEOUT, 150L);
+      curl_easy_setopt (c[i], CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+      /* NOTE: use of CONNECTTIMEOUT without also
+         setting NOSIGNAL results in really weird
+         crashes on my system! */
+      curl_easy_setopt (c[i], CURLOPT_NOSIGNAL, 1L);
+      curl_multi_add_handle (multi, c[i]);
+    }
+  ret = 0;
+  published = 0;
+  running = NUM_CLIENTS;
+  while (0 < running)
+    {
+      curl_multi_perform (multi, &running);
+      if (0 == running)
+        break;
+      if ( (NULL != bc) &&
+           (NUM_CLIENTS == subscribed) )
+        {
+          /* publish a few events per round, so that they are sent
+             while we publish more */
+          for (i = 0; (i < 16) && (published < EVENTS); i++, published++)
+            if (MHD_YES != MHD_broadcast_publish (bc,
+                                                  event,
+                                                  format_event (event,
+                                                                published)))
+              ret |= 8;
+          if (EVENTS == published)
+            {
+              MHD_broadcast_destroy (bc);
+              bc = NULL;
+            }
+        }
+      max = 0;
+      FD_ZERO (&rs);
+      FD_ZERO (&ws);
+      FD_ZERO (&es);
+      if (CURLM_OK != curl_multi_fdset (multi, &rs, &ws, &es, &max))
+        {
+          ret |= 16;
+          break;
+        }
+      tv.tv_sec = 0;
+      tv.tv_usec = 1000;
+      if (-1 == select (max + 1, &rs, &ws, &es, &tv))
+        {
+          ret |= 16;
+          break;
+        }
+    }
+  while (NULL != (msg = curl_multi_info_read (multi, &running)))
+    if ( (CURLMSG_DONE == msg->msg) &&
+         (CURLE_OK != msg->data.result) )
+      {
+        fprintf (stderr,
+                 "curl_multi_perform failed: `%s'\n",
+                 curl_easy_strerror (msg->data.result));
+        ret |= 32;
+      }
+  for (i = 0; i < NUM_CLIENTS; i++)
+    {
+      if ( (NULL == cbc[i].buf) ||
+           (expect_len != cbc[i].pos) ||
+           (0 != memcmp (expect, cbc[i].buf, expect_len)) )
+        ret |= 64;
+      curl_multi_remove_handle (multi, c[i]);
+      curl_easy_cleanup (c[i]);
+      free (cbc[i].buf);
+    }
+  curl_multi_cleanup (multi);
+  MHD_stop_daemon (d);
+  if (NULL != bc)
+    MHD_broadcast_destroy (bc);
+  free (expect);
+  return ret;
+}
+
+
+/**
+ * Check the policy for subscribers that fall behind, with a
+ * subscriber whose response is never sent.
+ *
+ * @param policy policy of the channel
+ * @return 0 on success
+ */
+static int
+testPolicy (enum MHD_BroadcastPolicy policy)
+{
+  struct MHD_Broadcast *bc;
+  struct MHD_Response *response;
+  char event[100];
+  int ret;
+
+  bc = MHD_broadcast_create (sizeof (event), policy);
+  if (NULL == bc)
+    return 1;
+  response = MHD_broadcast_subscribe (bc);
+  if (NULL == response)
+    {
+      MHD_broadcast_destroy (bc);
+      return 2;
+    }
+  ret = 0;
+  memset (event, 'e', sizeof (event));
+  /* the second event exceeds the backlog of the subscriber */
+  if ( (MHD_YES != MHD_broadcast_publish (bc, event, sizeof (event))) ||
+       (MHD_YES != MHD_broadcast_publish (bc, event, sizeof (event))) )
+    ret |= 4;
+  /* the stream of a disconnected subscriber already ended */
+  if (MHD_response_push_end (response) !=
+      ((MHD_BROADCAST_DISCONNECT == policy) ? MHD_NO : MHD_YES))
+    ret |= 8;
+  MHD_destroy_response (response);
+  MHD_broadcast_destroy (bc);
+  return ret;
+}
+
+
+/**
+ * Subscribe #MANY_CLIENTS raw HTTP/1.0 clients to a channel, publish
+ * #EVENTS events while the daemon sends them and check the streams.
+ *
+ * @param port port of the daemon
+ * @param flags flags for the daemon
+ * @return 0 on success
+ */
+static int
+testManySubscribers (int port, unsigned int flags)
+{
+  static MHD_socket fds[MANY_CLIENTS];
+  struct MHD_Daemon *d;
+  struct MHD_Broadcast *bc;
+  struct sockaddr_in sin;
+  struct timeval tv;
+  static const char req[] = "GET / HTTP/1.0\r\n\r\n";
+  char event[32];
+  char *expect;
+  char *buf;
+  const char *body;
+  size_t expect_len;
+  size_t off;
+  ssize_t got;
+  time_t start;
+  unsigned int i;
+  int ret;
+
+  subscribed = 0;
+  bc = MHD_broadcast_create (0, MHD_BROADCAST_DROP);
+  if (NULL == bc)
+    return 1;
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, bc,
+                        MHD_OPTION_CONNECTION_LIMIT, (unsigned int) (MANY_CLIENTS + 16),
+                        MHD_OPTION_END);
+  if (NULL == d)
+    {
+      MHD_broadcast_destroy (bc);
+      return 2;
+    }
+  ret = 0;
+  memset (&sin, 0, sizeof (sin));
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons (port);
+  sin.sin_addr.s_addr = htonl (0x7f000001);
+  tv.tv_sec = 30;
+  tv.tv_usec = 0;
+  for (i = 0; i < MANY_CLIENTS; i++)
+    {
+      fds[i] = socket (PF_INET, SOCK_STREAM, 0);
+      if (MHD_INVALID_SOCKET == fds[i])
+        {
+          ret |= 4;
+          break;
+        }
+      if ( (0 != setsockopt (fds[i], SOL_SOCKET, SO_RCVTIMEO,
+                             (const char *) &tv, sizeof (tv))) ||
+           (0 != connect (fds[i], (struct sockaddr *) &sin, sizeof (sin))) ||
+           ((ssize_t) strlen (req) != send (fds[i], req, strlen (req), 0)) )
+        {
+          MHD_socket_close_ (fds[i]);
+          ret |= 4;
+          break;
+        }
+    }
+  if (0 != ret)
+    {
+      while (0 < i)
+        MHD_socket_close_ (fds[--i]);
+      MHD_stop_daemon (d);
+      MHD_broadcast_destroy (bc);
+      return ret;
+    }
+  start = time (NULL);
+  while ( (MANY_CLIENTS != subscribed) &&
+          (time (NULL) - start < 30) )
+    (void) usleep (1000);
+  if (MANY_CLIENTS != subscribed)
+    ret |= 8;
+  /* publish in rounds, so that the connections park in between */
+  expect = malloc (MAX_BODY);
+  expect_len = 0;
+  for (i = 0; i < EVENTS; i++)
+    {
+      off = format_event (event, i);
+      memcpy (&expect[expect_len], event, off);
+      expect_len += off;
+      if (MHD_YES != MHD_broadcast_publish (bc, event, off))
+        ret |= 16;
+      if (0 == i % 16)
+        (void) usleep (1000);
+    }
+  /* end the streams */
+  MHD_broadcast_destroy (bc);
+  buf = malloc (MAX_BODY + 1024);
+  for (i = 0; i < MANY_CLIENTS; i++)
+    {
+      off = 0;
+      while (0 < (got = recv (fds[i], &buf[off], MAX_BODY + 1023 - off, 0)))
+        off += got;
+      if (0 != got)
+        ret |= 32; /* timeout or error */
+      buf[off] = '\0';
+      body = strstr (buf, "\r\n\r\n");
+      if ( (NULL == body) ||
+           (expect_len != off - (body + 4 - buf)) ||
+           (0 != memcmp (body + 4, expect, expect_len)) )
+        ret |= 64;
+      MHD_socket_close_ (fds[i]);
+    }
+  free (buf);
+  free (expect);
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  unsigned int flags = MHD_USE_SUSPEND_RESUME | MHD_USE_PIPE_FOR_SHUTDOWN;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testPolicy (MHD_BROADCAST_DROP);
+  errorCount += testPolicy (MHD_BROADCAST_DISCONNECT);
+  errorCount += testBroadcast (1123, MHD_USE_SELECT_INTERNALLY | flags);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+    {
+      errorCount += testBroadcast (1124, MHD_USE_EPOLL_INTERNALLY_LINUX_ONLY | flags);
+      errorCount += testManySubscribers (1125, MHD_USE_EPOLL_INTERNALLY_LINUX_ONLY | flags);
+    }
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
@@ -0,0 +1,278 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_data_ready.c
+ * @brief  Testcase for MHD_CONTENT_READER_WAIT and
+ *         MHD_response_data_ready(): a slow producer must not make
+ *         MHD poll the content reader
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+/**
+ * Number of pieces the producer adds.
+ */
+#define CHUNKS 10
+
+/**
+ * Size of each piece.
+ */
+#define CHUNK_SIZE 1000
+
+#define BODY_SIZE (CHUNKS * CHUNK_SIZE)
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * Data produced for the response so far.
+ */
+static struct
+{
+  pthread_mutex_t lock;
+  char data[BODY_SIZE];
+  size_t avail;
+  struct MHD_Connection *connection;
+  pthread_t producer;
+  int producer_running;
+  unsigned int reader_calls;
+  int chunked;
+} stream;
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static void *
+produce (void *cls)
+{
+  unsigned int i;
+
+  for (i = 0; i < CHUNKS; i++)
+    {
+      usleep (10000);
+      pthread_mutex_lock (&stream.lock);
+      memset (&stream.data[stream.avail], 'a' + i, CHUNK_SIZE);
+      stream.avail += CHUNK_SIZE;
+      pthread_mutex_unlock (&stream.lock);
+      MHD_response_data_ready (stream.connection);
+    }
+  return NULL;
+}
+
+
+static ssize_t
+crc (void *cls,
+     uint64_t pos,
+     char *buf,
+     size_t max)
+{
+  ssize_t ret;
+
+  pthread_mutex_lock (&stream.lock);
+  stream.reader_calls++;
+  if (pos < stream.avail)
+    {
+      ret = stream.avail - (size_t) pos;
+      if ((size_t) ret > max)
+        ret = max;
+      memcpy (buf, &stream.data[pos], ret);
+    }
+  else if (BODY_SIZE == pos)
+    ret = MHD_CONTENT_READER_END_OF_STREAM;
+  else
+    ret = MHD_CONTENT_READER_WAIT;
+  pthread_mutex_unlock (&stream.lock);
+  return ret;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  int ret;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  response = MHD_create_response_from_callback (stream.chunked
+                                                ? MHD_SIZE_UNKNOWN
+                                                : BODY_SIZE,
+                                                1024,
+                                                &crc,
+                                                NULL,
+                                                NULL);
+  stream.connection = connection;
+  if (0 != pthread_create (&stream.producer, NULL, &produce, NULL))
+    abort ();
+  stream.producer_running = MHD_YES;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+/**
+ * Download a response produced in pieces.
+ *
+ * @param port port of the daemon
+ * @param flags flags for the daemon
+ * @param chunked #MHD_YES to use a response of unknown size
+ * @param check_calls #MHD_YES if the content reader must not be polled
+ * @return 0 on success
+ */
+static int
+testDataReady (int port,
+               unsigned int flags,
+               int chunked,
+               int check_calls)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  CURLcode errornum;
+  struct CBC cbc;
+  char buf[BODY_SIZE];
+  char url[64];
+  unsigned int i;
+  int ret;
+
+  memset (&stream, 0, sizeof (stream));
+  pthread_mutex_init (&stream.lock, NULL);
+  stream.chunked = chunked;
+  cbc.buf = buf;
+  cbc.size = sizeof (buf);
+  cbc.pos = 0;
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    return 1;
+  ret = 0;
+  sprintf (url, "http://127.0.0.1:%d/", port);
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, url);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  /* NOTE: use of CONNECTTIMEOUT without also
+     setting NOSIGNAL results in really weird
+     crashes on my system! */
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  if (CURLE_OK != (errornum = curl_easy_perform (c)))
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      ret |= 2;
+    }
+  /* the producer must be done before the connection goes away */
+  if (MHD_YES == stream.producer_running)
+    pthread_join (stream.producer, NULL);
+  curl_easy_cleanup (c);
+  MHD_stop_daemon (d);
+  if (BODY_SIZE != cbc.pos)
+    ret |= 4;
+  for (i = 0; i < cbc.pos; i++)
+    if ('a' + i / CHUNK_SIZE != buf[i])
+      {
+        ret |= 8;
+        break;
+      }
+  /* a few calls per piece, not one per iteration of the event loop */
+  if ( (MHD_YES == check_calls) &&
+       (stream.reader_calls > 4 * CHUNKS + 4) )
+    {
+      fprintf (stderr,
+               "Content reader called %u times\n",
+               stream.reader_calls);
+      ret |= 16;
+    }
+  pthread_mutex_destroy (&stream.lock);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  unsigned int flags = MHD_USE_SUSPEND_RESUME | MHD_USE_PIPE_FOR_SHUTDOWN;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testDataReady (1114, MHD_USE_SELECT_INTERNALLY | flags,
+                               MHD_NO, MHD_YES);
+  errorCount += testDataReady (1115, MHD_USE_SELECT_INTERNALLY | flags,
+                               MHD_YES, MHD_YES);
+  errorCount += testDataReady (1116, MHD_USE_POLL_INTERNALLY | flags,
+                               MHD_NO, MHD_YES);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+    errorCount += testDataReady (1117, MHD_USE_EPOLL_INTERNALLY_LINUX_ONLY | flags,
+                                 MHD_YES, MHD_YES);
+  /* connections cannot be parked here, the reader is polled */
+  errorCount += testDataReady (1118, MHD_USE_THREAD_PER_CONNECTION,
+                               MHD_NO, MHD_NO);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
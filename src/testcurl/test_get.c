@@ -633,6 +633,13 @@ main (int argc, char *const *argv)
       errorCount += testUnknownPortGet(MHD_USE_EPOLL_LINUX_ONLY);
       errorCount += testEmptyGet(MHD_USE_EPOLL_LINUX_ONLY);
     }
+  if (MHD_YES == MHD_is_feature_supported(MHD_FEATURE_IO_URING))
+    {
+      errorCount += testInternalGet(MHD_USE_IO_URING);
+      errorCount += testMultithreadedPoolGet(MHD_USE_IO_URING);
+      errorCount += testUnknownPortGet(MHD_USE_IO_URING);
+      errorCount += testEmptyGet(MHD_USE_IO_URING);
+    }
   if (errorCount != 0)
     fprintf (stderr, "Error (code: %u)\n", errorCount);
   curl_global_cleanup ();
@@ -0,0 +1,202 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_header_filter.c
+ * @brief  Testcase for MHD_OPTION_HEADER_FILTER: only the headers
+ *         accepted by the filter (plus those MHD needs itself) must
+ *         be visible to the access handler
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * Set if the filter was asked about a header MHD must keep.
+ */
+static int asked_host;
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static int
+header_filter (void *cls,
+               struct MHD_Connection *connection,
+               const char *name)
+{
+  if (0 == strcasecmp (name, MHD_HTTP_HEADER_HOST))
+    asked_host = 1;
+  if (0 == strncasecmp (name, "X-Keep", strlen ("X-Keep")))
+    return MHD_YES;
+  return MHD_NO;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  int ret;
+
+  if (0 != strcmp ("GET", method))
+    return MHD_NO;              /* unexpected method */
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  if ( (NULL == MHD_lookup_connection_value (connection,
+                                             MHD_HEADER_KIND,
+                                             "X-Keep-Me")) ||
+       (NULL != MHD_lookup_connection_value (connection,
+                                             MHD_HEADER_KIND,
+                                             "X-Drop-Me")) ||
+       (NULL != MHD_lookup_connection_value (connection,
+                                             MHD_HEADER_KIND,
+                                             MHD_HTTP_HEADER_ACCEPT)) ||
+       (NULL != MHD_lookup_connection_value (connection,
+                                             MHD_COOKIE_KIND,
+                                             "name1")) ||
+       (NULL == MHD_lookup_connection_value (connection,
+                                             MHD_HEADER_KIND,
+                                             MHD_HTTP_HEADER_HOST)) ||
+       (2 != MHD_get_connection_values (connection,
+                                        MHD_HEADER_KIND,
+                                        NULL,
+                                        NULL)) )
+    return MHD_NO;
+  response = MHD_create_response_from_buffer (strlen (url),
+					      (void *) url,
+					      MHD_RESPMEM_MUST_COPY);
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+static int
+testHeaderFilter (int port, unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  CURLcode errornum;
+  struct curl_slist *headers;
+  struct CBC cbc;
+  char buf[64];
+  char url[64];
+  int ret;
+
+  asked_host = 0;
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_HEADER_FILTER, &header_filter, NULL,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    return 1;
+  cbc.buf = buf;
+  cbc.size = sizeof (buf);
+  cbc.pos = 0;
+  sprintf (url, "http://127.0.0.1:%d/hello_world", port);
+  headers = curl_slist_append (NULL, "X-Keep-Me: yes");
+  headers = curl_slist_append (headers, "X-Drop-Me: no");
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, url);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt (c, CURLOPT_COOKIE, "name1=var1");
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  /* NOTE: use of CONNECTTIMEOUT without also
+     setting NOSIGNAL results in really weird
+     crashes on my system! */
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  ret = 0;
+  if (CURLE_OK != (errornum = curl_easy_perform (c)))
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      ret = 2;
+    }
+  else if ( (cbc.pos != strlen ("/hello_world")) ||
+            (0 != strncmp ("/hello_world", cbc.buf, strlen ("/hello_world"))) )
+    ret = 4;
+  else if (asked_host)
+    ret = 8;
+  curl_easy_cleanup (c);
+  curl_slist_free_all (headers);
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testHeaderFilter (1096, MHD_USE_SELECT_INTERNALLY);
+  errorCount += testHeaderFilter (1097, MHD_USE_THREAD_PER_CONNECTION);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
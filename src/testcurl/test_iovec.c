@@ -0,0 +1,274 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_iovec.c
+ * @brief  Testcase for MHD_create_response_from_iovec: the body must
+ *         be the concatenation of the segments, and the segments must
+ *         be released once the response is no longer used
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+#define HEAD "<html><body>"
+
+#define FOOT "</body></html>"
+
+/**
+ * Size of the large segment.
+ */
+#define MIDDLE_SIZE (1024 * 1024)
+
+/**
+ * Number of small segments, more than can be passed to a single
+ * system call by MHD.
+ */
+#define SMALL_SEGMENTS 40
+
+/**
+ * Number of segments of the response.
+ */
+#define NUM_SEGMENTS (SMALL_SEGMENTS + 4)
+
+#define BODY_SIZE (strlen (HEAD) + MIDDLE_SIZE + SMALL_SEGMENTS + strlen (FOOT))
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+static const char digits[] = "0123456789";
+
+/**
+ * Number of calls to release_segment().
+ */
+static unsigned int released;
+
+
+static void
+release_segment (void *cls)
+{
+  released++;
+  free (cls);
+}
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *response = cls;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  return MHD_queue_response (connection, MHD_HTTP_OK, response);
+}
+
+
+/**
+ * Create the response, with an empty segment between the large one
+ * and the small ones.
+ *
+ * @param[out] expected set to the expected body (to be freed)
+ * @return NULL on error
+ */
+static struct MHD_Response *
+create_response (char **expected)
+{
+  struct MHD_IoVec iov[NUM_SEGMENTS];
+  struct MHD_Response *response;
+  char *middle;
+  char *foot;
+  unsigned int i;
+
+  middle = malloc (MIDDLE_SIZE);
+  foot = strdup (FOOT);
+  *expected = malloc (BODY_SIZE);
+  if ( (NULL == middle) || (NULL == foot) || (NULL == *expected) )
+    {
+      free (middle);
+      free (foot);
+      free (*expected);
+      return NULL;
+    }
+  for (i = 0; i < MIDDLE_SIZE; i++)
+    middle[i] = 'a' + (i % 26);
+  memset (iov, 0, sizeof (iov));
+  iov[0].iov_base = HEAD;
+  iov[0].iov_len = strlen (HEAD);
+  iov[1].iov_base = middle;
+  iov[1].iov_len = MIDDLE_SIZE;
+  iov[1].free_cb = &release_segment;
+  iov[1].free_cls = middle;
+  iov[2].iov_base = NULL;
+  iov[2].iov_len = 0;
+  for (i = 0; i < SMALL_SEGMENTS; i++)
+    {
+      iov[3 + i].iov_base = &digits[i % 10];
+      iov[3 + i].iov_len = 1;
+    }
+  iov[NUM_SEGMENTS - 1].iov_base = foot;
+  iov[NUM_SEGMENTS - 1].iov_len = strlen (FOOT);
+  iov[NUM_SEGMENTS - 1].free_cb = &release_segment;
+  iov[NUM_SEGMENTS - 1].free_cls = foot;
+  response = MHD_create_response_from_iovec (iov, NUM_SEGMENTS);
+  if (NULL == response)
+    {
+      free (middle);
+      free (foot);
+      free (*expected);
+      return NULL;
+    }
+  memcpy (*expected, HEAD, strlen (HEAD));
+  memcpy (*expected + strlen (HEAD), middle, MIDDLE_SIZE);
+  for (i = 0; i < SMALL_SEGMENTS; i++)
+    (*expected)[strlen (HEAD) + MIDDLE_SIZE + i] = digits[i % 10];
+  memcpy (*expected + strlen (HEAD) + MIDDLE_SIZE + SMALL_SEGMENTS,
+          FOOT, strlen (FOOT));
+  return response;
+}
+
+
+static int
+testIovec (int port, unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  struct MHD_Response *response;
+  CURL *c;
+  CURLcode errornum;
+  struct CBC cbc;
+  char *expected;
+  char url[64];
+  unsigned int i;
+  int ret;
+
+  released = 0;
+  response = create_response (&expected);
+  if (NULL == response)
+    return 1;
+  cbc.size = BODY_SIZE;
+  cbc.buf = malloc (cbc.size);
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, response,
+                        MHD_OPTION_END);
+  if ( (NULL == d) || (NULL == cbc.buf) )
+    {
+      if (NULL != d)
+        MHD_stop_daemon (d);
+      MHD_destroy_response (response);
+      free (expected);
+      free (cbc.buf);
+      return 2;
+    }
+  ret = 0;
+  sprintf (url, "http://127.0.0.1:%d/", port);
+  /* the response must be reusable */
+  for (i = 0; i < 2; i++)
+    {
+      cbc.pos = 0;
+      c = curl_easy_init ();
+      curl_easy_setopt (c, CURLOPT_URL, url);
+      curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+      curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+      curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+      curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+      curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+      curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+      /* NOTE: use of CONNECTTIMEOUT without also
+         setting NOSIGNAL results in really weird
+         crashes on my system! */
+      curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+      if (CURLE_OK != (errornum = curl_easy_perform (c)))
+        {
+          fprintf (stderr,
+                   "curl_easy_perform failed: `%s'\n",
+                   curl_easy_strerror (errornum));
+          ret |= 4;
+        }
+      else if ( (cbc.pos != BODY_SIZE) ||
+                (0 != memcmp (expected, cbc.buf, BODY_SIZE)) )
+        ret |= 8;
+      curl_easy_cleanup (c);
+    }
+  MHD_stop_daemon (d);
+  if (0 != released)
+    ret |= 16;
+  MHD_destroy_response (response);
+  if (2 != released)
+    ret |= 32;
+  free (expected);
+  free (cbc.buf);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testIovec (1108, MHD_USE_SELECT_INTERNALLY);
+  errorCount += testIovec (1109, MHD_USE_THREAD_PER_CONNECTION);
+  /* io_uring cannot gather, the segments are copied instead */
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_IO_URING))
+    errorCount += testIovec (1110, MHD_USE_SELECT_INTERNALLY | MHD_USE_IO_URING);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
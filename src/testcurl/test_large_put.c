@@ -45,6 +45,8 @@
 
 static int oneone;
 
+static unsigned int uring_flag;
+
 /**
  * Do not make this much larger since we will hit the
  * MHD default buffer limit and the test code is not
@@ -152,7 +154,7 @@ testInternalPut ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | uring_flag,
                         1080,
                         NULL, NULL, &ahc_echo, &done_flag, 
 			MHD_OPTION_CONNECTION_MEMORY_LIMIT, (size_t) (1024*1024),
@@ -271,7 +273,7 @@ testMultithreadedPoolPut ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | uring_flag,
                         1081,
                         NULL, NULL, &ahc_echo, &done_flag,
                         MHD_OPTION_THREAD_POOL_SIZE, CPU_COUNT,
@@ -343,7 +345,7 @@ testExternalPut ()
   cbc.size = 2048;
   cbc.pos = 0;
   multi = NULL;
-  d = MHD_start_daemon (MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_DEBUG | uring_flag,
                         1082,
                         NULL, NULL, &ahc_echo, &done_flag,
                         MHD_OPTION_CONNECTION_MEMORY_LIMIT,
@@ -462,13 +464,21 @@ main (int argc, char *const *argv)
 
   oneone = (NULL != strrchr (argv[0], (int) '/')) ?
     (NULL != strstr (strrchr (argv[0], (int) '/'), "11")) : 0;
+  if ( (NULL != strrchr (argv[0], (int) '/')) &&
+       (NULL != strstr (strrchr (argv[0], (int) '/'), "_uring")) )
+    {
+      if (MHD_YES != MHD_is_feature_supported (MHD_FEATURE_IO_URING))
+        return 77; /* skip */
+      uring_flag = MHD_USE_IO_URING;
+    }
   if (0 != curl_global_init (CURL_GLOBAL_WIN32))
     return 2;
   put_buffer = malloc (PUT_SIZE);
   if (NULL == put_buffer) return 1;
   memset (put_buffer, 1, PUT_SIZE);
   errorCount += testInternalPut ();
-  errorCount += testMultithreadedPut ();
+  if (0 == uring_flag)
+    errorCount += testMultithreadedPut ();
   errorCount += testMultithreadedPoolPut ();
   errorCount += testExternalPut ();
   free (put_buffer);
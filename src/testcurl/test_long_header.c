@@ -45,6 +45,8 @@
 
 static int oneone;
 
+static unsigned int uring_flag;
+
 static int
 apc_all (void *cls, const struct sockaddr *addr, socklen_t addrlen)
 {
@@ -101,7 +103,7 @@ testLongUrlGet ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY /* | MHD_USE_DEBUG */ ,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | uring_flag /* | MHD_USE_DEBUG */ ,
                         1080,
                         &apc_all,
                         NULL,
@@ -172,7 +174,7 @@ testLongHeaderGet ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY /* | MHD_USE_DEBUG */ ,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | uring_flag /* | MHD_USE_DEBUG */ ,
                         1080,
                         &apc_all,
                         NULL,
@@ -242,6 +244,13 @@ main (int argc, char *const *argv)
 
   oneone = (NULL != strrchr (argv[0], (int) '/')) ?
     (NULL != strstr (strrchr (argv[0], (int) '/'), "11")) : 0;
+  if ( (NULL != strrchr (argv[0], (int) '/')) &&
+       (NULL != strstr (strrchr (argv[0], (int) '/'), "_uring")) )
+    {
+      if (MHD_YES != MHD_is_feature_supported (MHD_FEATURE_IO_URING))
+        return 77; /* skip */
+      uring_flag = MHD_USE_IO_URING;
+    }
   if (0 != curl_global_init (CURL_GLOBAL_WIN32))
     return 2;
   errorCount += testLongUrlGet ();
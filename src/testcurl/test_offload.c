@@ -0,0 +1,320 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_offload.c
+ * @brief  Testcase for running blocking access handler calls on the
+ *         offload pool: while the handler of an uploading request
+ *         blocks, a second request on the same event loop must
+ *         still be answered quickly.
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include "platform_interface.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+/**
+ * How long does the offloaded handler block (in microseconds)?
+ */
+#define BLOCK_US 1000000
+
+/**
+ * How long may the fast request take at most (in microseconds)?
+ */
+#define FAST_LIMIT_US 500000
+
+/**
+ * Number of bytes uploaded by the slow request.
+ */
+#define UPLOAD_SIZE (64 * 1024)
+
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * Number of upload bytes the slow request processed so far.
+ */
+static size_t uploaded;
+
+/**
+ * Number of upload bytes curl sent so far.
+ */
+static size_t upload_pos;
+
+/**
+ * Port of the daemon under test.
+ */
+static int test_port;
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static size_t
+putBuffer (void *stream, size_t size, size_t nmemb, void *ptr)
+{
+  size_t wrt;
+
+  wrt = size * nmemb;
+  if (wrt > 1000)
+    wrt = 1000;                 /* upload in many small pieces */
+  if (wrt > UPLOAD_SIZE - upload_pos)
+    wrt = UPLOAD_SIZE - upload_pos;
+  memset (stream, 'u', wrt);
+  upload_pos += wrt;
+  return wrt;
+}
+
+
+/**
+ * Get the current timestamp
+ *
+ * @return current time in microseconds
+ */
+static unsigned long long
+now_us ()
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return (((unsigned long long) tv.tv_sec * 1000000LL) +
+	  ((unsigned long long) tv.tv_usec));
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  size_t i;
+  int ret;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      if ( (0 == strcmp (url, "/slow")) &&
+           (MHD_YES != MHD_offload_request (connection)) )
+        return MHD_NO;
+      return MHD_YES;
+    }
+  if (0 != *upload_data_size)
+    {
+      for (i = 0; i < *upload_data_size; i++)
+        if ('u' != upload_data[i])
+          return MHD_NO;
+      uploaded += *upload_data_size;
+      *upload_data_size = 0;
+      return MHD_YES;
+    }
+  if (0 == strcmp (url, "/slow"))
+    usleep (BLOCK_US);          /* e.g. a blocking database query */
+  response = MHD_create_response_from_buffer (strlen (url),
+					      (void *) url,
+					      MHD_RESPMEM_MUST_COPY);
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+static CURL *
+setup_curl (const char *path,
+            struct CBC *cbc)
+{
+  CURL *c;
+  char url[64];
+
+  sprintf (url, "http://127.0.0.1:%d%s", test_port, path);
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, url);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, cbc);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  /* NOTE: use of CONNECTTIMEOUT without also
+     setting NOSIGNAL results in really weird
+     crashes on my system! */
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1);
+  return c;
+}
+
+
+static void *
+slow_request (void *cls)
+{
+  int *ret = cls;
+  CURL *c;
+  CURLcode errornum;
+  struct CBC cbc;
+  char buf[64];
+
+  cbc.buf = buf;
+  cbc.size = sizeof (buf);
+  cbc.pos = 0;
+  c = setup_curl ("/slow", &cbc);
+  curl_easy_setopt (c, CURLOPT_READFUNCTION, &putBuffer);
+  curl_easy_setopt (c, CURLOPT_UPLOAD, 1L);
+  curl_easy_setopt (c, CURLOPT_INFILESIZE_LARGE, (curl_off_t) UPLOAD_SIZE);
+  if (CURLE_OK != (errornum = curl_easy_perform (c)))
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      *ret = 1;
+    }
+  else if ( (cbc.pos != strlen ("/slow")) ||
+            (0 != strncmp ("/slow", cbc.buf, strlen ("/slow"))) ||
+            (UPLOAD_SIZE != uploaded) )
+    *ret = 2;
+  else
+    *ret = 0;
+  curl_easy_cleanup (c);
+  return NULL;
+}
+
+
+static int
+testOffload (int port,
+             unsigned int flags,
+             unsigned int pool_size)
+{
+  struct MHD_Daemon *d;
+  pthread_t slow;
+  CURL *c;
+  CURLcode errornum;
+  struct CBC cbc;
+  char buf[64];
+  unsigned long long start;
+  unsigned long long delay;
+  int slow_ret;
+  int ret;
+
+  test_port = port;
+  uploaded = 0;
+  upload_pos = 0;
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_SUSPEND_RESUME | MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_THREAD_POOL_SIZE, pool_size,
+                        MHD_OPTION_OFFLOAD_POOL_SIZE, 2,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    return 1;
+  slow_ret = -1;
+  if (0 != pthread_create (&slow, NULL, &slow_request, &slow_ret))
+    {
+      MHD_stop_daemon (d);
+      return 2;
+    }
+  /* give the slow request time to block its handler */
+  usleep (BLOCK_US / 4);
+  cbc.buf = buf;
+  cbc.size = sizeof (buf);
+  cbc.pos = 0;
+  c = setup_curl ("/fast", &cbc);
+  start = now_us ();
+  errornum = curl_easy_perform (c);
+  delay = now_us () - start;
+  curl_easy_cleanup (c);
+  ret = 0;
+  if (CURLE_OK != errornum)
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      ret |= 4;
+    }
+  else if ( (cbc.pos != strlen ("/fast")) ||
+            (0 != strncmp ("/fast", cbc.buf, strlen ("/fast"))) )
+    ret |= 8;
+  else if (delay > FAST_LIMIT_US)
+    {
+      fprintf (stderr,
+               "Request took %llu ms while another handler was blocked\n",
+               delay / 1000);
+      ret |= 16;
+    }
+  if (0 != pthread_join (slow, NULL))
+    abort ();
+  if (0 != slow_ret)
+    ret |= 32;
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testOffload (1084, 0, 0);
+  errorCount += testOffload (1085, 0, 1);
+#ifdef HAVE_POLL
+  errorCount += testOffload (1086, MHD_USE_POLL, 0);
+#endif
+#if EPOLL_SUPPORT
+  errorCount += testOffload (1087, MHD_USE_EPOLL_LINUX_ONLY, 0);
+  errorCount += testOffload (1088, MHD_USE_EPOLL_LINUX_ONLY, 1);
+#endif
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_IO_URING))
+    errorCount += testOffload (1089, MHD_USE_IO_URING, 0);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
@@ -0,0 +1,247 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_pipelining.c
+ * @brief  Testcase for pipelined requests: requests sent at once on
+ *         one connection must be answered in order, with small and
+ *         large bodies and HEAD requests mixed
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include "platform_interface.h"
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+/**
+ * Size of the body for "/big", too large to be copied behind the
+ * headers and large enough to need several writes.
+ */
+#define BIG_SIZE (4 * 1024 * 1024)
+
+/**
+ * Requests sent in one go; the last one asks to close the
+ * connection.
+ */
+static const struct
+{
+  const char *method;
+  const char *path;
+} requests[] = {
+  { "GET", "/a" },
+  { "GET", "/big" },
+  { "HEAD", "/b" },
+  { "GET", "/c" },
+  { "HEAD", "/big" },
+  { "GET", "/d" },
+  { "GET", "/big" },
+  { "GET", "/e" },
+  { NULL, NULL }
+};
+
+static char big[BIG_SIZE];
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  int ret;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  if (0 == strcmp (url, "/big"))
+    response = MHD_create_response_from_buffer (BIG_SIZE,
+                                                big,
+                                                MHD_RESPMEM_PERSISTENT);
+  else
+    response = MHD_create_response_from_buffer (strlen (url),
+                                                (void *) url,
+                                                MHD_RESPMEM_MUST_COPY);
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+/**
+ * Check the response to request @a i at the start of @a *buf and
+ * advance @a *buf behind it.
+ *
+ * @return 0 on success
+ */
+static int
+check_response (unsigned int i,
+                const char **buf,
+                const char *end)
+{
+  const char *hdr_end;
+  const char *cl;
+  const char *expected;
+  unsigned long len;
+  size_t expected_len;
+
+  if (0 != strncmp (*buf, "HTTP/1.1 200 OK\r\n", strlen ("HTTP/1.1 200 OK\r\n")))
+    return 1;
+  hdr_end = strstr (*buf, "\r\n\r\n");
+  if (NULL == hdr_end)
+    return 2;
+  hdr_end += 4;
+  cl = strstr (*buf, MHD_HTTP_HEADER_CONTENT_LENGTH ": ");
+  if ( (NULL == cl) ||
+       (cl > hdr_end) )
+    return 4;
+  len = strtoul (cl + strlen (MHD_HTTP_HEADER_CONTENT_LENGTH ": "), NULL, 10);
+  if (0 == strcmp (requests[i].path, "/big"))
+    {
+      expected = big;
+      expected_len = BIG_SIZE;
+    }
+  else
+    {
+      expected = requests[i].path;
+      expected_len = strlen (expected);
+    }
+  if (len != expected_len)
+    return 8;
+  if (0 == strcmp (requests[i].method, "HEAD"))
+    {
+      *buf = hdr_end;
+      return 0;
+    }
+  if ( ((size_t) (end - hdr_end) < expected_len) ||
+       (0 != memcmp (hdr_end, expected, expected_len)) )
+    return 16;
+  *buf = hdr_end + expected_len;
+  return 0;
+}
+
+
+static int
+testPipelining (int port, unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  struct sockaddr_in sin;
+  MHD_socket fd;
+  char req[2048];
+  char *rbuf;
+  size_t rsize;
+  size_t roff;
+  size_t off;
+  ssize_t got;
+  const char *pos;
+  unsigned int i;
+  int ret;
+
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    return 1;
+  fd = socket (PF_INET, SOCK_STREAM, 0);
+  if (MHD_INVALID_SOCKET == fd)
+    {
+      MHD_stop_daemon (d);
+      return 2;
+    }
+  memset (&sin, 0, sizeof (sin));
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons (port);
+  sin.sin_addr.s_addr = htonl (0x7f000001);
+  if (0 != connect (fd, (struct sockaddr *) &sin, sizeof (sin)))
+    {
+      MHD_socket_close_ (fd);
+      MHD_stop_daemon (d);
+      return 4;
+    }
+  off = 0;
+  for (i = 0; NULL != requests[i].method; i++)
+    off += sprintf (&req[off],
+                    "%s %s HTTP/1.1\r\nHost: 127.0.0.1\r\n%s\r\n",
+                    requests[i].method,
+                    requests[i].path,
+                    (NULL == requests[i + 1].method) ? "Connection: close\r\n" : "");
+  ret = 0;
+  if (off != (size_t) send (fd, req, off, 0))
+    ret |= 8;
+  /* read until the server closes the connection */
+  rsize = 4 * BIG_SIZE;
+  rbuf = malloc (rsize + 1);
+  roff = 0;
+  while ( (NULL != rbuf) &&
+          (roff < rsize) &&
+          (0 < (got = recv (fd, &rbuf[roff], rsize - roff, 0))) )
+    roff += got;
+  MHD_socket_close_ (fd);
+  MHD_stop_daemon (d);
+  if (NULL == rbuf)
+    return ret | 16;
+  rbuf[roff] = '\0';
+  pos = rbuf;
+  for (i = 0; NULL != requests[i].method; i++)
+    if (0 != check_response (i, &pos, &rbuf[roff]))
+      {
+        fprintf (stderr,
+                 "Bad response to %s %s\n",
+                 requests[i].method,
+                 requests[i].path);
+        ret |= 32;
+        break;
+      }
+  if (pos != &rbuf[roff])
+    ret |= 64;
+  free (rbuf);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  memset (big, 'x', sizeof (big));
+  errorCount += testPipelining (1105, MHD_USE_SELECT_INTERNALLY);
+  errorCount += testPipelining (1106, MHD_USE_THREAD_PER_CONNECTION);
+  errorCount += testPipelining (1107, MHD_USE_SELECT_INTERNALLY | MHD_USE_POLL);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  return errorCount != 0;       /* 0 == pass */
+}
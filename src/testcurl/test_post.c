@@ -54,6 +54,8 @@
 
 static int oneone;
 
+static unsigned int uring_flag;
+
 struct CBC
 {
   char *buf;
@@ -170,7 +172,7 @@ testInternalPost ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | uring_flag,
                         1080, NULL, NULL, &ahc_echo, NULL, 
 			MHD_OPTION_NOTIFY_COMPLETED, &completed_cb, NULL,			
 			MHD_OPTION_END);
@@ -278,7 +280,7 @@ testMultithreadedPoolPost ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | uring_flag,
                         1081, NULL, NULL, &ahc_echo, NULL,
                         MHD_OPTION_THREAD_POOL_SIZE, CPU_COUNT,
 			MHD_OPTION_NOTIFY_COMPLETED, &completed_cb, NULL,			
@@ -343,7 +345,7 @@ testExternalPost ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_DEBUG | uring_flag,
                         1082, NULL, NULL, &ahc_echo, NULL, 
 			MHD_OPTION_NOTIFY_COMPLETED, &completed_cb, NULL,			
 			MHD_OPTION_END);
@@ -640,11 +642,20 @@ main (int argc, char *const *argv)
 
   oneone = (NULL != strrchr (argv[0], (int) '/')) ?
     (NULL != strstr (strrchr (argv[0], (int) '/'), "11")) : 0;
+  if ( (NULL != strrchr (argv[0], (int) '/')) &&
+       (NULL != strstr (strrchr (argv[0], (int) '/'), "_uring")) )
+    {
+      if (MHD_YES != MHD_is_feature_supported (MHD_FEATURE_IO_URING))
+        return 77; /* skip */
+      uring_flag = MHD_USE_IO_URING;
+    }
   if (0 != curl_global_init (CURL_GLOBAL_WIN32))
     return 2;
-  errorCount += testMultithreadedPostCancel ();
+  if (0 == uring_flag)
+    errorCount += testMultithreadedPostCancel ();
   errorCount += testInternalPost ();
-  errorCount += testMultithreadedPost ();
+  if (0 == uring_flag)
+    errorCount += testMultithreadedPost ();
   errorCount += testMultithreadedPoolPost ();
   errorCount += testExternalPost ();
   if (errorCount != 0)
@@ -46,6 +46,8 @@
 
 static int oneone;
 
+static unsigned int uring_flag;
+
 struct CBC
 {
   char *buf;
@@ -157,7 +159,7 @@ testInternalGet ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | uring_flag,
                         21080, NULL, NULL, &ahc_echo, "GET", MHD_OPTION_END);
   if (d == NULL)
     return 1;
@@ -255,7 +257,7 @@ testMultithreadedPoolGet ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | uring_flag,
                         21080, NULL, NULL, &ahc_echo, "GET",
                         MHD_OPTION_THREAD_POOL_SIZE, CPU_COUNT, MHD_OPTION_END);
   if (d == NULL)
@@ -315,7 +317,7 @@ testExternalGet ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_DEBUG | uring_flag,
                         21080, NULL, NULL, &ahc_echo, "GET", MHD_OPTION_END);
   if (d == NULL)
     return 256;
@@ -424,8 +426,16 @@ main (int argc, char *const *argv)
 
   oneone = (NULL != strrchr (argv[0], (int) '/')) ?
     (NULL != strstr (strrchr (argv[0], (int) '/'), "11")) : 0;
+  if ( (NULL != strrchr (argv[0], (int) '/')) &&
+       (NULL != strstr (strrchr (argv[0], (int) '/'), "_uring")) )
+    {
+      if (MHD_YES != MHD_is_feature_supported (MHD_FEATURE_IO_URING))
+        return 77; /* skip */
+      uring_flag = MHD_USE_IO_URING;
+    }
   errorCount += testInternalGet ();
-  errorCount += testMultithreadedGet ();
+  if (0 == uring_flag)
+    errorCount += testMultithreadedGet ();
   errorCount += testMultithreadedPoolGet ();
   errorCount += testExternalGet ();
   if (errorCount != 0)
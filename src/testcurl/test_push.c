@@ -0,0 +1,300 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_push.c
+ * @brief  Testcase for MHD_create_response_for_push: the body must be
+ *         the pushed buffers in order, with and without chunked
+ *         encoding, each buffer must be released once, and the
+ *         producer must be throttled by the high-water mark
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+/**
+ * Number of buffers the producer pushes.
+ */
+#define BUFFERS 256
+
+/**
+ * Size of each buffer.
+ */
+#define BUFFER_SIZE 1000
+
+#define BODY_SIZE (BUFFERS * BUFFER_SIZE)
+
+/**
+ * High-water mark of the response.
+ */
+#define HIGH_WATER (8 * BUFFER_SIZE)
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * State of the producer.
+ */
+static struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  struct MHD_Response *response;
+  pthread_t producer;
+  int producer_running;
+  int drained;
+  unsigned int released;
+  unsigned int refused;
+  int chunked;
+} stream;
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static void
+release_buffer (void *cls)
+{
+  free (cls);
+  pthread_mutex_lock (&stream.lock);
+  stream.released++;
+  pthread_mutex_unlock (&stream.lock);
+}
+
+
+static void
+drained (void *cls)
+{
+  pthread_mutex_lock (&stream.lock);
+  stream.drained = MHD_YES;
+  pthread_cond_signal (&stream.cond);
+  pthread_mutex_unlock (&stream.lock);
+}
+
+
+static void *
+produce (void *cls)
+{
+  char *buf;
+  unsigned int i;
+
+  for (i = 0; i < BUFFERS; i++)
+    {
+      buf = malloc (BUFFER_SIZE);
+      if (NULL == buf)
+        abort ();
+      memset (buf, 'a' + i % 26, BUFFER_SIZE);
+      while (MHD_YES != MHD_response_push (stream.response,
+                                           buf,
+                                           BUFFER_SIZE,
+                                           &release_buffer,
+                                           buf))
+        {
+          pthread_mutex_lock (&stream.lock);
+          stream.refused++;
+          while (MHD_NO == stream.drained)
+            pthread_cond_wait (&stream.cond, &stream.lock);
+          stream.drained = MHD_NO;
+          pthread_mutex_unlock (&stream.lock);
+        }
+      if (0 == i % 64)
+        usleep (1000); /* let the connection wait for data, too */
+    }
+  if (stream.chunked)
+    MHD_response_push_end (stream.response);
+  return NULL;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  int ret;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, stream.response);
+  if ( (MHD_YES == ret) &&
+       (MHD_NO == stream.producer_running) )
+    {
+      if (0 != pthread_create (&stream.producer, NULL, &produce, NULL))
+        abort ();
+      stream.producer_running = MHD_YES;
+    }
+  return ret;
+}
+
+
+/**
+ * Download a response pushed in pieces by another thread.
+ *
+ * @param port port of the daemon
+ * @param flags flags for the daemon
+ * @param chunked #MHD_YES to use a response of unknown size
+ * @return 0 on success
+ */
+static int
+testPush (int port,
+          unsigned int flags,
+          int chunked)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  CURLcode errornum;
+  struct CBC cbc;
+  char url[64];
+  unsigned int i;
+  int ret;
+
+  memset (&stream, 0, sizeof (stream));
+  pthread_mutex_init (&stream.lock, NULL);
+  pthread_cond_init (&stream.cond, NULL);
+  stream.chunked = chunked;
+  stream.producer_running = MHD_NO;
+  stream.drained = MHD_NO;
+  stream.response = MHD_create_response_for_push (chunked
+                                                  ? MHD_SIZE_UNKNOWN
+                                                  : BODY_SIZE,
+                                                  HIGH_WATER,
+                                                  &drained,
+                                                  NULL);
+  if (NULL == stream.response)
+    return 1;
+  cbc.size = BODY_SIZE;
+  cbc.buf = malloc (cbc.size);
+  cbc.pos = 0;
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_END);
+  if ( (NULL == d) || (NULL == cbc.buf) )
+    {
+      if (NULL != d)
+        MHD_stop_daemon (d);
+      MHD_destroy_response (stream.response);
+      free (cbc.buf);
+      return 2;
+    }
+  ret = 0;
+  sprintf (url, "http://127.0.0.1:%d/", port);
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, url);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  /* NOTE: use of CONNECTTIMEOUT without also
+     setting NOSIGNAL results in really weird
+     crashes on my system! */
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  if (CURLE_OK != (errornum = curl_easy_perform (c)))
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      ret |= 4;
+    }
+  if (MHD_YES == stream.producer_running)
+    pthread_join (stream.producer, NULL);
+  curl_easy_cleanup (c);
+  MHD_stop_daemon (d);
+  MHD_destroy_response (stream.response);
+  if (BODY_SIZE != cbc.pos)
+    ret |= 8;
+  for (i = 0; i < cbc.pos; i++)
+    if ('a' + (i / BUFFER_SIZE) % 26 != cbc.buf[i])
+      {
+        ret |= 16;
+        break;
+      }
+  if (BUFFERS != stream.released)
+    {
+      fprintf (stderr,
+               "%u buffers released\n",
+               stream.released);
+      ret |= 32;
+    }
+  free (cbc.buf);
+  pthread_cond_destroy (&stream.cond);
+  pthread_mutex_destroy (&stream.lock);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  unsigned int flags = MHD_USE_SUSPEND_RESUME | MHD_USE_PIPE_FOR_SHUTDOWN;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testPush (1119, MHD_USE_SELECT_INTERNALLY | flags, MHD_NO);
+  errorCount += testPush (1120, MHD_USE_SELECT_INTERNALLY | flags, MHD_YES);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+    errorCount += testPush (1121, MHD_USE_EPOLL_INTERNALLY_LINUX_ONLY | flags,
+                            MHD_YES);
+  /* io_uring cannot gather, the buffers are copied instead */
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_IO_URING))
+    errorCount += testPush (1122, MHD_USE_SELECT_INTERNALLY | MHD_USE_IO_URING | flags,
+                            MHD_YES);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
@@ -45,6 +45,8 @@
 
 static int oneone;
 
+static unsigned int uring_flag;
+
 struct CBC
 {
   char *buf;
@@ -131,7 +133,7 @@ testInternalPut ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | uring_flag,
                         1080,
                         NULL, NULL, &ahc_echo, &done_flag, MHD_OPTION_END);
   if (d == NULL)
@@ -244,7 +246,7 @@ testMultithreadedPoolPut ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY | MHD_USE_DEBUG | uring_flag,
                         1081,
                         NULL, NULL, &ahc_echo, &done_flag,
                         MHD_OPTION_THREAD_POOL_SIZE, CPU_COUNT, MHD_OPTION_END);
@@ -313,7 +315,7 @@ testExternalPut ()
   cbc.buf = buf;
   cbc.size = 2048;
   cbc.pos = 0;
-  d = MHD_start_daemon (MHD_USE_DEBUG,
+  d = MHD_start_daemon (MHD_USE_DEBUG | uring_flag,
                         1082,
                         NULL, NULL, &ahc_echo, &done_flag, MHD_OPTION_END);
   if (d == NULL)
@@ -427,10 +429,18 @@ main (int argc, char *const *argv)
 
   oneone = (NULL != strrchr (argv[0], (int) '/')) ?
     (NULL != strstr (strrchr (argv[0], (int) '/'), "11")) : 0;
+  if ( (NULL != strrchr (argv[0], (int) '/')) &&
+       (NULL != strstr (strrchr (argv[0], (int) '/'), "_uring")) )
+    {
+      if (MHD_YES != MHD_is_feature_supported (MHD_FEATURE_IO_URING))
+        return 77; /* skip */
+      uring_flag = MHD_USE_IO_URING;
+    }
   if (0 != curl_global_init (CURL_GLOBAL_WIN32))
     return 2;
   errorCount += testInternalPut ();
-  errorCount += testMultithreadedPut ();
+  if (0 == uring_flag)
+    errorCount += testMultithreadedPut ();
   errorCount += testMultithreadedPoolPut ();
   errorCount += testExternalPut ();
   if (errorCount != 0)
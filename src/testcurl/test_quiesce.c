@@ -179,7 +179,7 @@ setupCURL (void *cbc)
 
 
 static int
-testGet (int type, int pool_count, int poll_flag)
+testGet (int type, int pool_count, int poll_flag, int per_worker)
 {
   struct MHD_Daemon *d;
   CURL *c;
@@ -196,7 +196,9 @@ testGet (int type, int pool_count, int poll_flag)
   if (pool_count > 0) {
     d = MHD_start_daemon (type | MHD_USE_DEBUG | MHD_USE_PIPE_FOR_SHUTDOWN | poll_flag,
                           11080, NULL, NULL, &ahc_echo, "GET",
-                          MHD_OPTION_THREAD_POOL_SIZE, pool_count, MHD_OPTION_END);
+                          MHD_OPTION_THREAD_POOL_SIZE, pool_count,
+                          MHD_OPTION_LISTEN_SOCKET_PER_WORKER, (unsigned int) per_worker,
+                          MHD_OPTION_END);
 
   } else {
     d = MHD_start_daemon (type | MHD_USE_DEBUG | MHD_USE_PIPE_FOR_SHUTDOWN | poll_flag,
@@ -435,20 +437,23 @@ main (int argc, char *const *argv)
 
   if (0 != curl_global_init (CURL_GLOBAL_WIN32))
     return 2;
-  errorCount += testGet (MHD_USE_SELECT_INTERNALLY, 0, 0);
-  errorCount += testGet (MHD_USE_THREAD_PER_CONNECTION, 0, 0);
-  errorCount += testGet (MHD_USE_SELECT_INTERNALLY, CPU_COUNT, 0);
+  errorCount += testGet (MHD_USE_SELECT_INTERNALLY, 0, 0, 0);
+  errorCount += testGet (MHD_USE_THREAD_PER_CONNECTION, 0, 0, 0);
+  errorCount += testGet (MHD_USE_SELECT_INTERNALLY, CPU_COUNT, 0, 0);
+  errorCount += testGet (MHD_USE_SELECT_INTERNALLY, CPU_COUNT, 0, 1);
   errorCount += testExternalGet ();
   if (MHD_YES == MHD_is_feature_supported(MHD_FEATURE_POLL))
     {
-      errorCount += testGet(MHD_USE_SELECT_INTERNALLY, 0, MHD_USE_POLL);
-      errorCount += testGet (MHD_USE_THREAD_PER_CONNECTION, 0, MHD_USE_POLL);
-      errorCount += testGet (MHD_USE_SELECT_INTERNALLY, CPU_COUNT, MHD_USE_POLL);
+      errorCount += testGet(MHD_USE_SELECT_INTERNALLY, 0, MHD_USE_POLL, 0);
+      errorCount += testGet (MHD_USE_THREAD_PER_CONNECTION, 0, MHD_USE_POLL, 0);
+      errorCount += testGet (MHD_USE_SELECT_INTERNALLY, CPU_COUNT, MHD_USE_POLL, 0);
+      errorCount += testGet (MHD_USE_SELECT_INTERNALLY, CPU_COUNT, MHD_USE_POLL, 1);
     }
   if (MHD_YES == MHD_is_feature_supported(MHD_FEATURE_EPOLL))
     {
-      errorCount += testGet (MHD_USE_SELECT_INTERNALLY, 0, MHD_USE_EPOLL_LINUX_ONLY);
-      errorCount += testGet (MHD_USE_SELECT_INTERNALLY, CPU_COUNT, MHD_USE_EPOLL_LINUX_ONLY);
+      errorCount += testGet (MHD_USE_SELECT_INTERNALLY, 0, MHD_USE_EPOLL_LINUX_ONLY, 0);
+      errorCount += testGet (MHD_USE_SELECT_INTERNALLY, CPU_COUNT, MHD_USE_EPOLL_LINUX_ONLY, 0);
+      errorCount += testGet (MHD_USE_SELECT_INTERNALLY, CPU_COUNT, MHD_USE_EPOLL_LINUX_ONLY, 1);
     }
   if (errorCount != 0)
     fprintf (stderr, "Error (code: %u)\n", errorCount);
@@ -0,0 +1,223 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_request_line.c
+ * @brief  Testcase for MHD_OPTION_REQUEST_LINE_CALLBACK: requests
+ *         rejected right after the request line must get the canned
+ *         response (or none at all) without reaching the access
+ *         handler
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+#define DENIED "denied"
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * Canned response for rejected requests.
+ */
+static struct MHD_Response *denied;
+
+/**
+ * Number of calls to the access handler.
+ */
+static unsigned int handler_calls;
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static int
+check_request_line (void *cls,
+                    struct MHD_Connection *connection,
+                    const char *method,
+                    const char *url,
+                    unsigned int *status_code,
+                    struct MHD_Response **response)
+{
+  if (0 == strcmp (url, "/denied"))
+    {
+      *status_code = MHD_HTTP_FORBIDDEN;
+      *response = denied;
+      return MHD_NO;
+    }
+  if (0 == strcmp (url, "/dropped"))
+    return MHD_NO;
+  return MHD_YES;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  int ret;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  handler_calls++;
+  response = MHD_create_response_from_buffer (strlen (url),
+					      (void *) url,
+					      MHD_RESPMEM_MUST_COPY);
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+/**
+ * Request @a path from the daemon at @a port.
+ *
+ * @param port port of the daemon
+ * @param path path to request
+ * @param[out] status_code set to the status code of the response
+ * @param cbc where to store the body of the response
+ * @return result from curl
+ */
+static CURLcode
+request (int port,
+         const char *path,
+         long *status_code,
+         struct CBC *cbc)
+{
+  CURL *c;
+  CURLcode errornum;
+  char url[64];
+
+  sprintf (url, "http://127.0.0.1:%d%s", port, path);
+  cbc->pos = 0;
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, url);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, cbc);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  /* NOTE: use of CONNECTTIMEOUT without also
+     setting NOSIGNAL results in really weird
+     crashes on my system! */
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  errornum = curl_easy_perform (c);
+  *status_code = 0;
+  curl_easy_getinfo (c, CURLINFO_RESPONSE_CODE, status_code);
+  curl_easy_cleanup (c);
+  return errornum;
+}
+
+
+static int
+testRequestLine (int port, unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  struct CBC cbc;
+  char buf[64];
+  long status_code;
+  int ret;
+
+  handler_calls = 0;
+  cbc.buf = buf;
+  cbc.size = sizeof (buf);
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_REQUEST_LINE_CALLBACK, &check_request_line, NULL,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    return 1;
+  ret = 0;
+  if ( (CURLE_OK != request (port, "/allowed", &status_code, &cbc)) ||
+       (MHD_HTTP_OK != status_code) ||
+       (cbc.pos != strlen ("/allowed")) ||
+       (0 != strncmp ("/allowed", cbc.buf, strlen ("/allowed"))) )
+    ret |= 2;
+  if ( (CURLE_OK != request (port, "/denied", &status_code, &cbc)) ||
+       (MHD_HTTP_FORBIDDEN != status_code) ||
+       (cbc.pos != strlen (DENIED)) ||
+       (0 != strncmp (DENIED, cbc.buf, strlen (DENIED))) )
+    ret |= 4;
+  /* the denied response must be reusable */
+  if ( (CURLE_OK != request (port, "/denied?again", &status_code, &cbc)) ||
+       (MHD_HTTP_FORBIDDEN != status_code) )
+    ret |= 8;
+  if (CURLE_OK == request (port, "/dropped", &status_code, &cbc))
+    ret |= 16;
+  if (1 != handler_calls)
+    ret |= 32;
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  denied = MHD_create_response_from_buffer (strlen (DENIED),
+                                            DENIED,
+                                            MHD_RESPMEM_PERSISTENT);
+  errorCount += testRequestLine (1098, MHD_USE_SELECT_INTERNALLY);
+  errorCount += testRequestLine (1099, MHD_USE_THREAD_PER_CONNECTION);
+  MHD_destroy_response (denied);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
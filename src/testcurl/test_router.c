@@ -0,0 +1,271 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_router.c
+ * @brief  Testcase for MHD_OPTION_ROUTER: requests must reach the
+ *         handler of the best matching route with the parameters
+ *         of the route, or the default handler if no route matches
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * Requests made by the test and the expected bodies of the
+ * responses: the name of the handler, the route parameters
+ * and the url.
+ */
+static const struct
+{
+  const char *method;
+  const char *path;
+  const char *expected;
+} requests[] = {
+  { "GET", "/users/42", "user:42@/users/42" },
+  { "GET", "/users/me", "me@/users/me" },
+  { "GET", "/users/meh", "user:meh@/users/meh" },
+  { "POST", "/users/42", "update:42@/users/42" },
+  { "DELETE", "/users/42", "default@/users/42" },
+  { "GET", "/users/", "default@/users/" },
+  { "GET", "/users/42/posts/7", "post:42:7@/users/42/posts/7" },
+  { "GET", "/users/42/posts/7/x", "default@/users/42/posts/7/x" },
+  { "GET", "/static/a/b", "static@/static/a/b" },
+  { "PUT", "/static/", "static@/static/" },
+  { "GET", "/static", "default@/static" },
+  { "GET", "/st%61tic/x", "static@/static/x" },
+  { "GET", "/other", "default@/other" },
+  { NULL, NULL, NULL }
+};
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static int
+append_param (void *cls,
+              enum MHD_ValueKind kind,
+              const char *key,
+              const char *value)
+{
+  char *body = cls;
+
+  strcat (body, ":");
+  strcat (body, value);
+  return MHD_YES;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  const char *name = cls;
+  struct MHD_Response *response;
+  char body[256];
+  int ret;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  strcpy (body, name);
+  MHD_get_connection_values (connection,
+                             MHD_ROUTE_PARAMETER_KIND,
+                             &append_param,
+                             body);
+  strcat (body, "@");
+  strcat (body, url);
+  response = MHD_create_response_from_buffer (strlen (body),
+					      body,
+					      MHD_RESPMEM_MUST_COPY);
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+static int
+testPatterns ()
+{
+  struct MHD_Router *router;
+  int ret;
+
+  router = MHD_router_create ();
+  if (NULL == router)
+    return 1;
+  ret = 0;
+  if ( (MHD_NO == MHD_router_add (router, NULL, "/a/{b}/*", &ahc_echo, NULL)) ||
+       (MHD_NO == MHD_router_add (router, "GET", "/a/{b}/*", &ahc_echo, NULL)) ||
+       (MHD_NO == MHD_router_add (router, NULL, "/a/{b}", &ahc_echo, NULL)) )
+    ret |= 2;
+  if ( (MHD_YES == MHD_router_add (router, NULL, "/a/{c}/*", &ahc_echo, NULL)) ||
+       (MHD_YES == MHD_router_add (router, NULL, "a", &ahc_echo, NULL)) ||
+       (MHD_YES == MHD_router_add (router, NULL, "/a{b}", &ahc_echo, NULL)) ||
+       (MHD_YES == MHD_router_add (router, NULL, "/{b}c", &ahc_echo, NULL)) ||
+       (MHD_YES == MHD_router_add (router, NULL, "/{}", &ahc_echo, NULL)) ||
+       (MHD_YES == MHD_router_add (router, NULL, "/{b", &ahc_echo, NULL)) ||
+       (MHD_YES == MHD_router_add (router, NULL, "/*/b", &ahc_echo, NULL)) )
+    ret |= 4;
+  MHD_router_destroy (router);
+  return ret;
+}
+
+
+static int
+testRouter (int port, unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  struct MHD_Router *router;
+  CURL *c;
+  CURLcode errornum;
+  struct CBC cbc;
+  char buf[256];
+  char url[128];
+  unsigned int i;
+  int ret;
+
+  router = MHD_router_create ();
+  if (NULL == router)
+    return 1;
+  if ( (MHD_NO == MHD_router_add (router, "GET", "/users/{id}",
+                                  &ahc_echo, "user")) ||
+       (MHD_NO == MHD_router_add (router, "GET", "/users/me",
+                                  &ahc_echo, "me")) ||
+       (MHD_NO == MHD_router_add (router, "POST", "/users/{id}",
+                                  &ahc_echo, "update")) ||
+       (MHD_NO == MHD_router_add (router, "GET", "/users/{id}/posts/{post}",
+                                  &ahc_echo, "post")) ||
+       (MHD_NO == MHD_router_add (router, NULL, "/static/*",
+                                  &ahc_echo, "static")) )
+    {
+      MHD_router_destroy (router);
+      return 2;
+    }
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, "default",
+                        MHD_OPTION_ROUTER, router,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    {
+      MHD_router_destroy (router);
+      return 4;
+    }
+  ret = 0;
+  /* the router must not change while in use */
+  if (MHD_YES == MHD_router_add (router, NULL, "/late", &ahc_echo, "late"))
+    ret |= 8;
+  cbc.buf = buf;
+  cbc.size = sizeof (buf);
+  for (i = 0; NULL != requests[i].method; i++)
+    {
+      cbc.pos = 0;
+      sprintf (url, "http://127.0.0.1:%d%s", port, requests[i].path);
+      c = curl_easy_init ();
+      curl_easy_setopt (c, CURLOPT_URL, url);
+      curl_easy_setopt (c, CURLOPT_CUSTOMREQUEST, requests[i].method);
+      curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+      curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+      curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+      curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+      curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+      curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+      /* NOTE: use of CONNECTTIMEOUT without also
+         setting NOSIGNAL results in really weird
+         crashes on my system! */
+      curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+      if (CURLE_OK != (errornum = curl_easy_perform (c)))
+        {
+          fprintf (stderr,
+                   "curl_easy_perform failed: `%s'\n",
+                   curl_easy_strerror (errornum));
+          ret |= 16;
+        }
+      else if ( (cbc.pos != strlen (requests[i].expected)) ||
+                (0 != strncmp (requests[i].expected, cbc.buf, cbc.pos)) )
+        {
+          fprintf (stderr,
+                   "%s %s: got `%.*s', expected `%s'\n",
+                   requests[i].method,
+                   requests[i].path,
+                   (int) cbc.pos,
+                   cbc.buf,
+                   requests[i].expected);
+          ret |= 32;
+        }
+      curl_easy_cleanup (c);
+    }
+  MHD_stop_daemon (d);
+  MHD_router_destroy (router);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testPatterns ();
+  errorCount += testRouter (1100, MHD_USE_SELECT_INTERNALLY);
+  errorCount += testRouter (1101, MHD_USE_THREAD_PER_CONNECTION);
+  errorCount += testRouter (1102, MHD_USE_SELECT_INTERNALLY | MHD_USE_POLL);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
@@ -0,0 +1,274 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_shared_response.c
+ * @brief  Testcase for a callback response shared by concurrent
+ *         connections: each client must get the full body, and the
+ *         content reader must be asked for each byte only once per
+ *         connection
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+/**
+ * Size of the body of the response.
+ */
+#define BODY_SIZE (512 * 1024)
+
+/**
+ * Number of concurrent clients.
+ */
+#define NUM_CLIENTS 4
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * Number of bytes produced by the content reader.
+ */
+static uint64_t produced;
+
+
+static ssize_t
+crc (void *cls,
+     uint64_t pos,
+     char *buf,
+     size_t max)
+{
+  size_t i;
+
+  for (i = 0; i < max; i++)
+    buf[i] = (char) ((pos + i) % 251);
+  if (NULL != cls)
+    produced += max; /* calls are serialized */
+  return max;
+}
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *response = cls;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  return MHD_queue_response (connection, MHD_HTTP_OK, response);
+}
+
+
+/**
+ * Check that @a cbc holds the complete body.
+ */
+static int
+check_body (const struct CBC *cbc)
+{
+  size_t i;
+
+  if (BODY_SIZE != cbc->pos)
+    return MHD_NO;
+  for (i = 0; i < BODY_SIZE; i++)
+    if ((char) (i % 251) != cbc->buf[i])
+      return MHD_NO;
+  return MHD_YES;
+}
+
+
+/**
+ * Download the response with #NUM_CLIENTS concurrent clients.
+ *
+ * @param port port of the daemon
+ * @param flags flags for the daemon
+ * @param thread_safe #MHD_YES to mark the content reader as thread-safe
+ * @return 0 on success
+ */
+static int
+testSharedResponse (int port, unsigned int flags, int thread_safe)
+{
+  struct MHD_Daemon *d;
+  struct MHD_Response *response;
+  CURLM *multi;
+  CURL *c[NUM_CLIENTS];
+  struct CBC cbc[NUM_CLIENTS];
+  struct CURLMsg *msg;
+  fd_set rs;
+  fd_set ws;
+  fd_set es;
+  int max;
+  int running;
+  struct timeval tv;
+  char url[64];
+  unsigned int i;
+  int ret;
+
+  produced = 0;
+  response = MHD_create_response_from_callback (BODY_SIZE,
+                                                8 * 1024,
+                                                &crc,
+                                                thread_safe ? NULL : &produced,
+                                                NULL);
+  if (NULL == response)
+    return 1;
+  if (thread_safe)
+    MHD_set_response_options (response,
+                              MHD_RF_THREAD_SAFE_READER,
+                              MHD_RO_END);
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, response,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    {
+      MHD_destroy_response (response);
+      return 2;
+    }
+  multi = curl_multi_init ();
+  if (NULL == multi)
+    {
+      MHD_stop_daemon (d);
+      MHD_destroy_response (response);
+      return 4;
+    }
+  sprintf (url, "http://127.0.0.1:%d/", port);
+  for (i = 0; i < NUM_CLIENTS; i++)
+    {
+      cbc[i].buf = malloc (BODY_SIZE);
+      cbc[i].size = BODY_SIZE;
+      cbc[i].pos = 0;
+      c[i] = curl_easy_init ();
+      curl_easy_setopt (c[i], CURLOPT_URL, url);
+      curl_easy_setopt (c[i], CURLOPT_WRITEFUNCTION, &copyBuffer);
+      curl_easy_setopt (c[i], CURLOPT_WRITEDATA, &cbc[i]);
+      curl_easy_setopt (c[i], CURLOPT_FAILONERROR, 1L);
+      curl_easy_setopt (c[i], CURLOPT_TIMEOUT, 150L);
+      curl_easy_setopt (c[i], CURLOPT_CONNECTTIMEOUT, 150L);
+      curl_easy_setopt (c[i], CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+      /* NOTE: use of CONNECTTIMEOUT without also
+         setting NOSIGNAL results in really weird
+         crashes on my system! */
+      curl_easy_setopt (c[i], CURLOPT_NOSIGNAL, 1L);
+      curl_multi_add_handle (multi, c[i]);
+    }
+  ret = 0;
+  running = NUM_CLIENTS;
+  while (0 < running)
+    {
+      curl_multi_perform (multi, &running);
+      if (0 == running)
+        break;
+      max = 0;
+      FD_ZERO (&rs);
+      FD_ZERO (&ws);
+      FD_ZERO (&es);
+      if (CURLM_OK != curl_multi_fdset (multi, &rs, &ws, &es, &max))
+        {
+          ret |= 8;
+          break;
+        }
+      tv.tv_sec = 0;
+      tv.tv_usec = 1000;
+      if (-1 == select (max + 1, &rs, &ws, &es, &tv))
+        {
+          ret |= 8;
+          break;
+        }
+    }
+  while (NULL != (msg = curl_multi_info_read (multi, &running)))
+    if ( (CURLMSG_DONE == msg->msg) &&
+         (CURLE_OK != msg->data.result) )
+      {
+        fprintf (stderr,
+                 "curl_multi_perform failed: `%s'\n",
+                 curl_easy_strerror (msg->data.result));
+        ret |= 16;
+      }
+  for (i = 0; i < NUM_CLIENTS; i++)
+    {
+      if ( (NULL == cbc[i].buf) ||
+           (MHD_YES != check_body (&cbc[i])) )
+        ret |= 32;
+      curl_multi_remove_handle (multi, c[i]);
+      curl_easy_cleanup (c[i]);
+      free (cbc[i].buf);
+    }
+  curl_multi_cleanup (multi);
+  MHD_stop_daemon (d);
+  MHD_destroy_response (response);
+  /* no connection may make the reader produce data twice */
+  if ( (! thread_safe) &&
+       (NUM_CLIENTS * (uint64_t) BODY_SIZE != produced) )
+    ret |= 64;
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testSharedResponse (1111, MHD_USE_SELECT_INTERNALLY, MHD_NO);
+  errorCount += testSharedResponse (1112, MHD_USE_THREAD_PER_CONNECTION, MHD_NO);
+  errorCount += testSharedResponse (1113, MHD_USE_THREAD_PER_CONNECTION, MHD_YES);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
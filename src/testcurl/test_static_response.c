@@ -0,0 +1,262 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_static_response.c
+ * @brief  Testcase for MHD_OPTION_STATIC_RESPONSES: registered URLs
+ *         must be answered without calling the access handler
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+#define HEALTH "healthy"
+
+#define ROBOTS "User-agent: *\nDisallow: /\n"
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * Number of calls to the access handler (with a new request).
+ */
+static unsigned int handler_calls;
+
+/**
+ * Number of calls to the completion callback.
+ */
+static unsigned int completed_calls;
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static void
+completed_cb (void *cls,
+              struct MHD_Connection *connection,
+              void **con_cls,
+              enum MHD_RequestTerminationCode toe)
+{
+  completed_calls++;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  int ret;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      handler_calls++;
+      return MHD_YES;
+    }
+  if (0 != *upload_data_size)
+    {
+      *upload_data_size = 0;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  response = MHD_create_response_from_buffer (strlen (url),
+					      (void *) url,
+					      MHD_RESPMEM_MUST_COPY);
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+/**
+ * Request @a path from the daemon at @a port.
+ *
+ * @param port port of the daemon
+ * @param path path to request
+ * @param post body to POST, NULL to GET
+ * @param[out] status_code set to the status code of the response
+ * @param cbc where to store the body of the response
+ * @return result from curl
+ */
+static CURLcode
+request (int port,
+         const char *path,
+         const char *post,
+         long *status_code,
+         struct CBC *cbc)
+{
+  CURL *c;
+  CURLcode errornum;
+  char url[64];
+
+  sprintf (url, "http://127.0.0.1:%d%s", port, path);
+  cbc->pos = 0;
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, url);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, cbc);
+  if (NULL != post)
+    curl_easy_setopt (c, CURLOPT_POSTFIELDS, post);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  /* NOTE: use of CONNECTTIMEOUT without also
+     setting NOSIGNAL results in really weird
+     crashes on my system! */
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  errornum = curl_easy_perform (c);
+  *status_code = 0;
+  curl_easy_getinfo (c, CURLINFO_RESPONSE_CODE, status_code);
+  curl_easy_cleanup (c);
+  return errornum;
+}
+
+
+/**
+ * Check that @a cbc holds @a expected.
+ */
+static int
+check_body (const struct CBC *cbc,
+            const char *expected)
+{
+  return (cbc->pos == strlen (expected)) &&
+    (0 == strncmp (expected, cbc->buf, cbc->pos));
+}
+
+
+static int
+testStaticResponse (int port, unsigned int flags)
+{
+  struct MHD_StaticResponse sr[3];
+  struct MHD_Daemon *d;
+  struct CBC cbc;
+  char buf[64];
+  long status_code;
+  int ret;
+
+  handler_calls = 0;
+  completed_calls = 0;
+  cbc.buf = buf;
+  cbc.size = sizeof (buf);
+  memset (sr, 0, sizeof (sr));
+  sr[0].method = NULL;
+  sr[0].url = "/health";
+  sr[0].status_code = MHD_HTTP_OK;
+  sr[0].response = MHD_create_response_from_buffer (strlen (HEALTH),
+                                                    (void *) HEALTH,
+                                                    MHD_RESPMEM_PERSISTENT);
+  sr[0].notify_completed = MHD_NO;
+  sr[1].method = MHD_HTTP_METHOD_GET;
+  sr[1].url = "/robots.txt";
+  sr[1].status_code = MHD_HTTP_OK;
+  sr[1].response = MHD_create_response_from_buffer (strlen (ROBOTS),
+                                                    (void *) ROBOTS,
+                                                    MHD_RESPMEM_PERSISTENT);
+  sr[1].notify_completed = MHD_YES;
+  sr[2].url = NULL;
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_NOTIFY_COMPLETED, &completed_cb, NULL,
+                        MHD_OPTION_STATIC_RESPONSES, sr,
+                        MHD_OPTION_END);
+  /* the daemon keeps its own references */
+  MHD_destroy_response (sr[0].response);
+  MHD_destroy_response (sr[1].response);
+  if (NULL == d)
+    return 1;
+  ret = 0;
+  if ( (CURLE_OK != request (port, "/health", NULL, &status_code, &cbc)) ||
+       (MHD_HTTP_OK != status_code) ||
+       (! check_body (&cbc, HEALTH)) )
+    ret |= 2;
+  if ( (CURLE_OK != request (port, "/health?verbose=1", NULL, &status_code, &cbc)) ||
+       (! check_body (&cbc, HEALTH)) )
+    ret |= 4;
+  /* the body of the request must be skipped */
+  if ( (CURLE_OK != request (port, "/health", "some=data", &status_code, &cbc)) ||
+       (! check_body (&cbc, HEALTH)) )
+    ret |= 8;
+  if ( (CURLE_OK != request (port, "/robots.txt", NULL, &status_code, &cbc)) ||
+       (! check_body (&cbc, ROBOTS)) )
+    ret |= 16;
+  if (0 != handler_calls)
+    ret |= 32;
+  /* other methods and URLs go to the access handler */
+  if ( (CURLE_OK != request (port, "/robots.txt", "x=y", &status_code, &cbc)) ||
+       (! check_body (&cbc, "/robots.txt")) )
+    ret |= 128;
+  if ( (CURLE_OK != request (port, "/healthy", NULL, &status_code, &cbc)) ||
+       (! check_body (&cbc, "/healthy")) )
+    ret |= 256;
+  if (2 != handler_calls)
+    ret |= 512;
+  MHD_stop_daemon (d);
+  /* one static response plus the two requests to the handler */
+  if (3 != completed_calls)
+    ret |= 64;
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testStaticResponse (1103, MHD_USE_SELECT_INTERNALLY);
+  errorCount += testStaticResponse (1104, MHD_USE_THREAD_PER_CONNECTION);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}
@@ -0,0 +1,256 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2016 Christian Grothoff
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file test_zerocopy.c
+ * @brief  Testcase for MHD_OPTION_ZEROCOPY_THRESHOLD: concurrent
+ *         clients must get the full bodies of large responses, which
+ *         the application destroys right after queueing them
+ * @author Christian Grothoff
+ */
+
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+/**
+ * Size of the body of the response.
+ */
+#define BODY_SIZE (4 * 1024 * 1024)
+
+/**
+ * Number of concurrent clients.
+ */
+#define NUM_CLIENTS 4
+
+/**
+ * Number of requests of each client.
+ */
+#define ROUNDS 3
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+/**
+ * Body of the responses; copied for each response.
+ */
+static char *body;
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static int
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **unused)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  int ret;
+
+  if (&ptr != *unused)
+    {
+      *unused = &ptr;
+      return MHD_YES;
+    }
+  *unused = NULL;
+  /* MHD frees the copy with the last reference to the response */
+  response = MHD_create_response_from_buffer (BODY_SIZE,
+                                              body,
+                                              MHD_RESPMEM_MUST_COPY);
+  if (NULL == response)
+    return MHD_NO;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+/**
+ * Download the response #ROUNDS times with #NUM_CLIENTS concurrent
+ * clients, each over its own connection.
+ *
+ * @param port port of the daemon
+ * @param flags flags for the daemon
+ * @return 0 on success
+ */
+static int
+testZeroCopy (int port, unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  CURLM *multi;
+  CURL *c[NUM_CLIENTS];
+  struct CBC cbc[NUM_CLIENTS];
+  struct CURLMsg *msg;
+  fd_set rs;
+  fd_set ws;
+  fd_set es;
+  int max;
+  int running;
+  struct timeval tv;
+  char url[64];
+  unsigned int round;
+  unsigned int i;
+  int ret;
+
+  d = MHD_start_daemon (MHD_USE_DEBUG | flags,
+                        port, NULL, NULL, &ahc_echo, NULL,
+                        MHD_OPTION_ZEROCOPY_THRESHOLD, (size_t) (64 * 1024),
+                        MHD_OPTION_END);
+  if (NULL == d)
+    return 1;
+  multi = curl_multi_init ();
+  if (NULL == multi)
+    {
+      MHD_stop_daemon (d);
+      return 2;
+    }
+  ret = 0;
+  sprintf (url, "http://127.0.0.1:%d/", port);
+  for (i = 0; i < NUM_CLIENTS; i++)
+    {
+      cbc[i].buf = malloc (BODY_SIZE);
+      cbc[i].size = BODY_SIZE;
+      c[i] = curl_easy_init ();
+      curl_easy_setopt (c[i], CURLOPT_URL, url);
+      curl_easy_setopt (c[i], CURLOPT_WRITEFUNCTION, &copyBuffer);
+      curl_easy_setopt (c[i], CURLOPT_WRITEDATA, &cbc[i]);
+      curl_easy_setopt (c[i], CURLOPT_FAILONERROR, 1L);
+      curl_easy_setopt (c[i], CURLOPT_TIMEOUT, 150L);
+      curl_easy_setopt (c[i], CURLOPT_CONNECTTIMEOUT, 150L);
+      curl_easy_setopt (c[i], CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+      /* NOTE: use of CONNECTTIMEOUT without also
+         setting NOSIGNAL results in really weird
+         crashes on my system! */
+      curl_easy_setopt (c[i], CURLOPT_NOSIGNAL, 1L);
+    }
+  /* the connections are kept alive between the rounds */
+  for (round = 0; round < ROUNDS; round++)
+    {
+      for (i = 0; i < NUM_CLIENTS; i++)
+        {
+          cbc[i].pos = 0;
+          curl_multi_add_handle (multi, c[i]);
+        }
+      running = NUM_CLIENTS;
+      while (0 < running)
+        {
+          curl_multi_perform (multi, &running);
+          if (0 == running)
+            break;
+          max = 0;
+          FD_ZERO (&rs);
+          FD_ZERO (&ws);
+          FD_ZERO (&es);
+          if (CURLM_OK != curl_multi_fdset (multi, &rs, &ws, &es, &max))
+            {
+              ret |= 4;
+              break;
+            }
+          tv.tv_sec = 0;
+          tv.tv_usec = 1000;
+          if (-1 == select (max + 1, &rs, &ws, &es, &tv))
+            {
+              ret |= 4;
+              break;
+            }
+        }
+      while (NULL != (msg = curl_multi_info_read (multi, &running)))
+        if ( (CURLMSG_DONE == msg->msg) &&
+             (CURLE_OK != msg->data.result) )
+          {
+            fprintf (stderr,
+                     "curl_multi_perform failed: `%s'\n",
+                     curl_easy_strerror (msg->data.result));
+            ret |= 8;
+          }
+      for (i = 0; i < NUM_CLIENTS; i++)
+        {
+          if ( (NULL == cbc[i].buf) ||
+               (BODY_SIZE != cbc[i].pos) ||
+               (0 != memcmp (body, cbc[i].buf, BODY_SIZE)) )
+            ret |= 16;
+          curl_multi_remove_handle (multi, c[i]);
+        }
+      if (0 != ret)
+        break;
+    }
+  /* close the connections while the daemon is running */
+  for (i = 0; i < NUM_CLIENTS; i++)
+    {
+      curl_easy_cleanup (c[i]);
+      free (cbc[i].buf);
+    }
+  curl_multi_cleanup (multi);
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  unsigned int i;
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  body = malloc (BODY_SIZE);
+  if (NULL == body)
+    return 2;
+  for (i = 0; i < BODY_SIZE; i++)
+    body[i] = (char) (i % 251);
+  errorCount += testZeroCopy (1125, MHD_USE_SELECT_INTERNALLY);
+  errorCount += testZeroCopy (1126, MHD_USE_POLL_INTERNALLY);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+    errorCount += testZeroCopy (1127, MHD_USE_EPOLL_INTERNALLY_LINUX_ONLY);
+  free (body);
+  if (errorCount != 0)
+    fprintf (stderr, "Error (code: %u)\n", errorCount);
+  curl_global_cleanup ();
+  return errorCount != 0;       /* 0 == pass */
+}